@@ -0,0 +1,442 @@
+/*******************************************************************************
+ * Description: Host driver for the Lab 3 calculator batch mode (batch.h).
+ *              Streams random requests over all 16 opcodes, keeping a window
+ *              of them in flight so the board receives, computes and sends
+ *              at once, and checks every result against a reference model
+ *              written from the opcode table in Lab_3_Assembly/main.S.
+ *              Reports the host round trip rate and the rate the board
+ *              measured (BATCH_OP_STATS).
+ *
+ *              With no device the board is stood in for by a child process
+ *              on a local pseudo-terminal, running batch.c and calculator.c
+ *              as built for the host. Given a device (e.g. /dev/ttyUSB1) it
+ *              talks to the board at 115200 baud.
+ *
+ * Build:       gcc -O2 -I../Lab_3_C batch_driver.c ../Lab_3_C/batch.c ../Lab_3_C/calculator.c -o batch_driver
+ * Usage:       ./batch_driver [device] [requests]
+ ******************************************************************************/
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "batch.h"
+
+#define DEFAULT_REQUESTS 100000
+
+// Requests sent ahead of their responses. 64 requests (704 bytes) fit the
+// board's 1024 byte receive buffer, so it never has to drop input.
+#define WINDOW 64
+
+typedef struct
+{
+    uint8_t opcode;
+    uint32_t op1;
+    uint32_t op2;
+} request_t;
+
+static int standin_fd = -1;
+
+/************************************************************
+ * Function: now_micros
+ * Description: Monotonic time for the stand-in's receive
+ *              stamps and the host's own rate.
+ ************************************************************/
+static uint64_t now_micros()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000u + now.tv_nsec / 1000;
+}
+
+/************************************************************
+ * Function: write_all
+ * Description: Writes every byte, retrying short writes.
+ ************************************************************/
+static void write_all(int fd, const uint8_t *data, uint32_t length)
+{
+    while(length)
+    {
+        ssize_t written = write(fd, data, length);
+
+        if(written < 0)
+        {
+            perror("write");
+            exit(1);
+        }
+
+        data += written;
+        length -= written;
+    }
+}
+
+/************************************************************
+ * Function: standin_write
+ * Description: batch_write_t for the stand-in, the UART TX.
+ ************************************************************/
+static void standin_write(const uint8_t *data, uint32_t length)
+{
+    write_all(standin_fd, data, length);
+}
+
+/************************************************************
+ * Function: run_standin
+ * Description: The stand-in board: feeds whatever arrives on
+ *              the pseudo-terminal to batch_feed until the
+ *              driver closes it.
+ ************************************************************/
+static void run_standin(int fd)
+{
+    static batch_t batch;
+    uint8_t rx[64];
+    ssize_t received;
+
+    standin_fd = fd;
+    batch_init(&batch, standin_write);
+
+    while((received = read(fd, rx, sizeof(rx))) > 0)
+    {
+        batch_feed(&batch, rx, received, now_micros());
+    }
+
+    exit(0);
+}
+
+/************************************************************
+ * Function: make_raw
+ * Description: Puts a terminal in raw 8N1 mode at 115200 baud
+ *              so every byte value passes through unchanged.
+ ************************************************************/
+static void make_raw(int fd)
+{
+    struct termios tio;
+
+    if(tcgetattr(fd, &tio) < 0)
+    {
+        perror("tcgetattr");
+        exit(1);
+    }
+
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, B115200);
+    cfsetospeed(&tio, B115200);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+
+    if(tcsetattr(fd, TCSANOW, &tio) < 0)
+    {
+        perror("tcsetattr");
+        exit(1);
+    }
+}
+
+/************************************************************
+ * Function: open_standin
+ * Description: Opens a pseudo-terminal pair and forks the
+ *              stand-in board onto the secondary side.
+ * Returns: File descriptor of the primary side
+ ************************************************************/
+static int open_standin(pid_t *child)
+{
+    int primary = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if(primary < 0 || grantpt(primary) < 0 || unlockpt(primary) < 0)
+    {
+        perror("posix_openpt");
+        exit(1);
+    }
+
+    int secondary = open(ptsname(primary), O_RDWR | O_NOCTTY);
+
+    if(secondary < 0)
+    {
+        perror("open pts");
+        exit(1);
+    }
+
+    make_raw(secondary);
+    make_raw(primary);
+
+    *child = fork();
+
+    if(*child == 0)
+    {
+        close(primary);
+        run_standin(secondary);
+    }
+
+    close(secondary);
+
+    return primary;
+}
+
+/************************************************************
+ * Function: reference_calculate
+ * Description: The calculator opcodes as specified by
+ *              calculate_table, kept apart from calculate() so
+ *              the two check each other. Shifts use the low byte
+ *              of op2 like LSL/LSR by a register, so 32-255
+ *              shift every bit out.
+ ************************************************************/
+static uint32_t reference_calculate(uint8_t opcode, uint32_t op1, uint32_t op2, uint32_t *storage)
+{
+    switch(opcode)
+    {
+        case 0: return op1 + op2;                               // ADD
+        case 1: return op1 - op2;                               // SUB
+        case 2: return op2 - op1;                               // RSB
+        case 3: return op1 * op2;                               // MUL
+        case 4: return op1 * op2 + *storage;                    // MLA
+        case 5: return op1 == op2;                              // TEQ
+        case 6: return op2 & 0xE0 ? 0 : op1 << (op2 & 31);     // LSL
+        case 7: return op2 & 0xE0 ? 0 : op1 >> (op2 & 31);     // LSR
+        case 8: return op1 & op2;                               // AND
+        case 9: return op1 | op2;                               // ORR
+        case 10: return op1 ^ op2;                              // EOR
+        case 11: return op1 & ~op2 & 0xFFFF;                    // BIC, 16-bit
+        case 12: return ~op1 & 0xFFFF;                          // MVN, 16-bit
+        case 13:                                                // CLZ, 16-bit
+        {
+            uint32_t count = 0;
+
+            while(count < 16 && !(op1 & (0x8000 >> count)))
+            {
+                count++;
+            }
+
+            return count;
+        }
+        case 14: *storage = op1; return 0;                      // STR
+        default: return *storage;                               // LDR
+    }
+}
+
+/************************************************************
+ * Function: make_request
+ * Description: Encodes a request frame.
+ ************************************************************/
+static void make_request(uint8_t *frame, const request_t *request)
+{
+    frame[0] = BATCH_REQUEST_SYNC;
+    frame[1] = request->opcode;
+
+    for(uint32_t i = 0; i < 4; i++)
+    {
+        frame[2 + i] = request->op1 >> (8 * i);
+        frame[6 + i] = request->op2 >> (8 * i);
+    }
+
+    frame[10] = 0;
+
+    for(uint32_t i = 1; i < 10; i++)
+    {
+        frame[10] ^= frame[i];
+    }
+}
+
+/************************************************************
+ * Function: next_response
+ * Description: Finds the next valid response in the receive
+ *              buffer, skipping anything else the board prints.
+ * Returns: 1 with status and result set, 0 if more bytes are
+ *          needed
+ ************************************************************/
+static int next_response(uint8_t *buffer, uint32_t *length, uint8_t *status, uint32_t *result)
+{
+    uint32_t start = 0;
+    int found = 0;
+
+    while(*length - start >= BATCH_RESPONSE_SIZE)
+    {
+        uint8_t *frame = &buffer[start];
+        uint8_t checksum = 0;
+
+        for(uint32_t i = 1; i < BATCH_RESPONSE_SIZE - 1; i++)
+        {
+            checksum ^= frame[i];
+        }
+
+        if(frame[0] != BATCH_RESPONSE_SYNC || checksum != frame[BATCH_RESPONSE_SIZE - 1])
+        {
+            start++;
+            continue;
+        }
+
+        *status = frame[1];
+        *result = frame[2] | (frame[3] << 8) | (frame[4] << 16) | ((uint32_t)frame[5] << 24);
+        start += BATCH_RESPONSE_SIZE;
+        found = 1;
+        break;
+    }
+
+    memmove(buffer, &buffer[start], *length - start);
+    *length -= start;
+
+    return found;
+}
+
+int main(int argc, char **argv)
+{
+    const char *device = argc > 1 && strcmp(argv[1], "-") ? argv[1] : 0;
+    uint32_t count = argc > 2 ? strtoul(argv[2], 0, 0) : DEFAULT_REQUESTS;
+    pid_t child = 0;
+    int fd;
+
+    if(device)
+    {
+        fd = open(device, O_RDWR | O_NOCTTY);
+
+        if(fd < 0)
+        {
+            perror(device);
+            return 1;
+        }
+
+        make_raw(fd);
+        tcflush(fd, TCIOFLUSH);
+    }
+    else
+    {
+        fd = open_standin(&child);
+    }
+
+    // Shift amounts at and past the register width
+    static const request_t edge_cases[] =
+    {
+        {6, 0x80000001, 31}, {6, 0x80000001, 32}, {6, 0xFFFFFFFF, 255}, {6, 0x00000003, 256},
+        {7, 0x80000001, 31}, {7, 0x80000001, 32}, {7, 0xFFFFFFFF, 255}, {7, 0xC0000000, 257}
+    };
+    uint32_t edge_count = sizeof(edge_cases) / sizeof(edge_cases[0]);
+
+    // The stream is RESET, the edge cases, count random operations, then STATS
+    count += edge_count;
+    uint32_t total = count + 2;
+    request_t *requests = malloc(total * sizeof(request_t));
+    uint32_t seed = 1;
+
+    requests[0] = (request_t){BATCH_OP_RESET, 0, 0};
+    requests[total - 1] = (request_t){BATCH_OP_STATS, 0, 0};
+    memcpy(&requests[1], edge_cases, sizeof(edge_cases));
+
+    for(uint32_t i = 1 + edge_count; i <= count; i++)
+    {
+        seed = seed * 1664525 + 1013904223;
+        uint8_t opcode = seed >> 28;
+        uint32_t op1 = seed * 2654435761u;
+        seed = seed * 1664525 + 1013904223;
+        uint32_t op2 = seed;
+
+        // Small values so TEQ and CLZ see their interesting cases
+        if(i & 1) op2 = op1 ^ (seed >> 30);
+        if(i & 2) op1 >>= seed & 31;
+
+        requests[i] = (request_t){opcode, op1, op2};
+    }
+
+    uint8_t rx[4096];
+    uint32_t rx_length = 0;
+    uint32_t sent = 0;
+    uint32_t answered = 0;
+    uint32_t errors = 0;
+    uint32_t storage = 0;
+    uint32_t board_rate = 0;
+    uint64_t start = now_micros();
+
+    while(answered < total)
+    {
+        struct pollfd pfd = {fd, POLLIN | (sent < total && sent - answered < WINDOW ? POLLOUT : 0), 0};
+
+        if(poll(&pfd, 1, 2000) <= 0)
+        {
+            printf("timed out with %u of %u answered\n", answered, total);
+            errors++;
+            break;
+        }
+
+        if(pfd.revents & POLLOUT)
+        {
+            uint8_t frames[WINDOW * BATCH_REQUEST_SIZE];
+            uint32_t frame_count = 0;
+
+            while(sent < total && sent - answered < WINDOW)
+            {
+                make_request(&frames[frame_count++ * BATCH_REQUEST_SIZE], &requests[sent++]);
+            }
+
+            write_all(fd, frames, frame_count * BATCH_REQUEST_SIZE);
+        }
+
+        if(pfd.revents & POLLIN)
+        {
+            ssize_t received = read(fd, &rx[rx_length], sizeof(rx) - rx_length);
+
+            if(received <= 0)
+            {
+                printf("device closed\n");
+                errors++;
+                break;
+            }
+
+            rx_length += received;
+        }
+
+        uint8_t status;
+        uint32_t result;
+
+        while(answered < sent && next_response(rx, &rx_length, &status, &result))
+        {
+            const request_t *request = &requests[answered++];
+
+            if(request->opcode == BATCH_OP_STATS)
+            {
+                board_rate = result;
+            }
+            else if(request->opcode == BATCH_OP_RESET)
+            {
+                storage = 0;
+            }
+            else
+            {
+                uint32_t expected = reference_calculate(request->opcode, request->op1, request->op2, &storage);
+
+                if(status != BATCH_OK || result != expected)
+                {
+                    if(errors < 10)
+                    {
+                        printf("mismatch at %u: opcode %u %08X %08X: status %u result %08X, expected %08X\n",
+                               answered - 1, request->opcode, request->op1, request->op2, status, result, expected);
+                    }
+
+                    errors++;
+                }
+            }
+        }
+    }
+
+    uint64_t elapsed = now_micros() - start;
+
+    close(fd);
+
+    if(child > 0)
+    {
+        waitpid(child, 0, 0);
+    }
+
+    printf("%u requests, %u errors\n", count, errors);
+    printf("host round trip  %10.0f ops/s\n", elapsed ? count * 1e6 / elapsed : 0.0);
+    printf("board reported   %10u ops/s\n", board_rate);
+
+    free(requests);
+
+    return errors ? 1 : 0;
+}
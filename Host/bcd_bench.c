@@ -0,0 +1,190 @@
+/*******************************************************************************
+ * Description: Host benchmark for the seven-segment BCD conversion. Runs
+ *              bin_to_bcd (Lab_5_C/sevensegdisplay.c) over every displayable
+ *              value 0 - 9999 next to the original repeated subtraction and
+ *              a double dabble, checks all three agree, and reports the mean
+ *              and worst time per conversion. A flat worst case is what keeps
+ *              the display update bounded inside an ISR. udiv/umod are
+ *              checked against the C operators.
+ *
+ * Build:       gcc -O2 -I../Lab_5_C bcd_bench.c ../Lab_5_C/sevensegdisplay.c -o bcd_bench
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include "host_timer.h"
+#include "sevensegdisplay.h"
+
+#define DISPLAY_MAX 9999
+#define REPEATS 16                  // Conversions timed together per value
+#define TRIALS 8                    // Fastest trial kept, dropping host interrupts
+
+/************************************************************
+ * Function: subtraction_bcd
+ * Description: The original bin_to_bcd: each digit found by
+ *              repeatedly subtracting 10 (unsigned_division),
+ *              so the cost grows with the value.
+ ************************************************************/
+static __attribute__((noinline)) uint32_t subtraction_bcd(uint32_t value)
+{
+    uint32_t bcd = 0;
+
+    for(uint32_t digit = 0; digit < SEVSEG_DIGITS; digit++)
+    {
+        uint32_t quotient = 0;
+
+        while(value >= 10)
+        {
+            value -= 10;
+            quotient++;
+        }
+
+        bcd |= value << (digit * 8);
+        value = quotient;
+    }
+
+    return bcd;
+}
+
+/************************************************************
+ * Function: dabble_bcd
+ * Description: Double dabble over the 14 bits of 0 - 9999,
+ *              packed to one digit per byte at the end.
+ ************************************************************/
+static __attribute__((noinline)) uint32_t dabble_bcd(uint32_t value)
+{
+    uint32_t packed = 0;
+    uint32_t bcd = 0;
+
+    for(int bit = 13; bit >= 0; bit--)
+    {
+        for(uint32_t shift = 0; shift < 16; shift += 4)
+        {
+            if(((packed >> shift) & 0xF) >= 5)
+            {
+                packed += 3 << shift;
+            }
+        }
+
+        packed = (packed << 1) | ((value >> bit) & 1);
+    }
+
+    for(uint32_t digit = 0; digit < SEVSEG_DIGITS; digit++)
+    {
+        bcd |= ((packed >> (digit * 4)) & 0xF) << (digit * 8);
+    }
+
+    return bcd;
+}
+
+/************************************************************
+ * Function: time_conversion
+ * Description: Times a converter over 0 - DISPLAY_MAX and
+ *              prints the mean and worst ticks per conversion,
+ *              each value's time the fastest of TRIALS runs.
+ * Input parameters:
+ *      - name: Label for the report
+ *      - convert: Conversion to time
+ * Returns: None
+ ************************************************************/
+static void time_conversion(const char *name, uint32_t (*convert)(uint32_t))
+{
+    volatile uint32_t sink;
+    uint64_t total = 0;
+    uint64_t worst = 0;
+    uint32_t worst_value = 0;
+
+    for(uint32_t value = 0; value <= DISPLAY_MAX; value++)
+    {
+        uint64_t ticks = UINT64_MAX;
+
+        for(uint32_t trial = 0; trial < TRIALS; trial++)
+        {
+            uint64_t start = host_timer_ticks();
+
+            for(uint32_t i = 0; i < REPEATS; i++)
+            {
+                sink = convert(value);
+            }
+
+            uint64_t elapsed = host_timer_ticks() - start;
+
+            if(elapsed < ticks)
+            {
+                ticks = elapsed;
+            }
+        }
+
+        total += ticks;
+
+        if(ticks > worst)
+        {
+            worst = ticks;
+            worst_value = value;
+        }
+    }
+
+    (void)sink;
+    printf("%-12s %8.1f %8.1f  (worst at %u)\n", name, (double)total / ((DISPLAY_MAX + 1) * REPEATS),
+           (double)worst / REPEATS, worst_value);
+}
+
+int main()
+{
+    uint32_t errors = 0;
+
+    for(uint32_t value = 0; value <= DISPLAY_MAX; value++)
+    {
+        uint32_t expected = subtraction_bcd(value);
+
+        if(bin_to_bcd(value) != expected || dabble_bcd(value) != expected)
+        {
+            printf("mismatch at %u: 0x%08X 0x%08X 0x%08X\n", value, expected, bin_to_bcd(value), dabble_bcd(value));
+            errors++;
+        }
+    }
+
+    // Values past the display keep their low four digits
+    for(uint32_t value = 0xFFFFFFFF; value > 0xFFFF0000; value -= 7)
+    {
+        if(bin_to_bcd(value) != subtraction_bcd(value % 10000))
+        {
+            printf("mismatch at %u\n", value);
+            errors++;
+        }
+    }
+
+    uint32_t seed = 1;
+
+    for(uint32_t i = 0; i < 1000000; i++)
+    {
+        seed = seed * 1664525 + 1013904223;
+        uint32_t numerator = seed;
+        uint32_t denominator = (seed >> (i & 31)) | 1;
+
+        if(udiv(numerator, denominator) != numerator / denominator || umod(numerator, denominator) != numerator % denominator)
+        {
+            printf("udiv/umod mismatch at %u / %u\n", numerator, denominator);
+            errors++;
+        }
+    }
+
+    if(udiv(5, 0) != 0xFFFFFFFF || umod(5, 0) != 0xFFFFFFFF)
+    {
+        printf("udiv/umod by zero did not return 0xFFFFFFFF\n");
+        errors++;
+    }
+
+    if(errors)
+    {
+        return 1;
+    }
+
+    printf("0 - %u, %s per conversion\n", DISPLAY_MAX, HOST_TIMER_UNIT);
+    printf("%-12s %8s %8s\n", "", "mean", "worst");
+    time_conversion("subtraction", subtraction_bcd);
+    time_conversion("double dabble", dabble_bcd);
+    time_conversion("reciprocal", bin_to_bcd);
+
+    return 0;
+}
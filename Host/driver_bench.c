@@ -0,0 +1,845 @@
+/*******************************************************************************
+ * Description: Host benchmark for the Lab 3 and Lab 5 C drivers, built
+ *              against the simulated peripherals in sim/mmio_sim.c. Checks
+ *              that each driver produces the expected register state, then
+ *              reports its cost per call in register reads and writes and
+ *              in host time. Interrupts are delivered by calling IRQ_Handler
+ *              while the simulated GIC asserts one, and by the simulator
+ *              itself when one preempts a nested handler. The motor PWM is
+ *              checked on the recorded JB waveform. With PROFILE_ENABLE
+ *              (and ../Lab_3_C/profile.c) the probes in the handlers are
+ *              printed as well, in simulated time.
+ *
+ * Build:       gcc -O2 -DMMIO_HOST -Isim -I../Lab_3_C -I../Lab_5_C driver_bench.c sim/mmio_sim.c
+ *                  ../Lab_3_C/serial.c ../Lab_3_C/format.c ../Lab_3_C/pmodb.c ../Lab_3_C/switches.c
+ *                  ../Lab_3_C/led.c ../Lab_3_C/led_engine.c ../Lab_3_C/motor.c ../Lab_3_C/hexpad.c ../Lab_3_C/input.c ../Lab_3_C/interrupt.c
+ *                  ../Lab_3_C/timers.c ../Lab_3_C/task.c ../Lab_3_C/profile.c ../Lab_3_C/shell.c ../Lab_5_C/sevensegdisplay.c
+ *                  -o driver_bench
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "host_timer.h"
+#include "mmio_sim.h"
+#include "serial.h"
+#include "pmodb.h"
+#include "switches.h"
+#include "led.h"
+#include "led_engine.h"
+#include "motor.h"
+#include "hexpad.h"
+#include "input.h"
+#include "interrupt.h"
+#include "timers.h"
+#include "sevensegdisplay.h"
+#include "profile.h"
+#include "shell.h"
+
+#define ITERATIONS 100000
+
+static uint32_t errors = 0;
+static volatile uint32_t sink = 0;
+
+/************************************************************
+ * Function: run_irqs
+ * Description: Takes interrupts until the GIC has none left
+ *              to signal, as the CPU would with IRQs unmasked.
+ ************************************************************/
+static void run_irqs()
+{
+    while(mmio_sim_irq_asserted())
+    {
+        IRQ_Handler(0);
+    }
+}
+
+/************************************************************
+ * Function: run_for_us
+ * Description: Lets simulated time pass in 10 us steps,
+ *              taking interrupts as they come due.
+ ************************************************************/
+static void run_for_us(uint64_t us)
+{
+    for(uint64_t step = 0; step < us; step += 10)
+    {
+        mmio_sim_advance_us(10);
+        run_irqs();
+    }
+}
+
+/************************************************************
+ * Function: check
+ * Description: Counts and reports a failed expectation.
+ ************************************************************/
+static void check(int condition, const char *what)
+{
+    if(!condition)
+    {
+        printf("FAILED: %s\n", what);
+        errors++;
+    }
+}
+
+/************************************************************
+ * Function: report
+ * Description: Prints the access counts and host time of a
+ *              measured run per call.
+ ************************************************************/
+static void report(const char *name, uint32_t calls, uint64_t ticks)
+{
+    mmio_sim_counts_t counts = mmio_sim_get_total_counts();
+
+    printf("%-24s %8.2f %8.2f %10.1f %s\n", name, (double)counts.reads / calls, (double)counts.writes / calls,
+           (double)ticks / calls, HOST_TIMER_UNIT);
+}
+
+// Runs a statement ITERATIONS times with clean counters and reports it
+#define MEASURE(name, statement) \
+    do \
+    { \
+        mmio_sim_clear_counts(); \
+        uint64_t start = host_timer_ticks(); \
+        for(uint32_t i = 0; i < ITERATIONS; i++) \
+        { \
+            statement; \
+        } \
+        report(name, ITERATIONS, host_timer_ticks() - start); \
+    } while(0)
+
+/************************************************************
+ * Function: test_leds
+ * Description: LEDs, RGB PWM and seven-segment output.
+ ************************************************************/
+static void test_leds()
+{
+    set_leds_10bit(0x2A5);
+    check(mmio_sim_peek(LED_BASEADDR) == 0x2A5, "set_leds_10bit");
+
+    set_rgb_color(11, 10, 20, 30);
+    check(mmio_sim_peek(RGB11_BASEADDR + RGB_RED_OFFSET + RGB_WIDTH_OFFSET) == 10 &&
+          mmio_sim_peek(RGB11_BASEADDR + RGB_GREEN_OFFSET + RGB_WIDTH_OFFSET) == 20 &&
+          mmio_sim_peek(RGB11_BASEADDR + RGB_BLUE_OFFSET + RGB_WIDTH_OFFSET) == 30, "set_rgb_color");
+
+    init_seven_seg();
+    write_seven_seg_dec(1234);
+    check(mmio_sim_peek(SEVSEG_BASEADDR + SEVSEG_DATA_OFFSET) == 0x065B4F66, "write_seven_seg_dec");
+
+    mmio_sim_clear_counts();
+    write_seven_seg_dec(1234);
+    check(mmio_sim_get_total_counts().writes == 0, "write_seven_seg_dec skips an unchanged value");
+
+    write_seven_seg_hex(0xBEEF);
+    check(mmio_sim_peek(SEVSEG_BASEADDR + SEVSEG_DATA_OFFSET) == 0x7C797971, "write_seven_seg_hex");
+
+    write_seven_seg_signed(-42);
+    check(mmio_sim_peek(SEVSEG_BASEADDR + SEVSEG_DATA_OFFSET) == 0x403F665B, "write_seven_seg_signed");
+
+    seven_seg_set_blank_zeros(true);
+    check(mmio_sim_peek(SEVSEG_BASEADDR + SEVSEG_DATA_OFFSET) == 0x0040665B, "signed with blanked zeros");
+
+    seven_seg_set_points(0b0010);
+    write_seven_seg_dec(7);
+    check(mmio_sim_peek(SEVSEG_BASEADDR + SEVSEG_DATA_OFFSET) == 0x00008007, "blanked zeros and a decimal point");
+
+    seven_seg_set_points(0);
+    seven_seg_set_blank_zeros(false);
+
+    set_led(3, true);
+    set_led(6, true);
+    set_led(3, false);
+    check(mmio_sim_peek(LED_BASEADDR) == 0x2E5, "set_led leaves other LEDs alone");
+
+    MEASURE("set_leds_10bit", set_leds_10bit(i));
+    MEASURE("set_leds_12bit", set_leds_12bit(i));
+    MEASURE("set_rgb_color", set_rgb_color(10, i, i, i));
+    MEASURE("set_rgb_color same", set_rgb_color(10, 5, 6, 7));
+    MEASURE("write_seven_seg_dec", write_seven_seg_dec(i));
+    MEASURE("write_seven_seg_dec same", write_seven_seg_dec(42));
+    MEASURE("write_seven_seg_signed", write_seven_seg_signed(i - ITERATIONS / 2));
+}
+
+/************************************************************
+ * Function: test_led_engine
+ * Description: Fades and blinks run from the timer tick.
+ ************************************************************/
+static void test_led_engine()
+{
+    led_engine_init();
+    set_leds_10bit(0);
+
+    led_engine_fade(11, LED_LEVEL_MAX, 0, 0, 100);
+    run_for_us(50000);
+    uint32_t red = mmio_sim_peek(RGB11_BASEADDR + RGB_RED_OFFSET + RGB_WIDTH_OFFSET);
+    check(red > led_gamma(LED_LEVEL_MAX / 4) && red < led_gamma(LED_LEVEL_MAX * 3 / 4), "fade half way");
+
+    run_for_us(60000);
+    check(mmio_sim_peek(RGB11_BASEADDR + RGB_RED_OFFSET + RGB_WIDTH_OFFSET) == RGB_PERIOD &&
+          !led_engine_playing(11), "fade done");
+
+    set_led(2, true);
+    led_engine_blink(5, 50, 50);
+    run_for_us(25000);
+    check(mmio_sim_peek(LED_BASEADDR) == 0x24, "blink on");
+    run_for_us(50000);
+    check(mmio_sim_peek(LED_BASEADDR) == 0x04, "blink off");
+
+    mmio_sim_clear_counts();
+    run_for_us(1000000);
+    mmio_sim_counts_t leds = mmio_sim_get_counts(MMIO_SIM_LEDS);
+    check(leds.writes == 20, "blink writes only on changes");
+
+    led_engine_set(5, false);
+    run_for_us(20000);
+    check(mmio_sim_peek(LED_BASEADDR) == 0x04, "blink stopped");
+}
+
+/************************************************************
+ * Function: test_inputs
+ * Description: Buttons, switches and the debounced input
+ *              events.
+ ************************************************************/
+static void test_inputs()
+{
+    input_event_t event;
+
+    mmio_sim_set_switches(0xA5C);
+    mmio_sim_set_buttons(0b0100);
+    check(get_switches() == 0xA5C && get_buttons() == 0b0100, "get_switches/get_buttons");
+
+    input_init();
+    mmio_sim_set_buttons(0b1000);
+    run_for_us(20000);
+    check(input_poll(&event) && event.type == INPUT_BUTTON_RELEASE && event.index == 2, "button 2 release");
+    check(input_poll(&event) && event.type == INPUT_BUTTON_PRESS && event.index == 3, "button 3 press");
+    check(!input_poll(&event), "no further input events");
+
+    MEASURE("get_switches", sink += get_switches());
+    MEASURE("input_sample_isr", input_sample_isr(0));
+}
+
+/************************************************************
+ * Function: test_pmod
+ * Description: PMOD pin writes and the keypad scanner.
+ ************************************************************/
+static void test_pmod()
+{
+    hexpad_event_t event;
+
+    hexpad_init();
+    mmio_sim_set_keys(1 << 0x5);
+    run_for_us(40000);
+    check(hexpad_poll(&event) && event.key == 0x5 && event.pressed, "key 5 press");
+
+    mmio_sim_set_keys(0);
+    run_for_us(40000);
+    check(hexpad_poll(&event) && event.key == 0x5 && !event.pressed, "key 5 release");
+    check(!hexpad_poll(&event), "no further key events");
+
+    pmod_write_pins(0b0110);
+    check((mmio_sim_get_pmod_pins() & 0x0F) == 0b0110, "pmod_write_pins");
+
+    MEASURE("pmod_write_pins", pmod_write_pins(i & 0x0F));
+    MEASURE("pmod_read_pins", sink += pmod_read_pins());
+    MEASURE("pmod_toggle_pins", pmod_toggle_pins(0b0001));
+    MEASURE("hexpad_scan_isr", hexpad_scan_isr(0));
+}
+
+/************************************************************
+ * Function: run_fine_us
+ * Description: run_for_us in 1 us steps, for edge timing.
+ ************************************************************/
+static void run_fine_us(uint64_t us)
+{
+    for(uint64_t step = 0; step < us; step++)
+    {
+        mmio_sim_advance_us(1);
+        run_irqs();
+    }
+}
+
+/************************************************************
+ * Function: wave_next_edge
+ * Description: Finds the first recorded change of a pin at or
+ *              after a time, to a given level.
+ * Input parameters:
+ *      - pin: Pin bit, bit 0 = pin 1
+ *      - level: true for a rising edge
+ *      - after: Earliest time, in ticks
+ * Returns: uint64_t - Time of the edge, UINT64_MAX if none
+ ************************************************************/
+static uint64_t wave_next_edge(uint8_t pin, bool level, uint64_t after)
+{
+    for(uint32_t i = 1; i < mmio_sim_wave_count(); i++)
+    {
+        const mmio_sim_edge_t *edge = mmio_sim_wave_entry(i);
+        bool was = mmio_sim_wave_entry(i - 1)->pins & pin;
+
+        if(edge->time >= after && was != level && (bool)(edge->pins & pin) == level)
+        {
+            return edge->time;
+        }
+    }
+
+    return UINT64_MAX;
+}
+
+/************************************************************
+ * Function: wave_high_ticks
+ * Description: Adds up the time a pin was high between two
+ *              times in the recording.
+ * Input parameters:
+ *      - pin: Pin bit
+ *      - from, to: Window, in ticks
+ * Returns: uint64_t - Ticks high
+ ************************************************************/
+static uint64_t wave_high_ticks(uint8_t pin, uint64_t from, uint64_t to)
+{
+    uint64_t high = 0;
+
+    for(uint32_t i = 0; i < mmio_sim_wave_count(); i++)
+    {
+        const mmio_sim_edge_t *edge = mmio_sim_wave_entry(i);
+        uint64_t start = edge->time > from ? edge->time : from;
+        uint64_t end = i + 1 < mmio_sim_wave_count() ? mmio_sim_wave_entry(i + 1)->time : to;
+
+        if(end > to)
+        {
+            end = to;
+        }
+
+        if((edge->pins & pin) && end > start)
+        {
+            high += end - start;
+        }
+    }
+
+    return high;
+}
+
+/************************************************************
+ * Function: direction_changes_safe
+ * Description: Checks that every change of the direction pins
+ *              in the recording happened with that motor's
+ *              enable pin low on both sides of it.
+ ************************************************************/
+static bool direction_changes_safe()
+{
+    static const uint8_t pairs[MOTORS][2] =
+    {
+        {MOTOR_LEFT_DIRECTION, MOTOR_LEFT_ENABLE},
+        {MOTOR_RIGHT_DIRECTION, MOTOR_RIGHT_ENABLE}
+    };
+
+    for(uint32_t i = 1; i < mmio_sim_wave_count(); i++)
+    {
+        uint8_t before = mmio_sim_wave_entry(i - 1)->pins;
+        uint8_t after = mmio_sim_wave_entry(i)->pins;
+
+        for(uint32_t motor = 0; motor < MOTORS; motor++)
+        {
+            if(((before ^ after) & pairs[motor][0]) && ((before | after) & pairs[motor][1]))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/************************************************************
+ * Function: test_motor
+ * Description: Motor PWM on the recorded JB waveform: latency
+ *              from a command to the pins, duty cycle accuracy
+ *              once ramped, reversal through 0 and braking.
+ ************************************************************/
+static void test_motor()
+{
+    const uint64_t period = MOTOR_PERIOD_US * MMIO_SIM_TICKS_PER_US;
+
+    hexpad_stop();
+    motor_init();
+    mmio_sim_set_wave_recording(true);
+
+    // From stopped the first period starts at once
+    uint64_t command = mmio_sim_time();
+    motor_command(MOTION_FORWARD, 0x80);
+    run_fine_us(MOTOR_PERIOD_US);
+    uint64_t latency = wave_next_edge(MOTOR_LEFT_ENABLE, true, command) - command;
+    printf("%-24s %8.2f us from stopped\n", "motor latency", (double)latency / MMIO_SIM_TICKS_PER_US);
+    check(latency <= 10 * MMIO_SIM_TICKS_PER_US, "motor starts within 10 us");
+    check((mmio_sim_get_pmod_pins() & (MOTOR_LEFT_DIRECTION | MOTOR_RIGHT_DIRECTION)) ==
+          (MOTOR_LEFT_DIRECTION | MOTOR_RIGHT_DIRECTION), "both motors forward");
+
+    // 0x80 / MOTOR_RAMP_STEP periods to ramp up
+    run_fine_us(0x80 / MOTOR_RAMP_STEP * MOTOR_PERIOD_US);
+    check(motor_get_level(MOTOR_LEFT) == 0x80 && motor_get_level(MOTOR_RIGHT) == 0x80, "motor ramped to 0x80");
+
+    // Duty cycle over 20 whole periods
+    mmio_sim_set_wave_recording(true);
+    run_fine_us(22 * MOTOR_PERIOD_US);
+    uint64_t from = wave_next_edge(MOTOR_LEFT_ENABLE, true, 0);
+    double duty = (double)wave_high_ticks(MOTOR_LEFT_ENABLE, from, from + 20 * period) / (20 * period);
+    double expected = (double)0x80 / MOTOR_LEVEL_MAX;
+    printf("%-24s %8.4f %8.4f error %+.4f%%\n", "motor duty", duty, expected, (duty - expected) * 100);
+    check(duty - expected < 0.002 && expected - duty < 0.002, "motor duty within 0.2%");
+
+    // A command while running applies from the next period start
+    mmio_sim_set_wave_recording(true);
+    command = mmio_sim_time();
+    motor_command(MOTION_BACKWARD, 0x80);
+    run_fine_us(2 * MOTOR_PERIOD_US);
+    uint64_t start = wave_next_edge(MOTOR_LEFT_ENABLE, true, command);
+    uint64_t width = wave_next_edge(MOTOR_LEFT_ENABLE, false, start) - start;
+    latency = start - command;
+    printf("%-24s %8.2f us while running\n", "motor latency", (double)latency / MMIO_SIM_TICKS_PER_US);
+    check(latency <= period + 10 * MMIO_SIM_TICKS_PER_US, "motor command applies within a period");
+    check(width < (uint64_t)(expected * period), "motor ramps down from the next period");
+
+    // Reversal passes through 0 with the enable pins low
+    run_fine_us(2 * 0x80 / MOTOR_RAMP_STEP * MOTOR_PERIOD_US);
+    check(motor_get_level(MOTOR_LEFT) == -0x80 && motor_get_level(MOTOR_RIGHT) == -0x80, "motor reversed");
+    check(direction_changes_safe(), "direction changes only with the enable pin low");
+    uint64_t reversed = wave_next_edge(MOTOR_LEFT_DIRECTION, false, command);
+    check(reversed != UINT64_MAX && reversed - command >= (uint64_t)(0x80 / MOTOR_RAMP_STEP - 1) * period,
+          "direction waits for the ramp down");
+
+    // Brake ramps to 0 and stops the PWM timer
+    motor_command(MOTION_BRAKE, 0);
+    run_for_us(0x80 / MOTOR_RAMP_STEP * MOTOR_PERIOD_US + 1000);
+    uint32_t changes = mmio_sim_wave_count();
+    run_for_us(10000);
+    check(!(mmio_sim_get_pmod_pins() & (MOTOR_LEFT_ENABLE | MOTOR_RIGHT_ENABLE)) &&
+          mmio_sim_wave_count() == changes, "motor braked and idle");
+
+    MEASURE("motor_command", motor_command(MOTION_LEFT, i));
+
+    motor_release();
+    mmio_sim_set_wave_recording(false);
+    run_for_us(1000);
+}
+
+static uint32_t shell_calls = 0;
+static uint32_t shell_last_value = 0;
+
+/************************************************************
+ * Function: shell_set
+ * Description: Test command, keeps its number argument.
+ ************************************************************/
+static void shell_set(uint32_t argc, char *argv[])
+{
+    shell_calls++;
+    shell_parse_number(argv[1], &shell_last_value);
+}
+
+static const shell_command_t shell_test_commands[] = {{"set", "<value>", "test", 1, shell_set}};
+
+/************************************************************
+ * Function: test_serial_rx
+ * Description: Line reads, the shell, receive error counters
+ *              and input at the full line rate.
+ ************************************************************/
+static void test_serial_rx()
+{
+    char line[16];
+    uint8_t input[256];
+
+    const char *text = "set 3F\r\nset #12 x\nset\nsetsetsetsetsetset";
+    mmio_sim_uart_receive((const uint8_t*)text, strlen(text));
+    run_for_us(2000);
+
+    shell_init(shell_test_commands, 1);
+    check(serial_readline(line, sizeof(line)) == SERIAL_LINE_READY && !strcmp(line, "set 3F"), "readline CR");
+    shell_execute(line);
+    check(serial_readline(line, sizeof(line)) == SERIAL_LINE_READY && !strcmp(line, ""), "readline LF after CR");
+    check(serial_readline(line, sizeof(line)) == SERIAL_LINE_READY && !strcmp(line, "set #12 x"), "readline LF");
+    shell_execute(line);
+    check(serial_readline(line, sizeof(line)) == SERIAL_LINE_READY && !strcmp(line, "set"), "readline short command");
+    shell_execute(line);
+    check(shell_calls == 2 && shell_last_value == 12, "shell commands");
+
+    char many[] = "set 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16";
+    shell_execute(many);
+    check(shell_calls == 2, "shell refuses too many arguments");
+
+    uint32_t value = 0;
+    check(shell_parse_number("FFFFFFFF", &value) && value == 0xFFFFFFFF && !shell_parse_number("100000000", &value) &&
+          shell_parse_number("#4294967295", &value) && !shell_parse_number("#4294967296", &value) &&
+          shell_parse_number("-#2147483648", &value) && value == 0x80000000 && !shell_parse_number("-80000001", &value),
+          "shell numbers past 32 bits refused");
+    check(serial_readline(line, sizeof(line)) == SERIAL_LINE_NONE, "readline drops a long line until its end");
+    text = " #7\r\nsetsetsetsetset\n";
+    mmio_sim_uart_receive((const uint8_t*)text, strlen(text));
+    run_for_us(2000);
+    check(serial_readline(line, sizeof(line)) == SERIAL_LINE_TOO_LONG, "readline refuses a long line once");
+    check(serial_readline(line, sizeof(line)) == SERIAL_LINE_READY && !strcmp(line, ""), "readline LF after a long line");
+    check(serial_readline(line, sizeof(line)) == SERIAL_LINE_READY && !strcmp(line, "setsetsetsetset"),
+          "readline line that just fits");
+    check(serial_readline(line, sizeof(line)) == SERIAL_LINE_NONE, "readline waits for a line end");
+    serial_read(input, sizeof(input));
+    run_for_us(5000);
+    mmio_sim_uart_take_output(input, sizeof(input));
+
+    // 100 bytes in one burst overflow the 64 byte FIFO
+    uint32_t overruns = serial_get_rx_overruns();
+    memset(input, 'x', 100);
+    mmio_sim_uart_receive(input, 100);
+    run_for_us(2000);
+    check(serial_get_rx_overruns() == overruns + 1 && serial_read(input, sizeof(input)) == 64, "RX overrun counted");
+
+    mmio_sim_uart_framing_error();
+    run_irqs();
+    check(serial_get_rx_framing_errors() == 1, "RX framing error counted");
+
+    // 20000 bytes back to back at 115200 baud, read once a millisecond
+    uint32_t dropped = serial_get_rx_dropped();
+    uint32_t received = 0;
+    overruns = serial_get_rx_overruns();
+
+    for(uint32_t i = 0; i < 20000; i++)
+    {
+        uint8_t byte = i;
+
+        mmio_sim_uart_receive(&byte, 1);
+        run_for_us(87);
+
+        if(i % 12 == 0)
+        {
+            received += serial_read(input, sizeof(input));
+        }
+    }
+
+    run_for_us(2000);
+    received += serial_read(input, sizeof(input));
+    check(received == 20000 && serial_get_rx_dropped() == dropped && serial_get_rx_overruns() == overruns,
+          "full rate RX without loss");
+}
+
+static uint32_t slow_rx_before = 0;
+static uint32_t slow_rx_after = 0;
+
+/************************************************************
+ * Function: slow_callback
+ * Description: Timer wheel callback that takes 500 us, with
+ *              UART input arriving while it runs.
+ ************************************************************/
+static void slow_callback(void *context)
+{
+    slow_rx_before = serial_rx_available();
+    mmio_sim_uart_receive((const uint8_t*)"nested", 6);
+
+    for(uint32_t step = 0; step < 50; step++)
+    {
+        mmio_sim_advance_us(10);
+    }
+
+    slow_rx_after = serial_rx_available();
+}
+
+/************************************************************
+ * Function: test_nesting
+ * Description: The UART interrupt preempting a slow timer
+ *              wheel handler, which runs at a lower priority,
+ *              only with nesting on.
+ ************************************************************/
+static void test_nesting()
+{
+    uint8_t input[16];
+    sw_timer_t slow;
+
+    sw_timer_init(&slow, slow_callback, 0);
+    serial_read(input, sizeof(input));
+
+    for(uint32_t nesting = 0; nesting < 2; nesting++)
+    {
+        irq_set_nesting(nesting);
+        sw_timer_start(&slow, 100, 0);
+        run_for_us(1000);
+
+        uint32_t length = serial_read(input, sizeof(input));
+        check(length == 6 && !memcmp(input, "nested", 6), "RX after a slow handler");
+
+        if(nesting)
+        {
+            check(slow_rx_before == 0 && slow_rx_after == 6, "UART preempts the timer wheel");
+        }
+        else
+        {
+            check(slow_rx_before == 0 && slow_rx_after == 0, "UART waits for the timer wheel without nesting");
+        }
+    }
+}
+
+/************************************************************
+ * Function: test_serial
+ * Description: Interrupt-driven UART transmit and receive.
+ ************************************************************/
+static void test_serial()
+{
+    uint8_t output[256];
+    uint8_t input[64];
+    uint32_t length;
+
+    serial_print("value %d 0x%08X\n", -42, 0xBEEF);
+    run_for_us(5000);
+    length = mmio_sim_uart_take_output(output, sizeof(output) - 1);
+    output[length] = '\0';
+    check(!strcmp((char*)output, "value -42 0x0000BEEF\n"), "serial_print output");
+
+    const char *text = "hello from the host";
+    mmio_sim_uart_receive((const uint8_t*)text, strlen(text));
+    run_for_us(2000);
+    length = serial_read(input, sizeof(input));
+    check(length == strlen(text) && !memcmp(input, text, length), "serial_read input");
+
+    // 1000 lines of 16 bytes, each given time to go out on the line so the
+    // ring never fills and serial_print does not spin under SERIAL_TX_BLOCK
+    mmio_sim_clear_counts();
+    uint64_t ticks = 0;
+
+    for(uint32_t i = 0; i < 1000; i++)
+    {
+        uint64_t start = host_timer_ticks();
+        serial_print("line %8u\n", i);
+        ticks += host_timer_ticks() - start;
+
+        mmio_sim_advance_us(1500);
+        run_irqs();
+    }
+
+    report("serial_print (per line)", 1000, ticks);
+    check(mmio_sim_uart_take_output(output, sizeof(output)) == sizeof(output), "serial_print lines sent");
+
+    // 64 byte bursts through the RX interrupt
+    mmio_sim_clear_counts();
+    uint64_t start = host_timer_ticks();
+
+    for(uint32_t i = 0; i < 1000; i++)
+    {
+        mmio_sim_uart_receive(input, 32);
+        mmio_sim_uart_receive(input, 32);
+        run_irqs();
+        sink += serial_read(input, sizeof(input));
+    }
+
+    report("RX burst (per 64 bytes)", 1000, host_timer_ticks() - start);
+}
+
+static sw_timer_t late_timer;
+static uint64_t late_started = 0;
+static uint64_t late_fired = 0;
+static uint32_t periodic_runs = 0;
+static uint64_t periodic_fired = 0;
+
+/************************************************************
+ * Function: late_callback
+ * Description: Records when the restarted timer ran.
+ ************************************************************/
+static void late_callback(void *context)
+{
+    late_fired = get_micros();
+}
+
+/************************************************************
+ * Function: restart_callback
+ * Description: One-shot callback that takes 500 us, then
+ *              starts another timer on the now empty wheel.
+ ************************************************************/
+static void restart_callback(void *context)
+{
+    for(uint32_t step = 0; step < 50; step++)
+    {
+        mmio_sim_advance_us(10);
+    }
+
+    late_started = get_micros();
+    sw_timer_start(&late_timer, 20, 0);
+}
+
+/************************************************************
+ * Function: periodic_callback
+ * Description: Counts the runs of a periodic timer.
+ ************************************************************/
+static void periodic_callback(void *context)
+{
+    periodic_runs++;
+    periodic_fired = get_micros();
+}
+
+/************************************************************
+ * Function: test_wheel
+ * Description: Timer wheel corner cases, run first while the
+ *              wheel holds no other timers.
+ ************************************************************/
+static void test_wheel()
+{
+    // A timer started from a slow callback is not run early
+    sw_timer_t restart;
+    sw_timer_init(&restart, restart_callback, 0);
+    sw_timer_init(&late_timer, late_callback, 0);
+    sw_timer_start(&restart, 100, 0);
+    run_for_us(2000);
+    check(late_started && late_fired >= late_started + 20 && late_fired < late_started + 70,
+          "timer started from a slow callback");
+
+    // A periodic timer held up for 5.5 periods runs once, then keeps its phase
+    sw_timer_t periodic;
+    sw_timer_init(&periodic, periodic_callback, 0);
+    uint64_t start = get_micros();
+    sw_timer_start(&periodic, 1000, 1000);
+    mmio_sim_advance_us(6500);
+    run_irqs();
+    check(periodic_runs == 1, "late periodic timer runs once");
+    run_for_us(1000);
+    check(periodic_runs == 2 && periodic_fired >= start + 7000 && periodic_fired < start + 7050,
+          "late periodic timer keeps its phase");
+    sw_timer_cancel(&periodic);
+}
+
+/************************************************************
+ * Function: test_clock
+ * Description: get_micros and get_tick_millis against the
+ *              simulated clock, across odd tick counts.
+ ************************************************************/
+static void test_clock()
+{
+    bool exact = true;
+
+    for(uint32_t i = 0; i < 1000; i++)
+    {
+        mmio_sim_advance(i * 7919 + 333);
+
+        uint64_t before = mmio_sim_time();
+        uint64_t micros = get_micros();
+        uint32_t millis = get_tick_millis();
+        uint64_t after = mmio_sim_time();
+
+        exact = exact && micros >= before * 3 / 1000 && micros <= after * 3 / 1000 &&
+                millis >= (uint32_t)(before * 3 / 1000000) && millis <= (uint32_t)(after * 3 / 1000000);
+    }
+
+    check(exact, "get_micros and get_tick_millis follow the global timer");
+
+    MEASURE("get_micros", sink += get_micros());
+}
+
+/************************************************************
+ * Function: test_baud
+ * Description: Baud divisors over the range the UART can
+ *              make, and a rate change under traffic.
+ ************************************************************/
+static void test_baud()
+{
+    static const uint32_t rates[] =
+    {
+        300, 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200, 230400, 460800, 500000, 576000,
+        921600, 1000000, 1500000, 2000000, 2500000, 3000000, 3125000
+    };
+    serial_baud_t baud;
+    uint32_t bad = 0;
+
+    printf("\n%10s %6s %5s %10s %10s\n", "baud", "cd", "bdiv", "actual", "error ppm");
+
+    for(uint32_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++)
+    {
+        bool ok = serial_compute_baud(rates[i], &baud);
+        uint32_t divisor = baud.cd * (baud.bdiv + 1);
+
+        printf("%10u %6u %5u %10u %10d\n", rates[i], baud.cd, baud.bdiv, baud.actual, baud.error_ppm);
+
+        if(!ok || baud.cd < 1 || baud.cd > UART_CD_MAX || baud.bdiv < UART_BDIV_MIN || baud.bdiv > UART_BDIV_MAX ||
+           baud.actual != (UART_REF_CLOCK_HZ + divisor / 2) / divisor)
+        {
+            bad++;
+        }
+    }
+
+    check(!bad, "divisors for 300 baud to 3.125 Mbaud");
+    check(serial_compute_baud(115200, &baud) && baud.cd == 124 && baud.bdiv == 6, "115200 keeps CD 124, BDIV 6");
+    check(serial_compute_baud(1000000, &baud) && baud.error_ppm == 0, "1 Mbaud exact");
+    check(!serial_compute_baud(0, &baud) && !serial_compute_baud(1, &baud), "rates too low rejected");
+    check(!serial_compute_baud(13000000, &baud) && !serial_compute_baud(45000000, &baud), "rates off by over 2% rejected");
+
+    // Output queued before the change goes out at the old rate, the rest at the new one
+    uint8_t output[128];
+
+    run_for_us(20000);
+
+    while(mmio_sim_uart_take_output(output, sizeof(output)));
+
+    serial_print("%s", "before the change\n");
+    check(serial_set_baudrate(UART_BAUDRATE_1000000), "set 1 Mbaud");
+    check(mmio_sim_uart_take_output(output, sizeof(output)) == 18, "queued output sent before the change");
+    check(mmio_sim_peek(UART1_BAUDGEN_ADDR) == 20 && mmio_sim_peek(UART1_BAUDRATE_D_ADDR) == 4, "1 Mbaud divisors");
+
+    // 100 bytes take 1 ms at 1 Mbaud, 8.7 ms at 115200
+    for(uint32_t i = 0; i < 10; i++)
+    {
+        serial_print("%9u\n", i);
+    }
+
+    run_for_us(1100);
+    check(mmio_sim_uart_take_output(output, sizeof(output)) == 100, "TX paced at 1 Mbaud");
+
+    check(!serial_set_baudrate(45000000) && serial_get_baud()->actual == 1000000, "rejected rate leaves the UART alone");
+    check(serial_set_baudrate(UART_BAUDRATE_115200) && serial_get_baud()->cd == 124, "back to 115200");
+}
+
+#ifdef PROFILE_ENABLE
+/************************************************************
+ * Function: print_probes
+ * Description: Prints the profile probes that recorded
+ *              anything, in simulated nanoseconds.
+ ************************************************************/
+static void print_probes()
+{
+    printf("\n%-24s %8s %10s %10s %10s\n", "probe", "count", "min ns", "mean ns", "max ns");
+
+    for(uint32_t id = 0; id < PROFILE_PROBES; id++)
+    {
+        const profile_stats_t *probe = profile_get_stats(id);
+
+        if(probe->count)
+        {
+            printf("%-24s %8u %10llu %10llu %10llu\n", profile_probe_name(id), probe->count,
+                   (unsigned long long)probe->min * PROFILE_NS_PER_TICK,
+                   (unsigned long long)probe->total * PROFILE_NS_PER_TICK / probe->count,
+                   (unsigned long long)probe->max * PROFILE_NS_PER_TICK);
+        }
+    }
+}
+#endif // PROFILE_ENABLE
+
+int main()
+{
+    mmio_sim_reset();
+    init_GIC();
+    serial_init(UART_STOP_BIT_1, UART_DATA_BITS_8, UART_PARITY_NONE, UART_BAUDRATE_115200);
+    profile_init();
+
+    printf("%-24s %8s %8s %10s\n", "driver call", "reads", "writes", "host");
+
+    test_wheel();
+    test_leds();
+    test_led_engine();
+    test_inputs();
+    test_pmod();
+    test_motor();
+    test_serial();
+    test_serial_rx();
+    test_nesting();
+    test_clock();
+    test_baud();
+
+    mmio_sim_counts_t unmapped = mmio_sim_get_counts(MMIO_SIM_UNMAPPED);
+    check(unmapped.reads + unmapped.writes == 0, "no unmapped accesses");
+
+#ifdef PROFILE_ENABLE
+    print_probes();
+#endif
+
+    printf("%s\n", errors ? "FAILED" : "all checks passed");
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,136 @@
+/*******************************************************************************
+ * Description: Host microbenchmark for the Lab 3 serial formatter. Formats
+ *              the same integers with format_vprint (Lab_3_C/format.c) and
+ *              libc vsnprintf, checks that both produce identical text and
+ *              reports the time per formatted integer.
+ *
+ * Build:       gcc -O2 -I../Lab_3_C format_bench.c ../Lab_3_C/format.c -o format_bench
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "host_timer.h"
+#include "format.h"
+
+#define ITERATIONS 2000000
+
+static char sink[128];
+static uint32_t sink_length = 0;
+
+/************************************************************
+ * Function: sink_putc
+ * Description: Character sink standing in for the UART ring
+ *              buffer.
+ * Input parameters:
+ *      - c: Character to store
+ * Returns: None
+ ************************************************************/
+static void sink_putc(char c)
+{
+    sink[sink_length++ & 127] = c;
+}
+
+/************************************************************
+ * Function: stream_format
+ * Description: Formats through format_vprint into the sink.
+ ************************************************************/
+static void stream_format(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    sink_length = 0;
+    format_vprint(sink_putc, format, args);
+    va_end(args);
+    sink[sink_length & 127] = '\0';
+}
+
+/************************************************************
+ * Function: libc_format
+ * Description: Formats through vsnprintf into a stack buffer
+ *              the way serial_print used to.
+ ************************************************************/
+static void libc_format(char *buffer, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, 64, format, args);
+    va_end(args);
+}
+
+/************************************************************
+ * Function: check_matches_libc
+ * Description: Compares format_vprint against vsnprintf for a
+ *              spread of values and conversions.
+ * Returns: Number of mismatches
+ ************************************************************/
+static int check_matches_libc()
+{
+    static const char *formats[] = {"%x", "%d", "%u", "%8x", "%08X", "%-6d|", "%05d", "%10u"};
+    static const int32_t values[] = {0, 1, -1, 9, 10, 255, 4096, 9999, -12345, 0x7FFFFFFF, (int32_t)0x80000000};
+    char expected[64];
+    int mismatches = 0;
+
+    for(uint32_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++)
+    {
+        for(uint32_t v = 0; v < sizeof(values) / sizeof(values[0]); v++)
+        {
+            libc_format(expected, formats[f], values[v]);
+            stream_format(formats[f], values[v]);
+
+            if(strcmp(expected, sink))
+            {
+                printf("mismatch: \"%s\" of %d: libc \"%s\", format \"%s\"\n", formats[f], values[v], expected, sink);
+                mismatches++;
+            }
+        }
+    }
+
+    libc_format(expected, "%s=%c %-5s|%3c", "op", 'x', "ab", 'y');
+    stream_format("%s=%c %-5s|%3c", "op", 'x', "ab", 'y');
+    if(strcmp(expected, sink))
+    {
+        printf("mismatch: string/char: libc \"%s\", format \"%s\"\n", expected, sink);
+        mismatches++;
+    }
+
+    return mismatches;
+}
+
+int main(void)
+{
+    char buffer[64];
+    uint64_t start;
+    uint64_t libc_ticks;
+    uint64_t stream_ticks;
+
+    if(check_matches_libc())
+    {
+        return 1;
+    }
+
+    // Same value sequence for both so the digit counts match
+    start = host_timer_ticks();
+    for(uint32_t i = 0; i < ITERATIONS; i++)
+    {
+        libc_format(buffer, "%x %d", i * 2654435761u, (int32_t)(i * 40503u));
+        __asm__ volatile("" : : "r"(buffer) : "memory");
+    }
+    libc_ticks = host_timer_ticks() - start;
+
+    start = host_timer_ticks();
+    for(uint32_t i = 0; i < ITERATIONS; i++)
+    {
+        stream_format("%x %d", i * 2654435761u, (int32_t)(i * 40503u));
+        __asm__ volatile("" : : "r"(sink) : "memory");
+    }
+    stream_ticks = host_timer_ticks() - start;
+
+    // Two integers are formatted per iteration
+    printf("%-14s %10.1f %s/integer\n", "vsnprintf", (double)libc_ticks / (2.0 * ITERATIONS), HOST_TIMER_UNIT);
+    printf("%-14s %10.1f %s/integer\n", "format_vprint", (double)stream_ticks / (2.0 * ITERATIONS), HOST_TIMER_UNIT);
+    printf("speedup        %10.2fx\n", (double)libc_ticks / (double)stream_ticks);
+
+    return 0;
+}
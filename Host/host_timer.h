@@ -0,0 +1,25 @@
+#ifndef HOST_TIMER_H
+#define HOST_TIMER_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Cycle counter where the host has one, nanoseconds otherwise
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HOST_TIMER_UNIT "cycles"
+static inline uint64_t host_timer_ticks()
+{
+    return __rdtsc();
+}
+#else
+#define HOST_TIMER_UNIT "ns"
+static inline uint64_t host_timer_ticks()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+#endif
+
+#endif // HOST_TIMER_H
@@ -0,0 +1,1213 @@
+/*******************************************************************************
+ * Description: Host model of the Zybo peripherals used by the C drivers,
+ *              reached through mmio_read/mmio_write when they are built with
+ *              MMIO_HOST. Register behaviour follows the Zynq-7000 TRM
+ *              (UG585) closely enough for the drivers' use of it; see
+ *              mmio_sim.h for what is covered.
+ ******************************************************************************/
+
+#include "mmio_sim.h"
+#include <string.h>
+
+// UART1
+#define UART_BASE 0xE0001000
+#define UART_CTRL 0x00
+#define UART_MODE 0x04
+#define UART_IER 0x08
+#define UART_IDR 0x0C
+#define UART_IMR 0x10
+#define UART_ISR 0x14
+#define UART_BAUDGEN 0x18
+#define UART_RXTOUT 0x1C
+#define UART_RXWM 0x20
+#define UART_SR 0x2C
+#define UART_FIFO 0x30
+#define UART_BAUDDIV 0x34
+
+#define UART_CTRL_RXRST 0x01
+#define UART_CTRL_TXRST 0x02
+#define UART_CTRL_RSTTO 0x40
+
+// Status and interrupt bits share positions
+#define UART_RTRIG 0x001
+#define UART_REMPTY 0x002
+#define UART_RFUL 0x004
+#define UART_TEMPTY 0x008
+#define UART_TFUL 0x010
+#define UART_ROVR 0x020
+#define UART_FRAME 0x040
+#define UART_TIMEOUT 0x100
+#define UART_TACTIVE 0x800          // Status only
+
+#define UART_FIFO_SIZE 64
+#define UART_REF_CLOCK 100000000ull
+#define UART_OUTPUT_SIZE 65536
+
+// GPIO bank 2
+#define GPIO_BASE 0xE000A000
+#define GPIO_MASK_DATA_2_LSW 0x010
+#define GPIO_MASK_DATA_2_MSW 0x014
+#define GPIO_DATA_2 0x048
+#define GPIO_DATA_2_RO 0x068
+#define GPIO_DIRM_2 0x284
+#define GPIO_OEN_2 0x288
+
+// The keypad on JB, bank 2 bits 7-14: columns 1-4 on pins 4-1, rows 1-4
+// on pins 8-5
+#define PMOD_SHIFT 7
+
+// AXI blocks
+#define BUTTON_BASE 0x41200000
+#define LED_BASE 0x41210000
+#define SWITCH_BASE 0x41220000
+#define AXI_GPIO_SIZE 0x200
+#define RGB_BASE 0x43C00000
+#define RGB_WORDS 24
+#define SEVSEG_BASE 0x43C10000
+#define SEVSEG_WORDS 4
+
+// Global timer
+#define GTC_BASE 0xF8F00200
+#define GTC_LOWER 0x00
+#define GTC_UPPER 0x04
+#define GTC_CTRL 0x08
+#define GTC_ISR 0x0C
+#define GTC_COMPARE_LOWER 0x10
+#define GTC_COMPARE_UPPER 0x14
+#define GTC_COMPARE_ENABLE 0x2
+#define GTC_IRQ_ENABLE 0x4
+#define GTC_INTERRUPT_ID 27
+
+// GIC CPU interface and distributor
+#define GIC_CPU_BASE 0xF8F00100
+#define GIC_ICCICR 0x00
+#define GIC_ICCPMR 0x04
+#define GIC_ICCIAR 0x0C
+#define GIC_ICCEOIR 0x10
+#define GIC_DIST_BASE 0xF8F01000
+#define GIC_ICDDCR 0x000
+#define GIC_ICDISER 0x100
+#define GIC_ICDICER 0x180
+#define GIC_ICDIPR 0x400
+#define GIC_ICDIPTR 0x800
+#define GIC_ICDICFR 0xC00
+#define GIC_IDS 96
+#define GIC_SPURIOUS_ID 1023
+#define GIC_ACTIVE_DEPTH 32          // Nesting levels tracked, one per priority in use is plenty
+#define GIC_IDLE_PRIORITY 256
+#define UART1_INTERRUPT_ID 82
+
+typedef struct
+{
+    uint32_t ctrl;
+    uint32_t mode;
+    uint32_t imr;
+    uint32_t isr;
+    uint32_t baudgen;
+    uint32_t bauddiv;
+    uint32_t rxtout;
+    uint32_t rxwm;
+    uint8_t rx_fifo[UART_FIFO_SIZE];
+    uint32_t rx_head;
+    uint32_t rx_count;
+    uint64_t rx_last;               // Time the latest byte arrived
+    bool rx_timeout_armed;
+    uint8_t tx_fifo[UART_FIFO_SIZE];
+    uint32_t tx_head;
+    uint32_t tx_count;
+    uint64_t tx_done;               // Time the byte on the wire finishes
+    uint8_t output[UART_OUTPUT_SIZE];
+    uint32_t output_head;
+    uint32_t output_tail;
+} uart_t;
+
+typedef struct
+{
+    uint32_t data;
+    uint32_t dirm;
+    uint32_t oen;
+} gpio_t;
+
+typedef struct
+{
+    uint32_t ctrl;
+    uint32_t isr;
+    uint64_t compare;
+} gtc_t;
+
+typedef struct
+{
+    uint32_t iccicr;
+    uint32_t iccpmr;
+    uint32_t icddcr;
+    uint32_t enabled[GIC_IDS / 32];
+    uint32_t ipr[GIC_IDS / 4];
+    uint32_t iptr[GIC_IDS / 4];
+    uint32_t icfr[GIC_IDS / 16];
+    uint32_t active[GIC_ACTIVE_DEPTH];  // Acknowledged, waiting for EOI, innermost last
+    uint32_t active_count;
+} gic_t;
+
+static uint64_t now = 0;
+static uart_t uart;
+static gpio_t gpio;
+static gtc_t gtc;
+static gic_t gic;
+static void (*irq_entry)(void *data) = 0;     // CPU IRQ vector, kept over a reset
+static void *irq_entry_data = 0;
+static bool irq_nested = false;                 // IRQs unmasked inside a handler
+static uint32_t buttons = 0;
+static uint32_t switches = 0;
+static uint32_t leds = 0;
+static uint32_t keys = 0;
+static uint32_t rgb[RGB_WORDS];
+static uint32_t sevseg[SEVSEG_WORDS];
+
+static mmio_sim_counts_t counts[MMIO_SIM_REGIONS];
+static bool logging = false;
+static mmio_sim_access_t access_log[MMIO_SIM_LOG_SIZE];
+static uint64_t log_total = 0;
+static bool wave_recording = false;
+static mmio_sim_edge_t wave[MMIO_SIM_WAVE_SIZE];
+static uint64_t wave_total = 0;
+
+static const char *region_names[MMIO_SIM_REGIONS] =
+{
+    "uart", "gpio", "buttons", "switches", "leds", "rgb", "sevseg", "gtc", "gic", "unmapped"
+};
+
+// Key number at each row and column, the Digilent PmodKYPD layout
+static const uint8_t keypad_layout[4][4] =
+{
+    {0x1, 0x2, 0x3, 0xA},
+    {0x4, 0x5, 0x6, 0xB},
+    {0x7, 0x8, 0x9, 0xC},
+    {0x0, 0xF, 0xE, 0xD}
+};
+
+static void update();
+static void record(uint32_t address, uint32_t value, bool write);
+static mmio_sim_region_t region_of(uint32_t address);
+static uint32_t uart_read(uint32_t offset);
+static void uart_write(uint32_t offset, uint32_t value);
+static uint64_t uart_byte_ticks();
+static uint32_t gpio_read(uint32_t offset);
+static void gpio_write(uint32_t offset, uint32_t value);
+static uint32_t gic_read(uint32_t address);
+static void gic_write(uint32_t address, uint32_t value);
+static bool gic_pending(uint32_t id);
+static uint32_t gic_highest_pending();
+static uint32_t gic_running_priority();
+static void take_nested_irqs();
+
+/************************************************************
+ * Function: mmio_read
+ * Description: Target of every driver register read in a host
+ *              build.
+ * Input parameters:
+ *      - address: Register address
+ * Returns: uint32_t - Register value
+ ************************************************************/
+uint32_t mmio_read(uint32_t address)
+{
+    uint32_t value = 0;
+
+    now += MMIO_SIM_ACCESS_TICKS;
+    update();
+
+    switch(region_of(address))
+    {
+        case MMIO_SIM_UART:
+        value = uart_read(address - UART_BASE);
+        break;
+
+        case MMIO_SIM_GPIO:
+        value = gpio_read(address - GPIO_BASE);
+        break;
+
+        case MMIO_SIM_BUTTONS:
+        value = address == BUTTON_BASE ? buttons : 0;
+        break;
+
+        case MMIO_SIM_SWITCHES:
+        value = address == SWITCH_BASE ? switches : 0;
+        break;
+
+        case MMIO_SIM_LEDS:
+        value = address == LED_BASE ? leds : 0;
+        break;
+
+        case MMIO_SIM_RGB:
+        value = rgb[(address - RGB_BASE) / 4];
+        break;
+
+        case MMIO_SIM_SEVSEG:
+        value = sevseg[(address - SEVSEG_BASE) / 4];
+        break;
+
+        case MMIO_SIM_GTC:
+        switch(address - GTC_BASE)
+        {
+            case GTC_LOWER: value = (uint32_t)now; break;
+            case GTC_UPPER: value = now >> 32; break;
+            case GTC_CTRL: value = gtc.ctrl; break;
+            case GTC_ISR: value = gtc.isr; break;
+            case GTC_COMPARE_LOWER: value = (uint32_t)gtc.compare; break;
+            case GTC_COMPARE_UPPER: value = gtc.compare >> 32; break;
+        }
+        break;
+
+        case MMIO_SIM_GIC:
+        value = gic_read(address);
+        break;
+
+        default:
+        break;
+    }
+
+    record(address, value, false);
+
+    return value;
+}
+
+/************************************************************
+ * Function: mmio_write
+ * Description: Target of every driver register write in a host
+ *              build.
+ * Input parameters:
+ *      - address: Register address
+ *      - value: Value written
+ * Returns: None
+ ************************************************************/
+void mmio_write(uint32_t address, uint32_t value)
+{
+    now += MMIO_SIM_ACCESS_TICKS;
+    update();
+    record(address, value, true);
+
+    switch(region_of(address))
+    {
+        case MMIO_SIM_UART:
+        uart_write(address - UART_BASE, value);
+        break;
+
+        case MMIO_SIM_GPIO:
+        gpio_write(address - GPIO_BASE, value);
+        break;
+
+        case MMIO_SIM_LEDS:
+        if(address == LED_BASE) leds = value;
+        break;
+
+        case MMIO_SIM_RGB:
+        rgb[(address - RGB_BASE) / 4] = value;
+        break;
+
+        case MMIO_SIM_SEVSEG:
+        sevseg[(address - SEVSEG_BASE) / 4] = value;
+        break;
+
+        case MMIO_SIM_GTC:
+        switch(address - GTC_BASE)
+        {
+            case GTC_CTRL: gtc.ctrl = value; break;
+            case GTC_ISR: gtc.isr &= ~value; break;
+            case GTC_COMPARE_LOWER: gtc.compare = (gtc.compare & ~0xFFFFFFFFull) | value; break;
+            case GTC_COMPARE_UPPER: gtc.compare = (gtc.compare & 0xFFFFFFFFull) | ((uint64_t)value << 32); break;
+        }
+        break;
+
+        case MMIO_SIM_GIC:
+        gic_write(address, value);
+        break;
+
+        default:
+        break;
+    }
+
+    update();
+}
+
+/************************************************************
+ * Function: mmio_sim_reset
+ * Description: Returns every peripheral to its power-on state,
+ *              clears the counters and log and sets the clock
+ *              to 0.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void mmio_sim_reset()
+{
+    now = 0;
+    memset(&uart, 0, sizeof(uart));
+    memset(&gpio, 0, sizeof(gpio));
+    memset(&gtc, 0, sizeof(gtc));
+    memset(&gic, 0, sizeof(gic));
+    irq_nested = false;
+    buttons = 0;
+    switches = 0;
+    leds = 0;
+    keys = 0;
+    memset(rgb, 0, sizeof(rgb));
+    memset(sevseg, 0, sizeof(sevseg));
+    mmio_sim_clear_counts();
+    log_total = 0;
+    wave_recording = false;
+    wave_total = 0;
+}
+
+/************************************************************
+ * Function: mmio_sim_advance
+ * Description: Moves the simulated clock on, running the UART
+ *              and global timer comparator up to the new time.
+ *              Called from a handler that unmasked IRQs, it is
+ *              also where a higher priority interrupt preempts
+ *              that handler.
+ * Input parameters:
+ *      - ticks: Global timer ticks (3 ns) to pass
+ * Returns: None
+ ************************************************************/
+void mmio_sim_advance(uint64_t ticks)
+{
+    now += ticks;
+    update();
+    take_nested_irqs();
+}
+
+/************************************************************
+ * Function: mmio_sim_advance_us
+ * Description: mmio_sim_advance in microseconds.
+ * Input parameters:
+ *      - us: Microseconds to pass
+ * Returns: None
+ ************************************************************/
+void mmio_sim_advance_us(uint64_t us)
+{
+    mmio_sim_advance(us * MMIO_SIM_TICKS_PER_US);
+}
+
+/************************************************************
+ * Function: mmio_sim_time
+ * Description: Returns the simulated clock, which is also what
+ *              the global timer counter reads.
+ * Input parameters: None
+ * Returns: uint64_t - Ticks since mmio_sim_reset
+ ************************************************************/
+uint64_t mmio_sim_time()
+{
+    return now;
+}
+
+/************************************************************
+ * Function: mmio_sim_set_buttons
+ * Description: Sets which of buttons 0-3 are held.
+ * Input parameters:
+ *      - held: One bit per button
+ * Returns: None
+ ************************************************************/
+void mmio_sim_set_buttons(uint32_t held)
+{
+    buttons = held & 0xF;
+}
+
+/************************************************************
+ * Function: mmio_sim_set_switches
+ * Description: Sets the positions of switches 0-11.
+ * Input parameters:
+ *      - positions: One bit per switch, 1 for on
+ * Returns: None
+ ************************************************************/
+void mmio_sim_set_switches(uint32_t positions)
+{
+    switches = positions & 0xFFF;
+}
+
+/************************************************************
+ * Function: mmio_sim_set_keys
+ * Description: Sets which keypad keys are held. A held key
+ *              pulls its row pin low while its column pin is
+ *              driven low.
+ * Input parameters:
+ *      - held: Bit n set for key n, 0x0-0xF
+ * Returns: None
+ ************************************************************/
+void mmio_sim_set_keys(uint32_t held)
+{
+    keys = held & 0xFFFF;
+}
+
+/************************************************************
+ * Function: mmio_sim_uart_receive
+ * Description: Delivers bytes to the UART receiver as one
+ *              burst. Bytes beyond the 64 byte RX FIFO are lost
+ *              and raise the overrun bit, as on the board.
+ * Input parameters:
+ *      - data: Bytes arriving on the line
+ *      - length: Number of bytes
+ * Returns: uint32_t - Bytes that fitted in the FIFO
+ ************************************************************/
+uint32_t mmio_sim_uart_receive(const uint8_t *data, uint32_t length)
+{
+    uint32_t accepted = 0;
+
+    for(uint32_t i = 0; i < length; i++)
+    {
+        if(uart.rx_count == UART_FIFO_SIZE)
+        {
+            uart.isr |= UART_ROVR;
+            continue;
+        }
+
+        uart.rx_fifo[(uart.rx_head + uart.rx_count++) % UART_FIFO_SIZE] = data[i];
+        accepted++;
+    }
+
+    uart.rx_last = now;
+    uart.rx_timeout_armed = true;
+    update();
+
+    return accepted;
+}
+
+/************************************************************
+ * Function: mmio_sim_uart_framing_error
+ * Description: Raises the framing error bit, as a byte with a
+ *              bad stop bit would. The byte itself is not
+ *              delivered.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void mmio_sim_uart_framing_error()
+{
+    uart.isr |= UART_FRAME;
+    update();
+}
+
+/************************************************************
+ * Function: mmio_sim_uart_take_output
+ * Description: Takes bytes the UART has finished sending.
+ * Input parameters:
+ *      - buffer: Where to copy them
+ *      - length: Most bytes to take
+ * Returns: uint32_t - Bytes copied
+ ************************************************************/
+uint32_t mmio_sim_uart_take_output(uint8_t *buffer, uint32_t length)
+{
+    uint32_t count = 0;
+
+    while(count < length && uart.output_tail != uart.output_head)
+    {
+        buffer[count++] = uart.output[uart.output_tail++ % UART_OUTPUT_SIZE];
+    }
+
+    return count;
+}
+
+/************************************************************
+ * Function: mmio_sim_uart_tx_pending
+ * Description: Returns the bytes still in the TX FIFO.
+ * Input parameters: None
+ * Returns: uint32_t - Byte count
+ ************************************************************/
+uint32_t mmio_sim_uart_tx_pending()
+{
+    return uart.tx_count;
+}
+
+/************************************************************
+ * Function: mmio_sim_peek
+ * Description: Reads the stored value of an LED, RGB,
+ *              seven-segment or UART register without counting
+ *              an access, for checking driver output. The UART
+ *              FIFO reads as 0 so nothing is consumed.
+ * Input parameters:
+ *      - address: Register address
+ * Returns: uint32_t - Last value written, 0 for other blocks
+ ************************************************************/
+uint32_t mmio_sim_peek(uint32_t address)
+{
+    switch(region_of(address))
+    {
+        case MMIO_SIM_LEDS: return address == LED_BASE ? leds : 0;
+        case MMIO_SIM_RGB: return rgb[(address - RGB_BASE) / 4];
+        case MMIO_SIM_SEVSEG: return sevseg[(address - SEVSEG_BASE) / 4];
+        case MMIO_SIM_UART: return address - UART_BASE == UART_FIFO ? 0 : uart_read(address - UART_BASE);
+        default: return 0;
+    }
+}
+
+/************************************************************
+ * Function: mmio_sim_get_pmod_pins
+ * Description: Returns the levels of the eight JB pins.
+ * Input parameters: None
+ * Returns: uint8_t - Bit 0 = pin 1
+ ************************************************************/
+uint8_t mmio_sim_get_pmod_pins()
+{
+    return (gpio_read(GPIO_DATA_2_RO) >> PMOD_SHIFT) & 0xFF;
+}
+
+/************************************************************
+ * Function: mmio_sim_set_wave_recording
+ * Description: Starts or stops recording the JB pin levels.
+ *              Starting clears the recording and takes the
+ *              levels now as its first entry; after that an
+ *              entry is added whenever a GPIO write changes
+ *              them.
+ * Input parameters:
+ *      - enable: true to record
+ * Returns: None
+ ************************************************************/
+void mmio_sim_set_wave_recording(bool enable)
+{
+    wave_recording = enable;
+    wave_total = 0;
+
+    if(enable)
+    {
+        wave[0].time = now;
+        wave[0].pins = mmio_sim_get_pmod_pins();
+        wave_total = 1;
+    }
+}
+
+/************************************************************
+ * Function: mmio_sim_wave_count
+ * Description: Returns how many pin changes the recording
+ *              holds.
+ * Input parameters: None
+ * Returns: uint32_t - Entries, at most MMIO_SIM_WAVE_SIZE
+ ************************************************************/
+uint32_t mmio_sim_wave_count()
+{
+    return wave_total < MMIO_SIM_WAVE_SIZE ? wave_total : MMIO_SIM_WAVE_SIZE;
+}
+
+/************************************************************
+ * Function: mmio_sim_wave_entry
+ * Description: Returns a recorded pin change, oldest first.
+ * Input parameters:
+ *      - index: 0 to mmio_sim_wave_count() - 1
+ * Returns: const mmio_sim_edge_t* - The change
+ ************************************************************/
+const mmio_sim_edge_t *mmio_sim_wave_entry(uint32_t index)
+{
+    uint64_t first = wave_total - mmio_sim_wave_count();
+
+    return &wave[(first + index) % MMIO_SIM_WAVE_SIZE];
+}
+
+/************************************************************
+ * Function: mmio_sim_irq_asserted
+ * Description: Returns whether the GIC is signalling an IRQ to
+ *              the CPU. The host calls IRQ_Handler while this
+ *              is true.
+ * Input parameters: None
+ * Returns: bool - true if an interrupt would be taken
+ ************************************************************/
+bool mmio_sim_irq_asserted()
+{
+    update();
+
+    return gic.active_count == 0 && gic_highest_pending() != GIC_SPURIOUS_ID;
+}
+
+/************************************************************
+ * Function: mmio_sim_set_irq_entry
+ * Description: Sets the function the CPU enters on an IRQ
+ *              (Xil_ExceptionRegisterHandler), used to deliver
+ *              nested interrupts.
+ * Input parameters:
+ *      - entry: IRQ handler, 0 for none
+ *      - data: Passed to the handler
+ * Returns: None
+ ************************************************************/
+void mmio_sim_set_irq_entry(void (*entry)(void *data), void *data)
+{
+    irq_entry = entry;
+    irq_entry_data = data;
+}
+
+/************************************************************
+ * Function: mmio_sim_set_nested_irqs
+ * Description: Unmasks or masks IRQs inside a running handler
+ *              (Xil_EnableNestedInterrupts and
+ *              Xil_DisableNestedInterrupts). While unmasked, a
+ *              pending interrupt above the running priority is
+ *              taken at the next mmio_sim_advance.
+ * Input parameters:
+ *      - enable: true to unmask
+ * Returns: None
+ ************************************************************/
+void mmio_sim_set_nested_irqs(bool enable)
+{
+    irq_nested = enable;
+}
+
+/************************************************************
+ * Function: mmio_sim_get_counts
+ * Description: Returns the reads and writes made to one block
+ *              since the counters were last cleared.
+ * Input parameters:
+ *      - region: Peripheral block
+ * Returns: mmio_sim_counts_t - Access counts
+ ************************************************************/
+mmio_sim_counts_t mmio_sim_get_counts(mmio_sim_region_t region)
+{
+    return counts[region];
+}
+
+/************************************************************
+ * Function: mmio_sim_get_total_counts
+ * Description: Returns the reads and writes made to all blocks
+ *              since the counters were last cleared.
+ * Input parameters: None
+ * Returns: mmio_sim_counts_t - Access counts
+ ************************************************************/
+mmio_sim_counts_t mmio_sim_get_total_counts()
+{
+    mmio_sim_counts_t total = {0, 0};
+
+    for(uint32_t region = 0; region < MMIO_SIM_REGIONS; region++)
+    {
+        total.reads += counts[region].reads;
+        total.writes += counts[region].writes;
+    }
+
+    return total;
+}
+
+/************************************************************
+ * Function: mmio_sim_clear_counts
+ * Description: Zeroes the access counters.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void mmio_sim_clear_counts()
+{
+    memset(counts, 0, sizeof(counts));
+}
+
+/************************************************************
+ * Function: mmio_sim_region_name
+ * Description: Returns a short name for a block.
+ * Input parameters:
+ *      - region: Peripheral block
+ * Returns: const char* - Name
+ ************************************************************/
+const char *mmio_sim_region_name(mmio_sim_region_t region)
+{
+    return region_names[region];
+}
+
+/************************************************************
+ * Function: mmio_sim_set_logging
+ * Description: Starts or stops recording accesses in the log.
+ * Input parameters:
+ *      - enable: true to record
+ * Returns: None
+ ************************************************************/
+void mmio_sim_set_logging(bool enable)
+{
+    logging = enable;
+    log_total = 0;
+}
+
+/************************************************************
+ * Function: mmio_sim_log_count
+ * Description: Returns how many accesses the log holds.
+ * Input parameters: None
+ * Returns: uint32_t - Entries, at most MMIO_SIM_LOG_SIZE
+ ************************************************************/
+uint32_t mmio_sim_log_count()
+{
+    return log_total < MMIO_SIM_LOG_SIZE ? log_total : MMIO_SIM_LOG_SIZE;
+}
+
+/************************************************************
+ * Function: mmio_sim_log_entry
+ * Description: Returns a logged access, oldest first.
+ * Input parameters:
+ *      - index: 0 to mmio_sim_log_count() - 1
+ * Returns: const mmio_sim_access_t* - The access
+ ************************************************************/
+const mmio_sim_access_t *mmio_sim_log_entry(uint32_t index)
+{
+    uint64_t first = log_total - mmio_sim_log_count();
+
+    return &access_log[(first + index) % MMIO_SIM_LOG_SIZE];
+}
+
+/************************************************************
+ * Function: update
+ * Description: Brings the UART and global timer up to the
+ *              current time: shifts out TX bytes, raises the
+ *              RX timeout and sets the sticky status bits.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+static void update()
+{
+    uint64_t byte_ticks = uart_byte_ticks();
+
+    while(uart.tx_count && now >= uart.tx_done)
+    {
+        uart.output[uart.output_head++ % UART_OUTPUT_SIZE] = uart.tx_fifo[uart.tx_head];
+        uart.tx_head = (uart.tx_head + 1) % UART_FIFO_SIZE;
+        uart.tx_count--;
+        uart.tx_done += byte_ticks;
+    }
+
+    if(!uart.tx_count)
+    {
+        uart.isr |= UART_TEMPTY;
+    }
+
+    if(uart.rxwm && uart.rx_count >= uart.rxwm)
+    {
+        uart.isr |= UART_RTRIG;
+    }
+
+    // The timeout counts 4 bit periods per RXTOUT step from the last byte
+    if(uart.rx_timeout_armed && uart.rxtout && uart.rx_count &&
+       now >= uart.rx_last + uart.rxtout * 4 * byte_ticks / 10)
+    {
+        uart.isr |= UART_TIMEOUT;
+        uart.rx_timeout_armed = false;
+    }
+
+    if((gtc.ctrl & GTC_COMPARE_ENABLE) && now >= gtc.compare)
+    {
+        gtc.isr = 1;
+    }
+}
+
+/************************************************************
+ * Function: record
+ * Description: Counts an access and adds it to the log.
+ * Input parameters:
+ *      - address: Register address
+ *      - value: Value read or written
+ *      - write: true for a write
+ * Returns: None
+ ************************************************************/
+static void record(uint32_t address, uint32_t value, bool write)
+{
+    mmio_sim_region_t region = region_of(address);
+
+    if(write)
+    {
+        counts[region].writes++;
+    }
+    else
+    {
+        counts[region].reads++;
+    }
+
+    if(logging)
+    {
+        access_log[log_total++ % MMIO_SIM_LOG_SIZE] = (mmio_sim_access_t){now, address, value, write};
+    }
+}
+
+/************************************************************
+ * Function: region_of
+ * Description: Finds the block an address belongs to.
+ * Input parameters:
+ *      - address: Register address
+ * Returns: mmio_sim_region_t - The block
+ ************************************************************/
+static mmio_sim_region_t region_of(uint32_t address)
+{
+    if(address - UART_BASE < 0x48) return MMIO_SIM_UART;
+    if(address - GPIO_BASE < 0x2E8) return MMIO_SIM_GPIO;
+    if(address - BUTTON_BASE < AXI_GPIO_SIZE) return MMIO_SIM_BUTTONS;
+    if(address - LED_BASE < AXI_GPIO_SIZE) return MMIO_SIM_LEDS;
+    if(address - SWITCH_BASE < AXI_GPIO_SIZE) return MMIO_SIM_SWITCHES;
+    if(address - RGB_BASE < RGB_WORDS * 4) return MMIO_SIM_RGB;
+    if(address - SEVSEG_BASE < SEVSEG_WORDS * 4) return MMIO_SIM_SEVSEG;
+    if(address - GTC_BASE < 0x1C) return MMIO_SIM_GTC;
+    if(address - GIC_CPU_BASE < 0x100 || address - GIC_DIST_BASE < 0x1000) return MMIO_SIM_GIC;
+
+    return MMIO_SIM_UNMAPPED;
+}
+
+/************************************************************
+ * Function: uart_read
+ * Description: Reads a UART1 register. Reading the FIFO takes
+ *              the oldest received byte.
+ * Input parameters:
+ *      - offset: Register offset
+ * Returns: uint32_t - Register value
+ ************************************************************/
+static uint32_t uart_read(uint32_t offset)
+{
+    switch(offset)
+    {
+        case UART_CTRL: return uart.ctrl;
+        case UART_MODE: return uart.mode;
+        case UART_IMR: return uart.imr;
+        case UART_ISR: return uart.isr;
+        case UART_BAUDGEN: return uart.baudgen;
+        case UART_RXTOUT: return uart.rxtout;
+        case UART_RXWM: return uart.rxwm;
+        case UART_BAUDDIV: return uart.bauddiv;
+
+        case UART_SR:
+        return (uart.rxwm && uart.rx_count >= uart.rxwm ? UART_RTRIG : 0) |
+               (uart.rx_count == 0 ? UART_REMPTY : 0) |
+               (uart.rx_count == UART_FIFO_SIZE ? UART_RFUL : 0) |
+               (uart.tx_count == 0 ? UART_TEMPTY : 0) |
+               (uart.tx_count == UART_FIFO_SIZE ? UART_TFUL : 0) |
+               (uart.tx_count != 0 ? UART_TACTIVE : 0);
+
+        case UART_FIFO:
+        {
+            if(!uart.rx_count)
+            {
+                return 0;
+            }
+
+            uint8_t byte = uart.rx_fifo[uart.rx_head];
+            uart.rx_head = (uart.rx_head + 1) % UART_FIFO_SIZE;
+            uart.rx_count--;
+            return byte;
+        }
+    }
+
+    return 0;
+}
+
+/************************************************************
+ * Function: uart_write
+ * Description: Writes a UART1 register. Writing the FIFO
+ *              queues a byte for transmission.
+ * Input parameters:
+ *      - offset: Register offset
+ *      - value: Value written
+ * Returns: None
+ ************************************************************/
+static void uart_write(uint32_t offset, uint32_t value)
+{
+    switch(offset)
+    {
+        case UART_CTRL:
+        // The resets complete at once and read back clear
+        if(value & UART_CTRL_RXRST)
+        {
+            uart.rx_count = 0;
+        }
+
+        if(value & UART_CTRL_TXRST)
+        {
+            uart.tx_count = 0;
+        }
+
+        if(value & UART_CTRL_RSTTO)
+        {
+            uart.rx_timeout_armed = false;
+        }
+
+        uart.ctrl = value & ~(UART_CTRL_RXRST | UART_CTRL_TXRST | UART_CTRL_RSTTO);
+        break;
+
+        case UART_MODE: uart.mode = value; break;
+        case UART_IER: uart.imr |= value; break;
+        case UART_IDR: uart.imr &= ~value; break;
+        case UART_ISR: uart.isr &= ~value; break;
+        case UART_BAUDGEN: uart.baudgen = value; break;
+        case UART_RXTOUT: uart.rxtout = value & 0xFF; break;
+        case UART_RXWM: uart.rxwm = value & 0x3F; break;
+        case UART_BAUDDIV: uart.bauddiv = value; break;
+
+        case UART_FIFO:
+        if(uart.tx_count == UART_FIFO_SIZE)
+        {
+            break;
+        }
+
+        if(!uart.tx_count)
+        {
+            uart.tx_done = now + uart_byte_ticks();
+        }
+
+        uart.tx_fifo[(uart.tx_head + uart.tx_count++) % UART_FIFO_SIZE] = value;
+        break;
+    }
+}
+
+/************************************************************
+ * Function: uart_byte_ticks
+ * Description: Returns the time one 10 bit character takes at
+ *              the programmed baud rate, from the 100 MHz UART
+ *              reference clock.
+ * Input parameters: None
+ * Returns: uint64_t - Ticks per byte, 0 before the baud rate
+ *          generator is set
+ ************************************************************/
+static uint64_t uart_byte_ticks()
+{
+    if(!uart.baudgen)
+    {
+        return 0;
+    }
+
+    return 10 * MMIO_SIM_TICKS_PER_US * 1000000ull * uart.baudgen * (uart.bauddiv + 1) / UART_REF_CLOCK;
+}
+
+/************************************************************
+ * Function: gpio_read
+ * Description: Reads a GPIO bank 2 register. DATA_2_RO gives
+ *              the pin levels: outputs read their driven value,
+ *              inputs float high unless a held key connects a
+ *              row to a column driven low.
+ * Input parameters:
+ *      - offset: Register offset
+ * Returns: uint32_t - Register value
+ ************************************************************/
+static uint32_t gpio_read(uint32_t offset)
+{
+    switch(offset)
+    {
+        case GPIO_DATA_2: return gpio.data;
+        case GPIO_DIRM_2: return gpio.dirm;
+        case GPIO_OEN_2: return gpio.oen;
+
+        case GPIO_DATA_2_RO:
+        {
+            uint32_t driven = gpio.dirm & gpio.oen;
+            uint32_t levels = (gpio.data & driven) | ~driven;
+
+            for(uint32_t row = 0; row < 4; row++)
+            {
+                for(uint32_t column = 0; column < 4; column++)
+                {
+                    uint32_t column_bit = 1 << (PMOD_SHIFT + 3 - column);
+                    uint32_t row_bit = 1 << (PMOD_SHIFT + 7 - row);
+
+                    if((keys >> keypad_layout[row][column] & 1) && (driven & column_bit) &&
+                       !(gpio.data & column_bit) && !(driven & row_bit))
+                    {
+                        levels &= ~row_bit;
+                    }
+                }
+            }
+
+            return levels;
+        }
+    }
+
+    return 0;
+}
+
+/************************************************************
+ * Function: gpio_write
+ * Description: Writes a GPIO bank 2 register. MASK_DATA writes
+ *              the bits whose mask bit is 0. Pin changes are
+ *              added to the waveform recording.
+ * Input parameters:
+ *      - offset: Register offset
+ *      - value: Value written
+ * Returns: None
+ ************************************************************/
+static void gpio_write(uint32_t offset, uint32_t value)
+{
+    uint32_t mask = ~value >> 16;
+
+    switch(offset)
+    {
+        case GPIO_MASK_DATA_2_LSW:
+        gpio.data = (gpio.data & ~mask) | (value & mask & 0xFFFF);
+        break;
+
+        case GPIO_MASK_DATA_2_MSW:
+        gpio.data = (gpio.data & ~(mask << 16)) | ((value & mask & 0xFFFF) << 16);
+        break;
+
+        case GPIO_DATA_2: gpio.data = value; break;
+        case GPIO_DIRM_2: gpio.dirm = value; break;
+        case GPIO_OEN_2: gpio.oen = value; break;
+    }
+
+    if(wave_recording)
+    {
+        uint8_t pins = mmio_sim_get_pmod_pins();
+
+        if(pins != wave[(wave_total - 1) % MMIO_SIM_WAVE_SIZE].pins)
+        {
+            wave[wave_total % MMIO_SIM_WAVE_SIZE].time = now;
+            wave[wave_total % MMIO_SIM_WAVE_SIZE].pins = pins;
+            wave_total++;
+        }
+    }
+}
+
+/************************************************************
+ * Function: gic_read
+ * Description: Reads a GIC register. Reading ICCIAR
+ *              acknowledges the highest priority pending
+ *              interrupt above the running priority, which
+ *              becomes the running priority until its EOI.
+ * Input parameters:
+ *      - address: Register address
+ * Returns: uint32_t - Register value
+ ************************************************************/
+static uint32_t gic_read(uint32_t address)
+{
+    uint32_t offset = address - GIC_DIST_BASE;
+
+    switch(address - GIC_CPU_BASE)
+    {
+        case GIC_ICCICR: return gic.iccicr;
+        case GIC_ICCPMR: return gic.iccpmr;
+
+        case GIC_ICCIAR:
+        {
+            uint32_t id = gic_highest_pending();
+
+            if(id == GIC_SPURIOUS_ID || gic.active_count == GIC_ACTIVE_DEPTH)
+            {
+                return GIC_SPURIOUS_ID;
+            }
+
+            gic.active[gic.active_count++] = id;
+            return id;
+        }
+    }
+
+    if(offset == GIC_ICDDCR) return gic.icddcr;
+    if(offset - GIC_ICDISER < sizeof(gic.enabled)) return gic.enabled[(offset - GIC_ICDISER) / 4];
+    if(offset - GIC_ICDICER < sizeof(gic.enabled)) return gic.enabled[(offset - GIC_ICDICER) / 4];
+    if(offset - GIC_ICDIPR < sizeof(gic.ipr)) return gic.ipr[(offset - GIC_ICDIPR) / 4];
+    if(offset - GIC_ICDIPTR < sizeof(gic.iptr)) return gic.iptr[(offset - GIC_ICDIPTR) / 4];
+    if(offset - GIC_ICDICFR < sizeof(gic.icfr)) return gic.icfr[(offset - GIC_ICDICFR) / 4];
+
+    return 0;
+}
+
+/************************************************************
+ * Function: gic_write
+ * Description: Writes a GIC register. ICCEOIR ends the
+ *              innermost active interrupt.
+ * Input parameters:
+ *      - address: Register address
+ *      - value: Value written
+ * Returns: None
+ ************************************************************/
+static void gic_write(uint32_t address, uint32_t value)
+{
+    uint32_t offset = address - GIC_DIST_BASE;
+
+    switch(address - GIC_CPU_BASE)
+    {
+        case GIC_ICCICR: gic.iccicr = value; return;
+        case GIC_ICCPMR: gic.iccpmr = value & 0xFF; return;
+
+        case GIC_ICCEOIR:
+        if(gic.active_count && (value & 0x3FF) == gic.active[gic.active_count - 1])
+        {
+            gic.active_count--;
+        }
+        return;
+    }
+
+    if(offset == GIC_ICDDCR) gic.icddcr = value;
+    else if(offset - GIC_ICDISER < sizeof(gic.enabled)) gic.enabled[(offset - GIC_ICDISER) / 4] |= value;
+    else if(offset - GIC_ICDICER < sizeof(gic.enabled)) gic.enabled[(offset - GIC_ICDICER) / 4] &= ~value;
+    else if(offset - GIC_ICDIPR < sizeof(gic.ipr)) gic.ipr[(offset - GIC_ICDIPR) / 4] = value;
+    else if(offset - GIC_ICDIPTR < sizeof(gic.iptr)) gic.iptr[(offset - GIC_ICDIPTR) / 4] = value;
+    else if(offset - GIC_ICDICFR < sizeof(gic.icfr)) gic.icfr[(offset - GIC_ICDICFR) / 4] = value;
+}
+
+/************************************************************
+ * Function: gic_pending
+ * Description: Returns whether a modelled source is raising its
+ *              interrupt line.
+ * Input parameters:
+ *      - id: Interrupt ID
+ * Returns: bool - true if raised
+ ************************************************************/
+static bool gic_pending(uint32_t id)
+{
+    switch(id)
+    {
+        case GTC_INTERRUPT_ID:
+        return (gtc.ctrl & GTC_IRQ_ENABLE) && gtc.isr;
+
+        case UART1_INTERRUPT_ID:
+        return (uart.isr & uart.imr) != 0;
+    }
+
+    return false;
+}
+
+/************************************************************
+ * Function: gic_highest_pending
+ * Description: Finds the enabled, raised interrupt with the
+ *              highest priority that passes the priority mask
+ *              and preempts the running priority.
+ * Input parameters: None
+ * Returns: uint32_t - Interrupt ID, 1023 if none
+ ************************************************************/
+static uint32_t gic_highest_pending()
+{
+    uint32_t best = GIC_SPURIOUS_ID;
+    uint32_t best_priority = gic.iccpmr < gic_running_priority() ? gic.iccpmr : gic_running_priority();
+
+    if(!(gic.icddcr & 1) || !(gic.iccicr & 1))
+    {
+        return GIC_SPURIOUS_ID;
+    }
+
+    for(uint32_t id = 0; id < GIC_IDS; id++)
+    {
+        uint32_t priority = (gic.ipr[id / 4] >> (id % 4 * 8)) & 0xFF;
+
+        if((gic.enabled[id / 32] >> (id % 32) & 1) && priority < best_priority && gic_pending(id))
+        {
+            best = id;
+            best_priority = priority;
+        }
+    }
+
+    return best;
+}
+
+/************************************************************
+ * Function: gic_running_priority
+ * Description: Returns the priority of the innermost active
+ *              interrupt. Only higher priorities (lower
+ *              numbers) are signalled until its EOI.
+ * Input parameters: None
+ * Returns: uint32_t - Priority, 256 when none is active
+ ************************************************************/
+static uint32_t gic_running_priority()
+{
+    if(!gic.active_count)
+    {
+        return GIC_IDLE_PRIORITY;
+    }
+
+    uint32_t id = gic.active[gic.active_count - 1];
+
+    return (gic.ipr[id / 4] >> (id % 4 * 8)) & 0xFF;
+}
+
+/************************************************************
+ * Function: take_nested_irqs
+ * Description: Enters the IRQ handler, as the CPU would, while
+ *              a handler runs with IRQs unmasked and the GIC
+ *              signals an interrupt that preempts it. IRQs are
+ *              masked again on entry and unmasked on return.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+static void take_nested_irqs()
+{
+    while(irq_nested && irq_entry && gic.active_count && gic_highest_pending() != GIC_SPURIOUS_ID)
+    {
+        irq_nested = false;
+        irq_entry(irq_entry_data);
+        irq_nested = true;
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef MMIO_SIM_H
+#define MMIO_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Host model of the Zybo peripherals behind mmio_read/mmio_write (see
+// Lab_3_C/mmio.h). Time is counted in global timer ticks (3 ns) and moves
+// on MMIO_SIM_ACCESS_TICKS with every register access, so driver loops that
+// poll a status bit make progress, and with mmio_sim_advance.
+//
+// Modelled: UART1 (64 byte FIFOs, status and sticky interrupt bits, TX
+// paced by the programmed baud rate, injected framing errors), GPIO bank 2 with the PMOD keypad on
+// JB, the AXI GPIO buttons, switches and LEDs, the RGB PWM block, the
+// seven-segment controller, the global timer with its comparator and the
+// GIC distributor and CPU interface, nesting by priority. Other addresses
+// read as 0 and are counted as MMIO_SIM_UNMAPPED. The JB pin levels can be
+// recorded as a waveform, one timestamped entry per change, to check PWM
+// drivers.
+
+// Cost of one register access, roughly an uncached AXI GP access
+#define MMIO_SIM_ACCESS_TICKS 20
+
+#define MMIO_SIM_TICKS_PER_US 333
+
+// Accesses kept by the access log, oldest dropped first
+#define MMIO_SIM_LOG_SIZE 4096
+
+// JB pin changes kept by the waveform recorder, oldest dropped first
+#define MMIO_SIM_WAVE_SIZE 4096
+
+typedef enum
+{
+    MMIO_SIM_UART,
+    MMIO_SIM_GPIO,
+    MMIO_SIM_BUTTONS,
+    MMIO_SIM_SWITCHES,
+    MMIO_SIM_LEDS,
+    MMIO_SIM_RGB,
+    MMIO_SIM_SEVSEG,
+    MMIO_SIM_GTC,
+    MMIO_SIM_GIC,
+    MMIO_SIM_UNMAPPED,
+    MMIO_SIM_REGIONS
+} mmio_sim_region_t;
+
+typedef struct
+{
+    uint64_t reads;
+    uint64_t writes;
+} mmio_sim_counts_t;
+
+typedef struct
+{
+    uint64_t time;                  // Ticks when the access happened
+    uint32_t address;
+    uint32_t value;                 // Value read or written
+    bool write;
+} mmio_sim_access_t;
+
+typedef struct
+{
+    uint64_t time;                  // Ticks when the pins changed
+    uint8_t pins;                   // Levels from then on, bit 0 = pin 1
+} mmio_sim_edge_t;
+
+void mmio_sim_reset();
+void mmio_sim_advance(uint64_t ticks);
+void mmio_sim_advance_us(uint64_t us);
+uint64_t mmio_sim_time();
+
+// Scripted input
+void mmio_sim_set_buttons(uint32_t buttons);
+void mmio_sim_set_switches(uint32_t switches);
+void mmio_sim_set_keys(uint32_t keys);
+uint32_t mmio_sim_uart_receive(const uint8_t *data, uint32_t length);
+void mmio_sim_uart_framing_error();
+
+// Recorded output
+uint32_t mmio_sim_uart_take_output(uint8_t *buffer, uint32_t length);
+uint32_t mmio_sim_uart_tx_pending();
+uint32_t mmio_sim_peek(uint32_t address);
+uint8_t mmio_sim_get_pmod_pins();
+void mmio_sim_set_wave_recording(bool enable);
+uint32_t mmio_sim_wave_count();
+const mmio_sim_edge_t *mmio_sim_wave_entry(uint32_t index);
+
+// Interrupts
+bool mmio_sim_irq_asserted();
+void mmio_sim_set_irq_entry(void (*entry)(void *data), void *data);
+void mmio_sim_set_nested_irqs(bool enable);
+
+// Measurement
+mmio_sim_counts_t mmio_sim_get_counts(mmio_sim_region_t region);
+mmio_sim_counts_t mmio_sim_get_total_counts();
+void mmio_sim_clear_counts();
+const char *mmio_sim_region_name(mmio_sim_region_t region);
+void mmio_sim_set_logging(bool enable);
+uint32_t mmio_sim_log_count();
+const mmio_sim_access_t *mmio_sim_log_entry(uint32_t index);
+
+#endif // MMIO_SIM_H
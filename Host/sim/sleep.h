@@ -0,0 +1,11 @@
+#ifndef SLEEP_H
+#define SLEEP_H
+
+// Host stand-in for the Xilinx BSP sleep.h. Sleeping moves the simulated
+// clock on instead of waiting.
+#include "mmio_sim.h"
+
+#define usleep(us) mmio_sim_advance_us(us)
+#define sleep(seconds) mmio_sim_advance_us((uint64_t)(seconds) * 1000000)
+
+#endif // SLEEP_H
@@ -0,0 +1,36 @@
+#ifndef XIL_EXCEPTION_H
+#define XIL_EXCEPTION_H
+
+#include <stdint.h>
+#include "mmio_sim.h"
+
+// Host stand-in for the Xilinx BSP xil_exception.h. There is no CPU
+// exception to hook, the host calls IRQ_Handler itself while
+// mmio_sim_irq_asserted() is true. The registered handler is only entered
+// by the simulator for a nested interrupt, while a handler runs between
+// Xil_EnableNestedInterrupts and Xil_DisableNestedInterrupts.
+
+#define XIL_EXCEPTION_ID_IRQ_INT 5
+
+typedef void (*Xil_ExceptionHandler)(void *data);
+
+static inline void Xil_ExceptionRegisterHandler(uint32_t id, Xil_ExceptionHandler handler, void *data)
+{
+    if(id == XIL_EXCEPTION_ID_IRQ_INT)
+    {
+        mmio_sim_set_irq_entry(handler, data);
+    }
+}
+
+static inline void Xil_ExceptionEnable()
+{
+}
+
+static inline void Xil_ExceptionDisable()
+{
+}
+
+#define Xil_EnableNestedInterrupts() mmio_sim_set_nested_irqs(true)
+#define Xil_DisableNestedInterrupts() mmio_sim_set_nested_irqs(false)
+
+#endif // XIL_EXCEPTION_H
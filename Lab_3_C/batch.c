@@ -0,0 +1,242 @@
+#include "batch.h"
+
+static void batch_execute(batch_t *batch, uint64_t now_us);
+static void batch_respond(batch_t *batch, uint8_t status, uint32_t result);
+static void batch_flush(batch_t *batch);
+static uint8_t batch_checksum(const uint8_t *data, uint32_t length);
+static uint32_t read_le32(const uint8_t *data);
+
+/************************************************************
+ * Function: batch_init
+ * Description: Sets up a batch decoder with empty storage.
+ * Input parameters:
+ *      - batch: Decoder state
+ *      - write: Where responses are sent
+ * Returns: None
+ ************************************************************/
+void batch_init(batch_t *batch, batch_write_t write)
+{
+    batch->write = write;
+    batch->request_length = 0;
+    batch->output_length = 0;
+    batch_reset(batch);
+}
+
+/************************************************************
+ * Function: batch_reset
+ * Description: Clears the STORE/LOAD storage and statistics.
+ *              A partly received request is kept.
+ * Input parameters:
+ *      - batch: Decoder state
+ * Returns: None
+ ************************************************************/
+void batch_reset(batch_t *batch)
+{
+    batch->storage = 0;
+    batch->operations = 0;
+    batch->errors = 0;
+    batch->first_us = 0;
+    batch->last_us = 0;
+}
+
+/************************************************************
+ * Function: batch_feed
+ * Description: Decodes received bytes, runs each complete
+ *              request and sends the responses. Requests may be
+ *              split across calls at any byte. Responses from
+ *              one call are written together once the input is
+ *              used up, or every BATCH_OUTPUT_RESPONSES.
+ * Input parameters:
+ *      - batch: Decoder state
+ *      - data: Received bytes
+ *      - length: Number of bytes
+ *      - now_us: Receive time, for the operation rate
+ * Returns: None
+ ************************************************************/
+void batch_feed(batch_t *batch, const uint8_t *data, uint32_t length, uint64_t now_us)
+{
+    for(uint32_t i = 0; i < length; i++)
+    {
+        if(!batch->request_length && data[i] != BATCH_REQUEST_SYNC)
+        {
+            continue;
+        }
+
+        batch->request[batch->request_length++] = data[i];
+
+        if(batch->request_length < BATCH_REQUEST_SIZE)
+        {
+            continue;
+        }
+
+        if(batch_checksum(&batch->request[1], BATCH_REQUEST_SIZE - 2) == batch->request[BATCH_REQUEST_SIZE - 1])
+        {
+            batch->request_length = 0;
+            batch_execute(batch, now_us);
+            continue;
+        }
+
+        batch->errors++;
+        batch_respond(batch, BATCH_BAD_CHECKSUM, 0);
+
+        // Seeking the next sync byte inside the rejected request
+        uint32_t skip = 1;
+
+        while(skip < BATCH_REQUEST_SIZE && batch->request[skip] != BATCH_REQUEST_SYNC)
+        {
+            skip++;
+        }
+
+        batch->request_length = BATCH_REQUEST_SIZE - skip;
+
+        for(uint32_t j = 0; j < batch->request_length; j++)
+        {
+            batch->request[j] = batch->request[skip + j];
+        }
+    }
+
+    batch_flush(batch);
+}
+
+/************************************************************
+ * Function: batch_ops_per_second
+ * Description: Returns the rate operations have been received
+ *              and run since the last reset, from the arrival
+ *              of the first to the arrival of the latest.
+ * Input parameters:
+ *      - batch: Decoder state
+ * Returns: uint32_t - Operations per second, 0 until two
+ *          receive times are known
+ ************************************************************/
+uint32_t batch_ops_per_second(const batch_t *batch)
+{
+    uint64_t elapsed = batch->last_us - batch->first_us;
+
+    if(batch->operations < 2 || !elapsed)
+    {
+        return 0;
+    }
+
+    return (uint32_t)((uint64_t)(batch->operations - 1) * 1000000 / elapsed);
+}
+
+/************************************************************
+ * Function: batch_execute
+ * Description: Runs the request held in batch->request and
+ *              queues its response.
+ * Input parameters:
+ *      - batch: Decoder state
+ *      - now_us: Receive time
+ * Returns: None
+ ************************************************************/
+static void batch_execute(batch_t *batch, uint64_t now_us)
+{
+    uint8_t opcode = batch->request[1];
+    uint32_t op1 = read_le32(&batch->request[2]);
+    uint32_t op2 = read_le32(&batch->request[6]);
+
+    if(opcode < CALCULATOR_OPCODES)
+    {
+        if(!batch->operations)
+        {
+            batch->first_us = now_us;
+        }
+
+        batch->operations++;
+        batch->last_us = now_us;
+        batch_respond(batch, BATCH_OK, calculate(op1, op2, opcode, &batch->storage));
+    }
+    else if(opcode == BATCH_OP_STATS)
+    {
+        batch_respond(batch, BATCH_OK, batch_ops_per_second(batch));
+    }
+    else if(opcode == BATCH_OP_RESET)
+    {
+        batch_reset(batch);
+        batch_respond(batch, BATCH_OK, 0);
+    }
+    else
+    {
+        batch->errors++;
+        batch_respond(batch, BATCH_BAD_OPCODE, 0);
+    }
+}
+
+/************************************************************
+ * Function: batch_respond
+ * Description: Adds a response to the output buffer, writing
+ *              the buffer out first if it is full.
+ * Input parameters:
+ *      - batch: Decoder state
+ *      - status: BATCH_OK or an error
+ *      - result: Result value
+ * Returns: None
+ ************************************************************/
+static void batch_respond(batch_t *batch, uint8_t status, uint32_t result)
+{
+    if(batch->output_length + BATCH_RESPONSE_SIZE > sizeof(batch->output))
+    {
+        batch_flush(batch);
+    }
+
+    uint8_t *response = &batch->output[batch->output_length];
+
+    response[0] = BATCH_RESPONSE_SYNC;
+    response[1] = status;
+    response[2] = result;
+    response[3] = result >> 8;
+    response[4] = result >> 16;
+    response[5] = result >> 24;
+    response[6] = batch_checksum(&response[1], BATCH_RESPONSE_SIZE - 2);
+
+    batch->output_length += BATCH_RESPONSE_SIZE;
+}
+
+/************************************************************
+ * Function: batch_flush
+ * Description: Writes out the buffered responses.
+ * Input parameters:
+ *      - batch: Decoder state
+ * Returns: None
+ ************************************************************/
+static void batch_flush(batch_t *batch)
+{
+    if(batch->output_length)
+    {
+        batch->write(batch->output, batch->output_length);
+        batch->output_length = 0;
+    }
+}
+
+/************************************************************
+ * Function: batch_checksum
+ * Description: XORs a run of bytes together.
+ * Input parameters:
+ *      - data: Bytes to check
+ *      - length: Number of bytes
+ * Returns: uint8_t - The checksum
+ ************************************************************/
+static uint8_t batch_checksum(const uint8_t *data, uint32_t length)
+{
+    uint8_t checksum = 0;
+
+    for(uint32_t i = 0; i < length; i++)
+    {
+        checksum ^= data[i];
+    }
+
+    return checksum;
+}
+
+/************************************************************
+ * Function: read_le32
+ * Description: Reads a little endian 32-bit value from a byte
+ *              stream that may not be aligned.
+ * Input parameters:
+ *      - data: First byte
+ * Returns: uint32_t - The value
+ ************************************************************/
+static uint32_t read_le32(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
@@ -0,0 +1,56 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "calculator.h"
+
+// Binary batch protocol for the calculator. All values are little endian.
+//
+// Request:  0xA5, opcode, op1[4], op2[4], checksum
+// Response: 0x5A, status, result[4], checksum
+//
+// The checksum is the XOR of the bytes between the sync byte and the
+// checksum. Requests are answered in order, one response each. Bytes
+// outside a request are skipped until the next sync byte; a request with
+// a bad checksum is answered with BATCH_BAD_CHECKSUM and the search for a
+// sync byte resumes one byte after it.
+#define BATCH_REQUEST_SYNC 0xA5
+#define BATCH_RESPONSE_SYNC 0x5A
+#define BATCH_REQUEST_SIZE 11
+#define BATCH_RESPONSE_SIZE 7
+
+// Opcodes 0-15 are calculate() operations, sharing one STORE/LOAD storage
+#define BATCH_OP_STATS 0x80         // Result is operations per second so far
+#define BATCH_OP_RESET 0x81         // Clears storage and the statistics
+
+#define BATCH_OK 0
+#define BATCH_BAD_OPCODE 1
+#define BATCH_BAD_CHECKSUM 2
+
+// Responses collected before each call to the write function
+#define BATCH_OUTPUT_RESPONSES 16
+
+typedef void (*batch_write_t)(const uint8_t *data, uint32_t length);
+
+typedef struct
+{
+    batch_write_t write;
+    uint8_t request[BATCH_REQUEST_SIZE];
+    uint32_t request_length;        // Bytes of request held, 0 while seeking sync
+    uint8_t output[BATCH_OUTPUT_RESPONSES * BATCH_RESPONSE_SIZE];
+    uint32_t output_length;
+    int32_t storage;
+
+    uint32_t operations;
+    uint32_t errors;
+    uint64_t first_us;              // When the first operation since reset arrived
+    uint64_t last_us;               // When the latest operation arrived
+} batch_t;
+
+void batch_init(batch_t *batch, batch_write_t write);
+void batch_reset(batch_t *batch);
+void batch_feed(batch_t *batch, const uint8_t *data, uint32_t length, uint64_t now_us);
+uint32_t batch_ops_per_second(const batch_t *batch);
+
+#endif // BATCH_H
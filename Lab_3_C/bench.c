@@ -0,0 +1,214 @@
+/*******************************************************************************
+ * Description: Benchmark firmware. Built instead of the calculator when
+ *              BENCH_FIRMWARE is defined, it calls every driver in a loop
+ *              under the profile.h probes, lets the keypad, button and UART
+ *              interrupts run for a while so their handlers are timed too,
+ *              then prints the probe table on the serial console.
+ *
+ * Build:       Lab_3_C sources with BENCH_FIRMWARE and PROFILE_ENABLE
+ *              defined, plus ../Lab_5_C/sevensegdisplay.c,
+ *              ../Lab_4_C/robomal.c and ../Lab_4_C/robomal_jit.c, with
+ *              Lab_5_C and Lab_4_C on the include path.
+ ******************************************************************************/
+
+#ifdef BENCH_FIRMWARE
+
+#include <stdint.h>
+#include "serial.h"
+#include "interrupt.h"
+#include "timers.h"
+#include "led.h"
+#include "switches.h"
+#include "pmodb.h"
+#include "hexpad.h"
+#include "input.h"
+#include "calculator.h"
+#include "profile.h"
+#include "sevensegdisplay.h"
+#include "robomal.h"
+
+#define BENCH_ITERATIONS 1000
+#define BENCH_PRINT_ITERATIONS 100
+
+// Time given to the scanner and UART interrupts before the table is printed
+#define BENCH_IRQ_TIME_US 2000000
+
+// Countdown from Lab_4_C/robomal_bench.c: subtract 1 until zero, then halt
+static const uint16_t countdown_instructions[] =
+{
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, 0),
+    ROBOMAL_INSTRUCTION(ROBOMAL_SUBTRACT, 2),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRANCHNE, 2),
+    ROBOMAL_INSTRUCTION(ROBOMAL_HALT, 0)
+};
+static const uint16_t countdown_data[] = {0x0010, 0x0001, 0x0000};
+
+static volatile uint32_t sink = 0;
+
+/************************************************************
+ * Function: bench_outputs
+ * Description: LEDs, RGB PWM, PMOD pins and the seven-segment
+ *              display.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+static void bench_outputs()
+{
+    init_seven_seg();
+
+    for(uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        PROFILE_BEGIN(PROFILE_SET_LEDS);
+        set_leds_10bit(i);
+        PROFILE_END(PROFILE_SET_LEDS);
+
+        PROFILE_BEGIN(PROFILE_SET_RGB);
+        set_rgb_color(10, i, i, i);
+        PROFILE_END(PROFILE_SET_RGB);
+
+        PROFILE_BEGIN(PROFILE_PMOD_WRITE);
+        pmod_write_pins(i & 0x0F);
+        PROFILE_END(PROFILE_PMOD_WRITE);
+
+        PROFILE_BEGIN(PROFILE_BIN_TO_BCD);
+        sink += bin_to_bcd(i * 9973);
+        PROFILE_END(PROFILE_BIN_TO_BCD);
+
+        PROFILE_BEGIN(PROFILE_SEVEN_SEG);
+        write_seven_seg_dec(i);
+        PROFILE_END(PROFILE_SEVEN_SEG);
+    }
+
+    set_leds_10bit(0);
+    set_rgb_color(10, 0, 0, 0);
+}
+
+/************************************************************
+ * Function: bench_inputs
+ * Description: Switches and PMOD pin reads.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+static void bench_inputs()
+{
+    for(uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        PROFILE_BEGIN(PROFILE_GET_SWITCHES);
+        sink += get_switches();
+        PROFILE_END(PROFILE_GET_SWITCHES);
+
+        PROFILE_BEGIN(PROFILE_PMOD_READ);
+        sink += pmod_read_pins();
+        PROFILE_END(PROFILE_PMOD_READ);
+    }
+}
+
+/************************************************************
+ * Function: bench_compute
+ * Description: Calculator operations, ROBOMAL cycles and
+ *              software timer starts.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+static void bench_compute()
+{
+    static robomal_t robo;
+    sw_timer_t timer;
+    int32_t storage = 0;
+
+    robomal_init(&robo, countdown_instructions, 4, countdown_data, 3, 0);
+    sw_timer_init(&timer, 0, 0);
+
+    for(uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        PROFILE_BEGIN(PROFILE_CALCULATE);
+        sink += calculate(i * 7919, i + 1, i % CALCULATOR_OPCODES, &storage);
+        PROFILE_END(PROFILE_CALCULATE);
+
+        PROFILE_BEGIN(PROFILE_ROBOMAL_STEP);
+        robomal_status_t status = robomal_step(&robo);
+        PROFILE_END(PROFILE_ROBOMAL_STEP);
+
+        if(status != ROBOMAL_RUNNING)
+        {
+            robomal_reset(&robo);
+        }
+
+        PROFILE_BEGIN(PROFILE_SW_TIMER);
+        sw_timer_start(&timer, 1000 + i, 0);
+        PROFILE_END(PROFILE_SW_TIMER);
+
+        sw_timer_cancel(&timer);
+    }
+
+    // An empty region shows what is left after the overhead is taken off
+    for(uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        PROFILE_BEGIN(PROFILE_EMPTY);
+        PROFILE_END(PROFILE_EMPTY);
+    }
+}
+
+/************************************************************
+ * Function: bench_serial
+ * Description: serial_print of a short line. Each line is
+ *              flushed outside the probe so the TX ring never
+ *              fills and the probe times formatting and
+ *              queueing, not the line rate.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+static void bench_serial()
+{
+    for(uint32_t i = 0; i < BENCH_PRINT_ITERATIONS; i++)
+    {
+        PROFILE_BEGIN(PROFILE_SERIAL_PRINT);
+        serial_print("serial_print %8u\r", i);
+        PROFILE_END(PROFILE_SERIAL_PRINT);
+
+        serial_flush();
+    }
+
+    serial_print("\n");
+}
+
+int main(void)
+{
+    init_GIC();
+    serial_init(UART_STOP_BIT_1, UART_DATA_BITS_8, UART_PARITY_NONE, UART_BAUDRATE_115200);
+    enable_interrupts();
+    profile_init();
+
+    serial_print("\n\nDriver benchmark, %u calls per probe\n", BENCH_ITERATIONS);
+    serial_flush();
+
+    // Startup prints are not part of the measurement
+    profile_reset();
+
+    bench_outputs();
+    bench_inputs();
+    bench_compute();
+    bench_serial();
+
+    serial_print("Scanning inputs for %u ms, press keys and buttons...\n", BENCH_IRQ_TIME_US / 1000);
+    serial_flush();
+    hexpad_init();
+    input_init();
+
+    uint64_t end = get_micros() + BENCH_IRQ_TIME_US;
+
+    while(get_micros() < end)
+    {
+        wait_for_interrupt();
+    }
+
+    profile_print();
+    serial_flush();
+
+    while(1)
+    {
+        wait_for_interrupt();
+    }
+}
+
+#endif // BENCH_FIRMWARE
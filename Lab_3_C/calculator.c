@@ -0,0 +1,120 @@
+#include "calculator.h"
+
+/************************************************************
+ * Function: calculate
+ * Description: Performs the calculation based on the opcode and
+ *              operands provided.
+ * Input parameters: 
+ *      - op1: The first operand.
+ *      - op2: The second operand.
+ *      - opcode: The opcode value.
+ *      - storage: Pointer to the storage value.
+ * Returns: int32_t - The result of the calculation.
+ ************************************************************/
+int32_t calculate(uint32_t op1, uint32_t op2, uint32_t opcode, int32_t *storage)
+{
+    int32_t result_val = 0;
+    uint32_t sixteen_bit_mask = 0xFFFF;
+    switch(opcode)
+    {
+        case 0:
+        result_val = op1 + op2;
+        break;
+
+        case 1:
+        result_val = op1 - op2;
+        break;
+
+        case 2:
+        result_val = op2 - op1;
+        break;
+
+        case 3:
+        result_val = op1 * op2;        
+        break;
+
+        case 4:
+        result_val = op1 * op2 + *storage;      // Cumulative multiply
+        break;
+
+        case 5:
+        result_val = op1 == op2;                // Test Equivalence        
+        break;
+
+        case 6:
+        result_val = (op2 & 0xFF) < 32 ? op1 << (op2 & 0xFF) : 0;    // Shift by the low byte, as LSL does
+        break;
+
+        case 7:
+        result_val = (op2 & 0xFF) < 32 ? op1 >> (op2 & 0xFF) : 0;    // Shift by the low byte, as LSR does
+        break;
+
+        case 8:
+        result_val = op1 & op2; 
+        break;
+
+        case 9:
+        result_val = op1 | op2;        
+        break;
+
+        case 10:
+        result_val = op1 ^ op2;                 // XOR        
+        break;
+
+        case 11:
+        result_val = (op1 & ~op2) & sixteen_bit_mask;
+        break;
+
+        case 12:
+        result_val = (~op1 & sixteen_bit_mask); 
+        break;
+
+        case 13:
+        result_val = count_zeros(op1);
+        break;
+
+        case 14:
+        *storage = op1;
+        // serial_print("Value Stored = %x\n", *storage);     
+        break;
+
+        case 15:
+        // serial_print("Loading value = %x\n", *storage);
+        result_val = *storage;   
+        break;       
+
+        default:
+        // Opcodes are 4 bits, callers reject anything else
+        break;
+    }
+
+    return result_val;
+}
+
+/************************************************************
+ * Function: count_zeros
+ * Description: Counts the number of leading zeros in a 16-bit
+ *              value.
+ * Input parameters: 
+ *      - val: The value to count leading zeros in.
+ * Returns: int32_t - The number of leading zeros.
+ ************************************************************/
+int32_t count_zeros(uint32_t val)
+{
+    uint32_t count = 0;
+    uint32_t mask = 0x8000;   
+    
+    for(int i = 0; i < 16; i++)
+    {
+        if(!(val & (mask >> i))) 
+        {
+            count++;   
+        }
+        else 
+        {
+            return count;
+        }            
+    }
+
+    return count;
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#ifndef CALCULATOR_H
+#define CALCULATOR_H
+
+#include <stdint.h>
+
+// The 16 calculator operations, selected by a 4-bit opcode
+#define CALCULATOR_OPCODES 16
+#define CALCULATOR_STORE 14
+#define CALCULATOR_LOAD 15
+
+int32_t calculate(uint32_t op1, uint32_t op2, uint32_t opcode, int32_t *storage);
+int32_t count_zeros(uint32_t val);
+
+#endif // CALCULATOR_H
@@ -0,0 +1,473 @@
+#include "commands.h"
+#include <string.h>
+#include "shell.h"
+#include "serial.h"
+#include "switches.h"
+#include "calculator.h"
+#include "task.h"
+#include "sevensegdisplay.h"
+#include "hexpad.h"
+#include "motor.h"
+#include "robomal.h"
+
+static void command_op(uint32_t argc, char *argv[]);
+static void command_operand(uint32_t argc, char *argv[]);
+static void command_run(uint32_t argc, char *argv[]);
+static void command_rclear(uint32_t argc, char *argv[]);
+static void command_rprog(uint32_t argc, char *argv[]);
+static void command_rdata(uint32_t argc, char *argv[]);
+static void command_rrun(uint32_t argc, char *argv[]);
+static void command_rstop(uint32_t argc, char *argv[]);
+static void command_rstate(uint32_t argc, char *argv[]);
+static void command_stats(uint32_t argc, char *argv[]);
+static void command_baud(uint32_t argc, char *argv[]);
+static void command_motor(uint32_t argc, char *argv[]);
+
+static const shell_command_t commands[] =
+{
+    {"op", "<opcode>", "set the calculator opcode, 0-F", 1, command_op},
+    {"a", "<value>", "set operand 1", 1, command_operand},
+    {"b", "<value>", "set operand 2", 1, command_operand},
+    {"run", "", "calculate and show the result", 0, command_run},
+    {"rclear", "", "clear the ROBOMAL program and data", 0, command_rclear},
+    {"rprog", "<word>...", "append ROBOMAL instructions", 1, command_rprog},
+    {"rdata", "<halfword>...", "append ROBOMAL data", 1, command_rdata},
+    {"rrun", "[cycles]", "run the ROBOMAL program from the start, 0 cycles for no limit", 0, command_rrun},
+    {"rstop", "", "stop the running ROBOMAL program", 0, command_rstop},
+    {"rstate", "", "show the ROBOMAL registers", 0, command_rstate},
+    {"stats", "", "show the serial, batch and task counters", 0, command_stats},
+    {"baud", "[rate]", "show or change the serial baud rate, decimal", 0, command_baud},
+    {"motor", "[on|off]", "drive the motors on JB from ROBOMAL, instead of the keypad", 0, command_motor}
+};
+
+static const char *robomal_status_names[] =
+{
+    "running", "halted", "invalid opcode", "pc out of range", "cycle limit", "invalid branch", "out of memory",
+    "data out of range", "return stack overflow", "return stack underflow"
+};
+
+static const char *robomal_motion_names[] = {"left", "right", "forward", "backward", "brake"};
+
+// Calculator operation built up by op, a and b
+static uint32_t opcode = 0;
+static uint32_t operands[2] = {0, 0};
+static int32_t storage = 0;
+
+static uint16_t robomal_instructions[COMMANDS_ROBOMAL_INSTRUCTIONS];
+static uint32_t robomal_instruction_count = 0;
+static uint16_t robomal_data[ROBOMAL_DATA_SIZE / 2];
+static uint32_t robomal_data_count = 0;
+static robomal_t robo;
+
+// rrun starts the program on robomal_runner, which runs it a slice at a
+// time so the console and the other tasks keep going
+static task_t robomal_runner;
+static task_event_t robomal_start;
+static uint64_t robomal_end = 0;           // robo.cycles to stop at
+static bool robomal_running = false;
+static bool robomal_stop = false;
+static robomal_status_t robomal_status = ROBOMAL_RUNNING;
+
+static task_status_t robomal_task(task_t *task);
+
+static const batch_t *batch_stats = 0;
+
+/************************************************************
+ * Function: commands_init
+ * Description: Gives the shell the command table and starts the
+ *              task that runs ROBOMAL programs.
+ * Input parameters:
+ *      - batch: Batch mode state, for stats
+ * Returns: None
+ ************************************************************/
+void commands_init(const batch_t *batch)
+{
+    batch_stats = batch;
+    shell_init(commands, sizeof(commands) / sizeof(commands[0]));
+
+    task_event_init(&robomal_start);
+    task_init(&robomal_runner, "robomal", robomal_task, 0);
+    task_start(&robomal_runner);
+}
+
+/************************************************************
+ * Function: parse_argument
+ * Description: Reads a number argument, printing an error if
+ *              it is not one.
+ * Input parameters:
+ *      - text: Argument
+ *      - value: Output, the number
+ * Returns: bool - false if the argument is not a number
+ ************************************************************/
+static bool parse_argument(const char *text, uint32_t *value)
+{
+    if(!shell_parse_number(text, value))
+    {
+        serial_print("'%s' is not a number\n", text);
+        return false;
+    }
+
+    return true;
+}
+
+/************************************************************
+ * Function: command_op
+ * Description: op <opcode>
+ ************************************************************/
+static void command_op(uint32_t argc, char *argv[])
+{
+    uint32_t value;
+
+    if(!parse_argument(argv[1], &value))
+    {
+        return;
+    }
+
+    if(value >= CALCULATOR_OPCODES)
+    {
+        serial_print("opcodes are 0-F\n");
+        return;
+    }
+
+    opcode = value;
+}
+
+/************************************************************
+ * Function: command_operand
+ * Description: a <value> and b <value>
+ ************************************************************/
+static void command_operand(uint32_t argc, char *argv[])
+{
+    parse_argument(argv[1], &operands[argv[0][0] == 'b']);
+}
+
+/************************************************************
+ * Function: command_run
+ * Description: run, computes op on a and b like the keypad
+ *              calculator and shows the result.
+ ************************************************************/
+static void command_run(uint32_t argc, char *argv[])
+{
+    int32_t result = calculate(operands[0], operands[1], opcode, &storage);
+
+    if(opcode == CALCULATOR_STORE)
+    {
+        serial_print("stored %x\n", storage);
+        return;
+    }
+
+    serial_print("%x\n", result);
+    write_seven_seg_hex(result);
+}
+
+/************************************************************
+ * Function: command_rclear
+ * Description: rclear
+ ************************************************************/
+static void command_rclear(uint32_t argc, char *argv[])
+{
+    robomal_instruction_count = 0;
+    robomal_data_count = 0;
+}
+
+/************************************************************
+ * Function: append_words
+ * Description: Appends the number arguments to a program or
+ *              data array, stopping at the first bad one.
+ * Input parameters:
+ *      - argc, argv: Command arguments
+ *      - words: Array to append to
+ *      - count: Words held, updated
+ *      - size: Capacity of words
+ * Returns: None
+ ************************************************************/
+static void append_words(uint32_t argc, char *argv[], uint16_t *words, uint32_t *count, uint32_t size)
+{
+    for(uint32_t i = 1; i < argc; i++)
+    {
+        uint32_t value;
+
+        if(*count == size)
+        {
+            serial_print("full at %u words\n", size);
+            return;
+        }
+
+        if(!parse_argument(argv[i], &value))
+        {
+            return;
+        }
+
+        words[(*count)++] = value;
+    }
+}
+
+/************************************************************
+ * Function: command_rprog
+ * Description: rprog <word>...
+ ************************************************************/
+static void command_rprog(uint32_t argc, char *argv[])
+{
+    append_words(argc, argv, robomal_instructions, &robomal_instruction_count, COMMANDS_ROBOMAL_INSTRUCTIONS);
+}
+
+/************************************************************
+ * Function: command_rdata
+ * Description: rdata <halfword>...
+ ************************************************************/
+static void command_rdata(uint32_t argc, char *argv[])
+{
+    append_words(argc, argv, robomal_data, &robomal_data_count, ROBOMAL_DATA_SIZE / 2);
+}
+
+/************************************************************
+ * Function: robomal_read_pins
+ * Description: ROBOMAL READ takes the slide switches.
+ ************************************************************/
+static uint32_t robomal_read_pins(void *context)
+{
+    return get_switches();
+}
+
+/************************************************************
+ * Function: robomal_write_pins
+ * Description: ROBOMAL WRITE prints the value.
+ ************************************************************/
+static void robomal_write_pins(void *context, uint32_t value)
+{
+    serial_print("write %x\n", value);
+}
+
+/************************************************************
+ * Function: robomal_motion
+ * Description: ROBOMAL motion instructions are printed, and
+ *              set the motor targets while motor is on.
+ ************************************************************/
+static void robomal_motion(void *context, uint8_t opcode, uint8_t operand)
+{
+    serial_print("%s %u\n", robomal_motion_names[opcode - ROBOMAL_LEFT], operand);
+
+    if(motor_active())
+    {
+        motor_command(opcode - ROBOMAL_LEFT, operand);
+    }
+}
+
+/************************************************************
+ * Function: command_rstate
+ * Description: rstate
+ ************************************************************/
+static void command_rstate(uint32_t argc, char *argv[])
+{
+    serial_print("acc %x pc %x cycles %u invalid %u\n", robo.accumulator, robo.pc, (uint32_t)robo.cycles,
+                 robo.invalid_opcodes);
+}
+
+/************************************************************
+ * Function: command_rrun
+ * Description: rrun [cycles], resets the machine and hands the
+ *              program to robomal_task, which reports when it
+ *              stops. A program already running starts over.
+ ************************************************************/
+static void command_rrun(uint32_t argc, char *argv[])
+{
+    static const robomal_io_t io = {robomal_read_pins, robomal_write_pins, robomal_motion, 0};
+    uint32_t cycles = COMMANDS_ROBOMAL_CYCLES;
+
+    if(argc > 1 && !parse_argument(argv[1], &cycles))
+    {
+        return;
+    }
+
+    if(!robomal_instruction_count)
+    {
+        serial_print("no program, load one with rprog\n");
+        return;
+    }
+
+    robomal_init(&robo, robomal_instructions, robomal_instruction_count, robomal_data, robomal_data_count, &io);
+    robomal_end = cycles ? cycles : UINT64_MAX;
+    robomal_stop = false;
+    robomal_running = true;
+    task_event_signal(&robomal_start);
+}
+
+/************************************************************
+ * Function: command_rstop
+ * Description: rstop, ends the running program before its next
+ *              slice.
+ ************************************************************/
+static void command_rstop(uint32_t argc, char *argv[])
+{
+    if(!robomal_running)
+    {
+        serial_print("no program running\n");
+        return;
+    }
+
+    robomal_stop = true;
+}
+
+/************************************************************
+ * Function: robomal_task
+ * Description: Waits for rrun, then runs the program at most
+ *              COMMANDS_ROBOMAL_SLICE cycles per scheduler pass
+ *              until it stops, reaches its cycle budget or
+ *              rstop, and prints how it ended.
+ * Input parameters:
+ *      - task: This task
+ * Returns: task_status_t - How the task stopped
+ ************************************************************/
+static task_status_t robomal_task(task_t *task)
+{
+    TASK_BEGIN(task);
+
+    while(1)
+    {
+        TASK_WAIT_UNTIL(task, &robomal_start, robomal_running);
+
+        while(1)
+        {
+            if(robomal_stop)
+            {
+                break;
+            }
+
+            uint64_t left = robomal_end - robo.cycles;
+
+            robomal_status = robomal_run(&robo, left < COMMANDS_ROBOMAL_SLICE ? left : COMMANDS_ROBOMAL_SLICE);
+
+            if(robomal_status != ROBOMAL_CYCLE_LIMIT || robo.cycles >= robomal_end)
+            {
+                break;
+            }
+
+            TASK_YIELD(task);
+        }
+
+        robomal_running = false;
+        serial_print("%s: ", robomal_stop ? "stopped" : robomal_status_names[robomal_status]);
+        command_rstate(0, 0);
+        shell_prompt();
+    }
+
+    TASK_END(task);
+}
+
+/************************************************************
+ * Function: command_stats
+ * Description: stats
+ ************************************************************/
+static void command_stats(uint32_t argc, char *argv[])
+{
+    serial_print("rx: %u waiting, %u dropped, %u overruns, %u framing errors, %u parity errors\n",
+                 serial_rx_available(), serial_get_rx_dropped(), serial_get_rx_overruns(),
+                 serial_get_rx_framing_errors(), serial_get_rx_parity_errors());
+    serial_print("tx: %u dropped, %u high water\n", serial_get_tx_dropped(), serial_get_tx_high_water());
+
+    if(batch_stats)
+    {
+        serial_print("batch: %u operations, %u errors, %u per second\n", batch_stats->operations,
+                     batch_stats->errors, batch_ops_per_second(batch_stats));
+    }
+
+    task_print_stats();
+}
+
+/************************************************************
+ * Function: print_baud
+ * Description: Prints a rate and its divisors.
+ * Input parameters:
+ *      - baud: Divisors and the rate they give
+ * Returns: None
+ ************************************************************/
+static void print_baud(const serial_baud_t *baud)
+{
+    int32_t error = baud->error_ppm;
+    uint32_t magnitude = error < 0 ? -error : error;
+
+    serial_print("%u baud, cd %u bdiv %u, error %c%u.%04u%%\n", baud->actual, baud->cd, baud->bdiv,
+                 error < 0 ? '-' : '+', magnitude / 10000, magnitude % 10000);
+}
+
+/************************************************************
+ * Function: command_baud
+ * Description: baud [rate], shows the rate or changes it. The
+ *              new rate is printed before the switch so it can
+ *              still be read at the old one.
+ ************************************************************/
+static void command_baud(uint32_t argc, char *argv[])
+{
+    serial_baud_t baud = {0, 0, 0, 0};
+    uint32_t rate;
+
+    if(argc < 2)
+    {
+        print_baud(serial_get_baud());
+        return;
+    }
+
+    if(!shell_parse_decimal(argv[1], &rate))
+    {
+        serial_print("'%s' is not a number\n", argv[1]);
+        return;
+    }
+
+    bool reachable = serial_compute_baud(rate, &baud);
+
+    if(!reachable && !baud.actual)
+    {
+        serial_print("%u baud is out of range\n", rate);
+        return;
+    }
+
+    print_baud(&baud);
+
+    if(!reachable)
+    {
+        serial_print("too far from %u baud, unchanged\n", rate);
+        return;
+    }
+
+    serial_set_baudrate(rate);
+}
+
+/************************************************************
+ * Function: command_motor
+ * Description: motor [on|off], shows the motor levels or hands
+ *              the JB pins between the keypad and the motors.
+ *              Turning off stops the motors at once.
+ ************************************************************/
+static void command_motor(uint32_t argc, char *argv[])
+{
+    if(argc > 1 && !strcmp(argv[1], "on"))
+    {
+        if(!motor_active())
+        {
+            hexpad_stop();
+            motor_init();
+        }
+    }
+    else if(argc > 1 && !strcmp(argv[1], "off"))
+    {
+        if(motor_active())
+        {
+            motor_release();
+            hexpad_init();
+        }
+    }
+    else if(argc > 1)
+    {
+        serial_print("usage: motor [on|off]\n");
+        return;
+    }
+
+    if(!motor_active())
+    {
+        serial_print("motors off, JB is the keypad\n");
+        return;
+    }
+
+    serial_print("left %d of %d, right %d of %d\n", motor_get_level(MOTOR_LEFT), motor_get_target(MOTOR_LEFT),
+                 motor_get_level(MOTOR_RIGHT), motor_get_target(MOTOR_RIGHT));
+}
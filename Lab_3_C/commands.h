@@ -0,0 +1,20 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <stdint.h>
+#include "batch.h"
+
+// Shell commands of the calculator firmware: set and run calculator
+// operations, load and run a ROBOMAL program, and dump the counters.
+
+// Largest ROBOMAL program the shell holds
+#define COMMANDS_ROBOMAL_INSTRUCTIONS 256
+
+#define COMMANDS_ROBOMAL_CYCLES 100000
+
+// Cycles rrun runs per scheduler pass, so other tasks are not held up
+#define COMMANDS_ROBOMAL_SLICE 2000
+
+void commands_init(const batch_t *batch);
+
+#endif // COMMANDS_H
@@ -0,0 +1,202 @@
+#include "format.h"
+#include <stdint.h>
+
+/************************************************************
+ * Function: format_padding
+ * Description: Writes a run of padding characters.
+ * Input parameters:
+ *      - putc: Character sink
+ *      - pad: Padding character
+ *      - count: Number of characters to write
+ * Returns: None
+ ************************************************************/
+static void format_padding(format_putc_t putc, char pad, int32_t count)
+{
+    while(count-- > 0)
+    {
+        putc(pad);
+    }
+}
+
+/************************************************************
+ * Function: format_number
+ * Description: Streams an unsigned value in base 10 or 16 with
+ *              sign and padding. Digits are produced least
+ *              significant first into a 10 character scratch
+ *              area; decimal digits use a reciprocal multiply
+ *              since the Cortex-A9 has no hardware divide.
+ * Input parameters:
+ *      - putc: Character sink
+ *      - value: Magnitude to print
+ *      - hex: true for base 16, false for base 10
+ *      - upper: true for 'A'-'F' hex digits
+ *      - negative: true to print a leading '-'
+ *      - width: Minimum field width
+ *      - zero_pad: true to pad with '0' instead of ' '
+ *      - left: true to left-justify in the field
+ * Returns: None
+ ************************************************************/
+static void format_number(format_putc_t putc, uint32_t value, bool hex, bool upper, bool negative,
+                          int32_t width, bool zero_pad, bool left)
+{
+    char digits[10];
+    int32_t count = 0;
+    char hex_base = upper ? 'A' - 10 : 'a' - 10;
+
+    do
+    {
+        if(hex)
+        {
+            uint32_t nibble = value & 0xF;
+            digits[count++] = nibble < 10 ? '0' + nibble : hex_base + nibble;
+            value >>= 4;
+        }
+        else
+        {
+            // value / 10, exact for all 32-bit values
+            uint32_t quotient = (uint32_t)(((uint64_t)value * 0xCCCCCCCDu) >> 35);
+            digits[count++] = '0' + (value - quotient * 10);
+            value = quotient;
+        }
+    } while(value);
+
+    int32_t padding = width - count - negative;
+
+    if(!left && !zero_pad) format_padding(putc, ' ', padding);
+    if(negative) putc('-');
+    if(!left && zero_pad) format_padding(putc, '0', padding);
+
+    while(count)
+    {
+        putc(digits[--count]);
+    }
+
+    if(left) format_padding(putc, ' ', padding);
+}
+
+/************************************************************
+ * Function: format_vprint
+ * Description: Streams a formatted string into putc one
+ *              character at a time. Supports %d %i %u %x %X
+ *              %s %c and %%, with '-' and '0' flags and a field
+ *              width. There is no intermediate buffer and no
+ *              output length limit.
+ * Input parameters:
+ *      - putc: Character sink
+ *      - format: The format string
+ *      - args: Arguments for the format string
+ * Returns: None
+ ************************************************************/
+void format_vprint(format_putc_t putc, const char *format, va_list args)
+{
+    while(*format)
+    {
+        if(*format != '%')
+        {
+            putc(*format++);
+            continue;
+        }
+
+        format++;
+
+        // Parsing flags and width
+        bool left = false;
+        bool zero_pad = false;
+        int32_t width = 0;
+
+        while(*format == '-' || *format == '0')
+        {
+            if(*format == '-') left = true;
+            if(*format == '0') zero_pad = true;
+            format++;
+        }
+
+        while(*format >= '0' && *format <= '9')
+        {
+            width = width * 10 + (*format - '0');
+            format++;
+        }
+
+        // int and long are both 32 bits on the target
+        while(*format == 'l')
+        {
+            format++;
+        }
+
+        switch(*format)
+        {
+            case 'd':
+            case 'i':
+            {
+                int32_t value = va_arg(args, int32_t);
+                uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+                format_number(putc, magnitude, false, false, value < 0, width, zero_pad, left);
+                break;
+            }
+
+            case 'u':
+            format_number(putc, va_arg(args, uint32_t), false, false, false, width, zero_pad, left);
+            break;
+
+            case 'x':
+            format_number(putc, va_arg(args, uint32_t), true, false, false, width, zero_pad, left);
+            break;
+
+            case 'X':
+            format_number(putc, va_arg(args, uint32_t), true, true, false, width, zero_pad, left);
+            break;
+
+            case 's':
+            {
+                const char *string = va_arg(args, const char*);
+                int32_t length = 0;
+
+                if(!string) string = "(null)";
+                while(string[length]) length++;
+
+                if(!left) format_padding(putc, ' ', width - length);
+                while(*string) putc(*string++);
+                if(left) format_padding(putc, ' ', width - length);
+                break;
+            }
+
+            case 'c':
+            if(!left) format_padding(putc, ' ', width - 1);
+            putc((char)va_arg(args, int));
+            if(left) format_padding(putc, ' ', width - 1);
+            break;
+
+            case '%':
+            putc('%');
+            break;
+
+            case '\0':
+            // Lone '%' at end of string
+            return;
+
+            default:
+            // Unsupported conversion, print it unchanged
+            putc('%');
+            putc(*format);
+        }
+
+        format++;
+    }
+}
+
+/************************************************************
+ * Function: format_print
+ * Description: Variadic wrapper around format_vprint.
+ * Input parameters:
+ *      - putc: Character sink
+ *      - format: The format string
+ *      - ...: Additional arguments for the format string
+ * Returns: None
+ ************************************************************/
+void format_print(format_putc_t putc, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    format_vprint(putc, format, args);
+    va_end(args);
+}
@@ -0,0 +1,14 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+// Character sink that format_print streams into (UART FIFO, TX buffer...)
+typedef void (*format_putc_t)(char c);
+
+void format_print(format_putc_t putc, const char *format, ...);
+void format_vprint(format_putc_t putc, const char *format, va_list args);
+
+#endif // FORMAT_H
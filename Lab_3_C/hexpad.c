@@ -1,17 +1,78 @@
 #include "hexpad.h"
+#include "profile.h"
 #include <stdint.h>
 
+// Key number for each column/row, filled from parse_key_number
+static uint8_t key_map[HEXPAD_COLUMNS][HEXPAD_ROWS];
+
+// Scanner state, owned by hexpad_scan_isr
+static uint32_t scan_column = 0;
+static uint8_t debounce_count[HEXPAD_KEYS];
+static volatile uint32_t held_keys = 0;
+static sw_timer_t scan_timer;
+
+// Key event queue. event_head is only advanced by the scanner and
+// event_tail by the reader, so both run free and are masked on access.
+static volatile hexpad_event_t event_queue[HEXPAD_EVENT_QUEUE_SIZE];
+static volatile uint32_t event_head = 0;
+static volatile uint32_t event_tail = 0;
+static volatile uint32_t events_dropped = 0;
+static task_event_t *event_signal = 0;    // Signalled for each queued event, if set
+
+int32_t parse_key_number(uint32_t row, uint32_t column);
+static void drive_column(uint32_t column);
+static void push_event(uint8_t key, bool pressed);
+
 /************************************************************
  * Function: hexpad_init
  * Description: Initializes the hex keypad by setting the pin
- *              directions and writing initial values to the pins.
+ *              directions and starts the background scanner on
+ *              a software timer. init_GIC must have been
+ *              called; keys are scanned once interrupts are
+ *              enabled.
  * Input parameters: None
  * Returns: None
  ************************************************************/
 void hexpad_init()
 {
+    for(uint32_t column = 0; column < HEXPAD_COLUMNS; column++)
+    {
+        for(uint32_t row = 0; row < HEXPAD_ROWS; row++)
+        {
+            key_map[column][row] = parse_key_number(row + 1, column + 1);
+        }
+    }
+
+    for(uint32_t key = 0; key < HEXPAD_KEYS; key++)
+    {
+        debounce_count[key] = 0;
+    }
+
+    held_keys = 0;
+    event_head = 0;
+    event_tail = 0;
+
     pmod_set_pin_directions(0b00001111);
-    pmod_write_pins(0b00001111);
+
+    // The first column is driven now and read on the first scan
+    scan_column = 0;
+    drive_column(scan_column);
+
+    sw_timer_init(&scan_timer, hexpad_scan_isr, 0);
+    sw_timer_start(&scan_timer, HEXPAD_SCAN_US, HEXPAD_SCAN_US);
+}
+
+/************************************************************
+ * Function: hexpad_stop
+ * Description: Stops the background scanner so another driver
+ *              can use the JB pins. Held keys and queued events
+ *              are kept; hexpad_init starts over.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void hexpad_stop()
+{
+    sw_timer_cancel(&scan_timer);
 }
 
 /************************************************************
@@ -49,52 +110,223 @@ int32_t parse_key_number(uint32_t row, uint32_t column)
 }
 
 /************************************************************
- * Function: get_hexkey
- * Description: Reads the hex keypad to determine which key
- *              has been pressed.
- * Input parameters: None
- * Returns: The key number corresponding to the pressed key,
- *          or -1 if no valid key press is detected.
+ * Function: hexpad_scan_isr
+ * Description: Scan timer callback. Reads the four rows of the
+ *              column driven on the previous scan with a single
+ *              pmod_read_pins, giving the lines a whole period
+ *              to settle, runs an integrating debounce on each
+ *              of its keys and queues press and release edges.
+ *              Then drives the next column low.
+ * Input parameters:
+ *      - context: Unused timer context
+ * Returns: None
  ************************************************************/
-int32_t get_hexkey()
+void hexpad_scan_isr(void *context)
 {
-    uint32_t column = 0;
-    uint32_t row = 0;
+    PROFILE_SCOPE(PROFILE_HEXPAD_SCAN_ISR);
+
+    // Rows are active low on pins 8 (row 1) down to 5 (row 4)
+    uint32_t rows = ~pmod_read_pins();
 
-    for(int i = 4; i >= 1; i--)
+    for(uint32_t row = 0; row < HEXPAD_ROWS; row++)
     {
-        for(int j = 8; j >= 5; j--)
-        {
-            pmod_write_pin(i, 0);
+        uint8_t key = key_map[scan_column][row];
+        uint32_t key_bit = 1 << key;
+        bool down = (rows >> (7 - row)) & 1;
 
-            if(!pmod_read_pin(j))
+        // Counting towards pressed or released, the state only flips at the ends
+        if(down && debounce_count[key] < HEXPAD_DEBOUNCE_SCANS)
+        {
+            if(++debounce_count[key] == HEXPAD_DEBOUNCE_SCANS && !(held_keys & key_bit))
             {
-                column = 5 - i;
-                row = 9 - j;
+                held_keys |= key_bit;
+                push_event(key, true);
+            }
+        }
+        else if(!down && debounce_count[key] > 0)
+        {
+            if(--debounce_count[key] == 0 && (held_keys & key_bit))
+            {
+                held_keys &= ~key_bit;
+                push_event(key, false);
             }
-                
-            pmod_write_pin(i, 1);
         }
     }
 
-    return parse_key_number(row, column);
+    scan_column = (scan_column + 1) % HEXPAD_COLUMNS;
+    drive_column(scan_column);
+}
+
+/************************************************************
+ * Function: hexpad_poll
+ * Description: Takes the oldest key event from the queue
+ *              without waiting.
+ * Input parameters:
+ *      - event: Where the event is stored
+ * Returns: bool - true if an event was taken
+ ************************************************************/
+bool hexpad_poll(hexpad_event_t *event)
+{
+    uint32_t tail = event_tail;
+
+    if(tail == event_head)
+    {
+        return false;
+    }
+
+    *event = event_queue[tail & (HEXPAD_EVENT_QUEUE_SIZE - 1)];
+    event_tail = tail + 1;
+
+    return true;
+}
+
+/************************************************************
+ * Function: hexpad_wait
+ * Description: Waits for the next key event, up to a timeout.
+ * Input parameters:
+ *      - event: Where the event is stored
+ *      - timeout_ms: Milliseconds to wait, or
+ *                    HEXPAD_WAIT_FOREVER
+ * Returns: bool - true if an event was taken, false on timeout
+ ************************************************************/
+bool hexpad_wait(hexpad_event_t *event, uint32_t timeout_ms)
+{
+    uint32_t start = get_tick_millis();
+
+    // Events only arrive from the scan timer, so sleeping until the next interrupt
+    while(!hexpad_poll(event))
+    {
+        if(timeout_ms != HEXPAD_WAIT_FOREVER && get_tick_millis() - start >= timeout_ms)
+        {
+            return false;
+        }
+
+        wait_for_interrupt();
+    }
+
+    return true;
+}
+
+/************************************************************
+ * Function: hexpad_held_keys
+ * Description: Returns the debounced state of every key.
+ * Input parameters: None
+ * Returns: uint32_t - Bit n set while key n is held
+ ************************************************************/
+uint32_t hexpad_held_keys()
+{
+    return held_keys;
+}
+
+/************************************************************
+ * Function: hexpad_get_dropped
+ * Description: Returns the number of key events discarded
+ *              because the queue was full.
+ * Input parameters: None
+ * Returns: uint32_t - Dropped event count
+ ************************************************************/
+uint32_t hexpad_get_dropped()
+{
+    return events_dropped;
+}
+
+/************************************************************
+ * Function: hexpad_set_task_event
+ * Description: Sets a task event to signal each time a key
+ *              event is queued, so a task can wait on it with
+ *              TASK_WAIT_UNTIL around hexpad_poll. The same event
+ *              may be given to several drivers.
+ * Input parameters:
+ *      - event: Event to signal, 0 for none
+ * Returns: None
+ ************************************************************/
+void hexpad_set_task_event(task_event_t *event)
+{
+    event_signal = event;
+}
+
+/************************************************************
+ * Function: get_hexkey
+ * Description: Returns the key currently held down, from the
+ *              debounced scanner state.
+ * Input parameters: None
+ * Returns: The key number of the lowest held key, or -1 if no
+ *          key is held.
+ ************************************************************/
+int32_t get_hexkey()
+{
+    PROFILE_SCOPE(PROFILE_GET_HEXKEY);
+
+    uint32_t keys = held_keys;
+
+    if(!keys)
+    {
+        return -1;
+    }
+
+    return __builtin_ctz(keys);
 }
 
 /************************************************************
  * Function: wait_for_next_hexkey
- * Description: Waits indefinitely for the next valid hex key
- *              press.
+ * Description: Waits indefinitely for the next hex key press.
+ *              Each press is returned once, however long the
+ *              key is held.
  * Input parameters: None
  * Returns: The key number corresponding to the pressed key.
  ************************************************************/
 int32_t wait_for_next_hexkey()
 {
-    int32_t key_number = -1;
+    hexpad_event_t event;
+
+    do
+    {
+        hexpad_wait(&event, HEXPAD_WAIT_FOREVER);
+    } while(!event.pressed);
+
+    return event.key;
+}
+
+/************************************************************
+ * Function: drive_column
+ * Description: Drives one column low and the others high.
+ * Input parameters:
+ *      - column: Column index 0-3 (column 1 is pin 4)
+ * Returns: None
+ ************************************************************/
+static void drive_column(uint32_t column)
+{
+    pmod_write_pins(0b00001111 & ~(0b1000 >> column));
+}
 
-    while(key_number < 0)       
+/************************************************************
+ * Function: push_event
+ * Description: Queues a key event, dropping it if the queue is
+ *              full.
+ * Input parameters:
+ *      - key: Key number
+ *      - pressed: true for a press, false for a release
+ * Returns: None
+ ************************************************************/
+static void push_event(uint8_t key, bool pressed)
+{
+    uint32_t head = event_head;
+
+    if(head - event_tail >= HEXPAD_EVENT_QUEUE_SIZE)
     {
-        key_number = get_hexkey();
+        events_dropped++;
+        return;
     }
 
-    return key_number;
-}
\ No newline at end of file
+    volatile hexpad_event_t *event = &event_queue[head & (HEXPAD_EVENT_QUEUE_SIZE - 1)];
+    event->key = key;
+    event->pressed = pressed;
+    event->time_ms = get_tick_millis();
+
+    event_head = head + 1;
+
+    if(event_signal)
+    {
+        task_event_signal(event_signal);
+    }
+}
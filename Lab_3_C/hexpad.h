@@ -6,11 +6,42 @@
 #include <sleep.h>
 #include "pmodb.h"
 #include "serial.h"
+#include "timers.h"
+#include "task.h"
 
-static bool hexpad_initialized = false;
+// The scanner drives one column per HEXPAD_SCAN_US, so a full scan of
+// the keypad takes 4 ms
+#define HEXPAD_COLUMNS 4
+#define HEXPAD_ROWS 4
+#define HEXPAD_KEYS 16
+
+// One column is scanned per timer period
+#define HEXPAD_SCAN_US 1000
+
+// Full scans a key must read the same before its state changes (20 ms)
+#define HEXPAD_DEBOUNCE_SCANS 5
+
+// Size of the key event queue, must be a power of 2
+#define HEXPAD_EVENT_QUEUE_SIZE 16
+
+#define HEXPAD_WAIT_FOREVER 0xFFFFFFFF
+
+typedef struct
+{
+    uint8_t key;            // Key number 0x0-0xF
+    bool pressed;           // true on press, false on release
+    uint32_t time_ms;       // get_tick_millis() when the edge was accepted
+} hexpad_event_t;
 
 void hexpad_init();
+void hexpad_stop();
+bool hexpad_poll(hexpad_event_t *event);
+bool hexpad_wait(hexpad_event_t *event, uint32_t timeout_ms);
+uint32_t hexpad_held_keys();
+uint32_t hexpad_get_dropped();
+void hexpad_scan_isr(void *context);
+void hexpad_set_task_event(task_event_t *event);
 int32_t wait_for_next_hexkey();
 int32_t get_hexkey();
 
-#endif // HEXPAD_H
\ No newline at end of file
+#endif // HEXPAD_H
@@ -0,0 +1,308 @@
+#include "input.h"
+#include "profile.h"
+
+// Buttons in bits 0-3 and switches in bits 4-15 of one sample
+#define INPUT_SWITCH_SHIFT INPUT_BUTTONS
+
+// Sampler state, owned by input_sample_isr
+static uint32_t last_sample = 0;
+static uint32_t stable_samples = INPUT_DEBOUNCE_MS;
+static uint32_t change_started = 0;
+static volatile uint32_t debounced = 0;
+static sw_timer_t sample_timer;
+
+// Event queue. event_head is only advanced by the sampler and
+// event_tail by the reader, so both run free and are masked on access.
+static volatile input_event_t event_queue[INPUT_EVENT_QUEUE_SIZE];
+static volatile uint32_t event_head = 0;
+static volatile uint32_t event_tail = 0;
+static volatile uint32_t events_dropped = 0;
+static task_event_t *event_signal = 0;    // Signalled for each queued event, if set
+static uint32_t max_latency = 0;
+
+static uint32_t read_inputs();
+static void push_event(input_event_type_t type, uint8_t index, bool value, uint32_t time_ms);
+
+/************************************************************
+ * Function: input_init
+ * Description: Takes the current buttons and switches as the
+ *              starting state and starts sampling them every
+ *              millisecond on a software timer. init_GIC must
+ *              have been called.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void input_init()
+{
+    last_sample = read_inputs();
+    debounced = last_sample;
+    stable_samples = INPUT_DEBOUNCE_MS;
+    event_head = 0;
+    event_tail = 0;
+
+    sw_timer_init(&sample_timer, input_sample_isr, 0);
+    sw_timer_start(&sample_timer, INPUT_SAMPLE_US, INPUT_SAMPLE_US);
+}
+
+/************************************************************
+ * Function: input_sample_isr
+ * Description: Sample timer callback. Samples the buttons and
+ *              switches with one read each. Once every input
+ *              has read the same for INPUT_DEBOUNCE_MS samples,
+ *              each bit that differs from the debounced state
+ *              is queued as a press, release or switch change,
+ *              stamped with the time the change first appeared.
+ * Input parameters:
+ *      - context: Unused timer context
+ * Returns: None
+ ************************************************************/
+void input_sample_isr(void *context)
+{
+    PROFILE_SCOPE(PROFILE_INPUT_SAMPLE_ISR);
+
+    uint32_t sample = read_inputs();
+
+    if(sample != last_sample)
+    {
+        // The first difference from a settled state starts the change
+        if(stable_samples >= INPUT_DEBOUNCE_MS)
+        {
+            change_started = get_tick_millis();
+        }
+
+        last_sample = sample;
+        stable_samples = 0;
+        return;
+    }
+
+    if(stable_samples >= INPUT_DEBOUNCE_MS)
+    {
+        return;
+    }
+
+    if(++stable_samples < INPUT_DEBOUNCE_MS)
+    {
+        return;
+    }
+
+    uint32_t changed = sample ^ debounced;
+    debounced = sample;
+
+    while(changed)
+    {
+        uint32_t bit = __builtin_ctz(changed);
+        bool value = (sample >> bit) & 1;
+
+        changed &= changed - 1;
+
+        if(bit < INPUT_SWITCH_SHIFT)
+        {
+            push_event(value ? INPUT_BUTTON_PRESS : INPUT_BUTTON_RELEASE, bit, value, change_started);
+        }
+        else
+        {
+            push_event(INPUT_SWITCH_CHANGE, bit - INPUT_SWITCH_SHIFT, value, change_started);
+        }
+    }
+}
+
+/************************************************************
+ * Function: input_poll
+ * Description: Takes the oldest input event from the queue
+ *              without waiting, and updates the latency figure.
+ * Input parameters:
+ *      - event: Where the event is stored
+ * Returns: bool - true if an event was taken
+ ************************************************************/
+bool input_poll(input_event_t *event)
+{
+    uint32_t tail = event_tail;
+
+    if(tail == event_head)
+    {
+        return false;
+    }
+
+    *event = event_queue[tail & (INPUT_EVENT_QUEUE_SIZE - 1)];
+    event_tail = tail + 1;
+
+    uint32_t latency = get_tick_millis() - event->time_ms;
+
+    if(latency > max_latency)
+    {
+        max_latency = latency;
+    }
+
+    return true;
+}
+
+/************************************************************
+ * Function: input_wait
+ * Description: Sleeps until the next input event, up to a
+ *              timeout.
+ * Input parameters:
+ *      - event: Where the event is stored
+ *      - timeout_ms: Milliseconds to wait, or
+ *                    INPUT_WAIT_FOREVER
+ * Returns: bool - true if an event was taken, false on timeout
+ ************************************************************/
+bool input_wait(input_event_t *event, uint32_t timeout_ms)
+{
+    uint32_t start = get_tick_millis();
+
+    while(!input_poll(event))
+    {
+        if(timeout_ms != INPUT_WAIT_FOREVER && get_tick_millis() - start >= timeout_ms)
+        {
+            return false;
+        }
+
+        wait_for_interrupt();
+    }
+
+    return true;
+}
+
+/************************************************************
+ * Function: input_wait_for_button
+ * Description: Sleeps until one of the given buttons is
+ *              pressed, discarding other events.
+ * Input parameters:
+ *      - buttons: Bitmask of the buttons of interest
+ *      - timeout_ms: Milliseconds to wait, or
+ *                    INPUT_WAIT_FOREVER
+ * Returns: int32_t - Button pressed (0-3), or -1 on timeout
+ ************************************************************/
+int32_t input_wait_for_button(uint32_t buttons, uint32_t timeout_ms)
+{
+    uint32_t start = get_tick_millis();
+    input_event_t event;
+
+    while(1)
+    {
+        uint32_t waited = get_tick_millis() - start;
+
+        if(timeout_ms != INPUT_WAIT_FOREVER && waited >= timeout_ms)
+        {
+            return -1;
+        }
+
+        if(!input_wait(&event, timeout_ms == INPUT_WAIT_FOREVER ? INPUT_WAIT_FOREVER : timeout_ms - waited))
+        {
+            return -1;
+        }
+
+        if(event.type == INPUT_BUTTON_PRESS && ((buttons >> event.index) & 1))
+        {
+            return event.index;
+        }
+    }
+}
+
+/************************************************************
+ * Function: input_get_buttons
+ * Description: Returns the debounced state of the buttons.
+ * Input parameters: None
+ * Returns: uint32_t - Bit n set while button n is held
+ ************************************************************/
+uint32_t input_get_buttons()
+{
+    return debounced & ((1 << INPUT_BUTTONS) - 1);
+}
+
+/************************************************************
+ * Function: input_get_switches
+ * Description: Returns the debounced state of the switches.
+ * Input parameters: None
+ * Returns: uint32_t - Switches 0-11
+ ************************************************************/
+uint32_t input_get_switches()
+{
+    return debounced >> INPUT_SWITCH_SHIFT;
+}
+
+/************************************************************
+ * Function: input_get_dropped
+ * Description: Returns the number of input events discarded
+ *              because the queue was full.
+ * Input parameters: None
+ * Returns: uint32_t - Dropped event count
+ ************************************************************/
+uint32_t input_get_dropped()
+{
+    return events_dropped;
+}
+
+/************************************************************
+ * Function: input_set_task_event
+ * Description: Sets a task event to signal each time an input
+ *              event is queued, so a task can wait on it with
+ *              TASK_WAIT_UNTIL around input_poll. The same event
+ *              may be given to several drivers.
+ * Input parameters:
+ *      - event: Event to signal, 0 for none
+ * Returns: None
+ ************************************************************/
+void input_set_task_event(task_event_t *event)
+{
+    event_signal = event;
+}
+
+/************************************************************
+ * Function: input_get_max_latency
+ * Description: Returns the longest time from an input first
+ *              changing to its event being taken by
+ *              input_poll, debounce included.
+ * Input parameters: None
+ * Returns: uint32_t - Latency in milliseconds
+ ************************************************************/
+uint32_t input_get_max_latency()
+{
+    return max_latency;
+}
+
+/************************************************************
+ * Function: read_inputs
+ * Description: Reads the buttons and switches into one sample.
+ * Input parameters: None
+ * Returns: uint32_t - Buttons in bits 0-3, switches in 4-15
+ ************************************************************/
+static uint32_t read_inputs()
+{
+    return get_buttons() | (get_switches() << INPUT_SWITCH_SHIFT);
+}
+
+/************************************************************
+ * Function: push_event
+ * Description: Queues an input event, dropping it if the queue
+ *              is full.
+ * Input parameters:
+ *      - type: Press, release or switch change
+ *      - index: Button or switch number
+ *      - value: New state of the input
+ *      - time_ms: Tick the change was first sampled
+ * Returns: None
+ ************************************************************/
+static void push_event(input_event_type_t type, uint8_t index, bool value, uint32_t time_ms)
+{
+    uint32_t head = event_head;
+
+    if(head - event_tail >= INPUT_EVENT_QUEUE_SIZE)
+    {
+        events_dropped++;
+        return;
+    }
+
+    volatile input_event_t *event = &event_queue[head & (INPUT_EVENT_QUEUE_SIZE - 1)];
+    event->type = type;
+    event->index = index;
+    event->value = value;
+    event->time_ms = time_ms;
+
+    event_head = head + 1;
+
+    if(event_signal)
+    {
+        task_event_signal(event_signal);
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "switches.h"
+#include "timers.h"
+#include "task.h"
+#include "interrupt.h"
+
+#define INPUT_BUTTONS 4
+#define INPUT_SWITCHES 12
+
+// The inputs are sampled once per millisecond
+#define INPUT_SAMPLE_US 1000
+
+// Samples the inputs must hold steady (one per millisecond) before a
+// change is accepted, so an event is at most this long after the input
+// settles
+#define INPUT_DEBOUNCE_MS 10
+
+// Size of the input event queue, must be a power of 2
+#define INPUT_EVENT_QUEUE_SIZE 32
+
+#define INPUT_WAIT_FOREVER 0xFFFFFFFF
+
+typedef enum
+{
+    INPUT_BUTTON_PRESS,
+    INPUT_BUTTON_RELEASE,
+    INPUT_SWITCH_CHANGE
+} input_event_type_t;
+
+typedef struct
+{
+    input_event_type_t type;
+    uint8_t index;          // Button 0-3 or switch 0-11
+    bool value;             // Switch position after a change
+    uint32_t time_ms;       // get_tick_millis() when the change was first sampled
+} input_event_t;
+
+void input_init();
+bool input_poll(input_event_t *event);
+bool input_wait(input_event_t *event, uint32_t timeout_ms);
+int32_t input_wait_for_button(uint32_t buttons, uint32_t timeout_ms);
+uint32_t input_get_buttons();
+uint32_t input_get_switches();
+uint32_t input_get_dropped();
+uint32_t input_get_max_latency();
+void input_sample_isr(void *context);
+void input_set_task_event(task_event_t *event);
+
+#endif // INPUT_H
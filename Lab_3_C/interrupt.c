@@ -0,0 +1,278 @@
+#include "interrupt.h"
+#include "profile.h"
+#include <stdint.h>
+
+// Handler and context for each interrupt ID, looked up by IRQ_Handler
+typedef struct
+{
+    irq_handler_t handler;
+    void *context;
+} irq_entry_t;
+
+static volatile irq_entry_t irq_table[IRQ_MAX_ID];
+static bool irq_nesting = false;
+
+static void irq_call_nested(irq_handler_t handler, void *context);
+
+/************************************************************
+ * Function: init_GIC
+ * Description: Initializes the Generic Interrupt Controller
+ *              (GIC) distributor and CPU interface, and
+ *              registers IRQ_Handler with the CPU. IRQs stay
+ *              masked on the CPU until enable_interrupts().
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void init_GIC()
+{
+    disable_interrupts();
+
+    Xil_ExceptionRegisterHandler(XIL_EXCEPTION_ID_IRQ_INT, (Xil_ExceptionHandler)IRQ_Handler, 0);
+
+    // Disable the GIC distributor to avoid spurious interrupts
+    mmio_write(ICDDCR_BASEADDR, 0b00);
+
+    // Drive IRQ from the GIC
+    mmio_write(ICCICR_BASEADDR, 0b00011);
+
+    // Set GIC priority mask (255 = lowest priority, 0 = highest priority)
+    mmio_write(ICCPMR_BASEADDR, 255);
+
+    // Reenable the GIC distributor
+    mmio_write(ICDDCR_BASEADDR, 0b11);
+}
+
+/************************************************************
+ * Function: configure_interrupt_ID
+ * Description: Configures the priority, sensitivity and CPU0
+ *              target of an interrupt ID and enables it in the
+ *              distributor. Other IDs sharing the same
+ *              registers are preserved.
+ * Input parameters:
+ *      - id: GIC interrupt ID (0-95)
+ *      - priority: 0 = highest, 255 = lowest
+ *      - sensitivity: INTERRUPT_SENSITIVITY_LEVEL or _EDGE
+ * Returns: None
+ ************************************************************/
+void configure_interrupt_ID(uint32_t id, uint8_t priority, uint8_t sensitivity)
+{
+    uint32_t byte_shift = (id % 4) * 8;
+    uint32_t cfg_shift = (id % 16) * 2;
+    uint32_t enable_bit = 1 << (id % 32);
+
+    // Temporarily disable interrupts from id to modify settings
+    mmio_write(ICDIPTR_BASEADDR + (id / 4) * 4, mmio_read(ICDIPTR_BASEADDR + (id / 4) * 4) & ~(0xFF << byte_shift));
+    mmio_write(ICDICER_BASEADDR + (id / 32) * 4, enable_bit);
+
+    // Set interrupt sensitivity
+    mmio_write(ICDICFR_BASEADDR + (id / 16) * 4, (mmio_read(ICDICFR_BASEADDR + (id / 16) * 4) & ~(0b11 << cfg_shift)) |
+                                                 ((sensitivity & 0b11) << cfg_shift));
+
+    // Set interrupt priority
+    mmio_write(ICDIPR_BASEADDR + (id / 4) * 4, (mmio_read(ICDIPR_BASEADDR + (id / 4) * 4) & ~(0xFF << byte_shift)) |
+                                               ((uint32_t)priority << byte_shift));
+
+    // Target CPU0 and reenable interrupts from id
+    mmio_write(ICDIPTR_BASEADDR + (id / 4) * 4, mmio_read(ICDIPTR_BASEADDR + (id / 4) * 4) | (0x01 << byte_shift));
+    mmio_write(ICDISER_BASEADDR + (id / 32) * 4, enable_bit);
+}
+
+/************************************************************
+ * Function: irq_register
+ * Description: Sets the handler for any interrupt ID and
+ *              configures its priority and sensitivity in the
+ *              distributor. The ID is disabled while its table
+ *              entry changes.
+ * Input parameters:
+ *      - id: GIC interrupt ID (0-95)
+ *      - handler: Called from IRQ_Handler with context
+ *      - priority: 0 = highest, 255 = lowest
+ *      - sensitivity: INTERRUPT_SENSITIVITY_LEVEL or _EDGE
+ *      - context: Passed to the handler
+ * Returns: bool - false if the ID is out of range
+ ************************************************************/
+bool irq_register(uint32_t id, irq_handler_t handler, uint8_t priority, uint8_t sensitivity, void *context)
+{
+    if(id >= IRQ_MAX_ID)
+    {
+        return false;
+    }
+
+    irq_unregister(id);
+
+    irq_table[id].context = context;
+    irq_table[id].handler = handler;
+
+    configure_interrupt_ID(id, priority, sensitivity);
+
+    return true;
+}
+
+/************************************************************
+ * Function: irq_unregister
+ * Description: Disables an interrupt ID in the distributor and
+ *              clears its handler.
+ * Input parameters:
+ *      - id: GIC interrupt ID (0-95)
+ * Returns: None
+ ************************************************************/
+void irq_unregister(uint32_t id)
+{
+    if(id >= IRQ_MAX_ID)
+    {
+        return;
+    }
+
+    mmio_write(ICDICER_BASEADDR + (id / 32) * 4, 1 << (id % 32));
+
+    irq_table[id].handler = 0;
+    irq_table[id].context = 0;
+}
+
+/************************************************************
+ * Function: irq_set_nesting
+ * Description: Enables or disables nested interrupts. When on,
+ *              handlers run with IRQs unmasked, so a source
+ *              with a higher priority (lower number) preempts
+ *              them; the GIC holds back equal and lower
+ *              priorities until the EOI.
+ * Input parameters:
+ *      - enable: true to allow nesting
+ * Returns: None
+ ************************************************************/
+void irq_set_nesting(bool enable)
+{
+    irq_nesting = enable;
+}
+
+/************************************************************
+ * Function: enable_interrupts
+ * Description: Enables IRQ interrupts on the CPU.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void enable_interrupts()
+{
+    Xil_ExceptionEnable();
+}
+
+/************************************************************
+ * Function: disable_interrupts
+ * Description: Disables IRQ interrupts on the CPU.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void disable_interrupts()
+{
+    Xil_ExceptionDisable();
+}
+
+/************************************************************
+ * Function: save_and_disable_interrupts
+ * Description: Masks IRQs and returns whether they were masked
+ *              before, for critical sections that may also run
+ *              from an ISR.
+ * Input parameters: None
+ * Returns: uint32_t - State for restore_interrupts
+ ************************************************************/
+uint32_t save_and_disable_interrupts()
+{
+    uint32_t cpsr = 0;
+
+#ifdef __arm__
+    __asm__ volatile("mrs %0, cpsr\n\tcpsid i" : "=r"(cpsr) :: "memory");
+#endif
+
+    return cpsr;
+}
+
+/************************************************************
+ * Function: restore_interrupts
+ * Description: Unmasks IRQs again if they were unmasked when
+ *              save_and_disable_interrupts was called.
+ * Input parameters:
+ *      - state: Value from save_and_disable_interrupts
+ * Returns: None
+ ************************************************************/
+void restore_interrupts(uint32_t state)
+{
+#ifdef __arm__
+    if(!(state & 0x80))                 // CPSR I bit
+    {
+        __asm__ volatile("cpsie i" ::: "memory");
+    }
+#endif
+}
+
+/************************************************************
+ * Function: wait_for_interrupt
+ * Description: Sleeps the CPU until an interrupt is pending, for
+ *              loops waiting on data that only an ISR produces.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void wait_for_interrupt()
+{
+#ifdef __arm__
+    __asm__ volatile("wfi" ::: "memory");
+#endif
+}
+
+/************************************************************
+ * Function: IRQ_Handler
+ * Description: Main IRQ handler. Acknowledges the interrupt and
+ *              calls the irq_table entry for its ID, one table
+ *              lookup for any source.
+ * Input parameters:
+ *      - data: Unused callback data
+ * Returns: None
+ ************************************************************/
+void IRQ_Handler(void *data)
+{
+    PROFILE_SCOPE(PROFILE_IRQ);
+
+    // Grab the IRQ ID that caused us to enter the IRQ handler
+    uint32_t acknowledge = mmio_read(ICCIAR_BASEADDR);
+    uint32_t id = acknowledge & 0x3FF;
+
+    // A spurious interrupt was never acknowledged, so it must not be ended
+    if(id == IRQ_SPURIOUS_ID)
+    {
+        return;
+    }
+
+    if(id < IRQ_MAX_ID && irq_table[id].handler)
+    {
+        if(irq_nesting)
+        {
+            irq_call_nested(irq_table[id].handler, irq_table[id].context);
+        }
+        else
+        {
+            irq_table[id].handler(irq_table[id].context);
+        }
+    }
+
+    // Acknowledge (clear) the IRQ ID that caused us to enter the IRQ handler
+    mmio_write(ICCEOIR_BASEADDR, acknowledge);
+}
+
+/************************************************************
+ * Function: irq_call_nested
+ * Description: Runs a handler in System mode with IRQs
+ *              unmasked, saving the IRQ mode lr and SPSR that a
+ *              preempting interrupt would overwrite (Xilinx
+ *              nested interrupt macros). Kept out of line so
+ *              nothing of IRQ_Handler's frame is touched while
+ *              the stack pointer is switched.
+ * Input parameters:
+ *      - handler: Handler to run
+ *      - context: Passed to the handler
+ * Returns: None
+ ************************************************************/
+static __attribute__((noinline)) void irq_call_nested(irq_handler_t handler, void *context)
+{
+    Xil_EnableNestedInterrupts();
+    handler(context);
+    Xil_DisableNestedInterrupts();
+}
@@ -0,0 +1,44 @@
+#ifndef INTERRUPT_H
+#define INTERRUPT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <xil_exception.h>
+#include "mmio.h"
+
+#define ICCICR_BASEADDR 0xF8F00100      // CPU Interface Control Register
+#define ICCPMR_BASEADDR 0xF8F00104      // Interrupt Priority Mask Register
+#define ICCIAR_BASEADDR 0xF8F0010C      // Interrupt Acknowledge Register
+#define ICCEOIR_BASEADDR 0xF8F00110     // End of Interrupt Register
+#define ICDDCR_BASEADDR 0xF8F01000      // Distributor Control Register
+#define ICDISER_BASEADDR 0xF8F01100     // Interrupt Set Enable Registers
+#define ICDICER_BASEADDR 0xF8F01180     // Interrupt Clear Enable Registers
+#define ICDIPR_BASEADDR 0xF8F01400      // Interrupt Priority Registers
+#define ICDIPTR_BASEADDR 0xF8F01800     // Interrupt Processor Targets Registers
+#define ICDICFR_BASEADDR 0xF8F01C00     // Interrupt Configuration Registers
+
+#define GTC_INTERRUPT_ID 27
+#define PTIMER_INTERRUPT_ID 29
+#define UART1_INTERRUPT_ID 82
+
+#define INTERRUPT_SENSITIVITY_LEVEL 0b01
+#define INTERRUPT_SENSITIVITY_EDGE 0b11
+
+#define IRQ_MAX_ID 96                   // Zynq GIC IDs 0-95
+#define IRQ_SPURIOUS_ID 1023
+
+typedef void (*irq_handler_t)(void *context);
+
+void init_GIC();
+void configure_interrupt_ID(uint32_t id, uint8_t priority, uint8_t sensitivity);
+bool irq_register(uint32_t id, irq_handler_t handler, uint8_t priority, uint8_t sensitivity, void *context);
+void irq_unregister(uint32_t id);
+void irq_set_nesting(bool enable);
+void enable_interrupts();
+void disable_interrupts();
+uint32_t save_and_disable_interrupts();
+void restore_interrupts(uint32_t state);
+void wait_for_interrupt();
+void IRQ_Handler(void *data);
+
+#endif // INTERRUPT_H
@@ -1,5 +1,54 @@
 #include "led.h"
 
+// Last value written to each register, so unchanged values are not written
+// again. All ones until the first write, which no register holds.
+static uint32_t led_register = 0xFFFFFFFF;
+static uint32_t rgb_enable[RGB_CHANNELS] = {0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF};
+static uint32_t rgb_period[RGB_CHANNELS] = {0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF};
+static uint32_t rgb_width[RGB_CHANNELS] = {0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF};
+
+/************************************************************
+ * Function: write_if_changed
+ * Description: Writes a register unless its shadow says it
+ *              already holds the value. Interrupts are masked so
+ *              the LED engine's timer tick cannot come between
+ *              the write and the shadow update.
+ * Input parameters:
+ *      - address: Register
+ *      - shadow: Last value written to it
+ *      - value: Value to write
+ * Returns: None
+ ************************************************************/
+static void write_if_changed(uint32_t address, uint32_t *shadow, uint32_t value)
+{
+    uint32_t state = save_and_disable_interrupts();
+
+    if(*shadow != value)
+    {
+        mmio_write(address, value);
+        *shadow = value;
+    }
+
+    restore_interrupts(state);
+}
+
+/************************************************************
+ * Function: set_rgb_channel
+ * Description: Sets the pulse width of one RGB colour, and its
+ *              period the first time.
+ * Input parameters:
+ *      - channel: 0 - 5, RGB10 blue, green, red, then RGB11
+ *      - width: Pulse width, 0 - RGB_PERIOD
+ * Returns: None
+ ************************************************************/
+static void set_rgb_channel(uint32_t channel, uint32_t width)
+{
+    uint32_t base = RGB_BASEADDR + channel * RGB_COLOR_OFFSET;
+
+    write_if_changed(base + RGB_PERIOD_OFFSET, &rgb_period[channel], RGB_PERIOD);
+    write_if_changed(base + RGB_WIDTH_OFFSET, &rgb_width[channel], width);
+}
+
 /*************************************************************
  * Function: void set_rgb_color(uint32_t, uint32_t,          *
  *                              uint32_t, uint32_t)          *   
@@ -17,30 +66,15 @@
 
 void set_rgb_color(uint32_t LED, uint32_t red, uint32_t green, uint32_t blue)
 {
-
-        //Setting the period on every color of RGBs to 1024
-    for(int i = 0; i < 6; i++ )
+        //Setting color of RGB by setting pulse width of colors based on input colors and LED.
+        //The periods are written with the first color, only changed registers are written.
+    if(LED == 10 || LED == 11)
     {
-        *((uint32_t*)(RGB_BASEADDR + RGB_PERIOD_OFFSET + i * RGB_COLOR_OFFSET)) = 1024;
-    }
+        uint32_t channel = (LED == 10) ? RGB10_CHANNEL : RGB11_CHANNEL;
 
-        //Setting color of RGB by setting pulse width of colors based on input colors and LED
-    switch (LED) 
-    {    
-        case 10:
-        {
-            *((uint32_t*)(RGB10_BASEADDR + RGB_RED_OFFSET + RGB_WIDTH_OFFSET)) = red;
-            *((uint32_t*)(RGB10_BASEADDR + RGB_GREEN_OFFSET + RGB_WIDTH_OFFSET)) = green;
-            *((uint32_t*)(RGB10_BASEADDR + RGB_BLUE_OFFSET + RGB_WIDTH_OFFSET)) = blue;  
-            break;                  
-        }
-        case 11:
-        {
-            *((uint32_t*)(RGB11_BASEADDR + RGB_RED_OFFSET + RGB_WIDTH_OFFSET)) = red;
-            *((uint32_t*)(RGB11_BASEADDR + RGB_GREEN_OFFSET + RGB_WIDTH_OFFSET)) = green;
-            *((uint32_t*)(RGB11_BASEADDR + RGB_BLUE_OFFSET + RGB_WIDTH_OFFSET)) = blue;  
-            break; 
-        }
+        set_rgb_channel(channel + RGB_BLUE_CHANNEL, blue);
+        set_rgb_channel(channel + RGB_GREEN_CHANNEL, green);
+        set_rgb_channel(channel + RGB_RED_CHANNEL, red);
     }
 }
 
@@ -49,7 +83,8 @@ void set_rgb_color(uint32_t LED, uint32_t red, uint32_t green, uint32_t blue)
  * Date Created: January 24, 2025                            *   
  * Date Last Modified: January 24, 2025                      *   
  * Description: This function turns LEDs 0-11 on or off      *
- *              individually.  This includes RGB LEDs.       * 
+ *              individually.  This includes RGB LEDs.       *
+ *              Other LEDs keep their state.                 * 
  * Input parameters: LED, enable/disable                     *   
  * Returns: None                .                            *                       
  * Usages: Used to turn LEDs on/off individually             *           
@@ -59,24 +94,26 @@ void set_rgb_color(uint32_t LED, uint32_t red, uint32_t green, uint32_t blue)
 
 void set_led(uint32_t LED, bool enable)
 {
-        //Turining on/off selected green LED if input is 1-9
+        //Turining on/off selected green LED if input is 0-9, leaving the others as they are
     if(LED <= 9)
     {
-        *((uint32_t*)LED_BASEADDR) = enable << LED;
-    }
-        //Turining on all colors of LED 10 if input is 10
-    if(LED == 10)
-    {
-        *((uint32_t*)(RGB10_BASEADDR + RGB_RED_OFFSET)) = enable;        
-        *((uint32_t*)(RGB10_BASEADDR + RGB_BLUE_OFFSET)) = enable;
-        *((uint32_t*)(RGB10_BASEADDR + RGB_GREEN_OFFSET)) = enable;
+        uint32_t state = save_and_disable_interrupts();
+        uint32_t leds = (led_register == 0xFFFFFFFF) ? 0 : led_register;
+
+        leds = (leds & ~(1 << LED)) | ((uint32_t)enable << LED);
+        write_if_changed(LED_BASEADDR, &led_register, leds);
+        restore_interrupts(state);
     }
-        //Turining on all colors of LED 11 if input is 11
-    if(LED == 11)
+        //Turining on all colors of LED 10 or 11
+    if(LED == 10 || LED == 11)
     {
-        *((uint32_t*)(RGB11_BASEADDR + RGB_RED_OFFSET)) = enable;        
-        *((uint32_t*)(RGB11_BASEADDR + RGB_BLUE_OFFSET)) = enable;
-        *((uint32_t*)(RGB11_BASEADDR + RGB_GREEN_OFFSET)) = enable;
+        uint32_t channel = (LED == 10) ? RGB10_CHANNEL : RGB11_CHANNEL;
+
+        for(uint32_t color = 0; color < RGB_COLORS; color++)
+        {
+            write_if_changed(RGB_BASEADDR + (channel + color) * RGB_COLOR_OFFSET + RGB_ENABLE_OFFSET,
+                             &rgb_enable[channel + color], enable);
+        }
     }
 }
 
@@ -96,7 +133,7 @@ void set_led(uint32_t LED, bool enable)
 void set_leds_10bit(uint32_t value)
 {
         //Setting LED register to input value and masking off unused bits
-    *((uint32_t*)LED_BASEADDR) = value & 0b1111111111;
+    write_if_changed(LED_BASEADDR, &led_register, value & 0b1111111111);
 }
 
 /*************************************************************
@@ -4,6 +4,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <sleep.h>
+#include "mmio.h"
+#include "interrupt.h"
 
 #define LED_BASEADDR 0x41210000
 
@@ -18,6 +20,17 @@
 #define RGB_WIDTH_OFFSET 0x8
 #define RGB_COLOR_OFFSET 0x10
 
+// PWM blocks in address order, three colours per RGB LED
+#define RGB_COLORS 3
+#define RGB_CHANNELS 6
+#define RGB10_CHANNEL 0
+#define RGB11_CHANNEL 3
+#define RGB_BLUE_CHANNEL 0
+#define RGB_GREEN_CHANNEL 1
+#define RGB_RED_CHANNEL 2
+
+#define RGB_PERIOD 1024
+
 void set_rgb_color(uint32_t LED, uint32_t red, uint32_t green, uint32_t blue);
 void set_led(uint32_t LED, bool enable);
 void set_leds_10bit(uint32_t value);
@@ -0,0 +1,348 @@
+#include "led_engine.h"
+
+// (level / 1024)^2.2 * 1024 at every 32nd level, interpolated in between
+static const uint16_t gamma_table[33] =
+{
+    0, 0, 2, 6, 11, 17, 26, 36, 49, 63, 79, 98, 118, 141, 166, 193,
+    223, 255, 289, 325, 364, 405, 449, 495, 544, 595, 649, 705, 763, 825, 888, 955,
+    1024
+};
+
+static led_track_t tracks[LED_ENGINE_LEDS];
+static sw_timer_t tick_timer;
+
+/************************************************************
+ * Function: led_gamma
+ * Description: Converts a linear level to the PWM width that
+ *              looks that bright.
+ * Input parameters:
+ *      - level: 0 - LED_LEVEL_MAX
+ * Returns: uint32_t - Pulse width, 0 - RGB_PERIOD
+ ************************************************************/
+uint32_t led_gamma(uint32_t level)
+{
+    if(level >= LED_LEVEL_MAX)
+    {
+        return gamma_table[32];
+    }
+
+    uint32_t index = level >> 5;
+    uint32_t fraction = level & 31;
+
+    return gamma_table[index] + (((gamma_table[index + 1] - gamma_table[index]) * fraction) >> 5);
+}
+
+/************************************************************
+ * Function: output
+ * Description: Shows an LED's current colour.
+ * Input parameters:
+ *      - led: 0 - 11
+ * Returns: None
+ ************************************************************/
+static void output(uint32_t led)
+{
+    const uint32_t *level = tracks[led].level;
+
+    if(led <= 9)
+    {
+        set_led(led, level[0] || level[1] || level[2]);
+    }
+    else
+    {
+        set_rgb_color(led, led_gamma(level[0]), led_gamma(level[1]), led_gamma(level[2]));
+    }
+}
+
+/************************************************************
+ * Function: begin_frame
+ * Description: Starts the fade to the track's current keyframe
+ *              from the colour shown now. The per-ms step is
+ *              worked out here, once per keyframe, so the tick
+ *              only multiplies.
+ * Input parameters:
+ *      - track: Track to update
+ * Returns: None
+ ************************************************************/
+static void begin_frame(led_track_t *track)
+{
+    const led_keyframe_t *frame = &track->frames[track->frame];
+    const uint32_t to[3] = {frame->red, frame->green, frame->blue};
+
+    for(uint32_t color = 0; color < 3; color++)
+    {
+        track->from[color] = track->level[color];
+        track->step[color] = frame->fade_ms ? (((int32_t)to[color] - track->from[color]) * 65536) / frame->fade_ms : 0;
+    }
+}
+
+/************************************************************
+ * Function: advance
+ * Description: Moves a track on by some time and works out the
+ *              colour to show, passing any keyframes that ended.
+ * Input parameters:
+ *      - track: Playing track
+ *      - ms: Time since the last call
+ * Returns: None
+ ************************************************************/
+static void advance(led_track_t *track, uint32_t ms)
+{
+    track->elapsed_ms += ms;
+
+    while(track->playing)
+    {
+        const led_keyframe_t *frame = &track->frames[track->frame];
+
+        if(track->elapsed_ms < frame->fade_ms)
+        {
+            for(uint32_t color = 0; color < 3; color++)
+            {
+                track->level[color] = track->from[color] + ((track->step[color] * (int32_t)track->elapsed_ms) >> 16);
+            }
+
+            return;
+        }
+
+        track->level[0] = frame->red;
+        track->level[1] = frame->green;
+        track->level[2] = frame->blue;
+
+        if(track->elapsed_ms < frame->fade_ms + frame->hold_ms)
+        {
+            return;
+        }
+
+        track->elapsed_ms -= frame->fade_ms + frame->hold_ms;
+        track->frame++;
+
+        if(track->frame == track->frame_count)
+        {
+            if(!track->loop)
+            {
+                track->playing = false;
+                return;
+            }
+
+            track->frame = 0;
+        }
+
+        begin_frame(track);
+    }
+}
+
+/************************************************************
+ * Function: led_engine_tick
+ * Description: Software timer callback, advances every playing
+ *              track and stops the timer once none is left.
+ * Input parameters:
+ *      - context: Unused
+ * Returns: None
+ ************************************************************/
+static void led_engine_tick(void *context)
+{
+    bool playing = false;
+
+    for(uint32_t led = 0; led < LED_ENGINE_LEDS; led++)
+    {
+        if(tracks[led].playing)
+        {
+            advance(&tracks[led], LED_ENGINE_TICK_MS);
+            output(led);
+            playing |= tracks[led].playing;
+        }
+    }
+
+    if(!playing)
+    {
+        sw_timer_cancel(&tick_timer);
+    }
+}
+
+/************************************************************
+ * Function: led_engine_init
+ * Description: Stops every animation and sets up the tick
+ *              timer. LEDs keep what they show.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void led_engine_init()
+{
+    sw_timer_cancel(&tick_timer);
+    sw_timer_init(&tick_timer, led_engine_tick, 0);
+
+    for(uint32_t led = 0; led < LED_ENGINE_LEDS; led++)
+    {
+        tracks[led].playing = false;
+        tracks[led].level[0] = 0;
+        tracks[led].level[1] = 0;
+        tracks[led].level[2] = 0;
+    }
+}
+
+/************************************************************
+ * Function: led_engine_set_color
+ * Description: Stops an LED's animation and shows a colour.
+ * Input parameters:
+ *      - led: 0 - 11
+ *      - red, green, blue: Levels, 0 - LED_LEVEL_MAX
+ * Returns: None
+ ************************************************************/
+void led_engine_set_color(uint32_t led, uint32_t red, uint32_t green, uint32_t blue)
+{
+    if(led >= LED_ENGINE_LEDS)
+    {
+        return;
+    }
+
+    uint32_t state = save_and_disable_interrupts();
+    led_track_t *track = &tracks[led];
+
+    track->playing = false;
+    track->level[0] = red;
+    track->level[1] = green;
+    track->level[2] = blue;
+    output(led);
+
+    restore_interrupts(state);
+}
+
+/************************************************************
+ * Function: led_engine_set
+ * Description: Stops an LED's animation and turns it fully on
+ *              (white for RGB LEDs) or off.
+ * Input parameters:
+ *      - led: 0 - 11
+ *      - on: true to light it
+ * Returns: None
+ ************************************************************/
+void led_engine_set(uint32_t led, bool on)
+{
+    uint32_t level = on ? LED_LEVEL_MAX : 0;
+
+    led_engine_set_color(led, level, level, level);
+}
+
+/************************************************************
+ * Function: led_engine_play
+ * Description: Starts an LED on a list of keyframes, fading
+ *              from the colour it shows now, and returns.
+ * Input parameters:
+ *      - led: 0 - 11
+ *      - frames: Keyframes, must stay valid while playing
+ *      - frame_count: Number of keyframes
+ *      - loop: true to start over after the last keyframe
+ * Returns: None
+ ************************************************************/
+void led_engine_play(uint32_t led, const led_keyframe_t *frames, uint32_t frame_count, bool loop)
+{
+    if(led >= LED_ENGINE_LEDS || !frame_count)
+    {
+        return;
+    }
+
+    uint32_t length = 0;
+
+    for(uint32_t i = 0; i < frame_count; i++)
+    {
+        length += frames[i].fade_ms + frames[i].hold_ms;
+    }
+
+    uint32_t state = save_and_disable_interrupts();
+    led_track_t *track = &tracks[led];
+
+    track->frames = frames;
+    track->frame_count = frame_count;
+    track->frame = 0;
+    track->elapsed_ms = 0;
+    track->loop = loop && length;   // A loop that takes no time would never end
+    track->playing = true;
+    begin_frame(track);
+    advance(track, 0);
+    output(led);
+
+    if(track->playing && !sw_timer_active(&tick_timer))
+    {
+        sw_timer_start(&tick_timer, LED_ENGINE_TICK_MS * 1000, LED_ENGINE_TICK_MS * 1000);
+    }
+
+    restore_interrupts(state);
+}
+
+/************************************************************
+ * Function: led_engine_blink
+ * Description: Blinks an LED (white for RGB LEDs) until it is
+ *              set or given another animation.
+ * Input parameters:
+ *      - led: 0 - 11
+ *      - on_ms: Time lit
+ *      - off_ms: Time dark
+ * Returns: None
+ ************************************************************/
+void led_engine_blink(uint32_t led, uint32_t on_ms, uint32_t off_ms)
+{
+    if(led >= LED_ENGINE_LEDS)
+    {
+        return;
+    }
+
+    uint32_t state = save_and_disable_interrupts();
+    led_keyframe_t *own = tracks[led].own;
+
+    own[0] = (led_keyframe_t){LED_LEVEL_MAX, LED_LEVEL_MAX, LED_LEVEL_MAX, 0, on_ms};
+    own[1] = (led_keyframe_t){0, 0, 0, 0, off_ms};
+    led_engine_play(led, own, 2, true);
+
+    restore_interrupts(state);
+}
+
+/************************************************************
+ * Function: led_engine_fade
+ * Description: Fades an LED from the colour it shows now to
+ *              another and leaves it there.
+ * Input parameters:
+ *      - led: 0 - 11
+ *      - red, green, blue: Levels, 0 - LED_LEVEL_MAX
+ *      - fade_ms: Length of the fade
+ * Returns: None
+ ************************************************************/
+void led_engine_fade(uint32_t led, uint32_t red, uint32_t green, uint32_t blue, uint32_t fade_ms)
+{
+    if(led >= LED_ENGINE_LEDS)
+    {
+        return;
+    }
+
+    uint32_t state = save_and_disable_interrupts();
+    led_keyframe_t *own = tracks[led].own;
+
+    own[0] = (led_keyframe_t){red, green, blue, fade_ms, 0};
+    led_engine_play(led, own, 1, false);
+
+    restore_interrupts(state);
+}
+
+/************************************************************
+ * Function: led_engine_stop
+ * Description: Stops an LED's animation where it is.
+ * Input parameters:
+ *      - led: 0 - 11
+ * Returns: None
+ ************************************************************/
+void led_engine_stop(uint32_t led)
+{
+    if(led < LED_ENGINE_LEDS)
+    {
+        tracks[led].playing = false;
+    }
+}
+
+/************************************************************
+ * Function: led_engine_playing
+ * Description: Checks whether an LED is animating.
+ * Input parameters:
+ *      - led: 0 - 11
+ * Returns: bool - true until a non-looping animation ends
+ ************************************************************/
+bool led_engine_playing(uint32_t led)
+{
+    return led < LED_ENGINE_LEDS && tracks[led].playing;
+}
@@ -0,0 +1,54 @@
+#ifndef LED_ENGINE_H
+#define LED_ENGINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "led.h"
+#include "timers.h"
+
+// Animates LEDs 0 - 11 from a software timer, so effects run without the
+// caller waiting. Each LED plays a list of keyframes: fade to a colour,
+// then hold it. Colours are linear levels 0 - LED_LEVEL_MAX per channel,
+// gamma corrected on the way out. LEDs 0 - 9 have one colour and are lit
+// while any channel is above 0. Writes go through led.c, which skips
+// registers that already hold the value.
+
+#define LED_ENGINE_LEDS 12
+#define LED_ENGINE_TICK_MS 10
+
+#define LED_LEVEL_MAX RGB_PERIOD
+
+typedef struct
+{
+    uint16_t red;
+    uint16_t green;
+    uint16_t blue;
+    uint16_t fade_ms;           // Time to move here from the previous colour, 0 jumps
+    uint16_t hold_ms;           // Time to stay before the next keyframe
+} led_keyframe_t;
+
+typedef struct
+{
+    const led_keyframe_t *frames;
+    uint32_t frame_count;
+    uint32_t frame;             // Keyframe being faded to or held
+    uint32_t elapsed_ms;        // Time spent on this keyframe
+    bool loop;
+    bool playing;
+    int32_t from[3];            // Colour the fade started from, red green blue
+    int32_t step[3];            // Level change per ms, 16.16 fixed point
+    uint32_t level[3];          // Colour shown now
+    led_keyframe_t own[2];      // Keyframes of led_engine_blink and led_engine_fade
+} led_track_t;
+
+void led_engine_init();
+void led_engine_set(uint32_t led, bool on);
+void led_engine_set_color(uint32_t led, uint32_t red, uint32_t green, uint32_t blue);
+void led_engine_play(uint32_t led, const led_keyframe_t *frames, uint32_t frame_count, bool loop);
+void led_engine_blink(uint32_t led, uint32_t on_ms, uint32_t off_ms);
+void led_engine_fade(uint32_t led, uint32_t red, uint32_t green, uint32_t blue, uint32_t fade_ms);
+void led_engine_stop(uint32_t led);
+bool led_engine_playing(uint32_t led);
+uint32_t led_gamma(uint32_t level);
+
+#endif // LED_ENGINE_H
@@ -7,68 +7,343 @@
  * Description: This program is a calculator that has 16 arithmetica/logical
  *              operations.  The calculator works with a hexidecimal keypad,
  *              slide switches, button 3, and the serial console as an output.                                  
+ *              Results are also shown in hex on the seven-segment display
+ *              (Lab_5_C/sevensegdisplay.c). The serial port also takes
+ *              shell commands (commands.c, which runs ROBOMAL programs with
+ *              Lab_4_C/robomal.c and robomal_jit.c, and can drive motors on
+ *              JB from its motion instructions with motor.c) and batch
+ *              requests.
  ******************************************************************************/
 
 #include "serial.h"
-#include <sleep.h>
 #include <stdint.h>
 #include <stdio.h>
 #include "hexpad.h"
 #include "switches.h"
+#include "interrupt.h"
+#include "input.h"
+#include "led.h"
+#include "led_engine.h"
+#include "task.h"
+#include "calculator.h"
+#include "batch.h"
+#include "shell.h"
+#include "commands.h"
+#include "sevensegdisplay.h"
+
+// Button 3 enters a value, button 0 prints the task statistics
+#define ENTER_BUTTON 3
+#define STATS_BUTTON 0
+
+#define STATUS_LED_PERIOD_US 50000
+#define HEARTBEAT_LED 9
+#define HEARTBEAT_MS 400
+#define IDLE_RGB_LED 10
+
+// Slow blue breathing on the RGB LED while the calculator runs
+static const led_keyframe_t breathe[] =
+{
+    {0, 0, 300, 1500, 0},
+    {0, 0, 0, 1500, 200}
+};
+
+// Calculator state, kept out of locals so it survives task waits
+typedef struct
+{
+    int32_t op1_val;
+    int32_t op2_val;
+    int32_t opcode;
+    int32_t result;
+    int32_t storage;
+    int32_t value;          // Operand being entered
+    uint32_t digits;        // Hex digits entered so far
+} calculator_t;
+
+typedef struct
+{
+    uint32_t switches;      // Opcode switches shown on LEDs 0-3
+} status_led_t;
+
+// Batch requests are taken from the receive buffer this many at a time
+#define BATCH_RX_CHUNK (6 * BATCH_REQUEST_SIZE)
+
+// Serial input: command lines for the shell and binary batch requests,
+// told apart by the first byte (a batch request starts with 0xA5, which
+// no command line does)
+typedef struct
+{
+    batch_t batch;
+    uint8_t rx[BATCH_RX_CHUNK];
+    uint32_t received;
+    char line[SHELL_LINE_SIZE];
+} console_t;
+
+// Signalled by the hexpad and input drivers for every queued event
+static task_event_t user_input;
+
+// Signalled by the UART as bytes are received
+static task_event_t serial_rx;
 
 void print_calculator_instructions();
-int32_t get_operand();
-int32_t get_opcode();
+bool take_input(bool take_keys, calculator_t *calc);
 void print_opcode(uint32_t opcode);
-int32_t calculate(uint32_t op1, uint32_t op2, uint32_t opcode, int32_t *storage);
-int32_t count_zeros(uint32_t val);
+task_status_t calculator_task(task_t *task);
+task_status_t status_led_task(task_t *task);
+task_status_t console_task(task_t *task);
 
+#ifndef BENCH_FIRMWARE
 int main(void)
 {
+    static calculator_t calc;
+    static status_led_t leds;
+    static task_t calculator;
+    static task_t status_led;
+    static console_t console;
+    static task_t console_runner;
+
+    init_GIC();
+    irq_set_nesting(true);      // The UART preempts the slower timer wheel callbacks
     serial_init(UART_STOP_BIT_1, UART_DATA_BITS_8, UART_PARITY_NONE, UART_BAUDRATE_115200);
+    enable_interrupts();
     hexpad_init();
-    print_calculator_instructions();
+    input_init();
+    init_seven_seg();
+    seven_seg_set_blank_zeros(true);
+    led_engine_init();
+
+    task_event_init(&user_input);
+    hexpad_set_task_event(&user_input);
+    input_set_task_event(&user_input);
+
+    task_event_init(&serial_rx);
+    serial_set_rx_task_event(&serial_rx);
+    batch_init(&console.batch, serial_write);
+    commands_init(&console.batch);
+
+    task_init(&calculator, "calculator", calculator_task, &calc);
+    task_init(&status_led, "status_led", status_led_task, &leds);
+    task_init(&console_runner, "console", console_task, &console);
+    task_start(&calculator);
+    task_start(&status_led);
+    task_start(&console_runner);
+
+    task_run();
+}
+#endif // BENCH_FIRMWARE
+
+/************************************************************
+ * Function: calculator_task
+ * Description: Runs the calculator as a task: waits for the
+ *              opcode and operands without holding the CPU,
+ *              then prints the result.
+ * Input parameters:
+ *      - task: This task, context is a calculator_t
+ * Returns: task_status_t - How the task stopped
+ ************************************************************/
+task_status_t calculator_task(task_t *task)
+{
+    calculator_t *calc = (calculator_t*)task->context;
 
-    int32_t op1_val = -1;
-    int32_t op2_val = -1;
-    int32_t opcode = -1;
-    int32_t result = 0;
-    int32_t storage = 0; 
+    TASK_BEGIN(task);
+
+    calc->op1_val = -1;
+    calc->op2_val = -1;
+    calc->storage = 0;
+    print_calculator_instructions();
 
     while(1)
-    {   
+    {
         serial_print("Enter opcode and press enter...\n");
-        opcode = get_opcode();
-        print_opcode(opcode);      
+        TASK_WAIT_UNTIL(task, &user_input, take_input(false, calc));
+        calc->opcode = 0b1111 & input_get_switches();
+        print_opcode(calc->opcode);
         serial_print(" opcode set.  Enter operands and press enter.\n");
-                
-        // Only get operands if opcode is not LOAD     
-        if(opcode != 15)
+
+        // Only get operands if opcode is not LOAD
+        if(calc->opcode != 15)
         {
-            op1_val = get_operand();
-            serial_print("\t");     
-            print_opcode(opcode);
+            TASK_WAIT_UNTIL(task, &user_input, take_input(true, calc));
+            calc->op1_val = calc->value;
+            serial_print("\t");
+            print_opcode(calc->opcode);
             serial_print("\n");
+
             // Only get second operand for opcodes associated with 2 operands
-            if(opcode < 12) op2_val = get_operand();
+            if(calc->opcode < 12)
+            {
+                TASK_WAIT_UNTIL(task, &user_input, take_input(true, calc));
+                calc->op2_val = calc->value;
+            }
+
             // Only print the equals line if opcode is not store
-            if(opcode != 14)
+            if(calc->opcode != 14)
             {
-                serial_print("\n----------\n");                
+                serial_print("\n----------\n");
             }
-            else 
+            else
             {
                 serial_print("\n");
-            }            
+            }
         }
-        
+
         // Printing the opcode still needs to occur but at a different time for load operation
-        if(opcode == 15) serial_print("LOAD\n");
+        if(calc->opcode == 15) serial_print("LOAD\n");
 
-        result = calculate(op1_val, op2_val, opcode, &storage);
+        calc->result = calculate(calc->op1_val, calc->op2_val, calc->opcode, &calc->storage);
         // Don't print result on a store operation
-        if(opcode != 14) serial_print("%x\n\n", result);                                                 
+        if(calc->opcode != 14)
+        {
+            serial_print("%x\n\n", calc->result);
+            write_seven_seg_hex(calc->result);
+        }
     }
+
+    TASK_END(task);
+}
+
+/************************************************************
+ * Function: status_led_task
+ * Description: Mirrors the opcode switches on LEDs 0-3 and
+ *              starts the heartbeat and breathing animations,
+ *              which the LED engine then runs on its own,
+ *              showing the scheduler is running while the
+ *              calculator waits.
+ * Input parameters:
+ *      - task: This task, context is a status_led_t
+ * Returns: task_status_t - How the task stopped
+ ************************************************************/
+task_status_t status_led_task(task_t *task)
+{
+    status_led_t *leds = (status_led_t*)task->context;
+
+    TASK_BEGIN(task);
+
+    leds->switches = 0xFFFFFFFF;    // Nothing shown yet
+    led_engine_blink(HEARTBEAT_LED, HEARTBEAT_MS, HEARTBEAT_MS);
+    led_engine_play(IDLE_RGB_LED, breathe, 2, true);
+
+    while(1)
+    {
+        uint32_t switches = input_get_switches() & 0b1111;
+
+        // set_led leaves the other LEDs alone, only changed bits are written
+        if(switches != leds->switches)
+        {
+            for(uint32_t led = 0; led < 4; led++)
+            {
+                set_led(led, switches & (1 << led));
+            }
+
+            leds->switches = switches;
+        }
+
+        TASK_SLEEP(task, STATUS_LED_PERIOD_US);
+    }
+
+    TASK_END(task);
+}
+
+/************************************************************
+ * Function: console_batch
+ * Description: Takes whole batch requests from the receive
+ *              buffer and runs them. Only bytes that complete
+ *              the request in progress or start with the sync
+ *              byte are taken, so a command line sent after the
+ *              requests stays for the shell.
+ * Input parameters:
+ *      - console: Console state
+ * Returns: bool - false if a whole request has not arrived yet
+ ************************************************************/
+static bool console_batch(console_t *console)
+{
+    uint32_t needed = BATCH_REQUEST_SIZE - console->batch.request_length;
+    uint8_t next;
+
+    console->received = 0;
+
+    while(console->received + needed <= BATCH_RX_CHUNK && serial_rx_available() >= needed &&
+          (needed < BATCH_REQUEST_SIZE || (serial_peek(&next) && next == BATCH_REQUEST_SYNC)))
+    {
+        console->received += serial_read(console->rx + console->received, needed);
+        needed = BATCH_REQUEST_SIZE;
+    }
+
+    if(!console->received)
+    {
+        return false;
+    }
+
+    batch_feed(&console->batch, console->rx, console->received, get_micros());
+    return true;
+}
+
+/************************************************************
+ * Function: console_poll
+ * Description: Handles the next piece of serial input: a run
+ *              of batch requests, or one command line. A line
+ *              too long for the shell is refused whole.
+ * Input parameters:
+ *      - console: Console state
+ * Returns: bool - false if nothing complete has arrived
+ ************************************************************/
+static bool console_poll(console_t *console)
+{
+    uint8_t next;
+
+    if(console->batch.request_length || (serial_peek(&next) && next == BATCH_REQUEST_SYNC))
+    {
+        return console_batch(console);
+    }
+
+    serial_line_t status = serial_readline(console->line, SHELL_LINE_SIZE);
+
+    if(status == SERIAL_LINE_NONE)
+    {
+        return false;
+    }
+
+    if(status == SERIAL_LINE_TOO_LONG)
+    {
+        serial_print("line too long, at most %u characters\n", SHELL_LINE_SIZE - 1);
+        shell_prompt();
+        return true;
+    }
+
+    // CR LF line ends give an empty line after each command
+    if(console->line[0])
+    {
+        shell_execute(console->line);
+        shell_prompt();
+    }
+
+    return true;
+}
+
+/************************************************************
+ * Function: console_task
+ * Description: Runs shell commands and binary batch requests
+ *              (see batch.h) from the serial port. The UART
+ *              interrupt keeps receiving and transmitting while
+ *              each chunk is handled, so the three overlap.
+ * Input parameters:
+ *      - task: This task, context is a console_t
+ * Returns: task_status_t - How the task stopped
+ ************************************************************/
+task_status_t console_task(task_t *task)
+{
+    console_t *console = (console_t*)task->context;
+
+    TASK_BEGIN(task);
+
+    while(1)
+    {
+        TASK_WAIT_UNTIL(task, &serial_rx, console_poll(console));
+
+        // Letting the other tasks in between chunks of a long batch
+        TASK_YIELD(task);
+    }
+
+    TASK_END(task);
 }
 
 /************************************************************
@@ -83,74 +358,70 @@ void print_calculator_instructions()
     serial_print("\n\nWelcome to the 32-bit Calculator\n\n");    
     serial_print("1. Set switches to opcode and press enter.\n");   
     serial_print("2. Input first operand and press enter.\n");
-    serial_print("3. Input second operand and press enter.\n\n");
+    serial_print("3. Input second operand and press enter.\n");
+    serial_print("Button 0 prints task statistics.\n");
+    serial_print("Batch requests are taken from the serial port at any time.\n\n");
 }
 
 /************************************************************
- * Function: get_operand
- * Description: Gets and prints hexpad presses until the enter
- *              button is pressed, and then returns the result.
- * Input parameters: None
- * Returns: int32_t - The operand value entered by the user.
+ * Function: take_input
+ * Description: Takes the queued hexpad and button events
+ *              without waiting. Hex keys are printed and
+ *              shifted into calc->value (up to 4 digits) when
+ *              take_keys is set, and discarded otherwise.
+ *              calc->value and calc->digits are reset once
+ *              enter is seen, ready for the next operand.
+ * Input parameters:
+ *      - take_keys: true while an operand is being entered
+ *      - calc: Calculator state
+ * Returns: bool - true once the enter button has been pressed
  ************************************************************/
-int32_t get_operand()
+bool take_input(bool take_keys, calculator_t *calc)
 {
-    bool enter_pressed = false;
-    int32_t value = -1;
-    int i = 0;       
-     
-    // Quickly checking pushbuttons and hexpad for user entries,
-    // and escapes loop once btn3 (enter button) is pressed.
-    while(!enter_pressed)
-    {        
-        int32_t hexkey = get_hexkey();
-
-        if(hexkey >= 0 && i < 4)
+    hexpad_event_t key;
+    input_event_t input;
+
+    while(hexpad_poll(&key))
+    {
+        if(take_keys && key.pressed && calc->digits < 4)
         {
-            serial_print("%x", hexkey);
-            
-            if(i) 
-                value = value << 4;
+            serial_print("%x", key.key);
+
+            if(calc->digits)
+                calc->value = calc->value << 4;
             else
-                value = 0;
+                calc->value = 0;
 
-            value |= hexkey;                       
-            i++;
-            
-            msleep(250);            
+            calc->value |= key.key;
+            calc->digits++;
         }
+    }
 
-        if(get_buttons() & 0b1000)
+    while(input_poll(&input))
+    {
+        if(input.type != INPUT_BUTTON_PRESS)
         {
-            enter_pressed = true;
-            msleep(250);        
+            continue;
         }
-    }
-
-    return value;
-}
 
-/************************************************************
- * Function: get_opcode
- * Description: Gets the opcode from the switches and waits for
- *              the enter button to be pressed.
- * Input parameters: None
- * Returns: int32_t - The opcode value.
- ************************************************************/
-int32_t get_opcode()
-{
-    bool enter_pressed = false;
+        if(input.index == STATS_BUTTON)
+        {
+            task_print_stats();
+        }
+        else if(input.index == ENTER_BUTTON)
+        {
+            // An operand with no digits entered reads as -1, as before
+            if(!calc->digits)
+            {
+                calc->value = -1;
+            }
 
-    while(!enter_pressed)
-    {
-        enter_pressed = get_buttons() & 0b1000;
+            calc->digits = 0;
+            return true;
+        }
     }
 
-    int32_t opcode = (0b1111 & get_switches());
-
-    msleep(250);  
-
-    return opcode;
+    return false;
 }
 
 /************************************************************
@@ -232,121 +503,3 @@ void print_opcode(uint32_t opcode)
         serial_print("Error");        
     }
 }
-
-/************************************************************
- * Function: calculate
- * Description: Performs the calculation based on the opcode and
- *              operands provided.
- * Input parameters: 
- *      - op1: The first operand.
- *      - op2: The second operand.
- *      - opcode: The opcode value.
- *      - storage: Pointer to the storage value.
- * Returns: int32_t - The result of the calculation.
- ************************************************************/
-int32_t calculate(uint32_t op1, uint32_t op2, uint32_t opcode, int32_t *storage)
-{
-    int32_t result_val = 0;
-    uint32_t sixteen_bit_mask = 0xFFFF;
-    switch(opcode)
-    {
-        case 0:
-        result_val = op1 + op2;
-        break;
-
-        case 1:
-        result_val = op1 - op2;
-        break;
-
-        case 2:
-        result_val = op2 - op1;
-        break;
-
-        case 3:
-        result_val = op1 * op2;        
-        break;
-
-        case 4:
-        result_val = op1 * op2 + *storage;      // Cumulative multiply
-        break;
-
-        case 5:
-        result_val = op1 == op2;                // Test Equivalence        
-        break;
-
-        case 6:
-        result_val = op1 << op2;
-        break;
-
-        case 7:
-        result_val = op1 >> op2;              
-        break;
-
-        case 8:
-        result_val = op1 & op2; 
-        break;
-
-        case 9:
-        result_val = op1 | op2;        
-        break;
-
-        case 10:
-        result_val = op1 ^ op2;                 // XOR        
-        break;
-
-        case 11:
-        result_val = (op1 & ~op2) & sixteen_bit_mask;
-        break;
-
-        case 12:
-        result_val = (~op1 & sixteen_bit_mask); 
-        break;
-
-        case 13:
-        result_val = count_zeros(op1);
-        break;
-
-        case 14:
-        *storage = op1;
-        // serial_print("Value Stored = %x\n", *storage);     
-        break;
-
-        case 15:
-        // serial_print("Loading value = %x\n", *storage);
-        result_val = *storage;   
-        break;       
-
-        default:
-        serial_print("Error");        
-    }
-
-    return result_val;
-}
-
-/************************************************************
- * Function: count_zeros
- * Description: Counts the number of leading zeros in a 16-bit
- *              value.
- * Input parameters: 
- *      - val: The value to count leading zeros in.
- * Returns: int32_t - The number of leading zeros.
- ************************************************************/
-int32_t count_zeros(uint32_t val)
-{
-    uint32_t count = 0;
-    uint32_t mask = 0x8000;   
-    
-    for(int i = 0; i < 16; i++)
-    {
-        if(!(val & (mask >> i))) 
-        {
-            count++;   
-        }
-        else 
-        {
-            return count;
-        }            
-    }
-
-    return count;
-}
\ No newline at end of file
@@ -0,0 +1,259 @@
+#include "motor.h"
+
+static const uint8_t enable_pins[MOTORS] = {MOTOR_LEFT_ENABLE, MOTOR_RIGHT_ENABLE};
+static const uint8_t direction_pins[MOTORS] = {MOTOR_LEFT_DIRECTION, MOTOR_RIGHT_DIRECTION};
+
+// Signed levels, negative drives backward. Targets are written by the
+// commands, levels only by motor_period.
+static volatile int32_t targets[MOTORS];
+static int32_t levels[MOTORS];
+static bool active = false;
+
+static sw_timer_t period_timer;
+static sw_timer_t edge_timers[MOTORS];
+
+static void motor_period(void *context);
+static void motor_edge(void *context);
+
+/************************************************************
+ * Function: motor_init
+ * Description: Takes PMODB pins 1-4 as outputs, driven low,
+ *              with both motors stopped.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void motor_init()
+{
+    motor_release();
+
+    pmod_set_pin_directions(pmod_get_directions() | MOTOR_PINS);
+    pmod_write_masked(MOTOR_PINS, 0);
+
+    sw_timer_init(&period_timer, motor_period, 0);
+
+    for(uint32_t motor = 0; motor < MOTORS; motor++)
+    {
+        sw_timer_init(&edge_timers[motor], motor_edge, (void*)&enable_pins[motor]);
+    }
+
+    active = true;
+}
+
+/************************************************************
+ * Function: motor_release
+ * Description: Stops the timers and drives the motor pins low
+ *              at once, without ramping down. The pins stay
+ *              outputs for whatever uses JB next.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void motor_release()
+{
+    if(!active)
+    {
+        return;
+    }
+
+    uint32_t state = save_and_disable_interrupts();
+
+    sw_timer_cancel(&period_timer);
+
+    for(uint32_t motor = 0; motor < MOTORS; motor++)
+    {
+        sw_timer_cancel(&edge_timers[motor]);
+        targets[motor] = 0;
+        levels[motor] = 0;
+    }
+
+    pmod_write_masked(MOTOR_PINS, 0);
+    active = false;
+
+    restore_interrupts(state);
+}
+
+/************************************************************
+ * Function: motor_active
+ * Description: Checks whether motor_init owns the pins.
+ * Input parameters: None
+ * Returns: bool - true between motor_init and motor_release
+ ************************************************************/
+bool motor_active()
+{
+    return active;
+}
+
+/************************************************************
+ * Function: motor_command
+ * Description: Runs a ROBOMAL motion instruction: sets the
+ *              target of both motors and returns.
+ * Input parameters:
+ *      - motion: Instruction, opcode - 0x40
+ *      - speed: Operand, 0 - MOTOR_LEVEL_MAX
+ * Returns: None
+ ************************************************************/
+void motor_command(motor_motion_t motion, uint8_t speed)
+{
+    int32_t level = speed;
+
+    switch(motion)
+    {
+        case MOTION_LEFT: motor_set_target(-level, level); break;
+        case MOTION_RIGHT: motor_set_target(level, -level); break;
+        case MOTION_FORWARD: motor_set_target(level, level); break;
+        case MOTION_BACKWARD: motor_set_target(-level, -level); break;
+        default: motor_set_target(0, 0); break;
+    }
+}
+
+/************************************************************
+ * Function: motor_set_target
+ * Description: Sets the levels the motors ramp to. Takes
+ *              effect at the next PWM period, or at once if the
+ *              motors were stopped.
+ * Input parameters:
+ *      - left, right: -MOTOR_LEVEL_MAX - MOTOR_LEVEL_MAX,
+ *                     negative drives backward
+ * Returns: None
+ ************************************************************/
+void motor_set_target(int32_t left, int32_t right)
+{
+    if(!active)
+    {
+        return;
+    }
+
+    if(left > MOTOR_LEVEL_MAX) left = MOTOR_LEVEL_MAX;
+    if(left < -MOTOR_LEVEL_MAX) left = -MOTOR_LEVEL_MAX;
+    if(right > MOTOR_LEVEL_MAX) right = MOTOR_LEVEL_MAX;
+    if(right < -MOTOR_LEVEL_MAX) right = -MOTOR_LEVEL_MAX;
+
+    uint32_t state = save_and_disable_interrupts();
+
+    targets[MOTOR_LEFT] = left;
+    targets[MOTOR_RIGHT] = right;
+
+    if(!sw_timer_active(&period_timer) && (left || right))
+    {
+        sw_timer_start(&period_timer, 0, MOTOR_PERIOD_US);
+    }
+
+    restore_interrupts(state);
+}
+
+/************************************************************
+ * Function: motor_get_target
+ * Description: Returns the level a motor is ramping to.
+ * Input parameters:
+ *      - motor: MOTOR_LEFT or MOTOR_RIGHT
+ * Returns: int32_t - Signed level
+ ************************************************************/
+int32_t motor_get_target(uint32_t motor)
+{
+    return motor < MOTORS ? targets[motor] : 0;
+}
+
+/************************************************************
+ * Function: motor_get_level
+ * Description: Returns the level a motor is driven at in the
+ *              current PWM period.
+ * Input parameters:
+ *      - motor: MOTOR_LEFT or MOTOR_RIGHT
+ * Returns: int32_t - Signed level
+ ************************************************************/
+int32_t motor_get_level(uint32_t motor)
+{
+    return motor < MOTORS ? levels[motor] : 0;
+}
+
+/************************************************************
+ * Function: ramp
+ * Description: Moves a level one period toward its target. A
+ *              level never passes through 0 in one step, it
+ *              stops there for a period first.
+ * Input parameters:
+ *      - level: Level driven in the last period
+ *      - target: Level commanded
+ * Returns: int32_t - Level for this period
+ ************************************************************/
+static int32_t ramp(int32_t level, int32_t target)
+{
+    if((level > 0 && target < 0) || (level < 0 && target > 0))
+    {
+        target = 0;
+    }
+
+    if(target > level)
+    {
+        return target - level > MOTOR_RAMP_STEP ? level + MOTOR_RAMP_STEP : target;
+    }
+
+    return level - target > MOTOR_RAMP_STEP ? level - MOTOR_RAMP_STEP : target;
+}
+
+/************************************************************
+ * Function: motor_period
+ * Description: Software timer callback at the start of every
+ *              PWM period. Ramps the levels, sets all four pins
+ *              with one store and schedules the falling edge of
+ *              each motor that is neither off nor at full
+ *              speed. Stops the timer once both motors are
+ *              stopped with nothing more to do.
+ * Input parameters:
+ *      - context: Unused
+ * Returns: None
+ ************************************************************/
+static void motor_period(void *context)
+{
+    uint8_t pins = 0;
+    bool idle = true;
+
+    for(uint32_t motor = 0; motor < MOTORS; motor++)
+    {
+        int32_t target = targets[motor];
+        int32_t level = ramp(levels[motor], target);
+        uint32_t magnitude = level < 0 ? -level : level;
+
+        levels[motor] = level;
+        idle &= !level && !target;
+
+        // At 0 the pin already points where the target will take it
+        if(level > 0 || (!level && target > 0))
+        {
+            pins |= direction_pins[motor];
+        }
+
+        if(!magnitude)
+        {
+            continue;
+        }
+
+        pins |= enable_pins[motor];
+
+        uint32_t on_us = (magnitude * MOTOR_PERIOD_US + MOTOR_LEVEL_MAX / 2) / MOTOR_LEVEL_MAX;
+
+        if(on_us < MOTOR_PERIOD_US)
+        {
+            sw_timer_start(&edge_timers[motor], on_us, 0);
+        }
+    }
+
+    pmod_write_masked(MOTOR_PINS, pins);
+
+    if(idle)
+    {
+        sw_timer_cancel(&period_timer);
+    }
+}
+
+/************************************************************
+ * Function: motor_edge
+ * Description: Software timer callback that ends the high part
+ *              of a motor's PWM period.
+ * Input parameters:
+ *      - context: The motor's entry in enable_pins
+ * Returns: None
+ ************************************************************/
+static void motor_edge(void *context)
+{
+    pmod_write_masked(*(const uint8_t*)context, 0);
+}
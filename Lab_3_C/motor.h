@@ -0,0 +1,51 @@
+#ifndef MOTOR_H
+#define MOTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pmodb.h"
+#include "timers.h"
+
+// PWM driver for two DC motors behind H-bridges with an enable and a
+// direction input each, on PMODB pins 1-4. Commands only set a target
+// level and return. A software timer starts every PWM period: it moves
+// each output level toward its target by at most MOTOR_RAMP_STEP, raises
+// the enable pins and schedules their falling edges. A reversal ramps
+// down to 0 first, so a direction pin only changes while its enable pin
+// is low. The timer stops once both motors are stopped and a command
+// restarts it at once. JB is also the keypad port: stop the keypad
+// before motor_init.
+
+#define MOTOR_LEFT 0
+#define MOTOR_RIGHT 1
+#define MOTORS 2
+
+#define MOTOR_LEFT_ENABLE 0b0001        // Pin 1
+#define MOTOR_LEFT_DIRECTION 0b0010     // Pin 2, high drives forward
+#define MOTOR_RIGHT_ENABLE 0b0100       // Pin 3
+#define MOTOR_RIGHT_DIRECTION 0b1000    // Pin 4
+#define MOTOR_PINS 0b1111
+
+#define MOTOR_PERIOD_US 500             // 2 kHz PWM
+#define MOTOR_LEVEL_MAX 255             // Full speed, the largest motion operand
+#define MOTOR_RAMP_STEP 2               // Per period, 0 to full speed in 64 ms
+
+// ROBOMAL motion instructions, in opcode order from 0x40
+typedef enum
+{
+    MOTION_LEFT,                // Spin left: left motor backward, right forward
+    MOTION_RIGHT,
+    MOTION_FORWARD,
+    MOTION_BACKWARD,
+    MOTION_BRAKE                // Both to 0, the operand is not used
+} motor_motion_t;
+
+void motor_init();
+void motor_release();
+bool motor_active();
+void motor_command(motor_motion_t motion, uint8_t speed);
+void motor_set_target(int32_t left, int32_t right);
+int32_t motor_get_target(uint32_t motor);
+int32_t motor_get_level(uint32_t motor);
+
+#endif // MOTOR_H
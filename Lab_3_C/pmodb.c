@@ -1,6 +1,18 @@
 #include "pmodb.h"
 #include <stdint.h>
 
+// Shadow copies, so no driver call has to read a register back. The
+// direction registers have no masked form, so they are cached whole and
+// other bank 2 pins must also change direction through this driver.
+static bool shadow_loaded = false;
+static uint32_t direction_shadow = 0;
+static uint32_t output_enable_shadow = 0;
+static volatile uint8_t output_shadow = 0;
+
+static void load_shadow();
+static void write_direction_shadow();
+static void update_output_shadow(uint8_t pins, uint8_t value);
+
 /*************************************************************
  * Function: void pmod_set_pin_directions(uint32_t)          *
  * Description: This function sets the directions of the     *
@@ -14,20 +26,20 @@
  *************************************************************/
 void pmod_set_pin_directions(uint32_t pin_directions)
 {
-       // Clearing PMODB pins w/o affecting other pins
-    *((uint32_t*)DATA2_DIR) &= ~PMODB_MASK;
-    *((uint32_t*)DATA2_OUT_EN) &= ~PMODB_MASK;
+    load_shadow();
 
-        // Setting PMODB pins to desired direction w/o affecting other pins 
-        // by shifting and masking
-    *((uint32_t*)DATA2_DIR) |= (pin_directions << 7);
-    *((uint32_t*)DATA2_OUT_EN) |= (pin_directions << 7);
+        // Replacing the PMODB pins w/o affecting other pins
+    direction_shadow = (direction_shadow & ~PMODB_MASK) | ((pin_directions << PMODB_SHIFT) & PMODB_MASK);
+    output_enable_shadow = (output_enable_shadow & ~PMODB_MASK) | ((pin_directions << PMODB_SHIFT) & PMODB_MASK);
+
+    write_direction_shadow();
 }
 
 /*************************************************************
  * Function: void pmod_set_pin_direction(uint8_t, uint8_t)   *
  * Description: This function sets the direction of a        *
- *              specific PMODB pin.                          *
+ *              specific PMODB pin, leaving the others as    *
+ *              they are.                                    *
  * Input parameters: pin - The pin number (1-8).             *
  *                   direction - The direction (0 for input, *
  *                   1 for output).                          *
@@ -35,8 +47,10 @@ void pmod_set_pin_directions(uint32_t pin_directions)
  *************************************************************/
 void pmod_set_pin_direction(uint8_t pin, uint8_t direction)
 {
+    uint8_t directions = pmod_get_directions() & ~(1 << (pin - 1));
+
         // Convinience function to set direction of individual pmodb pin
-    pmod_set_pin_directions((direction & 1) << (pin - 1));
+    pmod_set_pin_directions(directions | ((direction & 1) << (pin - 1)));
 }
 
 /*************************************************************
@@ -51,7 +65,7 @@ void pmod_set_pin_direction(uint8_t pin, uint8_t direction)
 uint8_t pmod_read_pins()
 {
         // Returning value associate with PMODB pins by shifting and masking
-    return (*((uint32_t*)DATA2_INPUT_ADDR) & PMODB_MASK) >> 7;
+    return (mmio_read(DATA2_INPUT_ADDR) & PMODB_MASK) >> 7;
 }
 
 /*************************************************************
@@ -71,7 +85,7 @@ uint8_t pmod_read_pin(uint8_t pin)
 /*************************************************************
  * Function: void pmod_write_pins(uint32_t)                  *
  * Description: This function writes values to the PMODB     *
- *              pins by updating the output register.        *
+ *              pins with one masked store.                  *
  * Input parameters: value - Bitmask representing the values *
  *                   to write to the pins. Each bit          *
  *                   corresponds to a pin (1 for high,       *
@@ -79,14 +93,14 @@ uint8_t pmod_read_pin(uint8_t pin)
  * Returns: None                                             *
  *************************************************************/
 void pmod_write_pins(uint32_t value)
-{       // Setting only DATA2 pins associated with PMODB to value
-    *((uint32_t*)DATA2_OUTPUT_ADDR) &= (((uint32_t)value << 7) | ~PMODB_MASK);
+{
+    pmod_write_masked(PMODB_PINS, value);
 }
 
 /*************************************************************
  * Function: void pmod_write_pin(uint8_t, uint8_t)           *
  * Description: This function writes a value to a specific   *
- *              PMODB pin.                                   *
+ *              PMODB pin with one masked store.             *
  * Input parameters: pin - The pin number (1-8).             *
  *                   value - The value to write (0 for low,  *
  *                   1 for high).                            *
@@ -94,17 +108,246 @@ void pmod_write_pins(uint32_t value)
  *************************************************************/
 void pmod_write_pin(uint8_t pin, uint8_t value)
 {
-        // Creating mask so only desired pin is affected
-    uint32_t mask = 1 << (pin + 6);  
+    uint8_t mask = 1 << (pin - 1);
+
+    pmod_write_masked(mask, value ? mask : 0);
+}
+
+/*************************************************************
+ * Function: void pmod_write_masked(uint8_t, uint8_t)        *
+ * Description: This function writes a subset of the PMODB   *
+ *              pins in a single store to MASK_DATA2_LSW.    *
+ *              Pins outside the subset, and every other     *
+ *              bank 2 pin, are left alone by the hardware,  *
+ *              so an ISR driving other pins cannot be       *
+ *              overwritten.                                 *
+ * Input parameters: pins - Bitmask of the pins to write     *
+ *                   (bit 0 = pin 1).                        *
+ *                   value - Values for those pins.          *
+ * Returns: None                                             *
+ *************************************************************/
+void pmod_write_masked(uint8_t pins, uint8_t value)
+{
+    uint32_t write_bits = (uint32_t)pins << PMODB_SHIFT;
 
-    if (value)
+    mmio_write(MASK_DATA2_LSW_ADDR, ((~write_bits & 0xFFFF) << 16) | (((uint32_t)value << PMODB_SHIFT) & write_bits));
+
+    update_output_shadow(pins, value);
+}
+
+/*************************************************************
+ * Function: void pmod_toggle_pins(uint8_t)                  *
+ * Description: This function inverts a subset of the PMODB  *
+ *              output pins, using the shadow instead of     *
+ *              reading DATA2. IRQs are masked so the shadow *
+ *              cannot change between the read and write.    *
+ * Input parameters: pins - Bitmask of the pins to toggle.   *
+ * Returns: None                                             *
+ *************************************************************/
+void pmod_toggle_pins(uint8_t pins)
+{
+    uint32_t state = save_and_disable_interrupts();
+
+    pmod_write_masked(pins, ~output_shadow);
+
+    restore_interrupts(state);
+}
+
+/*************************************************************
+ * Function: uint8_t pmod_get_outputs()                      *
+ * Description: This function returns the last values        *
+ *              written to the PMODB pins.                   *
+ * Input parameters: None                                    *
+ * Returns: uint8_t - Output shadow (bit 0 = pin 1).         *
+ *************************************************************/
+uint8_t pmod_get_outputs()
+{
+    return output_shadow;
+}
+
+/*************************************************************
+ * Function: uint8_t pmod_get_directions()                   *
+ * Description: This function returns the PMODB pin         *
+ *              directions from the shadow.                  *
+ * Input parameters: None                                    *
+ * Returns: uint8_t - 1 for output, 0 for input per pin.     *
+ *************************************************************/
+uint8_t pmod_get_directions()
+{
+    load_shadow();
+
+    return (direction_shadow & PMODB_MASK) >> PMODB_SHIFT;
+}
+
+/*************************************************************
+ * Function: void pmod_write_sequence(uint8_t,               *
+ *                        const uint8_t[], uint32_t)         *
+ * Description: This function writes a run of values to a    *
+ *              subset of the PMODB pins back to back, one   *
+ *              store each, for bit-banged waveforms.        *
+ * Input parameters: pins - Bitmask of the pins to write.    *
+ *                   values - Values to write in order.      *
+ *                   count - Number of values.               *
+ * Returns: None                                             *
+ *************************************************************/
+void pmod_write_sequence(uint8_t pins, const uint8_t values[], uint32_t count)
+{
+    uint32_t write_bits = (uint32_t)pins << PMODB_SHIFT;
+    uint32_t keep = (~write_bits & 0xFFFF) << 16;
+
+    if(count == 0)
     {
-            // Set bit if value is 1 (or greater)
-        *((uint32_t*)DATA2_OUTPUT_ADDR) |= mask;  
-    }        
-    else
+        return;
+    }
+
+    for(uint32_t i = 0; i < count; i++)
     {
-            // Clear bit if value is 0
-        *((uint32_t*)DATA2_OUTPUT_ADDR) &= ~mask;  
+        mmio_write(MASK_DATA2_LSW_ADDR, keep | (((uint32_t)values[i] << PMODB_SHIFT) & write_bits));
     }
-}
\ No newline at end of file
+
+    update_output_shadow(pins, values[count - 1]);
+}
+
+/*************************************************************
+ * Function: void pmod_shift_out(uint8_t, uint8_t,           *
+ *                               uint32_t, uint32_t)         *
+ * Description: This function clocks data out MSB first on   *
+ *              two PMODB pins, SPI mode 0 style: data is    *
+ *              set with the clock low, then the clock rises.*
+ *              Two stores per bit; the clock is left low.   *
+ * Input parameters: data_pin - Data pin number (1-8).       *
+ *                   clock_pin - Clock pin number (1-8).     *
+ *                   data - Bits to send, right aligned.     *
+ *                   bits - Number of bits (1-32).           *
+ * Returns: None                                             *
+ *************************************************************/
+void pmod_shift_out(uint8_t data_pin, uint8_t clock_pin, uint32_t data, uint32_t bits)
+{
+    uint32_t data_bit = 1 << (data_pin - 1 + PMODB_SHIFT);
+    uint32_t clock_bit = 1 << (clock_pin - 1 + PMODB_SHIFT);
+    uint32_t keep = (~(data_bit | clock_bit) & 0xFFFF) << 16;
+    uint32_t value = 0;
+
+    while(bits--)
+    {
+        value = ((data >> bits) & 1) ? data_bit : 0;
+        mmio_write(MASK_DATA2_LSW_ADDR, keep | value);
+        mmio_write(MASK_DATA2_LSW_ADDR, keep | value | clock_bit);
+    }
+
+    mmio_write(MASK_DATA2_LSW_ADDR, keep | value);
+
+    update_output_shadow((data_bit | clock_bit) >> PMODB_SHIFT, value >> PMODB_SHIFT);
+}
+
+/*************************************************************
+ * Function: void pmod_benchmark()                           *
+ * Description: This function times pin writes with the     *
+ *              global timer and prints writes per second    *
+ *              for the read-modify-write pin write this     *
+ *              driver used to do, pmod_write_pin,           *
+ *              pmod_write_pins and pmod_shift_out. The      *
+ *              PMODB pins toggle while it runs.             *
+ * Input parameters: None                                    *
+ * Returns: None                                             *
+ *************************************************************/
+void pmod_benchmark()
+{
+    const uint32_t writes = 100000;
+    uint64_t start, ticks;
+
+    serial_print("PMODB writes per second\n");
+
+    // Read-modify-write of DATA2, as pmod_write_pin did before masked writes
+    start = read_global_timer();
+    for(uint32_t i = 0; i < writes; i++)
+    {
+        if(i & 1)
+        {
+            mmio_write(DATA2_OUTPUT_ADDR, mmio_read(DATA2_OUTPUT_ADDR) | 1 << PMODB_SHIFT);
+        }
+        else
+        {
+            mmio_write(DATA2_OUTPUT_ADDR, mmio_read(DATA2_OUTPUT_ADDR) & ~(1 << PMODB_SHIFT));
+        }
+    }
+    ticks = read_global_timer() - start;
+    serial_print("  read-modify-write pin: %u\n", (uint32_t)(writes * (uint64_t)GTC_TICKS_PER_SECOND / ticks));
+
+    start = read_global_timer();
+    for(uint32_t i = 0; i < writes; i++)
+    {
+        pmod_write_pin(1, i & 1);
+    }
+    ticks = read_global_timer() - start;
+    serial_print("  pmod_write_pin: %u\n", (uint32_t)(writes * (uint64_t)GTC_TICKS_PER_SECOND / ticks));
+
+    start = read_global_timer();
+    for(uint32_t i = 0; i < writes; i++)
+    {
+        pmod_write_pins(i);
+    }
+    ticks = read_global_timer() - start;
+    serial_print("  pmod_write_pins: %u\n", (uint32_t)(writes * (uint64_t)GTC_TICKS_PER_SECOND / ticks));
+
+    // Two stores per bit
+    start = read_global_timer();
+    for(uint32_t i = 0; i < writes / 64; i++)
+    {
+        pmod_shift_out(1, 2, i, 32);
+    }
+    ticks = read_global_timer() - start;
+    serial_print("  pmod_shift_out stores: %u\n", (uint32_t)((writes / 64) * 65 * (uint64_t)GTC_TICKS_PER_SECOND / ticks));
+}
+
+/*************************************************************
+ * Function: void load_shadow()                              *
+ * Description: This function reads the direction, output    *
+ *              enable and PMODB output registers into the   *
+ *              shadows on first use.                        *
+ * Input parameters: None                                    *
+ * Returns: None                                             *
+ *************************************************************/
+static void load_shadow()
+{
+    if(!shadow_loaded)
+    {
+        direction_shadow = mmio_read(DATA2_DIR);
+        output_enable_shadow = mmio_read(DATA2_OUT_EN);
+        output_shadow = (mmio_read(DATA2_OUTPUT_ADDR) & PMODB_MASK) >> PMODB_SHIFT;
+        shadow_loaded = true;
+    }
+}
+
+/*************************************************************
+ * Function: void write_direction_shadow()                   *
+ * Description: This function stores the direction and       *
+ *              output enable shadows, one store each.       *
+ * Input parameters: None                                    *
+ * Returns: None                                             *
+ *************************************************************/
+static void write_direction_shadow()
+{
+    mmio_write(DATA2_DIR, direction_shadow);
+    mmio_write(DATA2_OUT_EN, output_enable_shadow);
+}
+
+/*************************************************************
+ * Function: void update_output_shadow(uint8_t, uint8_t)     *
+ * Description: This function records values written to a    *
+ *              subset of the PMODB pins in the output       *
+ *              shadow. The hexpad scan and motor PWM        *
+ *              callbacks write pins from interrupts, so the *
+ *              read-modify-write runs with IRQs masked.     *
+ * Input parameters: pins - Bitmask of the pins written.     *
+ *                   value - Values for those pins.          *
+ * Returns: None                                             *
+ *************************************************************/
+static void update_output_shadow(uint8_t pins, uint8_t value)
+{
+    uint32_t state = save_and_disable_interrupts();
+
+    output_shadow = (output_shadow & ~pins) | (value & pins);
+
+    restore_interrupts(state);
+}
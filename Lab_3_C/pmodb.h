@@ -2,13 +2,24 @@
 #define PMODB_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include "serial.h"
+#include "timers.h"
+#include "mmio.h"
 
 #define DATA2_OUTPUT_ADDR 0xE000A048
 #define DATA2_INPUT_ADDR 0xE000A068
 #define DATA2_DIR 0xE000A284
 #define DATA2_OUT_EN 0xE000A288
 
+// Masked write of bank 2 bits 0-15: the upper half selects the bits to
+// keep (1) or write (0) and the lower half holds the values, so any set
+// of PMODB pins changes in one store without reading DATA2 first
+#define MASK_DATA2_LSW_ADDR 0xE000A010
+
 #define PMODB_MASK 0x7F80
+#define PMODB_SHIFT 7
+#define PMODB_PINS 0xFF
 
 void pmod_set_pin_directions(uint32_t direction);
 void pmod_set_pin_direction(uint8_t pin, uint8_t direction);
@@ -16,9 +27,17 @@ uint8_t pmod_read_pins();
 uint8_t pmod_read_pin(uint8_t pin);
 void pmod_write_pins(uint32_t value);
 void pmod_write_pin(uint8_t pin, uint8_t value);
+void pmod_write_masked(uint8_t pins, uint8_t value);
+void pmod_toggle_pins(uint8_t pins);
+uint8_t pmod_get_outputs();
+uint8_t pmod_get_directions();
+void pmod_write_sequence(uint8_t pins, const uint8_t values[], uint32_t count);
+void pmod_shift_out(uint8_t data_pin, uint8_t clock_pin, uint32_t data, uint32_t bits);
+
+void pmod_benchmark();
 
 
 
 
 
-#endif // PMOD_H
\ No newline at end of file
+#endif // PMOD_H
@@ -0,0 +1,181 @@
+#include "profile.h"
+#include "serial.h"
+#include "interrupt.h"
+
+#define PROFILE_PROBE_NAME(id, name) name,
+
+static const char *probe_names[PROFILE_PROBES] =
+{
+    PROFILE_PROBE_LIST(PROFILE_PROBE_NAME)
+};
+
+static profile_stats_t stats[PROFILE_PROBES];
+
+// Ticks an empty probe measures, taken off every recorded duration
+static uint32_t overhead = 0;
+
+/************************************************************
+ * Function: profile_init
+ * Description: Clears every probe and measures the cost of an
+ *              empty begin/end pair (the fastest of 64), which
+ *              profile_record then subtracts so short regions
+ *              are not swamped by the timer reads.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void profile_init()
+{
+    uint32_t fastest = 0xFFFFFFFF;
+
+    for(uint32_t i = 0; i < 64; i++)
+    {
+        uint64_t start = read_global_timer();
+        uint32_t ticks = read_global_timer() - start;
+
+        if(ticks < fastest)
+        {
+            fastest = ticks;
+        }
+    }
+
+    overhead = fastest;
+    profile_reset();
+}
+
+/************************************************************
+ * Function: profile_reset
+ * Description: Clears the statistics of every probe.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void profile_reset()
+{
+    for(uint32_t id = 0; id < PROFILE_PROBES; id++)
+    {
+        stats[id].count = 0;
+        stats[id].min = 0xFFFFFFFF;
+        stats[id].max = 0;
+        stats[id].total = 0;
+
+        for(uint32_t bucket = 0; bucket < PROFILE_BUCKETS; bucket++)
+        {
+            stats[id].histogram[bucket] = 0;
+        }
+    }
+}
+
+/************************************************************
+ * Function: profile_record
+ * Description: Adds one measured duration to a probe. Safe from
+ *              an ISR.
+ * Input parameters:
+ *      - id: Probe
+ *      - ticks: Global timer ticks, probe overhead included
+ * Returns: None
+ ************************************************************/
+void profile_record(profile_probe_t id, uint64_t ticks)
+{
+    uint32_t duration = ticks > overhead ? ticks - overhead : 0;
+
+    if(ticks >> 32)
+    {
+        duration = 0xFFFFFFFF;
+    }
+
+    uint32_t bucket = duration ? 31 - __builtin_clz(duration) : 0;
+    uint32_t state = save_and_disable_interrupts();
+    profile_stats_t *probe = &stats[id];
+
+    probe->count++;
+    probe->total += duration;
+    probe->histogram[bucket]++;
+
+    if(duration < probe->min)
+    {
+        probe->min = duration;
+    }
+
+    if(duration > probe->max)
+    {
+        probe->max = duration;
+    }
+
+    restore_interrupts(state);
+}
+
+/************************************************************
+ * Function: profile_scope_end
+ * Description: Cleanup for PROFILE_SCOPE, records the time
+ *              since the scope was entered.
+ * Input parameters:
+ *      - scope: The scope's start stamp
+ * Returns: None
+ ************************************************************/
+void profile_scope_end(profile_scope_t *scope)
+{
+    profile_record(scope->id, read_global_timer() - scope->start);
+}
+
+/************************************************************
+ * Function: profile_get_stats
+ * Description: Returns a probe's statistics.
+ * Input parameters:
+ *      - id: Probe
+ * Returns: const profile_stats_t* - The statistics
+ ************************************************************/
+const profile_stats_t *profile_get_stats(profile_probe_t id)
+{
+    return &stats[id];
+}
+
+/************************************************************
+ * Function: profile_probe_name
+ * Description: Returns the name a probe is printed with.
+ * Input parameters:
+ *      - id: Probe
+ * Returns: const char* - The name
+ ************************************************************/
+const char *profile_probe_name(profile_probe_t id)
+{
+    return probe_names[id];
+}
+
+/************************************************************
+ * Function: profile_print
+ * Description: Prints a table of every probe that has recorded
+ *              anything, times in nanoseconds, each followed by
+ *              its non-empty histogram buckets as
+ *              lower bound:count.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void profile_print()
+{
+    serial_print("%-18s %8s %10s %10s %10s\n", "probe", "count", "min ns", "mean ns", "max ns");
+
+    for(uint32_t id = 0; id < PROFILE_PROBES; id++)
+    {
+        const profile_stats_t *probe = &stats[id];
+
+        if(!probe->count)
+        {
+            continue;
+        }
+
+        serial_print("%-18s %8u %10u %10u %10u\n", probe_names[id], probe->count,
+                     (uint32_t)((uint64_t)probe->min * PROFILE_NS_PER_TICK),
+                     (uint32_t)(probe->total * PROFILE_NS_PER_TICK / probe->count),
+                     (uint32_t)((uint64_t)probe->max * PROFILE_NS_PER_TICK));
+        serial_print("   ");
+
+        for(uint32_t bucket = 0; bucket < PROFILE_BUCKETS; bucket++)
+        {
+            if(probe->histogram[bucket])
+            {
+                serial_print(" %uns:%u", (uint32_t)((bucket ? 1ull << bucket : 0) * PROFILE_NS_PER_TICK), probe->histogram[bucket]);
+            }
+        }
+
+        serial_print("\n");
+    }
+}
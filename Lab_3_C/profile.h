@@ -0,0 +1,92 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "timers.h"
+
+// Probes time a region of code with the global timer (3 ns ticks) and
+// keep count, min, max, total and a log2 histogram per probe. Build with
+// PROFILE_ENABLE defined to turn them on; otherwise every PROFILE_* macro
+// expands to nothing and the probes cost nothing.
+//
+//     PROFILE_BEGIN(PROFILE_BIN_TO_BCD);
+//     bcd = bin_to_bcd(value);
+//     PROFILE_END(PROFILE_BIN_TO_BCD);
+//
+// or, for a whole function with several returns, PROFILE_SCOPE(id) at the
+// top, which records when the function returns.
+
+// Probe IDs and the names profile_print shows
+#define PROFILE_PROBE_LIST(PROBE) \
+    PROBE(PROFILE_IRQ, "IRQ_Handler") \
+    PROBE(PROFILE_SERIAL_ISR, "serial_isr") \
+    PROBE(PROFILE_TIMER_WHEEL_ISR, "timer_wheel_isr") \
+    PROBE(PROFILE_HEXPAD_SCAN_ISR, "hexpad_scan_isr") \
+    PROBE(PROFILE_INPUT_SAMPLE_ISR, "input_sample_isr") \
+    PROBE(PROFILE_SERIAL_PRINT, "serial_print") \
+    PROBE(PROFILE_GET_HEXKEY, "get_hexkey") \
+    PROBE(PROFILE_BIN_TO_BCD, "bin_to_bcd") \
+    PROBE(PROFILE_SEVEN_SEG, "write_seven_seg") \
+    PROBE(PROFILE_ROBOMAL_STEP, "robomal_step") \
+    PROBE(PROFILE_CALCULATE, "calculate") \
+    PROBE(PROFILE_SET_LEDS, "set_leds_10bit") \
+    PROBE(PROFILE_SET_RGB, "set_rgb_color") \
+    PROBE(PROFILE_GET_SWITCHES, "get_switches") \
+    PROBE(PROFILE_PMOD_WRITE, "pmod_write_pins") \
+    PROBE(PROFILE_PMOD_READ, "pmod_read_pins") \
+    PROBE(PROFILE_SW_TIMER, "sw_timer_start") \
+    PROBE(PROFILE_EMPTY, "empty probe")
+
+#define PROFILE_PROBE_ID(id, name) id,
+
+typedef enum
+{
+    PROFILE_PROBE_LIST(PROFILE_PROBE_ID)
+    PROFILE_PROBES
+} profile_probe_t;
+
+#define PROFILE_NS_PER_TICK 3
+
+// Bucket n counts durations of 2^n to 2^(n+1) - 1 ticks, bucket 0 also 0
+#define PROFILE_BUCKETS 32
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t histogram[PROFILE_BUCKETS];
+} profile_stats_t;
+
+typedef struct
+{
+    profile_probe_t id;
+    uint64_t start;
+} profile_scope_t;
+
+#ifdef PROFILE_ENABLE
+
+#define PROFILE_BEGIN(id) uint64_t profile_start_##id = read_global_timer()
+#define PROFILE_END(id) profile_record(id, read_global_timer() - profile_start_##id)
+#define PROFILE_SCOPE(id) \
+    profile_scope_t profile_scope __attribute__((cleanup(profile_scope_end))) = {id, read_global_timer()}
+
+#else
+
+#define PROFILE_BEGIN(id)
+#define PROFILE_END(id)
+#define PROFILE_SCOPE(id)
+
+#endif
+
+void profile_init();
+void profile_reset();
+void profile_record(profile_probe_t id, uint64_t ticks);
+void profile_scope_end(profile_scope_t *scope);
+const profile_stats_t *profile_get_stats(profile_probe_t id);
+const char *profile_probe_name(profile_probe_t id);
+void profile_print();
+
+#endif // PROFILE_H
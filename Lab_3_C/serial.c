@@ -1,6 +1,37 @@
 #include "serial.h"
+#include "profile.h"
 #include <sleep.h>
 
+// Transmit ring buffer. tx_head is only advanced by the producer and tx_tail
+// by the UART drain, so both run free and are masked on access.
+static volatile uint8_t tx_buffer[SERIAL_TX_BUFFER_SIZE];
+static volatile uint32_t tx_head = 0;
+static volatile uint32_t tx_tail = 0;
+static volatile uint32_t tx_dropped = 0;
+static volatile uint32_t tx_high_water = 0;
+static serial_tx_policy_t tx_policy = SERIAL_TX_BLOCK;
+
+// Receive ring buffer. rx_head is only advanced by the ISR and rx_tail by
+// the reader.
+static volatile uint8_t rx_buffer[SERIAL_RX_BUFFER_SIZE];
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+static volatile uint32_t rx_dropped = 0;
+static task_event_t *rx_event = 0;
+static bool rx_line_overflow = false;       // serial_readline is dropping a long line
+
+// Receive errors the UART reported
+static volatile uint32_t rx_overruns = 0;
+static volatile uint32_t rx_framing_errors = 0;
+static volatile uint32_t rx_parity_errors = 0;
+
+static serial_baud_t baud = {0, 0, 0, 0};
+
+static void serial_tx_drain();
+static void serial_tx_kick();
+static void serial_tx_enqueue(char c);
+static void serial_rx_drain();
+
 /************************************************************
  * Function: serial_init
  * Description: Initializes the UART with the specified 
@@ -9,41 +40,190 @@
  *      - stop_bit: Number of stop bits
  *      - data_bits: Number of data bits
  *      - parity: Parity setting
- *      - baudrate: Bauderate (Designed for MACRO)
- * Returns: None
+ *      - baudrate: Bits per second, e.g. UART_BAUDRATE_115200
+ * Returns: bool - false if the rate cannot be made within
+ *          UART_BAUD_MAX_ERROR_PPM, the UART is left alone
  ************************************************************/
-void serial_init(uint32_t stop_bit, uint32_t data_bits, uint32_t parity, uint32_t baudrate[])
+bool serial_init(uint32_t stop_bit, uint32_t data_bits, uint32_t parity, uint32_t baudrate)
 {
+    serial_baud_t divisors;
+
+    if(!serial_compute_baud(baudrate, &divisors))
+    {
+        return false;
+    }
+
     // Resetting transmitter/receiver and clearing FIFO buffer
-    *((uint32_t*)UART1_CTRL_ADDR) = 0b11;
+    mmio_write(UART1_CTRL_ADDR, 0b11);
 
-    int reset_pending = *((uint32_t*)UART1_CTRL_ADDR) & 0b11;
+    int reset_pending = mmio_read(UART1_CTRL_ADDR) & 0b11;
 
     while(reset_pending)
     {
-        reset_pending = *((uint32_t*)UART1_CTRL_ADDR) & 0b11;
+        reset_pending = mmio_read(UART1_CTRL_ADDR) & 0b11;
     }
 
     // Enabling TX and RX
-    *((uint32_t*)UART1_CTRL_ADDR) = 0b10100;
+    mmio_write(UART1_CTRL_ADDR, UART_CTRL_ENABLE);
 
     // Setting mode, stop bits, data bits, and parity
-    *((uint32_t*)UART1_MODE_ADDR) = 0b0000100000 | 
-                                    ((stop_bit & 0b11) << 6) | 
-                                    ((data_bits & 0b11) << 1) |
-                                    ((parity & 0b111) << 3);
+    mmio_write(UART1_MODE_ADDR, 0b0000100000 | 
+                                ((stop_bit & 0b11) << 6) | 
+                                ((data_bits & 0b11) << 1) |
+                                ((parity & 0b111) << 3));
         
     // Setting baudrate 
-    *((uint32_t*)UART1_BAUDGEN_ADDR) = baudrate[0];
-    *((uint32_t*)UART1_BAUDRATE_D_ADDR) = baudrate[1];
+    mmio_write(UART1_BAUDGEN_ADDR, divisors.cd);
+    mmio_write(UART1_BAUDRATE_D_ADDR, divisors.bdiv);
+    baud = divisors;
+
+    // Masking all UART interrupts and clearing stale events. TX empty is
+    // unmasked on demand by serial_tx_kick while the ring buffer has data.
+    mmio_write(UART1_INTERRUPT_DIS_ADDR, 0x1FFF);
+    mmio_write(UART1_INTERRUPT_STAT_ADDR, 0x1FFF);
+
+    tx_head = 0;
+    tx_tail = 0;
+    rx_head = 0;
+    rx_tail = 0;
+
+    // Receiving in bursts: a FIFO level interrupt while data streams in and
+    // a timeout for the bytes left over once the line goes quiet
+    mmio_write(UART1_RX_TRIGGER_ADDR, UART_RX_TRIGGER_LEVEL);
+    mmio_write(UART1_RX_TIMEOUT_ADDR, UART_RX_TIMEOUT);
+    mmio_write(UART1_CTRL_ADDR, UART_CTRL_ENABLE | UART_CTRL_RESTART_TIMEOUT);
+    mmio_write(UART1_INTERRUPT_EN_ADDR, UART_RX_INTERRUPTS);
+
+    // Routing UART1 through the GIC (init_GIC must have been called)
+    irq_register(UART1_INTERRUPT_ID, serial_isr, UART1_INTERRUPT_PRIORITY, INTERRUPT_SENSITIVITY_LEVEL, 0);
+
+    return true;
+}
+
+/************************************************************
+ * Function: serial_compute_baud
+ * Description: Finds the CD and BDIV pair whose rate,
+ *              UART_REF_CLOCK_HZ / (CD * (BDIV + 1)), is closest
+ *              to the one asked for. Every BDIV is tried with
+ *              the rounded CD for it; on a tie the smaller BDIV
+ *              is kept, as the Xilinx driver does. Runs in the
+ *              order of a few hundred divisions, for init and
+ *              rate changes only.
+ * Input parameters:
+ *      - baudrate: Bits per second
+ *      - baud: Output, the divisors, the rate they give and
+ *        its error, filled in even if the error is too large
+ * Returns: bool - false if the error is more than
+ *          UART_BAUD_MAX_ERROR_PPM
+ ************************************************************/
+bool serial_compute_baud(uint32_t baudrate, serial_baud_t *baud)
+{
+    uint64_t best_error = UINT64_MAX;
+
+    if(!baudrate)
+    {
+        return false;
+    }
+
+    for(uint32_t bdiv = UART_BDIV_MIN; bdiv <= UART_BDIV_MAX; bdiv++)
+    {
+        uint64_t per_cd = (uint64_t)baudrate * (bdiv + 1);
+        uint64_t cd = (UART_REF_CLOCK_HZ + per_cd / 2) / per_cd;
+
+        if(cd < 1)
+        {
+            cd = 1;
+        }
+        else if(cd > UART_CD_MAX)
+        {
+            continue;
+        }
 
-    // Enabling FIFO full and empty interrupts
-    *((uint32_t*)UART1_INTERRUPT_EN_ADDR) = 0b11000;      
+        // Distance of the rate this pair gives from the one asked for, in micro baud
+        uint64_t actual = (uint64_t)UART_REF_CLOCK_HZ * 1000000 / (cd * (bdiv + 1));
+        uint64_t wanted = (uint64_t)baudrate * 1000000;
+        uint64_t error = actual > wanted ? actual - wanted : wanted - actual;
+
+        if(error < best_error)
+        {
+            best_error = error;
+            baud->cd = cd;
+            baud->bdiv = bdiv;
+        }
+    }
+
+    if(best_error == UINT64_MAX)
+    {
+        return false;
+    }
+
+    uint64_t divisor = (uint64_t)baud->cd * (baud->bdiv + 1);
+
+    baud->actual = (UART_REF_CLOCK_HZ + divisor / 2) / divisor;
+    baud->error_ppm = (int32_t)(((int64_t)UART_REF_CLOCK_HZ * 1000000 / (int64_t)divisor - (int64_t)baudrate * 1000000) /
+                             (int64_t)baudrate);
+
+    return baud->error_ppm <= UART_BAUD_MAX_ERROR_PPM && baud->error_ppm >= -UART_BAUD_MAX_ERROR_PPM;
+}
+
+/************************************************************
+ * Function: serial_set_baudrate
+ * Description: Changes the baud rate once everything queued
+ *              has been sent. Bytes arriving during the change
+ *              may be lost.
+ * Input parameters:
+ *      - baudrate: Bits per second
+ * Returns: bool - false if the rate cannot be made within
+ *          UART_BAUD_MAX_ERROR_PPM, the rate is unchanged
+ ************************************************************/
+bool serial_set_baudrate(uint32_t baudrate)
+{
+    serial_baud_t divisors;
+
+    if(!serial_compute_baud(baudrate, &divisors))
+    {
+        return false;
+    }
+
+    serial_flush();
+
+    while(mmio_read(UART1_CHANNEL_STAT_ADDR) & UART_TX_ACTIVE_BIT);
+
+    // The divisors may only change while TX and RX are disabled
+    mmio_write(UART1_CTRL_ADDR, UART_CTRL_DISABLE);
+    mmio_write(UART1_BAUDGEN_ADDR, divisors.cd);
+    mmio_write(UART1_BAUDRATE_D_ADDR, divisors.bdiv);
+    mmio_write(UART1_CTRL_ADDR, UART_CTRL_ENABLE | UART_CTRL_RESTART_TIMEOUT);
+    baud = divisors;
+
+    // Restarting the timeout disarms it until the next byte, so collect what is waiting
+    uint32_t state = save_and_disable_interrupts();
+    serial_rx_drain();
+    restore_interrupts(state);
+
+    return true;
+}
+
+/************************************************************
+ * Function: serial_get_baud
+ * Description: Returns the divisors in use and the rate they
+ *              give.
+ * Input parameters: None
+ * Returns: const serial_baud_t* - Current divisors
+ ************************************************************/
+const serial_baud_t *serial_get_baud()
+{
+    return &baud;
 }
 
 /************************************************************
  * Function: serial_print
  * Description: Prints a formatted string to the serial console.
+ *              See format_vprint for supported conversions.
+ *              Characters are copied into the transmit ring
+ *              buffer and sent by the UART1 interrupt, so the
+ *              call returns without waiting on the UART unless
+ *              the buffer is full and the policy is BLOCK.
  * Input parameters: 
  *      - c_string: The format string
  *      - ...: Additional arguments for the format string
@@ -51,36 +231,441 @@ void serial_init(uint32_t stop_bit, uint32_t data_bits, uint32_t parity, uint32_
  ************************************************************/
 void serial_print(char c_string[], ...)
 {
-    // Parsing string to replace format specifiers with input args 
-    char parsed_string[64];
+    PROFILE_SCOPE(PROFILE_SERIAL_PRINT);
+
+    // Streaming the formatted characters straight into the ring buffer
     va_list args;
     va_start(args, c_string);
-    vsnprintf(parsed_string, sizeof(parsed_string), c_string, args);
+    format_vprint(serial_tx_enqueue, c_string, args);
     va_end(args);
 
-    char *string_iter = parsed_string;
+    serial_tx_kick();
+}
+
+/************************************************************
+ * Function: serial_flush
+ * Description: Blocks until every queued character has been
+ *              handed to the UART and the TX FIFO is empty.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void serial_flush()
+{
+    while(tx_head != tx_tail)
+    {
+        serial_tx_kick();
+    }
+
+    while(!(mmio_read(UART1_CHANNEL_STAT_ADDR) & UART_TX_EMPTY_BIT));
+}
+
+/************************************************************
+ * Function: serial_set_tx_policy
+ * Description: Sets what happens when serial_print finds the
+ *              transmit ring buffer full.
+ * Input parameters: 
+ *      - policy: SERIAL_TX_DROP, SERIAL_TX_BLOCK or
+ *                SERIAL_TX_OVERWRITE
+ * Returns: None
+ ************************************************************/
+void serial_set_tx_policy(serial_tx_policy_t policy)
+{
+    tx_policy = policy;
+}
+
+/************************************************************
+ * Function: serial_get_tx_dropped
+ * Description: Returns the number of bytes discarded because
+ *              the transmit ring buffer was full.
+ * Input parameters: None
+ * Returns: uint32_t - Dropped byte count
+ ************************************************************/
+uint32_t serial_get_tx_dropped()
+{
+    return tx_dropped;
+}
+
+/************************************************************
+ * Function: serial_get_tx_high_water
+ * Description: Returns the largest number of bytes that have
+ *              been queued in the transmit ring buffer at once.
+ * Input parameters: None
+ * Returns: uint32_t - High-water mark in bytes
+ ************************************************************/
+uint32_t serial_get_tx_high_water()
+{
+    return tx_high_water;
+}
+
+/************************************************************
+ * Function: serial_write
+ * Description: Queues raw bytes for transmission, zeros
+ *              included, under the same ring buffer and policy
+ *              as serial_print.
+ * Input parameters:
+ *      - data: Bytes to send
+ *      - length: Number of bytes
+ * Returns: None
+ ************************************************************/
+void serial_write(const uint8_t *data, uint32_t length)
+{
+    for(uint32_t i = 0; i < length; i++)
+    {
+        serial_tx_enqueue((char)data[i]);
+    }
+
+    serial_tx_kick();
+}
+
+/************************************************************
+ * Function: serial_read
+ * Description: Takes up to length received bytes from the
+ *              receive ring buffer without waiting.
+ * Input parameters:
+ *      - buffer: Where to copy the bytes
+ *      - length: Most bytes to take
+ * Returns: uint32_t - Number of bytes copied, 0 if none waiting
+ ************************************************************/
+uint32_t serial_read(uint8_t *buffer, uint32_t length)
+{
+    uint32_t tail = rx_tail;
+    uint32_t count = 0;
+
+    while(count < length && tail != rx_head)
+    {
+        buffer[count++] = rx_buffer[tail & (SERIAL_RX_BUFFER_SIZE - 1)];
+        tail++;
+    }
+
+    rx_tail = tail;
+
+    return count;
+}
+
+/************************************************************
+ * Function: serial_readline
+ * Description: Takes one line from the receive ring buffer
+ *              without waiting. A line ends at CR or LF, which
+ *              is dropped; CR LF gives an empty line after the
+ *              first. A line longer than size - 1 characters
+ *              is dropped up to its end, where it is reported
+ *              once as SERIAL_LINE_TOO_LONG.
+ * Input parameters:
+ *      - line: Where to copy the line, NUL terminated
+ *      - size: Size of line in bytes, at least 2
+ * Returns: serial_line_t - SERIAL_LINE_READY if a line was
+ *          copied, SERIAL_LINE_NONE if no complete line has
+ *          been received yet
+ ************************************************************/
+serial_line_t serial_readline(char *line, uint32_t size)
+{
+    uint32_t head = rx_head;
+    uint32_t tail = rx_tail;
+    uint32_t length = 0;
+
+    while(tail + length != head)
+    {
+        char c = rx_buffer[(tail + length) & (SERIAL_RX_BUFFER_SIZE - 1)];
 
-    // Write characters to serial console until null character is reached
-    while(*string_iter)
-    {       
-        // If fifo buffer is full wait until empty
-        if(*(uint32_t*)UART1_INTERRUPT_STAT_ADDR & 0b10000)
+        if(c == '\r' || c == '\n')
         {
-            // Clearing full flag
-            *(uint32_t*)UART1_INTERRUPT_STAT_ADDR = *(uint32_t*)UART1_INTERRUPT_STAT_ADDR | 0b10000;
+            rx_tail = tail + length + 1;
 
-            uint32_t buffer_empyt = *(uint32_t*)UART1_INTERRUPT_STAT_ADDR & 0b1000;
+            if(rx_line_overflow)
+            {
+                rx_line_overflow = false;
+                return SERIAL_LINE_TOO_LONG;
+            }
+
+            line[length] = '\0';
+            return SERIAL_LINE_READY;
+        }
+
+        // No room for c: everything up to the line end is taken and dropped
+        if(rx_line_overflow || length == size - 1)
+        {
+            rx_line_overflow = true;
+            rx_tail = tail + length + 1;
+            tail = rx_tail;
+            length = 0;
+            continue;
+        }
+
+        line[length++] = c;
+    }
 
-            // Waiting until empty. May need to update with timeout if it causes freeze.
-            while(!buffer_empyt)
+    return SERIAL_LINE_NONE;
+}
+
+/************************************************************
+ * Function: serial_peek
+ * Description: Looks at the next received byte without taking
+ *              it from the receive ring buffer.
+ * Input parameters:
+ *      - byte: Output, the next byte
+ * Returns: bool - false if nothing has been received
+ ************************************************************/
+bool serial_peek(uint8_t *byte)
+{
+    if(rx_tail == rx_head)
+    {
+        return false;
+    }
+
+    *byte = rx_buffer[rx_tail & (SERIAL_RX_BUFFER_SIZE - 1)];
+    return true;
+}
+
+/************************************************************
+ * Function: serial_rx_available
+ * Description: Returns the number of received bytes waiting in
+ *              the receive ring buffer. Bytes still in the UART
+ *              FIFO are not counted until the next RX interrupt.
+ * Input parameters: None
+ * Returns: uint32_t - Bytes waiting
+ ************************************************************/
+uint32_t serial_rx_available()
+{
+    return rx_head - rx_tail;
+}
+
+/************************************************************
+ * Function: serial_get_rx_dropped
+ * Description: Returns the number of received bytes lost
+ *              because the receive ring buffer was full.
+ * Input parameters: None
+ * Returns: uint32_t - Dropped byte count
+ ************************************************************/
+uint32_t serial_get_rx_dropped()
+{
+    return rx_dropped;
+}
+
+/************************************************************
+ * Function: serial_get_rx_overruns
+ * Description: Returns the number of times the UART RX FIFO
+ *              overflowed, losing bytes before the ISR could
+ *              take them.
+ * Input parameters: None
+ * Returns: uint32_t - Overrun count
+ ************************************************************/
+uint32_t serial_get_rx_overruns()
+{
+    return rx_overruns;
+}
+
+/************************************************************
+ * Function: serial_get_rx_framing_errors
+ * Description: Returns the number of RX interrupts that found
+ *              a byte received without a valid stop bit, usually
+ *              a baud rate mismatch.
+ * Input parameters: None
+ * Returns: uint32_t - Framing error count
+ ************************************************************/
+uint32_t serial_get_rx_framing_errors()
+{
+    return rx_framing_errors;
+}
+
+/************************************************************
+ * Function: serial_get_rx_parity_errors
+ * Description: Returns the number of RX interrupts that found
+ *              a byte received with a bad parity bit.
+ * Input parameters: None
+ * Returns: uint32_t - Parity error count
+ ************************************************************/
+uint32_t serial_get_rx_parity_errors()
+{
+    return rx_parity_errors;
+}
+
+/************************************************************
+ * Function: serial_set_rx_task_event
+ * Description: Sets a task event to signal whenever received
+ *              bytes are added to the receive ring buffer.
+ * Input parameters:
+ *      - event: Event to signal, 0 for none
+ * Returns: None
+ ************************************************************/
+void serial_set_rx_task_event(task_event_t *event)
+{
+    rx_event = event;
+}
+
+/************************************************************
+ * Function: serial_isr
+ * Description: UART1 ISR. Empties the RX FIFO into the receive
+ *              ring buffer, then refills the TX FIFO from the
+ *              transmit ring buffer if TX empty is unmasked,
+ *              masking it once there is nothing left to send.
+ * Input parameters:
+ *      - context: Unused irq_register context
+ * Returns: None
+ ************************************************************/
+void serial_isr(void *context)
+{
+    PROFILE_SCOPE(PROFILE_SERIAL_ISR);
+
+    uint32_t status = mmio_read(UART1_INTERRUPT_STAT_ADDR);
+
+    if(status & UART_RX_INTERRUPTS)
+    {
+        serial_rx_drain();
+    }
+
+    // TX empty is masked while serial_tx_kick drains the ring itself
+    if(mmio_read(UART1_INTERRUPT_MASK_ADDR) & UART_TX_EMPTY_BIT)
+    {
+        serial_tx_drain();
+
+        if(tx_head == tx_tail)
+        {
+            mmio_write(UART1_INTERRUPT_DIS_ADDR, UART_TX_EMPTY_BIT);
+        }
+    }
+}
+
+/************************************************************
+ * Function: serial_tx_drain
+ * Description: Moves bytes from the ring buffer into the TX
+ *              FIFO until the FIFO is full or the buffer is
+ *              empty. Callers outside the ISR must mask the TX
+ *              empty interrupt first.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+static void serial_tx_drain()
+{
+    uint32_t tail = tx_tail;
+
+    // Clearing TX empty event so the FIFO running dry again raises it
+    mmio_write(UART1_INTERRUPT_STAT_ADDR, UART_TX_EMPTY_BIT);
+
+    while(tail != tx_head && !(mmio_read(UART1_CHANNEL_STAT_ADDR) & UART_TX_FULL_BIT))
+    {
+        mmio_write(UART1_TRX_FIFO_ADDR, tx_buffer[tail & (SERIAL_TX_BUFFER_SIZE - 1)]);
+        tail++;
+    }
+
+    tx_tail = tail;
+}
+
+/************************************************************
+ * Function: serial_tx_kick
+ * Description: Starts transmission of queued bytes by priming
+ *              the TX FIFO directly, then leaves the TX empty
+ *              interrupt unmasked if anything is still queued.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+static void serial_tx_kick()
+{
+    mmio_write(UART1_INTERRUPT_DIS_ADDR, UART_TX_EMPTY_BIT);
+
+    serial_tx_drain();
+
+    if(tx_head != tx_tail)
+    {
+        mmio_write(UART1_INTERRUPT_EN_ADDR, UART_TX_EMPTY_BIT);
+    }
+}
+
+/************************************************************
+ * Function: serial_tx_enqueue
+ * Description: Copies one character into the transmit ring
+ *              buffer, applying the overflow policy if full.
+ * Input parameters: 
+ *      - c: Character to queue
+ * Returns: None
+ ************************************************************/
+static void serial_tx_enqueue(char c)
+{
+    uint32_t head = tx_head;
+
+    if(head - tx_tail >= SERIAL_TX_BUFFER_SIZE)
+    {
+        switch(tx_policy)
+        {
+            case SERIAL_TX_DROP:
+            tx_dropped++;
+            return;
+
+            case SERIAL_TX_BLOCK:
+            while(head - tx_tail >= SERIAL_TX_BUFFER_SIZE)
+            {
+                serial_tx_kick();
+            }
+            break;
+
+            case SERIAL_TX_OVERWRITE:
+            // The drain owns tx_tail, so it is masked while the oldest byte is discarded
+            mmio_write(UART1_INTERRUPT_DIS_ADDR, UART_TX_EMPTY_BIT);
+            if(head - tx_tail >= SERIAL_TX_BUFFER_SIZE)
             {
-                msleep(10);
-                buffer_empyt = *(uint32_t*)UART1_INTERRUPT_STAT_ADDR & 0b1000;
+                tx_tail++;
+                tx_dropped++;
             }
+            break;
         }
-            
-        // Write next element in char array to fifo buffer and increment to next element
-        *((uint32_t*)UART1_TRX_FIFO_ADDR) = *string_iter;
-        string_iter++;
     }
-}
\ No newline at end of file
+
+    tx_buffer[head & (SERIAL_TX_BUFFER_SIZE - 1)] = c;
+    tx_head = head + 1;
+
+    if(tx_head - tx_tail > tx_high_water)
+    {
+        tx_high_water = tx_head - tx_tail;
+    }
+}
+
+/************************************************************
+ * Function: serial_rx_drain
+ * Description: Moves every byte in the RX FIFO into the receive
+ *              ring buffer, counting bytes that do not fit and
+ *              the errors the UART flagged, and signals the RX
+ *              task event if any arrived.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+static void serial_rx_drain()
+{
+    uint32_t head = rx_head;
+    uint32_t start = head;
+
+    // Clearing the RX events first so bytes arriving during the drain raise them again
+    uint32_t status = mmio_read(UART1_INTERRUPT_STAT_ADDR) & UART_RX_INTERRUPTS;
+    mmio_write(UART1_INTERRUPT_STAT_ADDR, status);
+
+    if(status & UART_RX_ERRORS)
+    {
+        rx_overruns += (status & UART_RX_OVERFLOW_INT) != 0;
+        rx_framing_errors += (status & UART_RX_FRAMING_INT) != 0;
+        rx_parity_errors += (status & UART_RX_PARITY_INT) != 0;
+    }
+
+    while(!(mmio_read(UART1_CHANNEL_STAT_ADDR) & UART_RX_EMPTY_BIT))
+    {
+        uint8_t byte = mmio_read(UART1_TRX_FIFO_ADDR);
+
+        if(head - rx_tail >= SERIAL_RX_BUFFER_SIZE)
+        {
+            rx_dropped++;
+            continue;
+        }
+
+        rx_buffer[head & (SERIAL_RX_BUFFER_SIZE - 1)] = byte;
+        head++;
+    }
+
+    rx_head = head;
+
+    if(status & UART_RX_TIMEOUT_INT)
+    {
+        mmio_write(UART1_CTRL_ADDR, UART_CTRL_ENABLE | UART_CTRL_RESTART_TIMEOUT);
+    }
+
+    if(head != start && rx_event)
+    {
+        task_event_signal(rx_event);
+    }
+}
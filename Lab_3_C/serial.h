@@ -3,9 +3,12 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include <stdio.h>
 #include <stdarg.h>
 #include <sleep.h>
+#include "format.h"
+#include "interrupt.h"
+#include "task.h"
+#include "mmio.h"
 
 #define UART1_CTRL_ADDR 0xE0001000
 #define UART1_MODE_ADDR 0xE0001004
@@ -13,7 +16,35 @@
 #define UART1_BAUDRATE_D_ADDR 0xE0001034
 #define UART1_TRX_FIFO_ADDR 0xE0001030
 #define UART1_INTERRUPT_EN_ADDR 0xE0001008
+#define UART1_INTERRUPT_DIS_ADDR 0xE000100C
 #define UART1_INTERRUPT_STAT_ADDR 0xE0001014
+#define UART1_CHANNEL_STAT_ADDR 0xE000102C
+#define UART1_INTERRUPT_MASK_ADDR 0xE0001010
+#define UART1_RX_TIMEOUT_ADDR 0xE000101C
+#define UART1_RX_TRIGGER_ADDR 0xE0001020
+
+#define UART_TX_EMPTY_BIT 0b1000
+#define UART_TX_FULL_BIT 0b10000
+#define UART_RX_EMPTY_BIT 0b10
+#define UART_TX_ACTIVE_BIT 0b100000000000   // Channel status only: a byte is still being shifted out
+
+// Interrupt status/enable bits, the TX ones match the channel status bits
+#define UART_RX_TRIGGER_INT 0b1
+#define UART_RX_OVERFLOW_INT 0b100000
+#define UART_RX_FRAMING_INT 0b1000000
+#define UART_RX_PARITY_INT 0b10000000
+#define UART_RX_TIMEOUT_INT 0b100000000
+#define UART_RX_ERRORS (UART_RX_OVERFLOW_INT | UART_RX_FRAMING_INT | UART_RX_PARITY_INT)
+#define UART_RX_INTERRUPTS (UART_RX_TRIGGER_INT | UART_RX_TIMEOUT_INT | UART_RX_ERRORS)
+
+#define UART_CTRL_ENABLE 0b10100        // TX and RX enabled
+#define UART_CTRL_DISABLE 0b101000      // TX and RX disabled, for changing the baud rate
+#define UART_CTRL_RESTART_TIMEOUT 0b1000000
+
+// The RX interrupt fires once the 64 byte FIFO holds UART_RX_TRIGGER_LEVEL
+// bytes, or when the line has been idle for UART_RX_TIMEOUT * 4 bit times
+#define UART_RX_TRIGGER_LEVEL 32
+#define UART_RX_TIMEOUT 10
 
 #define UART_STOP_BIT_1 0
 
@@ -21,12 +52,78 @@
 
 #define UART_PARITY_NONE 0b100
 
-#define UART_BAUDRATE_9600 (uint32_t[]){0x7C, 83}
-#define UART_BAUDRATE_115200 (uint32_t[]){0x7C, 6}
+// Baud rate = UART_REF_CLOCK_HZ / (CD * (BDIV + 1)), see serial_compute_baud
+#define UART_REF_CLOCK_HZ 100000000
+#define UART_CD_MAX 65535
+#define UART_BDIV_MIN 4
+#define UART_BDIV_MAX 254
+
+// Largest difference from the requested rate serial_compute_baud accepts.
+// Both ends together must stay within about 5% over a 10 bit frame.
+#define UART_BAUD_MAX_ERROR_PPM 20000
+
+#define UART_BAUDRATE_9600 9600
+#define UART_BAUDRATE_115200 115200
+#define UART_BAUDRATE_921600 921600
+#define UART_BAUDRATE_1000000 1000000
+#define UART_BAUDRATE_2000000 2000000
+#define UART_BAUDRATE_3125000 3125000
 
 #define UART_TIMEOUT_MILLIS 100
 
-void serial_init(uint32_t stop_bit, uint32_t data_bits, uint32_t parity, uint32_t baudrate[]);
+// Ahead of the timer wheel, so output is never held up by it when nesting
+#define UART1_INTERRUPT_PRIORITY 0x90
+
+// Size of the RAM transmit ring buffer, must be a power of 2
+#define SERIAL_TX_BUFFER_SIZE 1024
+
+// Size of the RAM receive ring buffer, must be a power of 2
+#define SERIAL_RX_BUFFER_SIZE 1024
+
+// Divisors for a baud rate and how close they come
+typedef struct
+{
+    uint32_t cd;                // Baud rate generator, UART1_BAUDGEN_ADDR
+    uint32_t bdiv;              // Baud rate divider, UART1_BAUDRATE_D_ADDR
+    uint32_t actual;            // Rate the divisors give, rounded
+    int32_t error_ppm;          // (actual - requested) / requested, parts per million
+} serial_baud_t;
+
+// What serial_print does when the transmit ring buffer is full
+typedef enum
+{
+    SERIAL_TX_DROP,         // Discard the new byte
+    SERIAL_TX_BLOCK,        // Wait for the UART to make room
+    SERIAL_TX_OVERWRITE     // Discard the oldest queued byte
+} serial_tx_policy_t;
+
+// What serial_readline found
+typedef enum
+{
+    SERIAL_LINE_NONE,       // No complete line yet
+    SERIAL_LINE_READY,      // A line was copied
+    SERIAL_LINE_TOO_LONG    // A line too long for the buffer ended, it was dropped
+} serial_line_t;
+
+bool serial_init(uint32_t stop_bit, uint32_t data_bits, uint32_t parity, uint32_t baudrate);
+bool serial_compute_baud(uint32_t baudrate, serial_baud_t *baud);
+bool serial_set_baudrate(uint32_t baudrate);
+const serial_baud_t *serial_get_baud();
 void serial_print(char c_string[], ...);
+void serial_flush();
+void serial_set_tx_policy(serial_tx_policy_t policy);
+uint32_t serial_get_tx_dropped();
+uint32_t serial_get_tx_high_water();
+void serial_write(const uint8_t *data, uint32_t length);
+uint32_t serial_read(uint8_t *buffer, uint32_t length);
+serial_line_t serial_readline(char *line, uint32_t size);
+bool serial_peek(uint8_t *byte);
+uint32_t serial_rx_available();
+uint32_t serial_get_rx_dropped();
+uint32_t serial_get_rx_overruns();
+uint32_t serial_get_rx_framing_errors();
+uint32_t serial_get_rx_parity_errors();
+void serial_set_rx_task_event(task_event_t *event);
+void serial_isr(void *context);
 
 #endif // SERIAL_H
\ No newline at end of file
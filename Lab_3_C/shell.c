@@ -0,0 +1,239 @@
+#include "shell.h"
+#include <string.h>
+#include "serial.h"
+
+static const shell_command_t *shell_commands = 0;
+static uint32_t shell_command_count = 0;
+
+static void shell_help();
+static bool parse_number(const char *text, uint32_t base, uint32_t *value);
+
+/************************************************************
+ * Function: shell_init
+ * Description: Sets the table of commands the shell runs.
+ * Input parameters:
+ *      - commands: Command table, must stay valid
+ *      - count: Number of commands
+ * Returns: None
+ ************************************************************/
+void shell_init(const shell_command_t *commands, uint32_t count)
+{
+    shell_commands = commands;
+    shell_command_count = count;
+}
+
+/************************************************************
+ * Function: shell_execute
+ * Description: Splits a line into words and runs the command
+ *              it names. Empty lines are ignored, and lines of
+ *              more than SHELL_MAX_ARGS words are refused. The
+ *              line is modified.
+ * Input parameters:
+ *      - line: NUL terminated command line
+ * Returns: None
+ ************************************************************/
+void shell_execute(char *line)
+{
+    char *argv[SHELL_MAX_ARGS];
+    uint32_t argc = 0;
+
+    while(*line)
+    {
+        while(*line == ' ' || *line == '\t')
+        {
+            *line++ = '\0';
+        }
+
+        if(!*line)
+        {
+            break;
+        }
+
+        if(argc == SHELL_MAX_ARGS)
+        {
+            serial_print("too many arguments, at most %u\n", SHELL_MAX_ARGS - 1);
+            return;
+        }
+
+        argv[argc++] = line;
+
+        while(*line && *line != ' ' && *line != '\t')
+        {
+            line++;
+        }
+    }
+
+    if(!argc)
+    {
+        return;
+    }
+
+    if(!strcmp(argv[0], "help"))
+    {
+        shell_help();
+        return;
+    }
+
+    for(uint32_t i = 0; i < shell_command_count; i++)
+    {
+        const shell_command_t *command = &shell_commands[i];
+
+        if(strcmp(argv[0], command->name))
+        {
+            continue;
+        }
+
+        if(argc - 1 < command->min_args)
+        {
+            serial_print("usage: %s %s\n", command->name, command->usage);
+            return;
+        }
+
+        command->handler(argc, argv);
+        return;
+    }
+
+    serial_print("unknown command '%s', try help\n", argv[0]);
+}
+
+/************************************************************
+ * Function: shell_prompt
+ * Description: Prints the prompt.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void shell_prompt()
+{
+    serial_print(SHELL_PROMPT);
+}
+
+/************************************************************
+ * Function: shell_parse_number
+ * Description: Reads a command argument as a number: hex, as
+ *              the keypad takes it, with an optional 0x prefix,
+ *              or decimal after a #. A leading - negates it.
+ * Input parameters:
+ *      - text: Argument
+ *      - value: Output, the number
+ * Returns: bool - false if the argument is not a number or
+ *          does not fit in 32 bits
+ ************************************************************/
+bool shell_parse_number(const char *text, uint32_t *value)
+{
+    return parse_number(text, 16, value);
+}
+
+/************************************************************
+ * Function: shell_parse_decimal
+ * Description: Reads a command argument that is naturally
+ *              decimal, such as a baud rate. The prefixes of
+ *              shell_parse_number still select a base.
+ * Input parameters:
+ *      - text: Argument
+ *      - value: Output, the number
+ * Returns: bool - false if the argument is not a number or
+ *          does not fit in 32 bits
+ ************************************************************/
+bool shell_parse_decimal(const char *text, uint32_t *value)
+{
+    return parse_number(text, 10, value);
+}
+
+/************************************************************
+ * Function: parse_number
+ * Description: Reads a number with an optional -, then # for
+ *              decimal or 0x for hex, else the default base.
+ *              Numbers past 32 bits, or below -2^31, are
+ *              refused rather than wrapped.
+ * Input parameters:
+ *      - text: Argument
+ *      - base: Base without a prefix, 10 or 16
+ *      - value: Output, the number
+ * Returns: bool - false if the argument is not a number or
+ *          does not fit in 32 bits
+ ************************************************************/
+static bool parse_number(const char *text, uint32_t base, uint32_t *value)
+{
+    bool negative = false;
+    uint32_t result = 0;
+
+    if(*text == '-')
+    {
+        negative = true;
+        text++;
+    }
+
+    if(*text == '#')
+    {
+        base = 10;
+        text++;
+    }
+    else if(text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+    {
+        base = 16;
+        text += 2;
+    }
+
+    if(!*text)
+    {
+        return false;
+    }
+
+    for(; *text; text++)
+    {
+        uint32_t digit;
+
+        if(*text >= '0' && *text <= '9')
+        {
+            digit = *text - '0';
+        }
+        else if(*text >= 'a' && *text <= 'f')
+        {
+            digit = *text - 'a' + 10;
+        }
+        else if(*text >= 'A' && *text <= 'F')
+        {
+            digit = *text - 'A' + 10;
+        }
+        else
+        {
+            return false;
+        }
+
+        if(digit >= base)
+        {
+            return false;
+        }
+
+        if(result > (UINT32_MAX - digit) / base)
+        {
+            return false;
+        }
+
+        result = result * base + digit;
+    }
+
+    if(negative && result > 0x80000000)
+    {
+        return false;
+    }
+
+    *value = negative ? -result : result;
+    return true;
+}
+
+/************************************************************
+ * Function: shell_help
+ * Description: Lists the commands.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+static void shell_help()
+{
+    for(uint32_t i = 0; i < shell_command_count; i++)
+    {
+        const shell_command_t *command = &shell_commands[i];
+
+        serial_print("%-8s %-20s %s\n", command->name, command->usage, command->help);
+    }
+}
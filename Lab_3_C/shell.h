@@ -0,0 +1,35 @@
+#ifndef SHELL_H
+#define SHELL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Line-oriented command shell. The firmware gives shell_init a table of
+// commands; shell_execute splits a line at spaces and runs the command
+// named by the first word with the rest as arguments. "help" is built in
+// and lists the table. The shell does not echo, so set the terminal to
+// local echo when typing by hand.
+
+#define SHELL_LINE_SIZE 128
+#define SHELL_MAX_ARGS 16
+
+#define SHELL_PROMPT "> "
+
+typedef void (*shell_handler_t)(uint32_t argc, char *argv[]);
+
+typedef struct
+{
+    const char *name;
+    const char *usage;          // Arguments, shown by help
+    const char *help;
+    uint32_t min_args;          // Not counting the command name
+    shell_handler_t handler;
+} shell_command_t;
+
+void shell_init(const shell_command_t *commands, uint32_t count);
+void shell_execute(char *line);
+void shell_prompt();
+bool shell_parse_number(const char *text, uint32_t *value);
+bool shell_parse_decimal(const char *text, uint32_t *value);
+
+#endif // SHELL_H
@@ -1,5 +1,6 @@
 #include "switches.h"
 #include "led.h"
+#include "input.h"
 
 /*************************************************************
  * Function: uint32_t get_switches()                         *   
@@ -17,7 +18,7 @@
 
 uint32_t get_switches()
 {
-    return *((uint32_t*)SWITCH_BASEADDR) & 0xFFF;
+    return mmio_read(SWITCH_BASEADDR) & 0xFFF;
 }
 
 /*************************************************************
@@ -36,7 +37,7 @@ uint32_t get_switches()
 
 uint32_t get_buttons()
 {
-    return *((uint32_t*)BUTTON_BASEADDR) & 0xF;
+    return mmio_read(BUTTON_BASEADDR) & 0xF;
 }
 
 /*************************************************************
@@ -55,32 +56,9 @@ uint32_t get_buttons()
 
 int32_t wait_for_next_button(uint32_t timeout_millis)
 {
-
-    for(uint32_t i = 0; i < (timeout_millis * 10); i++)
-    {
-        uint32_t buttons = get_buttons();        
-
-        switch(buttons)
-        {
-            case 0b0001:
-                return 0;
-            
-            case 0b0010:
-                return 1;
-            
-            case 0b0100:
-                return 2;
-
-            case 0b1000:
-                return 3;
-        }
-
-        usleep(100);
-        
-    }
-
-    return -1;
-
+        // Sleeping on the debounced event queue (input_init must have been
+        // called) instead of sampling the buttons every 100 us
+    return input_wait_for_button(0b1111, timeout_millis);
 }
 
     //Reads slide switches 0-11 and displays value on LEDs 0-11 for 10 seconds
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <sleep.h>
+#include "mmio.h"
 
 
 #define BUTTON_BASEADDR 0x41200000
@@ -0,0 +1,293 @@
+#include "task.h"
+#include "serial.h"
+
+// Ready queue, run in the order tasks became ready
+static task_t *ready_head = 0;
+static task_t *ready_tail = 0;
+
+static task_t *all_tasks = 0;
+static uint64_t idle_time = 0;
+static uint64_t scheduler_start = 0;
+
+static void make_ready(task_t *task);
+static void task_timer_expired(void *context);
+
+/************************************************************
+ * Function: task_init
+ * Description: Sets up a task that has not started. The task
+ *              function is called with the task, and finds its
+ *              state through task->context.
+ * Input parameters:
+ *      - task: Task to set up, must stay allocated
+ *      - name: Name for task_print_stats
+ *      - function: Task body, see task.h
+ *      - context: Task state, for the function's use
+ * Returns: None
+ ************************************************************/
+void task_init(task_t *task, const char *name, task_function_t function, void *context)
+{
+    task->name = name;
+    task->function = function;
+    task->context = context;
+    task->resume_line = 0;
+    task->state = TASK_STATE_BLOCKED;
+    task->next = 0;
+    task->signals_seen = 0;
+    task->ready_time = 0;
+    task->runs = 0;
+    task->run_time = 0;
+    task->max_run_time = 0;
+    task->max_latency = 0;
+
+    sw_timer_init(&task->timer, task_timer_expired, task);
+
+    task->all_next = all_tasks;
+    all_tasks = task;
+}
+
+/************************************************************
+ * Function: task_start
+ * Description: Puts a task on the ready queue. It first runs
+ *              once task_run is called.
+ * Input parameters:
+ *      - task: Task from task_init
+ * Returns: None
+ ************************************************************/
+void task_start(task_t *task)
+{
+    uint32_t state = save_and_disable_interrupts();
+
+    make_ready(task);
+
+    restore_interrupts(state);
+}
+
+/************************************************************
+ * Function: task_run
+ * Description: Runs ready tasks one at a time, in the order they
+ *              became ready, sleeping the core while none are.
+ *              Never returns.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void task_run()
+{
+    scheduler_start = get_micros();
+
+    while(1)
+    {
+        uint32_t state = save_and_disable_interrupts();
+        task_t *task = ready_head;
+
+        if(!task)
+        {
+            // With IRQs masked a pending interrupt still ends the wait, so none is missed
+            uint64_t idle_start = get_micros();
+
+            wait_for_interrupt();
+            idle_time += get_micros() - idle_start;
+
+            restore_interrupts(state);
+            continue;
+        }
+
+        ready_head = task->next;
+
+        if(!ready_head)
+        {
+            ready_tail = 0;
+        }
+
+        task->state = TASK_STATE_RUNNING;
+        restore_interrupts(state);
+
+        uint32_t start = get_micros();
+        uint32_t latency = start - task->ready_time;
+        task_status_t status = task->function(task);
+        uint32_t run_time = (uint32_t)get_micros() - start;
+
+        task->runs++;
+        task->run_time += run_time;
+
+        if(run_time > task->max_run_time)
+        {
+            task->max_run_time = run_time;
+        }
+
+        if(latency > task->max_latency)
+        {
+            task->max_latency = latency;
+        }
+
+        state = save_and_disable_interrupts();
+
+        if(status == TASK_DONE)
+        {
+            task->state = TASK_STATE_DONE;
+        }
+        else if(status == TASK_YIELDED)
+        {
+            make_ready(task);
+        }
+        else if(task->state == TASK_STATE_RUNNING)
+        {
+            // Still running means no timer or event has woken it yet
+            task->state = TASK_STATE_BLOCKED;
+        }
+
+        restore_interrupts(state);
+    }
+}
+
+/************************************************************
+ * Function: task_sleep
+ * Description: Arms the task's timer to make it ready again
+ *              after a delay. Use the TASK_SLEEP macro.
+ * Input parameters:
+ *      - task: Running task
+ *      - us: Microseconds to sleep
+ * Returns: None
+ ************************************************************/
+void task_sleep(task_t *task, uint32_t us)
+{
+    sw_timer_start(&task->timer, us, 0);
+}
+
+/************************************************************
+ * Function: task_wait
+ * Description: Adds the task to an event's wait list, unless
+ *              the event was signalled after the task last
+ *              read its count. Use the TASK_WAIT macros.
+ * Input parameters:
+ *      - task: Running task, signals_seen set
+ *      - event: Event to wait for
+ * Returns: bool - true if the task is waiting, false if it was
+ *          signalled already and should check again
+ ************************************************************/
+bool task_wait(task_t *task, task_event_t *event)
+{
+    uint32_t state = save_and_disable_interrupts();
+    bool waiting = event->signals == task->signals_seen;
+
+    if(waiting)
+    {
+        task->next = event->waiters;
+        event->waiters = task;
+    }
+
+    restore_interrupts(state);
+
+    return waiting;
+}
+
+/************************************************************
+ * Function: task_event_init
+ * Description: Sets up an event with no waiters.
+ * Input parameters:
+ *      - event: Event to set up
+ * Returns: None
+ ************************************************************/
+void task_event_init(task_event_t *event)
+{
+    event->signals = 0;
+    event->waiters = 0;
+}
+
+/************************************************************
+ * Function: task_event_signal
+ * Description: Makes every task waiting on an event ready. Safe
+ *              from an ISR.
+ * Input parameters:
+ *      - event: Event to signal
+ * Returns: None
+ ************************************************************/
+void task_event_signal(task_event_t *event)
+{
+    uint32_t state = save_and_disable_interrupts();
+    task_t *task = event->waiters;
+
+    event->signals++;
+    event->waiters = 0;
+
+    while(task)
+    {
+        task_t *next = task->next;
+        make_ready(task);
+        task = next;
+    }
+
+    restore_interrupts(state);
+}
+
+/************************************************************
+ * Function: task_print_stats
+ * Description: Prints each task's run count, CPU time, longest
+ *              run and worst latency from ready to running,
+ *              then the time the core spent asleep.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void task_print_stats()
+{
+    uint64_t elapsed = get_micros() - scheduler_start;
+
+    serial_print("%-12s %8s %10s %10s %10s\n", "task", "runs", "cpu ms", "max us", "latency us");
+
+    for(task_t *task = all_tasks; task; task = task->all_next)
+    {
+        serial_print("%-12s %8u %10u %10u %10u\n", task->name, task->runs, (uint32_t)(task->run_time / 1000),
+                     task->max_run_time, task->max_latency);
+    }
+
+    if(elapsed)
+    {
+        serial_print("idle %u%%\n", (uint32_t)(idle_time * 100 / elapsed));
+    }
+}
+
+/************************************************************
+ * Function: make_ready
+ * Description: Queues a task to run unless it is queued or
+ *              done. Interrupts must be masked.
+ * Input parameters:
+ *      - task: Task to queue
+ * Returns: None
+ ************************************************************/
+static void make_ready(task_t *task)
+{
+    if(task->state == TASK_STATE_READY || task->state == TASK_STATE_DONE)
+    {
+        return;
+    }
+
+    task->state = TASK_STATE_READY;
+    task->ready_time = get_micros();
+    task->next = 0;
+
+    if(ready_tail)
+    {
+        ready_tail->next = task;
+    }
+    else
+    {
+        ready_head = task;
+    }
+
+    ready_tail = task;
+}
+
+/************************************************************
+ * Function: task_timer_expired
+ * Description: Timer callback ending a TASK_SLEEP.
+ * Input parameters:
+ *      - context: The sleeping task
+ * Returns: None
+ ************************************************************/
+static void task_timer_expired(void *context)
+{
+    uint32_t state = save_and_disable_interrupts();
+
+    make_ready((task_t*)context);
+
+    restore_interrupts(state);
+}
@@ -0,0 +1,128 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "timers.h"
+#include "interrupt.h"
+
+// Cooperative stackless tasks (protothreads). A task is a function that
+// is called again from the top each time it is scheduled and jumps back
+// to where it last blocked, so:
+//   - locals do not survive a TASK_* wait, keep state in the context
+//   - only one TASK_* macro per source line
+//   - the TASK_* macros cannot be used inside a switch statement
+//
+// task_status_t my_task(task_t *task)
+// {
+//     TASK_BEGIN(task);
+//     while(1)
+//     {
+//         TASK_WAIT_UNTIL(task, &user_input, hexpad_poll(&ctx->event));
+//         TASK_SLEEP(task, 1000);
+//     }
+//     TASK_END(task);
+// }
+
+typedef enum
+{
+    TASK_YIELDED,           // Run again after the other ready tasks
+    TASK_WAITING,           // Blocked on a timer or event
+    TASK_DONE               // Finished, never run again
+} task_status_t;
+
+typedef enum
+{
+    TASK_STATE_READY,
+    TASK_STATE_RUNNING,
+    TASK_STATE_BLOCKED,
+    TASK_STATE_DONE
+} task_state_t;
+
+typedef struct task task_t;
+typedef task_status_t (*task_function_t)(task_t *task);
+
+// Something tasks can wait for, signalled from task or ISR code
+typedef struct
+{
+    volatile uint32_t signals;      // Times signalled
+    task_t *waiters;
+} task_event_t;
+
+struct task
+{
+    const char *name;
+    task_function_t function;
+    void *context;
+    uint32_t resume_line;           // Where the task blocked, 0 to start
+    volatile task_state_t state;
+    task_t *next;                   // Ready queue or event wait list
+    task_t *all_next;               // Every initialised task, for task_print_stats
+    sw_timer_t timer;               // Wakes the task from TASK_SLEEP
+    uint32_t signals_seen;          // Event count when the task last checked
+
+    // Statistics, in microseconds
+    uint32_t ready_time;            // get_micros() when last made ready
+    uint32_t runs;
+    uint64_t run_time;
+    uint32_t max_run_time;
+    uint32_t max_latency;           // Longest wait from ready to running
+};
+
+#define TASK_BEGIN(task) switch((task)->resume_line) { case 0:
+
+#define TASK_END(task) } (task)->resume_line = 0; return TASK_DONE
+
+// Lets the other ready tasks run first
+#define TASK_YIELD(task) \
+    do \
+    { \
+        (task)->resume_line = __LINE__; \
+        return TASK_YIELDED; \
+        case __LINE__:; \
+    } while(0)
+
+// Sleeps for at least us microseconds without holding the CPU
+#define TASK_SLEEP(task, us) \
+    do \
+    { \
+        task_sleep(task, us); \
+        (task)->resume_line = __LINE__; \
+        return TASK_WAITING; \
+        case __LINE__:; \
+    } while(0)
+
+// Waits for the next signal of an event
+#define TASK_WAIT(task, event) \
+    do \
+    { \
+        (task)->signals_seen = (event)->signals; \
+        (task)->resume_line = __LINE__; \
+        return task_wait(task, event) ? TASK_WAITING : TASK_YIELDED; \
+        case __LINE__:; \
+    } while(0)
+
+// Waits until condition is true, checking it again each time event is
+// signalled. A signal between the check and the wait is not lost.
+#define TASK_WAIT_UNTIL(task, event, condition) \
+    do \
+    { \
+        (task)->resume_line = __LINE__; \
+        case __LINE__: \
+        (task)->signals_seen = (event)->signals; \
+        if(!(condition)) \
+        { \
+            return task_wait(task, event) ? TASK_WAITING : TASK_YIELDED; \
+        } \
+    } while(0)
+
+void task_init(task_t *task, const char *name, task_function_t function, void *context);
+void task_start(task_t *task);
+void task_run();
+void task_sleep(task_t *task, uint32_t us);
+bool task_wait(task_t *task, task_event_t *event);
+void task_event_init(task_event_t *event);
+void task_event_signal(task_event_t *event);
+void task_print_stats();
+
+#endif // TASK_H
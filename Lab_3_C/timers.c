@@ -0,0 +1,533 @@
+#include "timers.h"
+#include "profile.h"
+
+// Slot list heads, circular through the links of the timers in the slot
+static timer_link_t wheel_slots[SW_TIMER_LEVELS][SW_TIMER_SLOTS];
+static uint32_t wheel_bitmaps[SW_TIMER_LEVELS];     // Bit set for each slot holding timers
+static uint64_t wheel_now = 0;                      // Last microsecond the wheel was advanced to
+static bool wheel_started = false;
+
+static void wheel_start();
+static void wheel_resync();
+static void wheel_insert(sw_timer_t *timer);
+static void wheel_remove(sw_timer_t *timer);
+static void wheel_cascade(uint32_t level);
+static uint64_t wheel_next_event();
+static void wheel_arm();
+static void timer_wheel_isr(void *context);
+static uint64_t divide_by_1000(uint64_t value);
+static uint64_t divide_by_3(uint64_t value);
+static uint64_t multiply_high(uint64_t a, uint64_t b);
+
+/************************************************************
+ * Function: read_global_timer
+ * Description: Reads the full 64-bit global timer. The upper
+ *              half is read again after the lower half and the
+ *              read retried if it changed, so a carry between
+ *              the two reads cannot give a torn value.
+ * Input parameters: None
+ * Returns: uint64_t - Global timer ticks
+ ************************************************************/
+uint64_t read_global_timer()
+{
+    uint32_t upper, lower;
+
+    do
+    {
+        upper = mmio_read(GTC_UPPER32_ADDR);
+        lower = mmio_read(GTC_LOWER32_ADDR);
+    } while(upper != mmio_read(GTC_UPPER32_ADDR));
+
+    return ((uint64_t)upper << 32) | lower;
+}
+
+/************************************************************
+ * Function: get_micros
+ * Description: Monotonic microsecond clock from the global
+ *              timer, which never wraps in practice.
+ * Input parameters: None
+ * Returns: uint64_t - Microseconds since the timer started
+ ************************************************************/
+uint64_t get_micros()
+{
+    // 333,333,333 ticks per second is exactly 1000 ticks every 3 us
+    return divide_by_1000(read_global_timer() * 3);
+}
+
+/************************************************************
+ * Function: get_tick_millis
+ * Description: Millisecond clock for timeouts and event
+ *              timestamps. Wraps after 49 days, so compare
+ *              times by subtracting them.
+ * Input parameters: None
+ * Returns: uint32_t - Time in milliseconds
+ ************************************************************/
+uint32_t get_tick_millis()
+{
+    return divide_by_1000(get_micros());
+}
+
+/************************************************************
+ * Function: divide_by_1000
+ * Description: Exact value / 1000 as a multiply by the
+ *              reciprocal and shifts (the sequence a 64-bit
+ *              compiler emits), since a 64-bit divide is a
+ *              slow library call on the Cortex-A9.
+ * Input parameters:
+ *      - value: Dividend
+ * Returns: uint64_t - value / 1000, rounded down
+ ************************************************************/
+static uint64_t divide_by_1000(uint64_t value)
+{
+    // value / 1000 = (value / 8) / 125, and 0x20C49BA5E353F7CF / 2^68 is 1 / 125
+    return multiply_high(value >> 3, 0x20C49BA5E353F7CFull) >> 4;
+}
+
+/************************************************************
+ * Function: divide_by_3
+ * Description: Exact value / 3, like divide_by_1000.
+ * Input parameters:
+ *      - value: Dividend
+ * Returns: uint64_t - value / 3, rounded down
+ ************************************************************/
+static uint64_t divide_by_3(uint64_t value)
+{
+    // 0xAAAAAAAAAAAAAAAB / 2^65 is 1 / 3
+    return multiply_high(value, 0xAAAAAAAAAAAAAAABull) >> 1;
+}
+
+/************************************************************
+ * Function: multiply_high
+ * Description: Upper 64 bits of the 128-bit product, from four
+ *              32x32 multiplies (one UMULL each).
+ * Input parameters:
+ *      - a, b: Factors
+ * Returns: uint64_t - (a * b) >> 64
+ ************************************************************/
+static uint64_t multiply_high(uint64_t a, uint64_t b)
+{
+    uint64_t low = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    uint64_t middle1 = (a >> 32) * (b & 0xFFFFFFFF);
+    uint64_t middle2 = (a & 0xFFFFFFFF) * (b >> 32);
+    uint64_t carry = ((low >> 32) + (middle1 & 0xFFFFFFFF) + (middle2 & 0xFFFFFFFF)) >> 32;
+
+    return (a >> 32) * (b >> 32) + (middle1 >> 32) + (middle2 >> 32) + carry;
+}
+
+/************************************************************
+ * Function: sw_timer_init
+ * Description: Sets up a stopped software timer. Callbacks run
+ *              from the GTC interrupt.
+ * Input parameters:
+ *      - timer: Timer to set up, must stay allocated while it
+ *               is running
+ *      - callback: Function to run when the timer expires
+ *      - context: Passed to the callback
+ * Returns: None
+ ************************************************************/
+void sw_timer_init(sw_timer_t *timer, sw_timer_callback_t callback, void *context)
+{
+    timer->link.next = 0;
+    timer->link.prev = 0;
+    timer->expires = 0;
+    timer->period = 0;
+    timer->callback = callback;
+    timer->context = context;
+}
+
+/************************************************************
+ * Function: sw_timer_start
+ * Description: Starts or restarts a timer. Starting and
+ *              cancelling are O(1); the GTC comparator is set
+ *              to the next deadline, so there is no interrupt
+ *              between deadlines. The wheel is started on first
+ *              use, init_GIC must have been called.
+ * Input parameters:
+ *      - timer: Timer from sw_timer_init
+ *      - delay_us: Microseconds until the first run
+ *      - period_us: Microseconds between later runs, 0 for a
+ *                   one-shot timer
+ * Returns: None
+ ************************************************************/
+void sw_timer_start(sw_timer_t *timer, uint32_t delay_us, uint32_t period_us)
+{
+    uint32_t state = save_and_disable_interrupts();
+
+    wheel_start();
+
+    if(timer->link.next)
+    {
+        wheel_remove(timer);
+    }
+
+    wheel_resync();
+
+    timer->expires = get_micros() + (delay_us ? delay_us : 1);
+    timer->period = period_us;
+
+    wheel_insert(timer);
+    wheel_arm();
+
+    restore_interrupts(state);
+}
+
+/************************************************************
+ * Function: sw_timer_set_period
+ * Description: Changes the period of a timer, taking effect
+ *              after its next run.
+ * Input parameters:
+ *      - timer: Timer from sw_timer_init
+ *      - period_us: Microseconds between runs, 0 to stop after
+ *                   the next run
+ * Returns: None
+ ************************************************************/
+void sw_timer_set_period(sw_timer_t *timer, uint32_t period_us)
+{
+    timer->period = period_us;
+}
+
+/************************************************************
+ * Function: sw_timer_cancel
+ * Description: Stops a timer. Safe on a stopped timer and from
+ *              the timer's own callback. The comparator is left
+ *              alone, a wake-up with nothing due just re-arms.
+ * Input parameters:
+ *      - timer: Timer from sw_timer_init
+ * Returns: None
+ ************************************************************/
+void sw_timer_cancel(sw_timer_t *timer)
+{
+    uint32_t state = save_and_disable_interrupts();
+
+    if(timer->link.next)
+    {
+        wheel_remove(timer);
+    }
+
+    restore_interrupts(state);
+}
+
+/************************************************************
+ * Function: sw_timer_active
+ * Description: Checks whether a timer is waiting to run.
+ * Input parameters:
+ *      - timer: Timer from sw_timer_init
+ * Returns: bool - true if started and not yet expired (a
+ *          periodic timer stays active until cancelled)
+ ************************************************************/
+bool sw_timer_active(const sw_timer_t *timer)
+{
+    return timer->link.next != 0;
+}
+
+/************************************************************
+ * Function: wheel_start
+ * Description: Empties the wheel, makes sure the global timer
+ *              is counting and hooks up the GTC interrupt. Runs
+ *              once.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+static void wheel_start()
+{
+    if(wheel_started)
+    {
+        return;
+    }
+
+    for(uint32_t level = 0; level < SW_TIMER_LEVELS; level++)
+    {
+        for(uint32_t slot = 0; slot < SW_TIMER_SLOTS; slot++)
+        {
+            wheel_slots[level][slot].next = &wheel_slots[level][slot];
+            wheel_slots[level][slot].prev = &wheel_slots[level][slot];
+        }
+
+        wheel_bitmaps[level] = 0;
+    }
+
+    // The BSP normally leaves the global timer running; it is never reset, it is the clock
+    if(!(mmio_read(GTC_CTRL_ADDR) & GTC_TIMER_ENABLE_BIT))
+    {
+        mmio_write(GTC_CTRL_ADDR, GTC_TIMER_ENABLE_BIT);
+    }
+
+    wheel_now = get_micros();
+
+    irq_register(GTC_INTERRUPT_ID, timer_wheel_isr, GTC_INTERRUPT_PRIORITY, INTERRUPT_SENSITIVITY_EDGE, 0);
+
+    wheel_started = true;
+}
+
+/************************************************************
+ * Function: wheel_resync
+ * Description: Moves wheel_now up to the current time when no
+ *              timer is running. Nothing advances an empty
+ *              wheel, so it may be far behind. Interrupts must
+ *              be masked.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+static void wheel_resync()
+{
+    for(uint32_t level = 0; level < SW_TIMER_LEVELS; level++)
+    {
+        if(wheel_bitmaps[level])
+        {
+            return;
+        }
+    }
+
+    wheel_now = get_micros();
+}
+
+/************************************************************
+ * Function: wheel_insert
+ * Description: Links a timer into its slot. The level comes
+ *              from the time left after wheel_now, the slot
+ *              from the matching bits of the expiry, so a timer
+ *              cascades down a level each time its slot comes
+ *              round. Interrupts must be masked.
+ * Input parameters:
+ *      - timer: Timer with expires no earlier than wheel_now
+ * Returns: None
+ ************************************************************/
+static void wheel_insert(sw_timer_t *timer)
+{
+    uint64_t delta = timer->expires - wheel_now;
+    uint64_t position = timer->expires;
+    uint32_t level = 0;
+
+    // Past the top level the timer waits in the furthest slot and is placed again when it cascades
+    if(delta > SW_TIMER_MAX_DELTA)
+    {
+        delta = SW_TIMER_MAX_DELTA;
+        position = wheel_now + delta;
+    }
+
+    while(delta >= SW_TIMER_SLOTS)
+    {
+        delta >>= SW_TIMER_SLOT_BITS;
+        level++;
+    }
+
+    uint32_t slot = (position >> (level * SW_TIMER_SLOT_BITS)) & (SW_TIMER_SLOTS - 1);
+    timer_link_t *head = &wheel_slots[level][slot];
+
+    timer->link.next = head;
+    timer->link.prev = head->prev;
+    head->prev->next = &timer->link;
+    head->prev = &timer->link;
+
+    wheel_bitmaps[level] |= 1u << slot;
+}
+
+/************************************************************
+ * Function: wheel_remove
+ * Description: Unlinks a timer from its slot, clearing the
+ *              slot's bitmap bit if it is left empty.
+ *              Interrupts must be masked.
+ * Input parameters:
+ *      - timer: Linked timer
+ * Returns: None
+ ************************************************************/
+static void wheel_remove(sw_timer_t *timer)
+{
+    timer_link_t *prev = timer->link.prev;
+    timer_link_t *next = timer->link.next;
+
+    prev->next = next;
+    next->prev = prev;
+    timer->link.next = 0;
+
+    // Only the slot head is left when both neighbours are the same link
+    if(prev == next)
+    {
+        uint32_t index = prev - &wheel_slots[0][0];
+        wheel_bitmaps[index / SW_TIMER_SLOTS] &= ~(1u << (index % SW_TIMER_SLOTS));
+    }
+}
+
+/************************************************************
+ * Function: wheel_cascade
+ * Description: Empties the slot of a level that wheel_now has
+ *              just reached and places its timers again, each
+ *              landing on a lower level.
+ * Input parameters:
+ *      - level: Level to cascade, 1 or above
+ * Returns: None
+ ************************************************************/
+static void wheel_cascade(uint32_t level)
+{
+    uint32_t slot = (wheel_now >> (level * SW_TIMER_SLOT_BITS)) & (SW_TIMER_SLOTS - 1);
+    timer_link_t *head = &wheel_slots[level][slot];
+    timer_link_t *link = head->next;
+
+    if(link == head)
+    {
+        return;
+    }
+
+    // Detaching the whole list, then re-inserting one timer at a time
+    head->prev->next = 0;
+    head->next = head;
+    head->prev = head;
+    wheel_bitmaps[level] &= ~(1u << slot);
+
+    while(link)
+    {
+        timer_link_t *next = link->next;
+        wheel_insert((sw_timer_t*)link);
+        link = next;
+    }
+}
+
+/************************************************************
+ * Function: wheel_next_event
+ * Description: Finds the first time after wheel_now the wheel
+ *              has work: a level 0 slot expiring or a higher
+ *              slot due to cascade. One bitmap scan per level.
+ * Input parameters: None
+ * Returns: uint64_t - Microsecond time, UINT64_MAX if no timer
+ *          is running
+ ************************************************************/
+static uint64_t wheel_next_event()
+{
+    uint64_t next = UINT64_MAX;
+
+    for(uint32_t level = 0; level < SW_TIMER_LEVELS; level++)
+    {
+        uint32_t bitmap = wheel_bitmaps[level];
+
+        if(!bitmap)
+        {
+            continue;
+        }
+
+        uint32_t shift = level * SW_TIMER_SLOT_BITS;
+        uint64_t position = wheel_now >> shift;
+        uint32_t start = (position + 1) & (SW_TIMER_SLOTS - 1);
+
+        // Rotating the slot after the current one down to bit 0
+        uint32_t rotated = (bitmap >> start) | (bitmap << ((32 - start) & 31));
+        uint64_t event = (position + 1 + __builtin_ctz(rotated)) << shift;
+
+        if(event < next)
+        {
+            next = event;
+        }
+    }
+
+    return next;
+}
+
+/************************************************************
+ * Function: wheel_arm
+ * Description: Sets the GTC comparator to the next wheel event,
+ *              or turns it off when no timer is running. The
+ *              comparator fires once the counter is at or past
+ *              it, so a deadline already missed fires at once.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+static void wheel_arm()
+{
+    uint64_t next = wheel_next_event();
+
+    // The comparator is turned off while its two halves are written
+    mmio_write(GTC_CTRL_ADDR, GTC_TIMER_ENABLE_BIT);
+
+    if(next == UINT64_MAX)
+    {
+        return;
+    }
+
+    // Rounded up, so get_micros() has reached the event when it fires
+    uint64_t compare = divide_by_3(next * 1000 + 2);
+
+    mmio_write(GTC_COMPARE_LOWER32_ADDR, (uint32_t)compare);
+    mmio_write(GTC_COMPARE_UPPER32_ADDR, compare >> 32);
+    mmio_write(GTC_CTRL_ADDR, GTC_TIMER_ENABLE_BIT | GTC_COMPARE_ENABLE_BIT | GTC_IRQ_ENABLE_BIT);
+}
+
+/************************************************************
+ * Function: timer_wheel_isr
+ * Description: GTC comparator ISR. Steps the wheel from event
+ *              to event up to the current time, cascading slots
+ *              and running expired timers, then re-arms the
+ *              comparator. A periodic timer that fell more than
+ *              a period behind skips the runs it missed.
+ * Input parameters:
+ *      - context: Unused irq_register context
+ * Returns: None
+ ************************************************************/
+static void timer_wheel_isr(void *context)
+{
+    PROFILE_SCOPE(PROFILE_TIMER_WHEEL_ISR);
+
+    uint64_t now = get_micros();
+    uint64_t next;
+
+    // Cleared first, the comparator is re-armed below
+    mmio_write(GTC_ISR_ADDR, 1);
+
+    while((next = wheel_next_event()) <= now)
+    {
+        wheel_now = next;
+
+        // Every level whose slot boundary this is, highest first, so a timer can drop several levels at once
+        uint32_t top = 0;
+
+        while(top + 1 < SW_TIMER_LEVELS && !(wheel_now & ((1ull << ((top + 1) * SW_TIMER_SLOT_BITS)) - 1)))
+        {
+            top++;
+        }
+
+        for(uint32_t level = top; level > 0; level--)
+        {
+            wheel_cascade(level);
+        }
+
+        timer_link_t *head = &wheel_slots[0][wheel_now & (SW_TIMER_SLOTS - 1)];
+
+        while(head->next != head)
+        {
+            sw_timer_t *timer = (sw_timer_t*)head->next;
+
+            wheel_remove(timer);
+
+            // Re-inserted before the callback, which may cancel or restart it
+            if(timer->period)
+            {
+                timer->expires += timer->period;
+
+                if(timer->expires <= now)
+                {
+                    uint64_t behind = now - timer->expires;
+
+                    // Over 71 minutes behind, the old phase is not worth keeping
+                    if(behind > UINT32_MAX)
+                    {
+                        timer->expires = now + timer->period;
+                    }
+                    else
+                    {
+                        timer->expires += ((uint32_t)behind / timer->period + 1) * (uint64_t)timer->period;
+                    }
+                }
+
+                wheel_insert(timer);
+            }
+
+            timer->callback(timer->context);
+        }
+    }
+
+    // A callback that emptied the wheel and started a timer may have resynced it past now
+    if(now > wheel_now)
+    {
+        wheel_now = now;
+    }
+
+    wheel_arm();
+}
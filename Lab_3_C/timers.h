@@ -0,0 +1,59 @@
+#ifndef TIMERS_H
+#define TIMERS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "interrupt.h"
+#include "mmio.h"
+
+#define GTC_LOWER32_ADDR 0xF8F00200
+#define GTC_UPPER32_ADDR 0xF8F00204
+#define GTC_CTRL_ADDR 0xF8F00208
+#define GTC_ISR_ADDR 0xF8F0020C
+#define GTC_COMPARE_LOWER32_ADDR 0xF8F00210
+#define GTC_COMPARE_UPPER32_ADDR 0xF8F00214
+
+#define GTC_TIMER_ENABLE_BIT 0b0001
+#define GTC_COMPARE_ENABLE_BIT 0b0010
+#define GTC_IRQ_ENABLE_BIT 0b0100
+
+// The global timer counts at half the CPU clock, 3 ns per tick
+#define GTC_TICKS_PER_SECOND 333333333
+
+#define GTC_INTERRUPT_PRIORITY 0xA0
+
+// Software timer wheel on the GTC comparator. Timers are kept in
+// SW_TIMER_LEVELS levels of SW_TIMER_SLOTS slots, each level 32 times
+// coarser than the one below, in 1 us ticks.
+#define SW_TIMER_LEVELS 6
+#define SW_TIMER_SLOT_BITS 5
+#define SW_TIMER_SLOTS (1 << SW_TIMER_SLOT_BITS)       // one bit each in a uint32_t slot bitmap
+#define SW_TIMER_MAX_DELTA ((1ull << (SW_TIMER_LEVELS * SW_TIMER_SLOT_BITS)) - 1)
+
+typedef void (*sw_timer_callback_t)(void *context);
+
+typedef struct timer_link
+{
+    struct timer_link *next;
+    struct timer_link *prev;
+} timer_link_t;
+
+typedef struct
+{
+    timer_link_t link;              // Wheel slot list, link.next is 0 while stopped
+    uint64_t expires;               // get_micros() time of the next run
+    uint32_t period;                // Microseconds, 0 for a one-shot timer
+    sw_timer_callback_t callback;
+    void *context;
+} sw_timer_t;
+
+uint64_t read_global_timer();
+uint64_t get_micros();
+uint32_t get_tick_millis();
+void sw_timer_init(sw_timer_t *timer, sw_timer_callback_t callback, void *context);
+void sw_timer_start(sw_timer_t *timer, uint32_t delay_us, uint32_t period_us);
+void sw_timer_set_period(sw_timer_t *timer, uint32_t period_us);
+void sw_timer_cancel(sw_timer_t *timer);
+bool sw_timer_active(const sw_timer_t *timer);
+
+#endif // TIMERS_H
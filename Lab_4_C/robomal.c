@@ -0,0 +1,847 @@
+/*******************************************************************************
+ * Description: Portable reference implementation of the ROBOMAL 16-bit MCU
+ *              emulated by Lab_4/robomal.S. Instruction fetch, decode and
+ *              the process_opcode semantics are reproduced exactly,
+ *              including the 32-bit word read that add, subtract and
+ *              multiply use on ROBO_Data. Board I/O goes through the
+ *              robomal_io_t callbacks so it runs at full speed off the
+ *              board. Multi-byte values are little-endian like the Zynq.
+ *
+ *              Two execution engines share these semantics: robomal_step/
+ *              robomal_run decode every cycle like robomal.S, and
+ *              robomal_run_threaded runs a program pre-decoded once by
+ *              robomal_predecode with one indirect jump per instruction
+ *              (GCC/Clang computed goto). robomal_run_jit in robomal_jit.c
+ *              translates basic blocks to native code.
+ ******************************************************************************/
+
+#include "robomal.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Branch operands are 8-bit byte offsets, so targets reach 128 instructions
+#define BRANCH_REACH (0x100 / 2)
+
+// Handler slots of the threaded run loop, in opcode table order
+enum
+{
+    HANDLER_READ, HANDLER_WRITE, HANDLER_LOAD, HANDLER_STORE,
+    HANDLER_LOAD_INDIRECT, HANDLER_STORE_INDIRECT, HANDLER_LOAD_IMMEDIATE,
+    HANDLER_ADD, HANDLER_SUBTRACT, HANDLER_MULTIPLY,
+    HANDLER_ADD_IMMEDIATE, HANDLER_SUBTRACT_IMMEDIATE, HANDLER_MULTIPLY_IMMEDIATE,
+    HANDLER_BRANCH, HANDLER_BRANCHEQ, HANDLER_BRANCHNE, HANDLER_HALT,
+    HANDLER_BRANCHLT, HANDLER_BRANCHGE, HANDLER_CALL, HANDLER_RETURN,
+    HANDLER_LEFT, HANDLER_RIGHT, HANDLER_FORWARD, HANDLER_BACKWARD, HANDLER_BRAKE,
+    HANDLER_INVALID, HANDLER_END, HANDLER_COUNT
+};
+
+#define GROUPS 5
+#define GROUP_SIZE 8
+
+typedef struct
+{
+    const char *mnemonic;
+    uint8_t isa;                // ROBOMAL_ISA_* that introduced the opcode
+} opcode_info_t;
+
+// Indexed by high nibble then low nibble
+static const opcode_info_t opcodes[GROUPS][GROUP_SIZE] =
+{
+    {{0}},
+    {
+        {"read", ROBOMAL_ISA_BASE}, {"write", ROBOMAL_ISA_BASE}, {"load", ROBOMAL_ISA_BASE},
+        {"store", ROBOMAL_ISA_BASE}, {"loadind", ROBOMAL_ISA_EXTENDED}, {"storeind", ROBOMAL_ISA_EXTENDED},
+        {"loadi", ROBOMAL_ISA_EXTENDED}
+    },
+    {
+        {"add", ROBOMAL_ISA_BASE}, {"subtract", ROBOMAL_ISA_BASE}, {"multiply", ROBOMAL_ISA_BASE},
+        {"addi", ROBOMAL_ISA_EXTENDED}, {"subtracti", ROBOMAL_ISA_EXTENDED}, {"multiplyi", ROBOMAL_ISA_EXTENDED}
+    },
+    {
+        {"branch", ROBOMAL_ISA_BASE}, {"brancheq", ROBOMAL_ISA_BASE}, {"branchne", ROBOMAL_ISA_BASE},
+        {"halt", ROBOMAL_ISA_BASE}, {"branchlt", ROBOMAL_ISA_EXTENDED}, {"branchge", ROBOMAL_ISA_EXTENDED},
+        {"call", ROBOMAL_ISA_EXTENDED}, {"return", ROBOMAL_ISA_EXTENDED}
+    },
+    {
+        {"left", ROBOMAL_ISA_BASE}, {"right", ROBOMAL_ISA_BASE}, {"forward", ROBOMAL_ISA_BASE},
+        {"backward", ROBOMAL_ISA_BASE}, {"brake", ROBOMAL_ISA_BASE}
+    }
+};
+
+/************************************************************
+ * Function: read_halfword
+ * Description: Little-endian halfword read at any byte offset
+ *              (LDRH in robomal.S).
+ ************************************************************/
+static inline uint32_t read_halfword(const uint8_t *memory, uint32_t offset)
+{
+    return memory[offset] | (memory[offset + 1] << 8);
+}
+
+/************************************************************
+ * Function: read_word
+ * Description: Little-endian word read at any byte offset
+ *              (LDR in robomal.S).
+ ************************************************************/
+static inline uint32_t read_word(const uint8_t *memory, uint32_t offset)
+{
+    return read_halfword(memory, offset) | (read_halfword(memory, offset + 2) << 16);
+}
+
+/************************************************************
+ * Function: write_halfword
+ * Description: Little-endian halfword write at any byte offset
+ *              (STRH in robomal.S).
+ ************************************************************/
+static inline void write_halfword(uint8_t *memory, uint32_t offset, uint32_t value)
+{
+    memory[offset] = value & 0xFF;
+    memory[offset + 1] = (value >> 8) & 0xFF;
+}
+
+/************************************************************
+ * Function: robomal_init
+ * Description: Loads a program and its data into a ROBOMAL
+ *              machine and resets it. robo must not hold a
+ *              pre-decoded program (see robomal_release).
+ * Input parameters:
+ *      - robo: Machine to initialize
+ *      - instructions: ROBO_Instructions halfwords (not copied,
+ *                      must outlive robo)
+ *      - instruction_count: Number of halfwords
+ *      - data: ROBO_Data halfwords (copied)
+ *      - data_count: Number of data halfwords
+ *      - io: Board stand-ins, or NULL for none
+ * Returns: None
+ ************************************************************/
+void robomal_init(robomal_t *robo, const uint16_t *instructions, uint32_t instruction_count,
+                  const uint16_t *data, uint32_t data_count, const robomal_io_t *io)
+{
+    memset(robo, 0, sizeof(*robo));
+
+    if(instruction_count > ROBOMAL_MAX_INSTRUCTIONS)
+    {
+        instruction_count = ROBOMAL_MAX_INSTRUCTIONS;
+    }
+
+    if(data_count > ROBOMAL_DATA_SIZE / 2)
+    {
+        data_count = ROBOMAL_DATA_SIZE / 2;
+    }
+
+    robo->instructions = instructions;
+    robo->instruction_count = instruction_count;
+    robo->isa = ROBOMAL_ISA_EXTENDED;
+
+    for(uint32_t i = 0; i < data_count; i++)
+    {
+        write_halfword(robo->initial_data, i * 2, data[i]);
+    }
+
+    if(io)
+    {
+        robo->io = *io;
+    }
+
+    robomal_reset(robo);
+}
+
+/************************************************************
+ * Function: robomal_reset
+ * Description: Clears the register file, restores the initial
+ *              data memory and restarts the program at PC 0.
+ * Input parameters:
+ *      - robo: Machine to reset
+ * Returns: None
+ ************************************************************/
+void robomal_reset(robomal_t *robo)
+{
+    robo->accumulator = 0;
+    robo->pc = 0;
+    robo->instruction = 0;
+    robo->opcode = 0;
+    robo->operand = 0;
+    robo->multiply_high = 0;
+    robo->call_depth = 0;
+    robo->cycles = 0;
+    robo->invalid_opcodes = 0;
+
+    memcpy(robo->data, robo->initial_data, sizeof(robo->data));
+}
+
+/************************************************************
+ * Function: robomal_set_isa
+ * Description: Limits the machine to an ISA version, for
+ *              programs from images of that version. Drops any
+ *              pre-decoded program, which depends on it.
+ * Input parameters:
+ *      - robo: Machine to limit
+ *      - isa: ROBOMAL_ISA_BASE or ROBOMAL_ISA_EXTENDED
+ * Returns: None
+ ************************************************************/
+void robomal_set_isa(robomal_t *robo, uint32_t isa)
+{
+    robomal_release(robo);
+    robo->isa = isa;
+}
+
+/************************************************************
+ * Function: fault
+ * Description: Stops the machine on the instruction just
+ *              fetched, which does not count as executed.
+ * Input parameters:
+ *      - robo: Machine to stop
+ *      - status: Fault to report
+ * Returns: robomal_status_t - status
+ ************************************************************/
+static robomal_status_t fault(robomal_t *robo, robomal_status_t status)
+{
+    robo->pc -= 2;
+    robo->cycles--;
+    return status;
+}
+
+/************************************************************
+ * Function: robomal_step
+ * Description: Simulates one fetch, decode and execute cycle
+ *              (simulateClockCycle without wait_for_button).
+ * Input parameters:
+ *      - robo: Machine to step
+ * Returns: robomal_status_t - RUNNING, HALTED, INVALID_OPCODE,
+ *          PC_OUT_OF_RANGE or a fault
+ ************************************************************/
+robomal_status_t robomal_step(robomal_t *robo)
+{
+    // Fetch
+    if(robo->pc + 2 > robo->instruction_count * 2)
+    {
+        return ROBOMAL_PC_OUT_OF_RANGE;
+    }
+
+    robo->instruction = read_halfword((const uint8_t*)robo->instructions, robo->pc);
+    robo->pc += 2;
+    robo->cycles++;
+
+    // Decode
+    robo->opcode = robo->instruction >> 8;
+    robo->operand = robo->instruction & 0xFF;
+
+    if(!robomal_opcode_allowed(robo, robo->opcode))
+    {
+        robo->invalid_opcodes++;
+        return ROBOMAL_INVALID_OPCODE;
+    }
+
+    // Execute
+    uint8_t *data = robo->data;
+    uint32_t operand = robo->operand;
+    uint32_t address;
+
+    switch(robo->opcode)
+    {
+        case ROBOMAL_READ:
+        write_halfword(data, operand, (robo->io.read_pins ? robo->io.read_pins(robo->io.context) : 0) >> 4);
+        break;
+
+        case ROBOMAL_WRITE:
+        if(robo->io.write_pins) robo->io.write_pins(robo->io.context, read_halfword(data, operand));
+        break;
+
+        case ROBOMAL_LOAD:
+        robo->accumulator = read_halfword(data, operand);
+        break;
+
+        case ROBOMAL_STORE:
+        write_halfword(data, operand, robo->accumulator);
+        break;
+
+        case ROBOMAL_LOAD_INDIRECT:
+        address = read_halfword(data, operand);
+        if(address + 2 > ROBOMAL_DATA_SIZE) return fault(robo, ROBOMAL_DATA_OUT_OF_RANGE);
+        robo->accumulator = read_halfword(data, address);
+        break;
+
+        case ROBOMAL_STORE_INDIRECT:
+        address = read_halfword(data, operand);
+        if(address + 2 > ROBOMAL_DATA_SIZE) return fault(robo, ROBOMAL_DATA_OUT_OF_RANGE);
+        write_halfword(data, address, robo->accumulator);
+        break;
+
+        case ROBOMAL_LOAD_IMMEDIATE:
+        robo->accumulator = operand;
+        break;
+
+        case ROBOMAL_ADD:
+        robo->accumulator += read_word(data, operand);
+        break;
+
+        case ROBOMAL_SUBTRACT:
+        robo->accumulator -= read_word(data, operand);
+        break;
+
+        case ROBOMAL_MULTIPLY:
+        robo->accumulator *= read_word(data, operand);
+        robo->multiply_high = robo->accumulator >> 16;
+        robo->accumulator &= 0xFFFF;
+        break;
+
+        case ROBOMAL_ADD_IMMEDIATE:
+        robo->accumulator += operand;
+        break;
+
+        case ROBOMAL_SUBTRACT_IMMEDIATE:
+        robo->accumulator -= operand;
+        break;
+
+        case ROBOMAL_MULTIPLY_IMMEDIATE:
+        robo->accumulator *= operand;
+        robo->multiply_high = robo->accumulator >> 16;
+        robo->accumulator &= 0xFFFF;
+        break;
+
+        case ROBOMAL_BRANCH:
+        robo->pc = operand;
+        break;
+
+        case ROBOMAL_BRANCHEQ:
+        if(robo->accumulator == 0) robo->pc = operand;
+        break;
+
+        case ROBOMAL_BRANCHNE:
+        if(robo->accumulator != 0) robo->pc = operand;
+        break;
+
+        case ROBOMAL_HALT:
+        return ROBOMAL_HALTED;
+
+        case ROBOMAL_BRANCHLT:
+        if((int32_t)robo->accumulator < 0) robo->pc = operand;
+        break;
+
+        case ROBOMAL_BRANCHGE:
+        if((int32_t)robo->accumulator >= 0) robo->pc = operand;
+        break;
+
+        case ROBOMAL_CALL:
+        if(robo->call_depth == ROBOMAL_CALL_DEPTH) return fault(robo, ROBOMAL_STACK_OVERFLOW);
+        robo->return_stack[robo->call_depth++] = robo->pc;
+        robo->pc = operand;
+        break;
+
+        case ROBOMAL_RETURN:
+        if(!robo->call_depth) return fault(robo, ROBOMAL_STACK_UNDERFLOW);
+        robo->pc = robo->return_stack[--robo->call_depth];
+        break;
+
+        case ROBOMAL_LEFT:
+        case ROBOMAL_RIGHT:
+        case ROBOMAL_FORWARD:
+        case ROBOMAL_BACKWARD:
+        case ROBOMAL_BRAKE:
+        if(robo->io.motion) robo->io.motion(robo->io.context, robo->opcode, robo->operand);
+        break;
+    }
+
+    return ROBOMAL_RUNNING;
+}
+
+/************************************************************
+ * Function: robomal_run
+ * Description: Steps the machine until it halts, runs off the
+ *              end of the program, faults or reaches max_cycles.
+ *              Invalid opcodes are counted and skipped like
+ *              ROBO_Loop.
+ * Input parameters:
+ *      - robo: Machine to run
+ *      - max_cycles: Cycle budget, 0 for no limit
+ * Returns: robomal_status_t - HALTED, PC_OUT_OF_RANGE,
+ *          CYCLE_LIMIT or a fault
+ ************************************************************/
+robomal_status_t robomal_run(robomal_t *robo, uint64_t max_cycles)
+{
+    uint64_t end = max_cycles ? robo->cycles + max_cycles : UINT64_MAX;
+
+    while(robo->cycles < end)
+    {
+        robomal_status_t status = robomal_step(robo);
+
+        if(status != ROBOMAL_RUNNING && status != ROBOMAL_INVALID_OPCODE)
+        {
+            return status;
+        }
+    }
+
+    return ROBOMAL_CYCLE_LIMIT;
+}
+
+/************************************************************
+ * Function: handler_index
+ * Description: Maps an opcode to its threaded handler slot.
+ * Input parameters:
+ *      - robo: Machine whose ISA applies
+ *      - opcode: Opcode to map
+ * Returns: uint32_t - HANDLER_* slot, HANDLER_INVALID if the
+ *          opcode is not implemented
+ ************************************************************/
+static uint32_t handler_index(const robomal_t *robo, uint8_t opcode)
+{
+    static const uint8_t group_start[GROUPS] = {0, HANDLER_READ, HANDLER_ADD, HANDLER_BRANCH, HANDLER_LEFT};
+
+    if(!robomal_opcode_allowed(robo, opcode))
+    {
+        return HANDLER_INVALID;
+    }
+
+    return group_start[opcode >> 4] + (opcode & 0xF);
+}
+
+/************************************************************
+ * Function: threaded_execute
+ * Description: Threaded run loop over robo->decoded. Each
+ *              handler ends by jumping straight to the handler
+ *              of the next decoded instruction. When handlers is
+ *              not NULL the handler address table is returned
+ *              through it instead, for robomal_predecode.
+ * Input parameters:
+ *      - robo: Pre-decoded machine to run
+ *      - max_cycles: Cycle budget, 0 for no limit
+ *      - handlers: Optional output for the handler table
+ * Returns: robomal_status_t - HALTED, PC_OUT_OF_RANGE,
+ *          CYCLE_LIMIT or a fault
+ ************************************************************/
+static robomal_status_t threaded_execute(robomal_t *robo, uint64_t max_cycles, const void *const **handlers)
+{
+    static const void *const handler_table[HANDLER_COUNT] =
+    {
+        &&do_read, &&do_write, &&do_load, &&do_store,
+        &&do_load_indirect, &&do_store_indirect, &&do_load_immediate,
+        &&do_add, &&do_subtract, &&do_multiply,
+        &&do_add_immediate, &&do_subtract_immediate, &&do_multiply_immediate,
+        &&do_branch, &&do_brancheq, &&do_branchne, &&do_halt,
+        &&do_branchlt, &&do_branchge, &&do_call, &&do_return,
+        &&do_motion, &&do_motion, &&do_motion, &&do_motion, &&do_motion,
+        &&do_invalid, &&do_end
+    };
+
+    if(handlers)
+    {
+        *handlers = handler_table;
+        return ROBOMAL_RUNNING;
+    }
+
+    const robomal_decoded_t *base = robo->decoded;
+    const robomal_decoded_t *ip = base + robo->pc / 2;
+    const robomal_decoded_t *current = NULL;
+    const robomal_decoded_t *last_branch = NULL;
+    const robomal_decoded_t *last_target = NULL;
+    uint8_t *data = robo->data;
+    uint32_t accumulator = robo->accumulator;
+    uint32_t address;
+    uint64_t budget = max_cycles ? max_cycles : UINT64_MAX;
+    uint64_t start_budget = budget;
+    robomal_status_t status;
+
+    if(robo->pc / 2 >= robo->decoded_count)
+    {
+        return ROBOMAL_PC_OUT_OF_RANGE;
+    }
+
+    // Fetch and jump to the next handler, the only dispatch in the loop
+    #define DISPATCH()                      \
+        do                                  \
+        {                                   \
+            if(!budget) goto cycle_limit;   \
+            budget--;                       \
+            current = ip++;                 \
+            goto *current->handler;         \
+        } while(0)
+
+    // Taken control transfer, remembered for do_end
+    #define JUMP(target)                    \
+        do                                  \
+        {                                   \
+            ip = (target);                  \
+            last_branch = current;          \
+            last_target = ip;               \
+        } while(0)
+
+    // Stop on the current instruction without counting it, like fault()
+    #define FAULT(fault_status)             \
+        do                                  \
+        {                                   \
+            budget++;                       \
+            ip = current;                   \
+            status = (fault_status);        \
+            goto done;                      \
+        } while(0)
+
+    DISPATCH();
+
+    do_read:
+    write_halfword(data, current->operand, (robo->io.read_pins ? robo->io.read_pins(robo->io.context) : 0) >> 4);
+    DISPATCH();
+
+    do_write:
+    if(robo->io.write_pins) robo->io.write_pins(robo->io.context, read_halfword(data, current->operand));
+    DISPATCH();
+
+    do_load:
+    accumulator = read_halfword(data, current->operand);
+    DISPATCH();
+
+    do_store:
+    write_halfword(data, current->operand, accumulator);
+    DISPATCH();
+
+    do_load_indirect:
+    address = read_halfword(data, current->operand);
+    if(address + 2 > ROBOMAL_DATA_SIZE) FAULT(ROBOMAL_DATA_OUT_OF_RANGE);
+    accumulator = read_halfword(data, address);
+    DISPATCH();
+
+    do_store_indirect:
+    address = read_halfword(data, current->operand);
+    if(address + 2 > ROBOMAL_DATA_SIZE) FAULT(ROBOMAL_DATA_OUT_OF_RANGE);
+    write_halfword(data, address, accumulator);
+    DISPATCH();
+
+    do_load_immediate:
+    accumulator = current->operand;
+    DISPATCH();
+
+    do_add:
+    accumulator += read_word(data, current->operand);
+    DISPATCH();
+
+    do_subtract:
+    accumulator -= read_word(data, current->operand);
+    DISPATCH();
+
+    do_multiply:
+    accumulator *= read_word(data, current->operand);
+    robo->multiply_high = accumulator >> 16;
+    accumulator &= 0xFFFF;
+    DISPATCH();
+
+    do_add_immediate:
+    accumulator += current->operand;
+    DISPATCH();
+
+    do_subtract_immediate:
+    accumulator -= current->operand;
+    DISPATCH();
+
+    do_multiply_immediate:
+    accumulator *= current->operand;
+    robo->multiply_high = accumulator >> 16;
+    accumulator &= 0xFFFF;
+    DISPATCH();
+
+    do_branch:
+    JUMP(base + current->operand / 2);
+    DISPATCH();
+
+    do_brancheq:
+    if(accumulator == 0) JUMP(base + current->operand / 2);
+    DISPATCH();
+
+    do_branchne:
+    if(accumulator != 0) JUMP(base + current->operand / 2);
+    DISPATCH();
+
+    do_branchlt:
+    if((int32_t)accumulator < 0) JUMP(base + current->operand / 2);
+    DISPATCH();
+
+    do_branchge:
+    if((int32_t)accumulator >= 0) JUMP(base + current->operand / 2);
+    DISPATCH();
+
+    do_call:
+    if(robo->call_depth == ROBOMAL_CALL_DEPTH) FAULT(ROBOMAL_STACK_OVERFLOW);
+    robo->return_stack[robo->call_depth++] = (ip - base) * 2;
+    JUMP(base + current->operand / 2);
+    DISPATCH();
+
+    do_return:
+    if(!robo->call_depth) FAULT(ROBOMAL_STACK_UNDERFLOW);
+    JUMP(base + robo->return_stack[--robo->call_depth] / 2);
+    DISPATCH();
+
+    do_motion:
+    if(robo->io.motion) robo->io.motion(robo->io.context, current->instruction >> 8, current->operand);
+    DISPATCH();
+
+    do_invalid:
+    robo->invalid_opcodes++;
+    DISPATCH();
+
+    do_halt:
+    status = ROBOMAL_HALTED;
+    goto done;
+
+    do_end:
+    // Ran off the program, the end marker is not an executed cycle. The
+    // last executed instruction either branched here or sits just before.
+    budget++;
+    ip--;
+    if(budget == start_budget)
+        current = NULL;
+    else if(last_branch && last_target == current)
+        current = last_branch;
+    else
+        current = current - 1;
+    status = ROBOMAL_PC_OUT_OF_RANGE;
+    goto done;
+
+    cycle_limit:
+    status = ROBOMAL_CYCLE_LIMIT;
+
+    done:
+    #undef DISPATCH
+    #undef JUMP
+    #undef FAULT
+
+    robo->accumulator = accumulator;
+    robo->pc = (ip - base) * 2;
+    robo->cycles += start_budget - budget;
+
+    if(current)
+    {
+        robo->instruction = current->instruction;
+        robo->opcode = current->instruction >> 8;
+        robo->operand = current->instruction & 0xFF;
+    }
+
+    return status;
+}
+
+/************************************************************
+ * Function: robomal_predecode
+ * Description: Validates the whole program once and converts
+ *              every halfword into a handler address plus
+ *              operand for robomal_run_threaded. Invalid opcodes
+ *              are reported here instead of on every cycle and
+ *              decode to a handler that skips them like
+ *              robomal.S. Halfwords past the end of the program
+ *              (up to the branch reach) decode to an end marker.
+ * Input parameters:
+ *      - robo: Machine whose program is decoded
+ * Returns: robomal_status_t - RUNNING if the program is clean,
+ *          INVALID_OPCODE (still runnable), INVALID_BRANCH or
+ *          OUT_OF_MEMORY. first_error_pc holds the location.
+ ************************************************************/
+robomal_status_t robomal_predecode(robomal_t *robo)
+{
+    const void *const *handlers;
+    const uint8_t *code = (const uint8_t*)robo->instructions;
+    robomal_status_t status = ROBOMAL_RUNNING;
+    uint32_t count = robo->instruction_count > BRANCH_REACH ? robo->instruction_count : BRANCH_REACH;
+
+    threaded_execute(NULL, 0, &handlers);
+
+    free(robo->decoded);
+    robo->decoded = malloc((count + 1) * sizeof(robomal_decoded_t));
+    robo->decoded_count = 0;
+    robo->first_error_pc = 0;
+
+    if(!robo->decoded)
+    {
+        return ROBOMAL_OUT_OF_MEMORY;
+    }
+
+    for(uint32_t i = 0; i <= count; i++)
+    {
+        robomal_decoded_t *entry = &robo->decoded[i];
+
+        if(i >= robo->instruction_count)
+        {
+            entry->handler = handlers[HANDLER_END];
+            entry->operand = 0;
+            entry->instruction = 0;
+            continue;
+        }
+
+        uint16_t instruction = read_halfword(code, i * 2);
+        uint8_t opcode = instruction >> 8;
+        uint32_t index = handler_index(robo, opcode);
+
+        entry->handler = handlers[index];
+        entry->operand = instruction & 0xFF;
+        entry->instruction = instruction;
+
+        if(index == HANDLER_INVALID && status == ROBOMAL_RUNNING)
+        {
+            status = ROBOMAL_INVALID_OPCODE;
+            robo->first_error_pc = i * 2;
+        }
+
+        // Odd targets would fetch across two instructions
+        if(index != HANDLER_INVALID && robomal_opcode_has_target(opcode) && (entry->operand & 1) &&
+           status != ROBOMAL_INVALID_BRANCH)
+        {
+            status = ROBOMAL_INVALID_BRANCH;
+            robo->first_error_pc = i * 2;
+        }
+    }
+
+    robo->decoded_count = count + 1;
+
+    return status;
+}
+
+/************************************************************
+ * Function: robomal_run_threaded
+ * Description: Runs the pre-decoded program from the current
+ *              PC, decoding it first if needed. Results match
+ *              robomal_run for every program robomal_predecode
+ *              accepts.
+ * Input parameters:
+ *      - robo: Machine to run
+ *      - max_cycles: Cycle budget, 0 for no limit
+ * Returns: robomal_status_t - HALTED, PC_OUT_OF_RANGE,
+ *          CYCLE_LIMIT, a fault, or the robomal_predecode error
+ *          that prevented running
+ ************************************************************/
+robomal_status_t robomal_run_threaded(robomal_t *robo, uint64_t max_cycles)
+{
+    if(!robo->decoded)
+    {
+        robomal_status_t status = robomal_predecode(robo);
+
+        if(status != ROBOMAL_RUNNING && status != ROBOMAL_INVALID_OPCODE)
+        {
+            return status;
+        }
+    }
+
+    return threaded_execute(robo, max_cycles, NULL);
+}
+
+/************************************************************
+ * Function: robomal_release
+ * Description: Frees the pre-decoded program and translated
+ *              blocks. Call before robomal_init reuses robo.
+ * Input parameters:
+ *      - robo: Machine to release
+ * Returns: None
+ ************************************************************/
+void robomal_release(robomal_t *robo)
+{
+    robomal_jit_release(robo);
+    free(robo->decoded);
+    robo->decoded = NULL;
+    robo->decoded_count = 0;
+}
+
+/************************************************************
+ * Function: robomal_opcode_valid
+ * Description: Same check as validate_opcode in robomal.S with
+ *              the extended ISA.
+ * Input parameters:
+ *      - opcode: Opcode to check
+ * Returns: bool - true if the opcode is implemented
+ ************************************************************/
+bool robomal_opcode_valid(uint8_t opcode)
+{
+    return robomal_opcode_isa(opcode) != 0;
+}
+
+/************************************************************
+ * Function: robomal_opcode_isa
+ * Description: Returns the ISA version that introduced an
+ *              opcode.
+ * Input parameters:
+ *      - opcode: Opcode to look up
+ * Returns: uint32_t - ROBOMAL_ISA_*, 0 if invalid in every
+ *          version
+ ************************************************************/
+uint32_t robomal_opcode_isa(uint8_t opcode)
+{
+    uint32_t group = opcode >> 4;
+    uint32_t index = opcode & 0xF;
+
+    if(group >= GROUPS || index >= GROUP_SIZE)
+    {
+        return 0;
+    }
+
+    return opcodes[group][index].isa;
+}
+
+/************************************************************
+ * Function: robomal_opcode_allowed
+ * Description: Checks an opcode against the ISA version of a
+ *              machine.
+ * Input parameters:
+ *      - robo: Machine whose ISA applies
+ *      - opcode: Opcode to check
+ * Returns: bool - true if robo executes the opcode
+ ************************************************************/
+bool robomal_opcode_allowed(const robomal_t *robo, uint8_t opcode)
+{
+    uint32_t isa = robomal_opcode_isa(opcode);
+
+    return isa && isa <= robo->isa;
+}
+
+/************************************************************
+ * Function: robomal_opcode_has_target
+ * Description: Tells whether the operand of an opcode is an
+ *              instruction address: the branches and call.
+ * Input parameters:
+ *      - opcode: Opcode to check
+ * Returns: bool - true for branch targets
+ ************************************************************/
+bool robomal_opcode_has_target(uint8_t opcode)
+{
+    switch(opcode)
+    {
+        case ROBOMAL_BRANCH:
+        case ROBOMAL_BRANCHEQ:
+        case ROBOMAL_BRANCHNE:
+        case ROBOMAL_BRANCHLT:
+        case ROBOMAL_BRANCHGE:
+        case ROBOMAL_CALL:
+        return true;
+    }
+
+    return false;
+}
+
+/************************************************************
+ * Function: robomal_mnemonic
+ * Description: Returns the mnemonic robomal_debug.S prints for
+ *              an opcode.
+ * Input parameters:
+ *      - opcode: Opcode to name
+ * Returns: const char* - Mnemonic, or NULL if invalid
+ ************************************************************/
+const char *robomal_mnemonic(uint8_t opcode)
+{
+    if(!robomal_opcode_valid(opcode))
+    {
+        return NULL;
+    }
+
+    return opcodes[opcode >> 4][opcode & 0xF].mnemonic;
+}
+
+/************************************************************
+ * Function: robomal_data_halfword
+ * Description: Reads a halfword of data memory.
+ * Input parameters:
+ *      - robo: Machine to read
+ *      - offset: Byte offset into data memory
+ * Returns: uint16_t - Value at offset
+ ************************************************************/
+uint16_t robomal_data_halfword(const robomal_t *robo, uint32_t offset)
+{
+    if(offset + 2 > ROBOMAL_DATA_SIZE)
+    {
+        return 0;
+    }
+
+    return read_halfword(robo->data, offset);
+}
@@ -0,0 +1,148 @@
+#ifndef ROBOMAL_H
+#define ROBOMAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Opcodes, grouped by high nibble like the jump tables in robomal.S
+#define ROBOMAL_READ 0x10
+#define ROBOMAL_WRITE 0x11
+#define ROBOMAL_LOAD 0x12
+#define ROBOMAL_STORE 0x13
+#define ROBOMAL_ADD 0x20
+#define ROBOMAL_SUBTRACT 0x21
+#define ROBOMAL_MULTIPLY 0x22
+#define ROBOMAL_BRANCH 0x30
+#define ROBOMAL_BRANCHEQ 0x31
+#define ROBOMAL_BRANCHNE 0x32
+#define ROBOMAL_HALT 0x33
+#define ROBOMAL_LEFT 0x40
+#define ROBOMAL_RIGHT 0x41
+#define ROBOMAL_FORWARD 0x42
+#define ROBOMAL_BACKWARD 0x43
+#define ROBOMAL_BRAKE 0x44
+
+// Extended ISA, in the free slots of the same groups
+#define ROBOMAL_LOAD_INDIRECT 0x14          // Accumulator = halfword at the address held at operand
+#define ROBOMAL_STORE_INDIRECT 0x15         // Halfword at the address held at operand = accumulator
+#define ROBOMAL_LOAD_IMMEDIATE 0x16         // Accumulator = operand
+#define ROBOMAL_ADD_IMMEDIATE 0x23
+#define ROBOMAL_SUBTRACT_IMMEDIATE 0x24
+#define ROBOMAL_MULTIPLY_IMMEDIATE 0x25
+#define ROBOMAL_BRANCHLT 0x34               // Branch if the accumulator is negative as a 32-bit value
+#define ROBOMAL_BRANCHGE 0x35
+#define ROBOMAL_CALL 0x36                   // Push the next PC and branch
+#define ROBOMAL_RETURN 0x37                 // Pop the PC
+
+#define ROBOMAL_INSTRUCTION(opcode, operand) ((uint16_t)(((opcode) << 8) | ((operand) & 0xFF)))
+
+// ISA versions. A program image carries the version it was assembled for,
+// and opcodes newer than a machine's version are invalid there, exactly as
+// they were before the extension.
+#define ROBOMAL_ISA_BASE 1
+#define ROBOMAL_ISA_EXTENDED 2
+
+// Direct operands are 8-bit byte offsets and add/subtract/multiply read a
+// 32-bit word, so they reach the first ROBOMAL_DIRECT_DATA_SIZE bytes.
+// loadind and storeind take a 16-bit address from data memory and reach
+// all of it; an address past the end stops the machine.
+#define ROBOMAL_DIRECT_DATA_SIZE 0x104
+#define ROBOMAL_DATA_SIZE 0x800
+
+// Largest program accepted. Branch targets only reach the first 256 bytes,
+// but straight-line code may run past them. The image header and the
+// return stack hold byte offsets in 16 bits, so the byte size of the
+// program and the PC after its last instruction must stay below 0x10000.
+#define ROBOMAL_MAX_INSTRUCTIONS 0x7FFF
+
+// Return addresses call can nest
+#define ROBOMAL_CALL_DEPTH 8
+
+// The last three statuses are faults. They stop the machine before the
+// instruction executes: PC is left on it and it is not counted in cycles.
+typedef enum
+{
+    ROBOMAL_RUNNING,            // Instruction executed, keep going
+    ROBOMAL_HALTED,             // halt executed
+    ROBOMAL_INVALID_OPCODE,     // Opcode skipped (robomal.S prints and continues)
+    ROBOMAL_PC_OUT_OF_RANGE,    // PC ran past the end of the program
+    ROBOMAL_CYCLE_LIMIT,        // robomal_run stopped at max_cycles
+    ROBOMAL_INVALID_BRANCH,     // robomal_predecode found an odd branch target
+    ROBOMAL_OUT_OF_MEMORY,      // robomal_predecode could not allocate the decoded program
+    ROBOMAL_DATA_OUT_OF_RANGE,  // loadind/storeind address past the end of data memory
+    ROBOMAL_STACK_OVERFLOW,     // call with ROBOMAL_CALL_DEPTH returns pending
+    ROBOMAL_STACK_UNDERFLOW     // return without a call
+} robomal_status_t;
+
+// Stand-ins for the board. Any callback may be NULL: reads return 0 and
+// writes/motion are ignored.
+typedef struct
+{
+    uint32_t (*read_pins)(void *context);                               // PMODB pins 1-8
+    void (*write_pins)(void *context, uint32_t value);                  // value written to PMODB
+    void (*motion)(void *context, uint8_t opcode, uint8_t operand);     // 0x40-0x44
+    void *context;
+} robomal_io_t;
+
+// One pre-decoded instruction for the threaded run loop
+typedef struct
+{
+    const void *handler;        // Address of the handler in robomal_run_threaded
+    uint32_t operand;
+    uint16_t instruction;
+} robomal_decoded_t;
+
+typedef struct
+{
+    // Register file, named after the ARM registers robomal.S keeps them in
+    uint32_t accumulator;       // r5
+    uint32_t pc;                // r6, byte offset into instruction memory
+    uint16_t instruction;       // r7
+    uint8_t opcode;             // r8
+    uint8_t operand;            // r9
+    uint32_t multiply_high;     // r10, top half of the last multiply
+    uint16_t return_stack[ROBOMAL_CALL_DEPTH];
+    uint32_t call_depth;
+    uint32_t isa;               // ROBOMAL_ISA_*, ROBOMAL_ISA_EXTENDED after robomal_init
+
+    const uint16_t *instructions;
+    uint32_t instruction_count;
+    uint8_t data[ROBOMAL_DATA_SIZE];
+    uint8_t initial_data[ROBOMAL_DATA_SIZE];
+
+    robomal_io_t io;
+
+    uint64_t cycles;
+    uint32_t invalid_opcodes;
+
+    // Filled by robomal_predecode, one entry per halfword of the branch
+    // reachable range or program (whichever is larger) plus an end marker
+    robomal_decoded_t *decoded;
+    uint32_t decoded_count;
+    uint32_t first_error_pc;    // PC of the first invalid opcode or branch found
+
+    // Translated block cache owned by robomal_run_jit
+    void *jit;
+} robomal_t;
+
+void robomal_init(robomal_t *robo, const uint16_t *instructions, uint32_t instruction_count,
+                  const uint16_t *data, uint32_t data_count, const robomal_io_t *io);
+void robomal_reset(robomal_t *robo);
+void robomal_set_isa(robomal_t *robo, uint32_t isa);
+robomal_status_t robomal_step(robomal_t *robo);
+robomal_status_t robomal_run(robomal_t *robo, uint64_t max_cycles);
+robomal_status_t robomal_predecode(robomal_t *robo);
+robomal_status_t robomal_run_threaded(robomal_t *robo, uint64_t max_cycles);
+robomal_status_t robomal_run_jit(robomal_t *robo, uint64_t max_cycles);
+void robomal_jit_release(robomal_t *robo);
+void robomal_release(robomal_t *robo);
+
+bool robomal_opcode_valid(uint8_t opcode);
+uint32_t robomal_opcode_isa(uint8_t opcode);
+bool robomal_opcode_allowed(const robomal_t *robo, uint8_t opcode);
+bool robomal_opcode_has_target(uint8_t opcode);
+const char *robomal_mnemonic(uint8_t opcode);
+
+uint16_t robomal_data_halfword(const robomal_t *robo, uint32_t offset);
+
+#endif // ROBOMAL_H
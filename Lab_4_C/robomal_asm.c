@@ -0,0 +1,650 @@
+/*******************************************************************************
+ * Description: ROBOMAL assembler and disassembler. Assembles mnemonic
+ *              source into a binary program image (robomal_image.h) that
+ *              load_program_image in Lab_4/robomal.S copies straight into
+ *              ROBO_Instructions and ROBO_Data, and turns images back into
+ *              source. Mnemonics are the ones robomal_debug.S prints.
+ *
+ *              Source syntax, one statement per line:
+ *                  label:                  labels may share a line
+ *                  mnemonic [operand]      halt and return take no operand
+ *                  .code / .data           section for what follows
+ *                  .hword value, ...       raw halfwords
+ *                  .space bytes            zeroed data, an even number
+ *                  ; or @ starts a comment
+ *              Operands are numbers (C syntax, 0-255) or labels. Labels
+ *              are byte offsets into their section, so a code label is a
+ *              branch target and a data label is a ROBO_Data offset.
+ *              Data past 0xFF is only reached through loadind and
+ *              storeind, whose operand holds the address. The image
+ *              version is the oldest ISA that has every opcode used.
+ *
+ * Build:       gcc -O2 robomal_asm.c robomal_image.c robomal.c robomal_jit.c -o robomal_asm
+ * Usage:       ./robomal_asm source.rasm image.rbml   assemble
+ *              ./robomal_asm -d image.rbml            disassemble to source
+ *              ./robomal_asm -s image.rbml            print robomal.S .hword lines
+ ******************************************************************************/
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "robomal.h"
+#include "robomal_image.h"
+
+#define MAX_LABELS 512
+#define MAX_LABEL_LENGTH 32
+#define MAX_LINE_LENGTH 256
+#define MAX_IMAGE_SIZE (ROBOMAL_IMAGE_HEADER_SIZE + ROBOMAL_MAX_INSTRUCTIONS * 2 + ROBOMAL_DATA_SIZE)
+
+// Longest program the Lab_4 firmware accepts (ROBO_MAX_INSTRUCTIONS)
+#define FIRMWARE_MAX_INSTRUCTIONS 128
+
+typedef enum
+{
+    SECTION_CODE,
+    SECTION_DATA
+} section_t;
+
+typedef struct
+{
+    char name[MAX_LABEL_LENGTH];
+    section_t section;
+    uint32_t offset;
+} label_t;
+
+typedef struct
+{
+    label_t labels[MAX_LABELS];
+    uint32_t label_count;
+
+    uint16_t instructions[ROBOMAL_MAX_INSTRUCTIONS];
+    uint32_t instruction_count;
+    uint16_t data[ROBOMAL_DATA_SIZE / 2];
+    uint32_t data_count;
+    uint32_t isa;               // ROBOMAL_ISA_* needed so far
+
+    section_t section;
+    int pass;                   // 1 defines labels, 2 encodes
+    const char *path;
+    uint32_t line;
+    uint32_t errors;
+} assembler_t;
+
+/************************************************************
+ * Function: assembler_error
+ * Description: Reports an error at the current source line.
+ *              Label definitions are checked in pass 1 and
+ *              everything else in pass 2, so each error is
+ *              printed once.
+ ************************************************************/
+static void assembler_error(assembler_t *as, const char *format, ...)
+{
+    va_list args;
+
+    fprintf(stderr, "%s:%u: error: ", as->path, as->line);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+
+    as->errors++;
+}
+
+/************************************************************
+ * Function: find_label
+ * Description: Looks a label up by name.
+ * Returns: label_t* - The label, or NULL if undefined
+ ************************************************************/
+static label_t *find_label(assembler_t *as, const char *name)
+{
+    for(uint32_t i = 0; i < as->label_count; i++)
+    {
+        if(strcmp(as->labels[i].name, name) == 0)
+        {
+            return &as->labels[i];
+        }
+    }
+
+    return NULL;
+}
+
+/************************************************************
+ * Function: find_opcode
+ * Description: Reverse of robomal_mnemonic.
+ * Returns: int - Opcode, or -1 if name is not a mnemonic
+ ************************************************************/
+static int find_opcode(const char *name)
+{
+    for(int opcode = 0; opcode < 0x50; opcode++)
+    {
+        const char *mnemonic = robomal_mnemonic(opcode);
+
+        if(mnemonic && strcmp(mnemonic, name) == 0)
+        {
+            return opcode;
+        }
+    }
+
+    return -1;
+}
+
+/************************************************************
+ * Function: section_offset
+ * Description: Byte offset of the next halfword emitted into
+ *              the current section.
+ ************************************************************/
+static uint32_t section_offset(const assembler_t *as)
+{
+    return (as->section == SECTION_CODE ? as->instruction_count : as->data_count) * 2;
+}
+
+/************************************************************
+ * Function: emit
+ * Description: Appends a halfword to the current section.
+ ************************************************************/
+static void emit(assembler_t *as, uint16_t value)
+{
+    if(as->section == SECTION_CODE)
+    {
+        if(as->instruction_count == ROBOMAL_MAX_INSTRUCTIONS)
+        {
+            if(as->pass == 2) assembler_error(as, "program is longer than %u instructions", ROBOMAL_MAX_INSTRUCTIONS);
+            return;
+        }
+
+        as->instructions[as->instruction_count++] = value;
+    }
+    else
+    {
+        if(as->data_count == ROBOMAL_DATA_SIZE / 2)
+        {
+            if(as->pass == 2) assembler_error(as, "data is larger than %u bytes", ROBOMAL_DATA_SIZE);
+            return;
+        }
+
+        as->data[as->data_count++] = value;
+    }
+}
+
+/************************************************************
+ * Function: parse_value
+ * Description: Evaluates a number or label operand. Labels are
+ *              only resolved in pass 2.
+ * Input parameters:
+ *      - as: Assembler
+ *      - token: Operand text
+ *      - value: Output, the value
+ * Returns: int - 1 on success, 0 after reporting an error
+ ************************************************************/
+static int parse_value(assembler_t *as, const char *token, uint32_t *value)
+{
+    if(isdigit((unsigned char)token[0]))
+    {
+        char *end;
+        *value = strtoul(token, &end, 0);
+
+        if(*end != '\0')
+        {
+            if(as->pass == 2) assembler_error(as, "bad number '%s'", token);
+            return 0;
+        }
+
+        return 1;
+    }
+
+    if(as->pass == 1)
+    {
+        *value = 0;
+        return 1;
+    }
+
+    label_t *label = find_label(as, token);
+
+    if(!label)
+    {
+        assembler_error(as, "undefined label '%s'", token);
+        return 0;
+    }
+
+    *value = label->offset;
+    return 1;
+}
+
+/************************************************************
+ * Function: next_token
+ * Description: Splits the next token off a statement. Tokens
+ *              are separated by whitespace and commas.
+ * Input parameters:
+ *      - cursor: Parse position, advanced past the token
+ * Returns: char* - The token, or NULL at end of statement
+ ************************************************************/
+static char *next_token(char **cursor)
+{
+    char *start = *cursor;
+
+    while(*start && (isspace((unsigned char)*start) || *start == ','))
+    {
+        start++;
+    }
+
+    if(*start == '\0')
+    {
+        *cursor = start;
+        return NULL;
+    }
+
+    char *end = start;
+
+    while(*end && !isspace((unsigned char)*end) && *end != ',')
+    {
+        end++;
+    }
+
+    if(*end)
+    {
+        *end++ = '\0';
+    }
+
+    *cursor = end;
+    return start;
+}
+
+/************************************************************
+ * Function: define_label
+ * Description: Records a label at the current offset (pass 1).
+ ************************************************************/
+static void define_label(assembler_t *as, const char *name)
+{
+    if(as->pass == 2)
+    {
+        return;
+    }
+
+    if(!isalpha((unsigned char)name[0]) && name[0] != '_')
+    {
+        assembler_error(as, "bad label '%s'", name);
+    }
+    else if(strlen(name) >= MAX_LABEL_LENGTH)
+    {
+        assembler_error(as, "label '%s' is too long", name);
+    }
+    else if(find_label(as, name))
+    {
+        assembler_error(as, "label '%s' already defined", name);
+    }
+    else if(as->label_count == MAX_LABELS)
+    {
+        assembler_error(as, "too many labels");
+    }
+    else
+    {
+        label_t *label = &as->labels[as->label_count++];
+        strcpy(label->name, name);
+        label->section = as->section;
+        label->offset = section_offset(as);
+    }
+}
+
+/************************************************************
+ * Function: assemble_line
+ * Description: Assembles one source line.
+ ************************************************************/
+static void assemble_line(assembler_t *as, char *text)
+{
+    char *comment = strpbrk(text, ";@");
+    char *cursor = text;
+    char *token;
+    uint32_t value;
+
+    if(comment)
+    {
+        *comment = '\0';
+    }
+
+    while((token = next_token(&cursor)) != NULL)
+    {
+        size_t length = strlen(token);
+
+        if(token[length - 1] == ':')
+        {
+            token[length - 1] = '\0';
+            define_label(as, token);
+            continue;
+        }
+
+        if(strcmp(token, ".code") == 0)
+        {
+            as->section = SECTION_CODE;
+        }
+        else if(strcmp(token, ".data") == 0)
+        {
+            as->section = SECTION_DATA;
+        }
+        else if(strcmp(token, ".hword") == 0)
+        {
+            while((token = next_token(&cursor)) != NULL)
+            {
+                if(parse_value(as, token, &value))
+                {
+                    if(value > 0xFFFF && as->pass == 2) assembler_error(as, "'%s' does not fit in a halfword", token);
+                    emit(as, value);
+                }
+            }
+        }
+        else if(strcmp(token, ".space") == 0)
+        {
+            token = next_token(&cursor);
+
+            // A label would be 0 in pass 1 and move everything after it in pass 2
+            if(token && !isdigit((unsigned char)token[0]))
+            {
+                if(as->pass == 2) assembler_error(as, ".space needs a number, not '%s'", token);
+                return;
+            }
+
+            if(!token || !parse_value(as, token, &value) || (value & 1))
+            {
+                if(as->pass == 2) assembler_error(as, ".space needs an even byte count");
+                return;
+            }
+
+            for(uint32_t i = 0; i < value / 2; i++)
+            {
+                emit(as, 0);
+            }
+        }
+        else
+        {
+            int opcode = find_opcode(token);
+
+            if(opcode < 0)
+            {
+                if(as->pass == 2) assembler_error(as, "unknown mnemonic '%s'", token);
+                return;
+            }
+
+            if(as->section != SECTION_CODE)
+            {
+                if(as->pass == 2) assembler_error(as, "instruction in .data");
+                return;
+            }
+
+            value = 0;
+            token = next_token(&cursor);
+
+            if(token)
+            {
+                if(!parse_value(as, token, &value))
+                {
+                    return;
+                }
+            }
+            else if(opcode != ROBOMAL_HALT && opcode != ROBOMAL_RETURN)
+            {
+                if(as->pass == 2) assembler_error(as, "%s needs an operand", robomal_mnemonic(opcode));
+                return;
+            }
+
+            if(as->pass == 2)
+            {
+                if(value > 0xFF)
+                {
+                    assembler_error(as, "operand 0x%X does not fit in 8 bits", value);
+                }
+                else if(robomal_opcode_has_target(opcode) && (value & 1))
+                {
+                    assembler_error(as, "branch target 0x%X is not an instruction", value);
+                }
+            }
+
+            if(robomal_opcode_isa(opcode) > as->isa)
+            {
+                as->isa = robomal_opcode_isa(opcode);
+            }
+
+            emit(as, ROBOMAL_INSTRUCTION(opcode, value));
+        }
+
+        if(next_token(&cursor) && as->pass == 2)
+        {
+            assembler_error(as, "unexpected text after statement");
+        }
+
+        return;
+    }
+}
+
+/************************************************************
+ * Function: assemble_file
+ * Description: Runs both passes over a source file.
+ * Returns: int - 1 on success, 0 if anything was reported
+ ************************************************************/
+static int assemble_file(assembler_t *as, const char *path)
+{
+    FILE *file = fopen(path, "r");
+    char text[MAX_LINE_LENGTH];
+
+    if(!file)
+    {
+        perror(path);
+        return 0;
+    }
+
+    as->path = path;
+
+    for(as->pass = 1; as->pass <= 2; as->pass++)
+    {
+        rewind(file);
+        as->line = 0;
+        as->section = SECTION_CODE;
+        as->instruction_count = 0;
+        as->data_count = 0;
+        as->isa = ROBOMAL_ISA_BASE;
+
+        while(fgets(text, sizeof(text), file))
+        {
+            as->line++;
+            assemble_line(as, text);
+        }
+
+        if(as->errors)
+        {
+            break;
+        }
+    }
+
+    fclose(file);
+
+    if(as->instruction_count > FIRMWARE_MAX_INSTRUCTIONS)
+    {
+        fprintf(stderr, "%s: warning: %u instructions, Lab_4 firmware loads at most %u\n", path,
+                as->instruction_count, FIRMWARE_MAX_INSTRUCTIONS);
+    }
+
+    return as->errors == 0;
+}
+
+/************************************************************
+ * Function: read_image
+ * Description: Reads and validates an image file.
+ * Returns: int - 1 on success, 0 after reporting an error
+ ************************************************************/
+static int read_image(const char *path, assembler_t *program)
+{
+    static uint8_t image[MAX_IMAGE_SIZE + 1];
+    FILE *file = fopen(path, "rb");
+
+    if(!file)
+    {
+        perror(path);
+        return 0;
+    }
+
+    size_t size = fread(image, 1, sizeof(image), file);
+    fclose(file);
+
+    robomal_image_status_t status = robomal_image_load(image, size, program->instructions, &program->instruction_count,
+                                                       program->data, &program->data_count, &program->isa);
+
+    if(status != ROBOMAL_IMAGE_OK)
+    {
+        fprintf(stderr, "%s: %s\n", path, robomal_image_error(status));
+        return 0;
+    }
+
+    return 1;
+}
+
+/************************************************************
+ * Function: disassemble
+ * Description: Prints an image as source that assembles back
+ *              to the same image. Branch and call targets get
+ *              labels. Opcodes newer than the image version are
+ *              invalid on the machine and printed as .hword.
+ ************************************************************/
+static void disassemble(const assembler_t *program)
+{
+    static uint8_t is_target[ROBOMAL_MAX_INSTRUCTIONS];
+
+    memset(is_target, 0, sizeof(is_target));
+
+    for(uint32_t i = 0; i < program->instruction_count; i++)
+    {
+        uint8_t opcode = program->instructions[i] >> 8;
+        uint8_t operand = program->instructions[i] & 0xFF;
+
+        if(robomal_opcode_has_target(opcode) && robomal_opcode_isa(opcode) <= program->isa &&
+           operand / 2 < program->instruction_count)
+        {
+            is_target[operand / 2] = 1;
+        }
+    }
+
+    printf("; %u instructions, %u data halfwords, version %u\n", program->instruction_count, program->data_count,
+           program->isa);
+    printf("        .code\n");
+
+    for(uint32_t i = 0; i < program->instruction_count; i++)
+    {
+        uint16_t instruction = program->instructions[i];
+        uint8_t opcode = instruction >> 8;
+        uint8_t operand = instruction & 0xFF;
+        const char *mnemonic = robomal_opcode_isa(opcode) <= program->isa ? robomal_mnemonic(opcode) : NULL;
+        char text[32];
+
+        if(is_target[i])
+        {
+            printf("L%02X:\n", i * 2);
+        }
+
+        if(!mnemonic)
+        {
+            snprintf(text, sizeof(text), ".hword 0x%04X", instruction);
+        }
+        else if((opcode == ROBOMAL_HALT || opcode == ROBOMAL_RETURN) && operand == 0)
+        {
+            snprintf(text, sizeof(text), "%s", mnemonic);
+        }
+        else if(robomal_opcode_has_target(opcode) && operand / 2 < program->instruction_count && !(operand & 1))
+        {
+            snprintf(text, sizeof(text), "%-9s L%02X", mnemonic, operand);
+        }
+        else
+        {
+            snprintf(text, sizeof(text), "%-9s 0x%02X", mnemonic, operand);
+        }
+
+        printf("        %-24s; %02X: %04X%s\n", text, i * 2, instruction, mnemonic ? "" : " invalid opcode");
+    }
+
+    if(program->data_count)
+    {
+        printf("        .data\n");
+    }
+
+    for(uint32_t i = 0; i < program->data_count; i++)
+    {
+        printf("%s0x%04X%s", i % 8 ? ", " : "        .hword ", program->data[i],
+               i % 8 == 7 || i == program->data_count - 1 ? "\n" : "");
+    }
+}
+
+/************************************************************
+ * Function: print_firmware_source
+ * Description: Prints ROBO_Instructions and ROBO_Data lines to
+ *              paste into Lab_4/robomal.S.
+ ************************************************************/
+static void print_firmware_source(const assembler_t *program)
+{
+    printf(" ROBO_Instructions: .hword ");
+
+    for(uint32_t i = 0; i < program->instruction_count; i++)
+    {
+        printf("%s0x%04X", i ? ", " : "", program->instructions[i]);
+    }
+
+    printf("\n ROBO_Data: .hword ");
+
+    for(uint32_t i = 0; i < program->data_count; i++)
+    {
+        printf("%s0x%04X", i ? ", " : "", program->data[i]);
+    }
+
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    static assembler_t as;
+
+    if(argc == 3 && (strcmp(argv[1], "-d") == 0 || strcmp(argv[1], "-s") == 0))
+    {
+        if(!read_image(argv[2], &as))
+        {
+            return 1;
+        }
+
+        if(argv[1][1] == 'd')
+        {
+            disassemble(&as);
+        }
+        else
+        {
+            print_firmware_source(&as);
+        }
+
+        return 0;
+    }
+
+    if(argc != 3 || argv[1][0] == '-')
+    {
+        fprintf(stderr, "usage: %s source.rasm image.rbml\n"
+                        "       %s -d image.rbml\n"
+                        "       %s -s image.rbml\n", argv[0], argv[0], argv[0]);
+        return 2;
+    }
+
+    if(!assemble_file(&as, argv[1]))
+    {
+        return 1;
+    }
+
+    static uint8_t image[MAX_IMAGE_SIZE];
+    size_t size = robomal_image_build(image, sizeof(image), as.instructions, as.instruction_count, as.data, as.data_count,
+                                      as.isa);
+    FILE *file = fopen(argv[2], "wb");
+
+    if(!file || fwrite(image, 1, size, file) != size)
+    {
+        perror(argv[2]);
+        return 1;
+    }
+
+    fclose(file);
+    printf("%s: %u instructions, %u data halfwords, %zu bytes\n", argv[2], as.instruction_count, as.data_count, size);
+
+    return 0;
+}
@@ -0,0 +1,678 @@
+/*******************************************************************************
+ * Description: Host throughput benchmark for the ROBOMAL emulator. Runs the
+ *              sample ROBO_Instructions program from Lab_4/robomal.S and a
+ *              set of synthetic programs back to back under each execution
+ *              engine, and reports executed ROBOMAL instructions per second
+ *              and the speedup over the per-cycle decoding interpreter.
+ *              Every engine's final machine state is checked against the
+ *              interpreter's, and short programs that fault or use opcodes
+ *              outside the machine's ISA must stop the same way in every
+ *              engine. Time-sliced runs of several programs at once must
+ *              leave each machine as it would be run alone. The largest
+ *              program an image holds must load and run to its last
+ *              instruction, and one instruction more must be refused.
+ *              One control loop, written for the base and for the
+ *              extended ISA, must drive the robot the same way; the
+ *              instructions each version executed are reported.
+ *
+ * Build:       gcc -O2 robomal_bench.c robomal.c robomal_jit.c robomal_sched.c robomal_image.c -o robomal_bench
+ * Usage:       ./robomal_bench [instructions per program]
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "robomal.h"
+#include "robomal_image.h"
+#include "robomal_sched.h"
+
+#define DEFAULT_TARGET_INSTRUCTIONS 50000000ull
+#define LARGE_BODY_INSTRUCTIONS 20000
+#define SCHED_QUANTUM 7                 // Odd, so slices end mid-loop and mid-call
+
+// ROBO_Instructions / ROBO_Data from Lab_4/robomal.S
+static const uint16_t sample_instructions[] = {0x1002, 0x1202, 0x2100, 0x310C, 0x415A, 0x300E, 0x405A, 0x4201, 0x4403, 0x3300};
+static const uint16_t sample_data[] = {0x0080, 0x0000};
+
+// Countdown: load counter, subtract 1 until zero, 2 instructions per pass
+static const uint16_t countdown_instructions[] =
+{
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, 0),
+    ROBOMAL_INSTRUCTION(ROBOMAL_SUBTRACT, 2),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRANCHNE, 2),
+    ROBOMAL_INSTRUCTION(ROBOMAL_HALT, 0)
+};
+static const uint16_t countdown_data[] = {0xFFFF, 0x0001, 0x0000};
+
+// Extended ISA: a subroutine walks a table above the direct range through
+// a pointer, rewriting each entry and steering on its sign. Same program
+// as steer.rasm with more passes.
+#define STEER_TABLE 0x100
+#define STEER_TABLE_END 0x110
+
+static const uint16_t steer_instructions[] =
+{
+    ROBOMAL_INSTRUCTION(ROBOMAL_CALL, 0x0C),                // 00 loop
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, 0),
+    ROBOMAL_INSTRUCTION(ROBOMAL_SUBTRACT_IMMEDIATE, 1),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE, 0),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRANCHNE, 0x00),
+    ROBOMAL_INSTRUCTION(ROBOMAL_HALT, 0),
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD_INDIRECT, 2),          // 0C step
+    ROBOMAL_INSTRUCTION(ROBOMAL_ADD_IMMEDIATE, 0x25),
+    ROBOMAL_INSTRUCTION(ROBOMAL_MULTIPLY_IMMEDIATE, 3),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE_INDIRECT, 2),
+    ROBOMAL_INSTRUCTION(ROBOMAL_SUBTRACT_IMMEDIATE, 0x80),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRANCHLT, 0x1C),
+    ROBOMAL_INSTRUCTION(ROBOMAL_FORWARD, 1),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRANCH, 0x1E),
+    ROBOMAL_INSTRUCTION(ROBOMAL_LEFT, 1),                   // 1C slow
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, 2),                   // 1E next
+    ROBOMAL_INSTRUCTION(ROBOMAL_ADD_IMMEDIATE, 2),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE, 2),
+    ROBOMAL_INSTRUCTION(ROBOMAL_SUBTRACT, 6),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRANCHLT, 0x2C),
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, 4),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE, 2),
+    ROBOMAL_INSTRUCTION(ROBOMAL_RETURN, 0)                  // 2C done
+};
+static const uint16_t steer_data[STEER_TABLE_END / 2] =
+{
+    0x4000, STEER_TABLE, STEER_TABLE, STEER_TABLE_END, 0x0000,
+    [STEER_TABLE / 2] = 0x0010, 0x0090, 0x0030, 0x0100, 0x0005, 0x00F0, 0x0070, 0x0040
+};
+
+// One control loop in both ISAs: step the position toward the setpoint,
+// driving forward below it and backward above it, and on reaching it
+// brake and swap the setpoint with the other one. Word-spaced slots,
+// since add and subtract read a word.
+#define TRACK_COUNT 0x00
+#define TRACK_POSITION 0x04
+#define TRACK_SETPOINT 0x08
+#define TRACK_OTHER 0x0C
+#define TRACK_TEMP 0x10
+#define TRACK_ONE 0x14              // Constants and counters the base ISA needs
+#define TRACK_LEFT 0x18
+#define TRACK_RIGHT 0x1C
+
+static const uint16_t track_data[] = {0x0400, 0, 0x0020, 0, 0x0030, 0, 0x0010, 0, 0, 0, 1, 0, 0, 0, 0, 0};
+
+// The extended ISA tests the sign of position - setpoint with branchlt
+static const uint16_t track_extended_instructions[] =
+{
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_POSITION),          // 00 loop
+    ROBOMAL_INSTRUCTION(ROBOMAL_SUBTRACT, TRACK_SETPOINT),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRANCHLT, 0x22),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRANCHNE, 0x18),
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_SETPOINT),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE, TRACK_TEMP),
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_OTHER),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE, TRACK_SETPOINT),
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_TEMP),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE, TRACK_OTHER),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRAKE, 0),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRANCH, 0x2A),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BACKWARD, 1),                   // 18 above
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_POSITION),
+    ROBOMAL_INSTRUCTION(ROBOMAL_SUBTRACT_IMMEDIATE, 1),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE, TRACK_POSITION),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRANCH, 0x2A),
+    ROBOMAL_INSTRUCTION(ROBOMAL_FORWARD, 1),                    // 22 below
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_POSITION),
+    ROBOMAL_INSTRUCTION(ROBOMAL_ADD_IMMEDIATE, 1),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE, TRACK_POSITION),
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_COUNT),             // 2A next
+    ROBOMAL_INSTRUCTION(ROBOMAL_SUBTRACT_IMMEDIATE, 1),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE, TRACK_COUNT),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRANCHNE, 0x00),
+    ROBOMAL_INSTRUCTION(ROBOMAL_HALT, 0)
+};
+
+// The base ISA only branches on zero, so it finds which of position and
+// setpoint is smaller by counting both down until one reaches zero
+static const uint16_t track_base_instructions[] =
+{
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_POSITION),          // 00 loop
+    ROBOMAL_INSTRUCTION(ROBOMAL_SUBTRACT, TRACK_SETPOINT),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRANCHNE, 0x16),
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_SETPOINT),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE, TRACK_TEMP),
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_OTHER),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE, TRACK_SETPOINT),
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_TEMP),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE, TRACK_OTHER),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRAKE, 0),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRANCH, 0x46),
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_POSITION),          // 16 compare
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE, TRACK_LEFT),
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_SETPOINT),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE, TRACK_RIGHT),
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_LEFT),              // 1E count
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRANCHEQ, 0x3E),
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_RIGHT),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRANCHEQ, 0x34),
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_LEFT),
+    ROBOMAL_INSTRUCTION(ROBOMAL_SUBTRACT, TRACK_ONE),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE, TRACK_LEFT),
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_RIGHT),
+    ROBOMAL_INSTRUCTION(ROBOMAL_SUBTRACT, TRACK_ONE),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE, TRACK_RIGHT),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRANCH, 0x1E),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BACKWARD, 1),                   // 34 above
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_POSITION),
+    ROBOMAL_INSTRUCTION(ROBOMAL_SUBTRACT, TRACK_ONE),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE, TRACK_POSITION),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRANCH, 0x46),
+    ROBOMAL_INSTRUCTION(ROBOMAL_FORWARD, 1),                    // 3E below
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_POSITION),
+    ROBOMAL_INSTRUCTION(ROBOMAL_ADD, TRACK_ONE),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE, TRACK_POSITION),
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, TRACK_COUNT),             // 46 next
+    ROBOMAL_INSTRUCTION(ROBOMAL_SUBTRACT, TRACK_ONE),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE, TRACK_COUNT),
+    ROBOMAL_INSTRUCTION(ROBOMAL_BRANCHNE, 0x00),
+    ROBOMAL_INSTRUCTION(ROBOMAL_HALT, 0)
+};
+
+// Programs that stop on a fault, or meet opcodes their ISA lacks
+static const uint16_t recurse_instructions[] = {ROBOMAL_INSTRUCTION(ROBOMAL_CALL, 0)};
+static const uint16_t underflow_instructions[] =
+{
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD_IMMEDIATE, 7),
+    ROBOMAL_INSTRUCTION(ROBOMAL_RETURN, 0)
+};
+static const uint16_t wild_pointer_instructions[] =
+{
+    ROBOMAL_INSTRUCTION(ROBOMAL_LOAD_INDIRECT, 0),
+    ROBOMAL_INSTRUCTION(ROBOMAL_STORE_INDIRECT, 2),
+    ROBOMAL_INSTRUCTION(ROBOMAL_HALT, 0)
+};
+static const uint16_t wild_pointer_data[] = {ROBOMAL_DATA_SIZE - 2, ROBOMAL_DATA_SIZE - 1};
+
+typedef struct
+{
+    const char *name;
+    const uint16_t *instructions;
+    uint32_t instruction_count;
+    const uint16_t *data;
+    uint32_t data_count;
+} bench_program_t;
+
+typedef struct
+{
+    bench_program_t program;
+    uint32_t isa;
+    robomal_status_t status;    // How every engine must stop
+} fault_case_t;
+
+typedef struct
+{
+    const char *name;
+    robomal_status_t (*run)(robomal_t *robo, uint64_t max_cycles);
+} bench_mode_t;
+
+// The first mode is the baseline the others are compared against
+static const bench_mode_t modes[] =
+{
+    {"interpreter", robomal_run},
+    {"threaded", robomal_run_threaded},
+    {"jit", robomal_run_jit}
+};
+
+static uint32_t pin_state = 0;
+
+/************************************************************
+ * Function: bench_read_pins
+ * Description: PMODB stand-in that toggles input pin 8 on every
+ *              read so the sample program takes both branches.
+ ************************************************************/
+static uint32_t bench_read_pins(void *context)
+{
+    (void)context;
+    pin_state ^= 0x80;
+    return pin_state;
+}
+
+/************************************************************
+ * Function: bench_motion
+ * Description: Folds every motion command into the hash at
+ *              context, so two runs can be compared.
+ ************************************************************/
+static void bench_motion(void *context, uint8_t opcode, uint8_t operand)
+{
+    uint64_t *hash = context;
+    *hash = (*hash ^ ((opcode << 8) | operand)) * 1099511628211ull;
+}
+
+/************************************************************
+ * Function: build_large_body
+ * Description: Generates a loop whose body is a long run of
+ *              pseudo-random data/math/robot instructions,
+ *              closed by a counter decrement and branchne back
+ *              to the start.
+ * Input parameters:
+ *      - instructions: Output buffer
+ * Returns: uint32_t - Number of instructions generated
+ ************************************************************/
+static uint32_t build_large_body(uint16_t *instructions)
+{
+    static const uint8_t body_opcodes[] =
+    {
+        ROBOMAL_LOAD, ROBOMAL_STORE, ROBOMAL_ADD, ROBOMAL_SUBTRACT, ROBOMAL_MULTIPLY,
+        ROBOMAL_WRITE, ROBOMAL_READ, ROBOMAL_FORWARD, ROBOMAL_LEFT
+    };
+    uint32_t seed = 12345;
+    uint32_t count = 0;
+
+    for(uint32_t i = 0; i < LARGE_BODY_INSTRUCTIONS; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        uint8_t opcode = body_opcodes[(seed >> 16) % sizeof(body_opcodes)];
+        uint8_t operand = 8 + ((seed >> 8) % 60) * 2;      // even offsets 8-126, clear of the counter
+
+        instructions[count++] = ROBOMAL_INSTRUCTION(opcode, operand);
+    }
+
+    instructions[count++] = ROBOMAL_INSTRUCTION(ROBOMAL_LOAD, 0);
+    instructions[count++] = ROBOMAL_INSTRUCTION(ROBOMAL_SUBTRACT, 2);
+    instructions[count++] = ROBOMAL_INSTRUCTION(ROBOMAL_STORE, 0);
+    instructions[count++] = ROBOMAL_INSTRUCTION(ROBOMAL_BRANCHNE, 0);
+    instructions[count++] = ROBOMAL_INSTRUCTION(ROBOMAL_HALT, 0);
+
+    return count;
+}
+
+/************************************************************
+ * Function: seconds_now
+ * Description: Monotonic wall clock in seconds.
+ ************************************************************/
+static double seconds_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/************************************************************
+ * Function: state_signature
+ * Description: Hashes the architectural state after a run so
+ *              engines can be compared.
+ ************************************************************/
+static uint64_t state_signature(const robomal_t *robo)
+{
+    uint64_t hash = 1469598103934665603ull;
+    uint32_t words[] = {robo->accumulator, robo->pc, robo->multiply_high, robo->instruction,
+                        robo->invalid_opcodes, (uint32_t)robo->cycles, robo->call_depth};
+
+    for(uint32_t i = 0; i < sizeof(words) / sizeof(words[0]); i++)
+    {
+        hash = (hash ^ words[i]) * 1099511628211ull;
+    }
+
+    for(uint32_t i = 0; i < ROBOMAL_DATA_SIZE; i++)
+    {
+        hash = (hash ^ robo->data[i]) * 1099511628211ull;
+    }
+
+    return hash;
+}
+
+/************************************************************
+ * Function: bench_program
+ * Description: Runs a program to completion repeatedly under
+ *              one engine until at least target instructions
+ *              have executed and prints the throughput.
+ * Input parameters:
+ *      - program: Program to run
+ *      - mode: Execution engine
+ *      - target: Minimum number of instructions to execute
+ *      - signature: Output, state signature of a single run
+ * Returns: double - Instructions per second, 0 on failure
+ ************************************************************/
+static double bench_program(const bench_program_t *program, const bench_mode_t *mode, uint64_t target,
+                            uint64_t *signature)
+{
+    static robomal_t robo;
+    robomal_io_t io = {bench_read_pins, NULL, NULL, NULL};
+    uint64_t executed = 0;
+    uint32_t runs = 0;
+
+    robomal_init(&robo, program->instructions, program->instruction_count, program->data, program->data_count, &io);
+
+    // Load-time work (pre-decoding) is not part of the measurement
+    pin_state = 0;
+    if(mode->run(&robo, 0) != ROBOMAL_HALTED)
+    {
+        printf("%-12s %-12s did not halt (pc = %x)\n", program->name, mode->name, robo.pc);
+        robomal_release(&robo);
+        return 0;
+    }
+    *signature = state_signature(&robo);
+
+    double start = seconds_now();
+
+    while(executed < target)
+    {
+        robomal_reset(&robo);
+        mode->run(&robo, 0);
+        executed += robo.cycles;
+        runs++;
+    }
+
+    double elapsed = seconds_now() - start;
+
+    robomal_release(&robo);
+
+    printf("%-12s %-12s %12llu %8u %10.3f %10.1f", program->name, mode->name, (unsigned long long)executed,
+           runs, elapsed, executed / elapsed / 1e6);
+
+    return executed / elapsed;
+}
+
+/************************************************************
+ * Function: check_faults
+ * Description: Runs each fault case once under every engine
+ *              and checks the status and final state.
+ * Input parameters: None
+ * Returns: uint32_t - Number of engine runs that disagreed
+ ************************************************************/
+static uint32_t check_faults()
+{
+    static const fault_case_t cases[] =
+    {
+        {{"recurse", recurse_instructions, 1, NULL, 0}, ROBOMAL_ISA_EXTENDED, ROBOMAL_STACK_OVERFLOW},
+        {{"underflow", underflow_instructions, 2, NULL, 0}, ROBOMAL_ISA_EXTENDED, ROBOMAL_STACK_UNDERFLOW},
+        {{"wild_pointer", wild_pointer_instructions, 3, wild_pointer_data, 2}, ROBOMAL_ISA_EXTENDED,
+         ROBOMAL_DATA_OUT_OF_RANGE},
+        {{"base_isa", steer_instructions, sizeof(steer_instructions) / 2, steer_data, sizeof(steer_data) / 2},
+         ROBOMAL_ISA_BASE, ROBOMAL_CYCLE_LIMIT}
+    };
+    static robomal_t robo;
+    uint32_t failures = 0;
+
+    for(uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        const bench_program_t *program = &cases[i].program;
+        uint64_t baseline_signature = 0;
+
+        for(uint32_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+        {
+            robomal_init(&robo, program->instructions, program->instruction_count, program->data, program->data_count,
+                         NULL);
+            robomal_set_isa(&robo, cases[i].isa);
+
+            robomal_status_t status = modes[m].run(&robo, 1000);
+            uint64_t signature = state_signature(&robo);
+
+            if(m == 0)
+            {
+                baseline_signature = signature;
+            }
+
+            if(status != cases[i].status || signature != baseline_signature)
+            {
+                printf("%-12s %-12s stopped with status %u at pc %x%s\n", program->name, modes[m].name, status, robo.pc,
+                       signature == baseline_signature ? "" : "  STATE MISMATCH");
+                failures++;
+            }
+
+            robomal_release(&robo);
+        }
+    }
+
+    return failures;
+}
+
+/************************************************************
+ * Function: check_scheduler
+ * Description: Time-slices the programs together under every
+ *              engine and checks each context ends in the state
+ *              of an interpreter run of it alone, with its
+ *              instruction count equal to its cycles.
+ * Input parameters:
+ *      - programs: Programs to run together
+ *      - count: Number of programs, at most
+ *               ROBOMAL_SCHED_MAX_CONTEXTS
+ * Returns: uint32_t - Number of contexts that disagreed
+ ************************************************************/
+static uint32_t check_scheduler(const bench_program_t *programs, uint32_t count)
+{
+    static robomal_t robos[ROBOMAL_SCHED_MAX_CONTEXTS];
+    uint64_t solo_signatures[ROBOMAL_SCHED_MAX_CONTEXTS];
+    robomal_sched_t sched;
+    uint32_t failures = 0;
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        const bench_program_t *program = &programs[i];
+
+        robomal_init(&robos[i], program->instructions, program->instruction_count, program->data, program->data_count,
+                     NULL);
+        robomal_run(&robos[i], 0);
+        solo_signatures[i] = state_signature(&robos[i]);
+        robomal_release(&robos[i]);
+    }
+
+    for(uint32_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+    {
+        robomal_sched_init(&sched, SCHED_QUANTUM, modes[m].run);
+
+        for(uint32_t i = 0; i < count; i++)
+        {
+            const bench_program_t *program = &programs[i];
+
+            robomal_init(&robos[i], program->instructions, program->instruction_count, program->data,
+                         program->data_count, NULL);
+            robomal_sched_add(&sched, &robos[i]);
+        }
+
+        robomal_sched_run(&sched);
+
+        for(uint32_t i = 0; i < count; i++)
+        {
+            const robomal_context_t *context = &sched.contexts[i];
+
+            if(state_signature(context->robo) != solo_signatures[i] || context->instructions != context->robo->cycles)
+            {
+                printf("%-12s %-12s scheduled: %llu instructions in %u slices  STATE MISMATCH\n", programs[i].name,
+                       modes[m].name, (unsigned long long)context->instructions, context->slices);
+                failures++;
+            }
+
+            robomal_release(&robos[i]);
+        }
+    }
+
+    return failures;
+}
+
+/************************************************************
+ * Function: check_image_limits
+ * Description: Builds an image of ROBOMAL_MAX_INSTRUCTIONS
+ *              instructions that calls from its second to last
+ *              instruction and halts on its last, loads it back
+ *              and runs it under every engine. An image one
+ *              instruction longer must not build: its code size
+ *              does not fit the 16-bit header field.
+ * Input parameters: None
+ * Returns: uint32_t - Number of checks that failed
+ ************************************************************/
+static uint32_t check_image_limits()
+{
+    static uint16_t instructions[ROBOMAL_MAX_INSTRUCTIONS + 1];
+    static uint16_t loaded[ROBOMAL_MAX_INSTRUCTIONS];
+    static uint16_t data[ROBOMAL_DATA_SIZE / 2];
+    static uint8_t image[ROBOMAL_IMAGE_HEADER_SIZE + (ROBOMAL_MAX_INSTRUCTIONS + 1) * 2];
+    static robomal_t robo;
+    const uint32_t last = ROBOMAL_MAX_INSTRUCTIONS - 1;
+    uint32_t instruction_count = 0;
+    uint32_t data_count = 0;
+    uint32_t isa = 0;
+    uint32_t failures = 0;
+
+    // Skip the subroutine at 2, run straight down to the call, return and halt
+    instructions[0] = ROBOMAL_INSTRUCTION(ROBOMAL_BRANCH, 4);
+    instructions[1] = ROBOMAL_INSTRUCTION(ROBOMAL_RETURN, 0);
+
+    for(uint32_t i = 2; i < last - 1; i++)
+    {
+        instructions[i] = ROBOMAL_INSTRUCTION(ROBOMAL_LOAD_IMMEDIATE, i);
+    }
+
+    instructions[last - 1] = ROBOMAL_INSTRUCTION(ROBOMAL_CALL, 2);
+    instructions[last] = ROBOMAL_INSTRUCTION(ROBOMAL_HALT, 0);
+    instructions[last + 1] = ROBOMAL_INSTRUCTION(ROBOMAL_HALT, 0);
+
+    if(robomal_image_build(image, sizeof(image), instructions, ROBOMAL_MAX_INSTRUCTIONS + 1, NULL, 0,
+                           ROBOMAL_ISA_EXTENDED) != 0)
+    {
+        printf("image of %u instructions built\n", ROBOMAL_MAX_INSTRUCTIONS + 1);
+        failures++;
+    }
+
+    size_t size = robomal_image_build(image, sizeof(image), instructions, ROBOMAL_MAX_INSTRUCTIONS, NULL, 0,
+                                      ROBOMAL_ISA_EXTENDED);
+    robomal_image_status_t status = robomal_image_load(image, size, loaded, &instruction_count, data, &data_count,
+                                                       &isa);
+
+    if(status != ROBOMAL_IMAGE_OK || instruction_count != ROBOMAL_MAX_INSTRUCTIONS)
+    {
+        printf("image of %u instructions: %s\n", ROBOMAL_MAX_INSTRUCTIONS, robomal_image_error(status));
+        return failures + 1;
+    }
+
+    for(uint32_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+    {
+        robomal_init(&robo, loaded, instruction_count, data, data_count, NULL);
+        robomal_set_isa(&robo, isa);
+
+        robomal_status_t run_status = modes[m].run(&robo, 0);
+
+        if(run_status != ROBOMAL_HALTED || robo.pc != last * 2 + 2 || robo.cycles != last + 1)
+        {
+            printf("%-12s %-12s stopped with status %u at pc %x\n", "max_program", modes[m].name, run_status,
+                   robo.pc);
+            failures++;
+        }
+
+        robomal_release(&robo);
+    }
+
+    return failures;
+}
+
+/************************************************************
+ * Function: compare_isas
+ * Description: Runs the control loop written for each ISA
+ *              under the ISA it was written for, checks both
+ *              give the same motion commands and end state,
+ *              and reports the instructions each executed.
+ * Input parameters: None
+ * Returns: uint32_t - 1 if the versions disagreed, else 0
+ ************************************************************/
+static uint32_t compare_isas()
+{
+    static const fault_case_t versions[] =
+    {
+        {{"track_base", track_base_instructions, sizeof(track_base_instructions) / 2, track_data,
+          sizeof(track_data) / 2}, ROBOMAL_ISA_BASE, ROBOMAL_HALTED},
+        {{"track_ext", track_extended_instructions, sizeof(track_extended_instructions) / 2, track_data,
+          sizeof(track_data) / 2}, ROBOMAL_ISA_EXTENDED, ROBOMAL_HALTED}
+    };
+    static robomal_t robo;
+    uint64_t executed[2];
+    uint64_t motions[2];
+    uint32_t state[2][3];
+
+    for(uint32_t i = 0; i < 2; i++)
+    {
+        const bench_program_t *program = &versions[i].program;
+        robomal_io_t io = {NULL, NULL, bench_motion, &motions[i]};
+
+        motions[i] = 1469598103934665603ull;
+        robomal_init(&robo, program->instructions, program->instruction_count, program->data, program->data_count,
+                     &io);
+        robomal_set_isa(&robo, versions[i].isa);
+
+        if(robomal_run_threaded(&robo, 0) != versions[i].status)
+        {
+            printf("%-12s did not halt (pc = %x)\n", program->name, robo.pc);
+            robomal_release(&robo);
+            return 1;
+        }
+
+        executed[i] = robo.cycles;
+        state[i][0] = robo.data[TRACK_POSITION] | (robo.data[TRACK_POSITION + 1] << 8);
+        state[i][1] = robo.data[TRACK_SETPOINT] | (robo.data[TRACK_SETPOINT + 1] << 8);
+        state[i][2] = robo.data[TRACK_OTHER] | (robo.data[TRACK_OTHER + 1] << 8);
+        robomal_release(&robo);
+
+        printf("%-12s %-12s %12llu instructions %6u words\n", program->name,
+               versions[i].isa == ROBOMAL_ISA_BASE ? "base ISA" : "extended ISA", (unsigned long long)executed[i],
+               program->instruction_count);
+    }
+
+    if(motions[0] != motions[1] || state[0][0] != state[1][0] || state[0][1] != state[1][1] ||
+       state[0][2] != state[1][2])
+    {
+        printf("control loop versions disagree  STATE MISMATCH\n");
+        return 1;
+    }
+
+    printf("extended ISA runs the control loop in %.2fx fewer instructions\n\n",
+           (double)executed[0] / executed[1]);
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t target = argc > 1 ? strtoull(argv[1], NULL, 0) : DEFAULT_TARGET_INSTRUCTIONS;
+    static uint16_t large_body_instructions[LARGE_BODY_INSTRUCTIONS + 8];
+    static const uint16_t large_body_data[] = {100, 1, 0};
+
+    bench_program_t programs[] =
+    {
+        {"sample", sample_instructions, sizeof(sample_instructions) / 2, sample_data, sizeof(sample_data) / 2},
+        {"countdown", countdown_instructions, sizeof(countdown_instructions) / 2, countdown_data, sizeof(countdown_data) / 2},
+        {"large_body", large_body_instructions, build_large_body(large_body_instructions), large_body_data, sizeof(large_body_data) / 2},
+        {"steer", steer_instructions, sizeof(steer_instructions) / 2, steer_data, sizeof(steer_data) / 2}
+    };
+
+    if(check_faults() || check_image_limits() || check_scheduler(programs, sizeof(programs) / sizeof(programs[0])) ||
+       compare_isas())
+    {
+        return 1;
+    }
+
+    printf("%-12s %-12s %12s %8s %10s %10s %8s\n", "program", "mode", "instructions", "runs", "seconds", "MIPS", "speedup");
+
+    for(uint32_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++)
+    {
+        double baseline_rate = 0;
+        uint64_t baseline_signature = 0;
+
+        for(uint32_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+        {
+            uint64_t signature = 0;
+            double rate = bench_program(&programs[i], &modes[m], target, &signature);
+
+            if(rate == 0)
+            {
+                continue;
+            }
+
+            if(m == 0)
+            {
+                baseline_rate = rate;
+                baseline_signature = signature;
+            }
+
+            printf(" %7.2fx%s\n", baseline_rate ? rate / baseline_rate : 0,
+                   signature == baseline_signature ? "" : "  STATE MISMATCH");
+        }
+    }
+
+    return 0;
+}
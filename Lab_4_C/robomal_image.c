@@ -0,0 +1,207 @@
+/*******************************************************************************
+ * Description: Reader and writer for ROBOMAL binary program images (see
+ *              robomal_image.h for the layout). Used by robomal_asm on the
+ *              host; load_program_image in Lab_4/robomal.S is the firmware
+ *              side of the same format.
+ ******************************************************************************/
+
+#include "robomal_image.h"
+#include "robomal.h"
+
+/************************************************************
+ * Function: put16/put32/get16/get32
+ * Description: Little-endian field access at any byte offset.
+ ************************************************************/
+static void put16(uint8_t *bytes, uint16_t value)
+{
+    bytes[0] = value & 0xFF;
+    bytes[1] = value >> 8;
+}
+
+static void put32(uint8_t *bytes, uint32_t value)
+{
+    put16(bytes, value & 0xFFFF);
+    put16(bytes + 2, value >> 16);
+}
+
+static uint16_t get16(const uint8_t *bytes)
+{
+    return bytes[0] | (bytes[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *bytes)
+{
+    return get16(bytes) | ((uint32_t)get16(bytes + 2) << 16);
+}
+
+/************************************************************
+ * Function: robomal_image_checksum
+ * Description: Rotating sum over halfwords: rotate left by one
+ *              bit, then add. Cheap on the board (ROR + ADD)
+ *              and, unlike a plain sum, catches swapped words.
+ * Input parameters:
+ *      - halfwords: Values to add
+ *      - count: Number of halfwords
+ *      - checksum: Running value, 0 to start
+ * Returns: uint32_t - Updated checksum
+ ************************************************************/
+uint32_t robomal_image_checksum(const uint16_t *halfwords, uint32_t count, uint32_t checksum)
+{
+    for(uint32_t i = 0; i < count; i++)
+    {
+        checksum = ((checksum << 1) | (checksum >> 31)) + halfwords[i];
+    }
+
+    return checksum;
+}
+
+/************************************************************
+ * Function: robomal_image_build
+ * Description: Writes a program image.
+ * Input parameters:
+ *      - image: Output buffer
+ *      - capacity: Size of image in bytes
+ *      - instructions: ROBO_Instructions halfwords
+ *      - instruction_count: Number of instructions
+ *      - data: ROBO_Data halfwords
+ *      - data_count: Number of data halfwords
+ *      - isa: ROBOMAL_ISA_* the program needs, the version
+ * Returns: size_t - Image size in bytes, 0 if it does not fit
+ *          in capacity or in the machine
+ ************************************************************/
+size_t robomal_image_build(uint8_t *image, size_t capacity, const uint16_t *instructions, uint32_t instruction_count,
+                           const uint16_t *data, uint32_t data_count, uint32_t isa)
+{
+    size_t size = ROBOMAL_IMAGE_HEADER_SIZE + (instruction_count + data_count) * 2;
+
+    if(size > capacity || instruction_count > ROBOMAL_MAX_INSTRUCTIONS || data_count * 2 > ROBOMAL_DATA_SIZE ||
+       isa < ROBOMAL_ISA_BASE || isa > ROBOMAL_IMAGE_VERSION)
+    {
+        return 0;
+    }
+
+    uint32_t checksum = robomal_image_checksum(instructions, instruction_count, 0);
+    checksum = robomal_image_checksum(data, data_count, checksum);
+
+    put32(image, ROBOMAL_IMAGE_MAGIC);
+    put16(image + 4, isa);
+    put16(image + 6, ROBOMAL_IMAGE_HEADER_SIZE);
+    put16(image + 8, instruction_count * 2);
+    put16(image + 10, data_count * 2);
+    put32(image + 12, checksum);
+
+    uint8_t *section = image + ROBOMAL_IMAGE_HEADER_SIZE;
+
+    for(uint32_t i = 0; i < instruction_count; i++, section += 2)
+    {
+        put16(section, instructions[i]);
+    }
+
+    for(uint32_t i = 0; i < data_count; i++, section += 2)
+    {
+        put16(section, data[i]);
+    }
+
+    return size;
+}
+
+/************************************************************
+ * Function: robomal_image_load
+ * Description: Validates an image and copies its sections out,
+ *              the same checks load_program_image makes.
+ * Input parameters:
+ *      - image: Image bytes
+ *      - size: Image size in bytes
+ *      - instructions: Output, room for ROBOMAL_MAX_INSTRUCTIONS
+ *      - instruction_count: Output, number of instructions
+ *      - data: Output, room for ROBOMAL_DATA_SIZE / 2 halfwords
+ *      - data_count: Output, number of data halfwords
+ *      - isa: Output, ROBOMAL_ISA_* to run the program with
+ * Returns: robomal_image_status_t - OK or the first problem found
+ ************************************************************/
+robomal_image_status_t robomal_image_load(const uint8_t *image, size_t size, uint16_t *instructions,
+                                          uint32_t *instruction_count, uint16_t *data, uint32_t *data_count,
+                                          uint32_t *isa)
+{
+    if(size < ROBOMAL_IMAGE_HEADER_SIZE)
+    {
+        return ROBOMAL_IMAGE_TRUNCATED;
+    }
+
+    if(get32(image) != ROBOMAL_IMAGE_MAGIC)
+    {
+        return ROBOMAL_IMAGE_BAD_MAGIC;
+    }
+
+    uint32_t version = get16(image + 4);
+
+    if(version < ROBOMAL_ISA_BASE || version > ROBOMAL_IMAGE_VERSION)
+    {
+        return ROBOMAL_IMAGE_BAD_VERSION;
+    }
+
+    uint32_t header_size = get16(image + 6);
+    uint32_t code_size = get16(image + 8);
+    uint32_t data_size = get16(image + 10);
+
+    if((header_size | code_size | data_size) & 1 || header_size < ROBOMAL_IMAGE_HEADER_SIZE)
+    {
+        return ROBOMAL_IMAGE_BAD_LAYOUT;
+    }
+
+    if(code_size > ROBOMAL_MAX_INSTRUCTIONS * 2 || data_size > ROBOMAL_DATA_SIZE)
+    {
+        return ROBOMAL_IMAGE_TOO_LARGE;
+    }
+
+    if(size < header_size + code_size + data_size)
+    {
+        return ROBOMAL_IMAGE_TRUNCATED;
+    }
+
+    const uint8_t *section = image + header_size;
+
+    for(uint32_t i = 0; i < code_size / 2; i++, section += 2)
+    {
+        instructions[i] = get16(section);
+    }
+
+    for(uint32_t i = 0; i < data_size / 2; i++, section += 2)
+    {
+        data[i] = get16(section);
+    }
+
+    uint32_t checksum = robomal_image_checksum(instructions, code_size / 2, 0);
+    checksum = robomal_image_checksum(data, data_size / 2, checksum);
+
+    if(checksum != get32(image + 12))
+    {
+        return ROBOMAL_IMAGE_BAD_CHECKSUM;
+    }
+
+    *instruction_count = code_size / 2;
+    *data_count = data_size / 2;
+    *isa = version;
+
+    return ROBOMAL_IMAGE_OK;
+}
+
+/************************************************************
+ * Function: robomal_image_error
+ * Description: Describes a robomal_image_load result.
+ ************************************************************/
+const char *robomal_image_error(robomal_image_status_t status)
+{
+    switch(status)
+    {
+        case ROBOMAL_IMAGE_OK: return "ok";
+        case ROBOMAL_IMAGE_TRUNCATED: return "image is truncated";
+        case ROBOMAL_IMAGE_BAD_MAGIC: return "not a ROBOMAL image";
+        case ROBOMAL_IMAGE_BAD_VERSION: return "unsupported image version";
+        case ROBOMAL_IMAGE_BAD_LAYOUT: return "sections are not halfword aligned";
+        case ROBOMAL_IMAGE_TOO_LARGE: return "program or data does not fit";
+        case ROBOMAL_IMAGE_BAD_CHECKSUM: return "checksum mismatch";
+    }
+
+    return "unknown error";
+}
@@ -0,0 +1,48 @@
+#ifndef ROBOMAL_IMAGE_H
+#define ROBOMAL_IMAGE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary program image loaded by load_program_image in Lab_4/robomal.S.
+// All fields are little-endian and every section starts on a halfword, so
+// the firmware copies the sections straight into ROBO_Instructions and
+// ROBO_Data without parsing them:
+//
+//   0x00  magic        "RBML"
+//   0x04  version      ROBOMAL_ISA_* the program needs, at most
+//                      ROBOMAL_IMAGE_VERSION
+//   0x06  header_size  offset of the code section (16)
+//   0x08  code_size    bytes of ROBO_Instructions, even
+//   0x0A  data_size    bytes of ROBO_Data, even
+//   0x0C  checksum     robomal_image_checksum over code then data
+//   header_size              code section
+//   header_size + code_size  data section
+//
+// Version 1 images only use the base instruction set, so older firmware
+// keeps loading them; the assembler writes version 2 only when a program
+// uses an extended opcode.
+#define ROBOMAL_IMAGE_MAGIC 0x4C4D4252
+#define ROBOMAL_IMAGE_VERSION 2
+#define ROBOMAL_IMAGE_HEADER_SIZE 16
+
+typedef enum
+{
+    ROBOMAL_IMAGE_OK,
+    ROBOMAL_IMAGE_TRUNCATED,        // Shorter than the header says
+    ROBOMAL_IMAGE_BAD_MAGIC,
+    ROBOMAL_IMAGE_BAD_VERSION,
+    ROBOMAL_IMAGE_BAD_LAYOUT,       // Odd sizes or offsets
+    ROBOMAL_IMAGE_TOO_LARGE,        // Code or data does not fit the machine
+    ROBOMAL_IMAGE_BAD_CHECKSUM
+} robomal_image_status_t;
+
+uint32_t robomal_image_checksum(const uint16_t *halfwords, uint32_t count, uint32_t checksum);
+size_t robomal_image_build(uint8_t *image, size_t capacity, const uint16_t *instructions, uint32_t instruction_count,
+                           const uint16_t *data, uint32_t data_count, uint32_t isa);
+robomal_image_status_t robomal_image_load(const uint8_t *image, size_t size, uint16_t *instructions,
+                                          uint32_t *instruction_count, uint16_t *data, uint32_t *data_count,
+                                          uint32_t *isa);
+const char *robomal_image_error(robomal_image_status_t status);
+
+#endif // ROBOMAL_IMAGE_H
@@ -0,0 +1,856 @@
+/*******************************************************************************
+ * Description: Basic-block translation backend for the ROBOMAL emulator.
+ *              Straight-line runs of ROBOMAL instructions, ending at a
+ *              branch or halt, are translated to x86-64 machine code on
+ *              first use and cached per block. The accumulator lives
+ *              in ebx and data memory is addressed off r12 for the whole
+ *              run. Block exits are rel32 jumps that start out pointing at a
+ *              link stub and are patched to jump straight to the target
+ *              block once it has been translated, so hot loops never leave
+ *              native code. The PC is only materialized when leaving
+ *              native code.
+ *
+ *              Results match robomal_run exactly, including max_cycles:
+ *              each block charges its length against the budget on entry,
+ *              and a block that does not fit is finished by robomal_run.
+ *              The instructions that can fault (loadind, storeind, call
+ *              and return) check inline and branch to a fault exit that
+ *              hands back the cycles of the rest of the block and leaves
+ *              the PC on them, as robomal_step does. return looks its
+ *              target up in the block table.
+ *
+ *              On hosts other than x86-64 Linux, robomal_run_jit falls back
+ *              to robomal_run_threaded.
+ ******************************************************************************/
+
+#include "robomal.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <sys/mman.h>
+
+#define JIT_CODE_SIZE (1024 * 1024)
+#define JIT_MAX_BLOCK_LENGTH 64
+#define JIT_MAX_BLOCK_BYTES (JIT_MAX_BLOCK_LENGTH * 80 + 192)
+
+// Why native code returned to C
+enum
+{
+    JIT_EXIT_HALT,
+    JIT_EXIT_END,       // Ran into the end marker past the program
+    JIT_EXIT_BUDGET,    // Next block does not fit in the cycle budget
+    JIT_EXIT_LINK,      // Jump to a block that is not translated yet
+    JIT_EXIT_FAULT      // Instruction at exit_pc faulted with status fault
+};
+
+// State shared with the generated code through r13
+typedef struct
+{
+    robomal_t *robo;            // r15
+    uint8_t *data;              // r12
+    uint64_t budget;            // r14
+    uint32_t accumulator;       // ebx
+    uint32_t exit_pc;
+    uint32_t target_index;
+    uint8_t *patch;             // rel32 field to point at the target block, NULL for return
+    uint32_t fault;             // robomal_status_t of JIT_EXIT_FAULT
+} jit_context_t;
+
+// Fault exit of one instruction, emitted after the block
+typedef struct
+{
+    uint8_t *patch;             // rel32 field of the jcc taken on the fault
+    uint32_t index;             // Instruction index
+    uint32_t refund;            // Cycles charged for it and the rest of the block
+    uint32_t status;
+} jit_fault_t;
+
+typedef struct
+{
+    jit_context_t context;
+    uint8_t *code;
+    size_t used;
+    size_t prologue_size;
+    uint8_t *exit_common;
+    uint8_t **blocks;           // Translated block per instruction index
+    uint32_t block_count;
+} robomal_jit_t;
+
+typedef uint32_t (*jit_enter_t)(jit_context_t *context, const uint8_t *block);
+
+/************************************************************
+ * Function: emit8/emit16/emit32/emit64
+ * Description: Append little-endian values to the code buffer.
+ ************************************************************/
+static inline void emit8(robomal_jit_t *jit, uint8_t value)
+{
+    jit->code[jit->used++] = value;
+}
+
+static inline void emit16(robomal_jit_t *jit, uint16_t value)
+{
+    memcpy(jit->code + jit->used, &value, 2);
+    jit->used += 2;
+}
+
+static inline void emit32(robomal_jit_t *jit, uint32_t value)
+{
+    memcpy(jit->code + jit->used, &value, 4);
+    jit->used += 4;
+}
+
+static inline void emit64(robomal_jit_t *jit, uint64_t value)
+{
+    memcpy(jit->code + jit->used, &value, 8);
+    jit->used += 8;
+}
+
+/************************************************************
+ * Function: emit_bytes
+ * Description: Append a fixed instruction encoding.
+ ************************************************************/
+static void emit_bytes(robomal_jit_t *jit, const uint8_t *bytes, uint32_t count)
+{
+    memcpy(jit->code + jit->used, bytes, count);
+    jit->used += count;
+}
+
+/************************************************************
+ * Function: patch_rel32
+ * Description: Points the rel32 field at patch to target.
+ ************************************************************/
+static void patch_rel32(uint8_t *patch, const uint8_t *target)
+{
+    int32_t offset = (int32_t)(target - (patch + 4));
+    memcpy(patch, &offset, 4);
+}
+
+/************************************************************
+ * Function: emit_jump_to_exit
+ * Description: mov eax, reason; jmp exit_common
+ ************************************************************/
+static void emit_jump_to_exit(robomal_jit_t *jit, uint32_t reason)
+{
+    emit8(jit, 0xB8);
+    emit32(jit, reason);
+    emit8(jit, 0xE9);
+    emit32(jit, 0);
+    patch_rel32(jit->code + jit->used - 4, jit->exit_common);
+}
+
+/************************************************************
+ * Function: emit_set_context32
+ * Description: mov dword [r13 + offset], value
+ ************************************************************/
+static void emit_set_context32(robomal_jit_t *jit, uint32_t offset, uint32_t value)
+{
+    static const uint8_t mov_r13[] = {0x41, 0xC7, 0x85};
+    emit_bytes(jit, mov_r13, sizeof(mov_r13));
+    emit32(jit, offset);
+    emit32(jit, value);
+}
+
+/************************************************************
+ * Function: emit_data_op
+ * Description: <op> ebx, [r12 + operand] for the data memory
+ *              opcodes, using the given opcode prefix bytes.
+ ************************************************************/
+static void emit_data_op(robomal_jit_t *jit, const uint8_t *opcode, uint32_t count, uint32_t operand)
+{
+    emit_bytes(jit, opcode, count);
+    emit8(jit, 0x9C);           // ModRM: ebx, [SIB + disp32]
+    emit8(jit, 0x24);           // SIB: base r12, no index
+    emit32(jit, operand);
+}
+
+/************************************************************
+ * Function: emit_call
+ * Description: Calls helper(robo, argument) from generated
+ *              code. rbx and r12-r15 are callee-saved.
+ ************************************************************/
+static void emit_call(robomal_jit_t *jit, void (*helper)(robomal_t*, uint32_t), uint32_t argument)
+{
+    static const uint8_t mov_rdi_r15[] = {0x4C, 0x89, 0xFF};
+    static const uint8_t call_rax[] = {0xFF, 0xD0};
+
+    emit_bytes(jit, mov_rdi_r15, sizeof(mov_rdi_r15));
+    emit8(jit, 0xBE);           // mov esi, argument
+    emit32(jit, argument);
+    emit8(jit, 0x48);           // mov rax, helper
+    emit8(jit, 0xB8);
+    emit64(jit, (uint64_t)(uintptr_t)helper);
+    emit_bytes(jit, call_rax, sizeof(call_rax));
+}
+
+/************************************************************
+ * Function: emit_link_stub
+ * Description: Emits the stub a block exit jumps to until the
+ *              target block exists. It records the rel32 field
+ *              to patch and the target, then leaves native code.
+ * Input parameters:
+ *      - jit: Translator
+ *      - patch: rel32 field of the exit jump
+ *      - target_index: Instruction index of the target block
+ ************************************************************/
+static void emit_link_stub(robomal_jit_t *jit, uint8_t *patch, uint32_t target_index)
+{
+    static const uint8_t mov_patch[] = {0x49, 0x89, 0x85};      // mov [r13 + disp32], rax
+
+    patch_rel32(patch, jit->code + jit->used);
+
+    emit8(jit, 0x48);           // mov rax, patch
+    emit8(jit, 0xB8);
+    emit64(jit, (uint64_t)(uintptr_t)patch);
+    emit_bytes(jit, mov_patch, sizeof(mov_patch));
+    emit32(jit, offsetof(jit_context_t, patch));
+    emit_set_context32(jit, offsetof(jit_context_t, target_index), target_index);
+    emit_jump_to_exit(jit, JIT_EXIT_LINK);
+}
+
+/************************************************************
+ * Function: emit_block_exit
+ * Description: Emits an exit jump (jmp or jcc rel32) to the
+ *              block at target_index, directly if translated,
+ *              otherwise via a link stub emitted later.
+ * Returns: uint8_t* - rel32 field needing a stub, or NULL
+ ************************************************************/
+static uint8_t *emit_block_exit(robomal_jit_t *jit, const uint8_t *jump, uint32_t count, uint32_t target_index)
+{
+    emit_bytes(jit, jump, count);
+    emit32(jit, 0);
+
+    uint8_t *patch = jit->code + jit->used - 4;
+
+    if(jit->blocks[target_index])
+    {
+        patch_rel32(patch, jit->blocks[target_index]);
+        return NULL;
+    }
+
+    return patch;
+}
+
+/************************************************************
+ * Helpers called from generated code for board I/O
+ ************************************************************/
+static void jit_read(robomal_t *robo, uint32_t operand)
+{
+    uint32_t value = (robo->io.read_pins ? robo->io.read_pins(robo->io.context) : 0) >> 4;
+    robo->data[operand] = value & 0xFF;
+    robo->data[operand + 1] = (value >> 8) & 0xFF;
+}
+
+static void jit_write(robomal_t *robo, uint32_t operand)
+{
+    if(robo->io.write_pins) robo->io.write_pins(robo->io.context, robo->data[operand] | (robo->data[operand + 1] << 8));
+}
+
+static void jit_motion(robomal_t *robo, uint32_t instruction)
+{
+    if(robo->io.motion) robo->io.motion(robo->io.context, instruction >> 8, instruction & 0xFF);
+}
+
+/************************************************************
+ * Function: emit_prologue
+ * Description: Emits the entry trampoline called from C as
+ *              jit_enter_t and the common exit that writes the
+ *              host registers back to the context.
+ ************************************************************/
+static void emit_prologue(robomal_jit_t *jit)
+{
+    static const uint8_t enter[] =
+    {
+        0x53,                           // push rbx
+        0x41, 0x54,                     // push r12
+        0x41, 0x55,                     // push r13
+        0x41, 0x56,                     // push r14
+        0x41, 0x57,                     // push r15
+        0x49, 0x89, 0xFD                // mov r13, rdi
+    };
+    static const uint8_t load_r15[] = {0x4D, 0x8B, 0xBD};
+    static const uint8_t load_r12[] = {0x4D, 0x8B, 0xA5};
+    static const uint8_t load_r14[] = {0x4D, 0x8B, 0xB5};
+    static const uint8_t load_ebx[] = {0x41, 0x8B, 0x9D};
+    static const uint8_t jmp_rsi[] = {0xFF, 0xE6};
+    static const uint8_t store_ebx[] = {0x41, 0x89, 0x9D};
+    static const uint8_t store_r14[] = {0x4D, 0x89, 0xB5};
+    static const uint8_t leave[] =
+    {
+        0x41, 0x5F,                     // pop r15
+        0x41, 0x5E,                     // pop r14
+        0x41, 0x5D,                     // pop r13
+        0x41, 0x5C,                     // pop r12
+        0x5B,                           // pop rbx
+        0xC3                            // ret
+    };
+
+    jit->used = 0;
+
+    emit_bytes(jit, enter, sizeof(enter));
+    emit_bytes(jit, load_r15, sizeof(load_r15));
+    emit32(jit, offsetof(jit_context_t, robo));
+    emit_bytes(jit, load_r12, sizeof(load_r12));
+    emit32(jit, offsetof(jit_context_t, data));
+    emit_bytes(jit, load_r14, sizeof(load_r14));
+    emit32(jit, offsetof(jit_context_t, budget));
+    emit_bytes(jit, load_ebx, sizeof(load_ebx));
+    emit32(jit, offsetof(jit_context_t, accumulator));
+    emit_bytes(jit, jmp_rsi, sizeof(jmp_rsi));
+
+    jit->exit_common = jit->code + jit->used;
+    emit_bytes(jit, store_ebx, sizeof(store_ebx));
+    emit32(jit, offsetof(jit_context_t, accumulator));
+    emit_bytes(jit, store_r14, sizeof(store_r14));
+    emit32(jit, offsetof(jit_context_t, budget));
+    emit_bytes(jit, leave, sizeof(leave));
+
+    jit->prologue_size = jit->used;
+}
+
+/************************************************************
+ * Function: block_opcode
+ * Description: Returns the opcode translate_block treats an
+ *              instruction as, 0 for one robo does not run.
+ ************************************************************/
+static uint8_t block_opcode(const robomal_t *robo, uint32_t index)
+{
+    uint8_t opcode = ((const uint8_t*)robo->instructions)[index * 2 + 1];
+
+    return robomal_opcode_allowed(robo, opcode) ? opcode : 0;
+}
+
+/************************************************************
+ * Function: emit_fault_check
+ * Description: Emits the jcc rel32 taken when the instruction
+ *              at index faults, to an exit emitted later by
+ *              emit_fault_exit.
+ * Input parameters:
+ *      - jit: Translator
+ *      - fault: Output, the exit to emit
+ *      - jump: jcc opcode bytes
+ *      - index: Instruction index
+ *      - end: Index just past the block
+ *      - status: Fault to report
+ ************************************************************/
+static void emit_fault_check(robomal_jit_t *jit, jit_fault_t *fault, const uint8_t *jump, uint32_t index,
+                             uint32_t end, robomal_status_t status)
+{
+    emit_bytes(jit, jump, 2);
+    emit32(jit, 0);
+
+    fault->patch = jit->code + jit->used - 4;
+    fault->index = index;
+    fault->refund = end - index;
+    fault->status = status;
+}
+
+/************************************************************
+ * Function: emit_fault_exit
+ * Description: Emits a fault exit: gives back the cycles of
+ *              the faulting instruction and everything after it
+ *              in the block, and leaves with the instruction
+ *              fetched and the PC on it, like fault().
+ ************************************************************/
+static void emit_fault_exit(robomal_jit_t *jit, const jit_fault_t *fault, uint16_t instruction)
+{
+    static const uint8_t refund_budget[] = {0x49, 0x81, 0xC6};  // add r14, imm32
+    static const uint8_t store_instruction[] = {0x66, 0x41, 0xC7, 0x87}; // mov word [r15 + disp32], imm16
+
+    patch_rel32(fault->patch, jit->code + jit->used);
+
+    emit_bytes(jit, refund_budget, sizeof(refund_budget));
+    emit32(jit, fault->refund);
+    emit_bytes(jit, store_instruction, sizeof(store_instruction));
+    emit32(jit, offsetof(robomal_t, instruction));
+    emit16(jit, instruction);
+    emit_set_context32(jit, offsetof(jit_context_t, exit_pc), fault->index * 2);
+    emit_set_context32(jit, offsetof(jit_context_t, fault), fault->status);
+    emit_jump_to_exit(jit, JIT_EXIT_FAULT);
+}
+
+/************************************************************
+ * Function: flush_code_cache
+ * Description: Forgets every translated block.
+ ************************************************************/
+static void flush_code_cache(robomal_jit_t *jit)
+{
+    jit->used = jit->prologue_size;
+    memset(jit->blocks, 0, jit->block_count * sizeof(uint8_t*));
+}
+
+/************************************************************
+ * Function: translate_block
+ * Description: Translates the block starting at instruction
+ *              index and caches it.
+ * Input parameters:
+ *      - jit: Translator
+ *      - robo: Machine owning the program
+ *      - index: Instruction index of the block start
+ * Returns: uint8_t* - Native code of the block
+ ************************************************************/
+static uint8_t *translate_block(robomal_jit_t *jit, robomal_t *robo, uint32_t index)
+{
+    static const uint8_t load_op[] = {0x41, 0x0F, 0xB7};        // movzx ebx, word [r12 + disp32]
+    static const uint8_t store_op[] = {0x66, 0x41, 0x89};       // mov word [r12 + disp32], bx
+    static const uint8_t add_op[] = {0x41, 0x03};               // add ebx, [r12 + disp32]
+    static const uint8_t subtract_op[] = {0x41, 0x2B};          // sub ebx, [r12 + disp32]
+    static const uint8_t multiply_op[] = {0x41, 0x0F, 0xAF};    // imul ebx, [r12 + disp32]
+    static const uint8_t add_immediate[] = {0x81, 0xC3};        // add ebx, imm32
+    static const uint8_t subtract_immediate[] = {0x81, 0xEB};   // sub ebx, imm32
+    static const uint8_t multiply_immediate[] = {0x69, 0xDB};   // imul ebx, ebx, imm32
+    static const uint8_t multiply_high[] =
+    {
+        0x89, 0xD8,                     // mov eax, ebx
+        0xC1, 0xE8, 0x10,               // shr eax, 16
+        0x41, 0x89, 0x87                // mov [r15 + disp32], eax
+    };
+    static const uint8_t zero_extend[] = {0x0F, 0xB7, 0xDB};    // movzx ebx, bx
+    static const uint8_t count_invalid[] = {0x41, 0xFF, 0x87};  // inc dword [r15 + disp32]
+    static const uint8_t store_instruction[] = {0x66, 0x41, 0xC7, 0x87}; // mov word [r15 + disp32], imm16
+    static const uint8_t charge_budget[] = {0x49, 0x81, 0xEE};  // sub r14, imm32
+    static const uint8_t refund_budget[] = {0x49, 0x81, 0xC6};  // add r14, imm32
+    static const uint8_t jb[] = {0x0F, 0x82};
+    static const uint8_t test_ebx[] = {0x85, 0xDB};
+    static const uint8_t jz[] = {0x0F, 0x84};
+    static const uint8_t jnz[] = {0x0F, 0x85};
+    static const uint8_t js[] = {0x0F, 0x88};
+    static const uint8_t jns[] = {0x0F, 0x89};
+    static const uint8_t jmp[] = {0xE9};
+    static const uint8_t ja[] = {0x0F, 0x87};
+    static const uint8_t jae[] = {0x0F, 0x83};
+    static const uint8_t load_address[] = {0x41, 0x0F, 0xB7};   // movzx eax, word [r12 + disp32]
+    static const uint8_t load_indirect[] = {0x41, 0x0F, 0xB7, 0x1C, 0x04};     // movzx ebx, word [r12 + rax]
+    static const uint8_t store_indirect[] = {0x66, 0x41, 0x89, 0x1C, 0x04};    // mov word [r12 + rax], bx
+    static const uint8_t load_depth[] = {0x41, 0x8B, 0x87};     // mov eax, [r15 + disp32]
+    static const uint8_t store_depth[] = {0x41, 0x89, 0x87};    // mov [r15 + disp32], eax
+    static const uint8_t push_return[] = {0x66, 0x41, 0xC7, 0x84, 0x47};       // mov word [r15 + rax * 2 + disp32], imm16
+    static const uint8_t pop_return[] = {0x41, 0x0F, 0xB7, 0x84, 0x47};        // movzx eax, word [r15 + rax * 2 + disp32]
+    static const uint8_t test_eax[] = {0x85, 0xC0};
+    static const uint8_t decrement_eax[] = {0xFF, 0xC8};
+    static const uint8_t return_lookup[] =
+    {
+        0xD1, 0xE8,                     // shr eax, 1
+        0x48, 0x8B, 0x14, 0xC1,         // mov rdx, [rcx + rax * 8]
+        0x48, 0x85, 0xD2,               // test rdx, rdx
+        0x74, 0x02,                     // jz unlinked
+        0xFF, 0xE2                      // jmp rdx
+    };
+    static const uint8_t store_target[] = {0x41, 0x89, 0x85};   // mov [r13 + disp32], eax
+    static const uint8_t clear_patch[] = {0x49, 0xC7, 0x85};    // mov qword [r13 + disp32], imm32
+
+    const uint8_t *code = (const uint8_t*)robo->instructions;
+    uint8_t *pending_patch[2] = {NULL, NULL};
+    uint32_t pending_target[2] = {0, 0};
+    jit_fault_t faults[JIT_MAX_BLOCK_LENGTH];
+    uint32_t fault_count = 0;
+
+    if(jit->used + JIT_MAX_BLOCK_BYTES > JIT_CODE_SIZE)
+    {
+        flush_code_cache(jit);
+    }
+
+    uint8_t *block = jit->code + jit->used;
+    jit->blocks[index] = block;
+
+    // Running into the end marker leaves native code without using a cycle
+    if(index >= robo->instruction_count)
+    {
+        emit_set_context32(jit, offsetof(jit_context_t, exit_pc), index * 2);
+        emit_jump_to_exit(jit, JIT_EXIT_END);
+        return block;
+    }
+
+    // Block length: up to and including the terminator
+    uint32_t length = 0;
+    uint8_t last_opcode = 0;
+
+    while(index + length < robo->instruction_count && length < JIT_MAX_BLOCK_LENGTH)
+    {
+        last_opcode = block_opcode(robo, index + length);
+        length++;
+
+        if(last_opcode >= ROBOMAL_BRANCH && last_opcode <= ROBOMAL_RETURN)
+        {
+            break;
+        }
+    }
+
+    emit_bytes(jit, charge_budget, sizeof(charge_budget));
+    emit32(jit, length);
+    emit_bytes(jit, jb, sizeof(jb));
+    emit32(jit, 0);
+    uint8_t *budget_patch = jit->code + jit->used - 4;
+
+    for(uint32_t i = index; i < index + length; i++)
+    {
+        uint16_t instruction = code[i * 2] | (code[i * 2 + 1] << 8);
+        uint8_t opcode = block_opcode(robo, i);
+        uint32_t operand = instruction & 0xFF;
+
+        switch(opcode)
+        {
+            case ROBOMAL_READ:
+            emit_call(jit, jit_read, operand);
+            break;
+
+            case ROBOMAL_WRITE:
+            emit_call(jit, jit_write, operand);
+            break;
+
+            case ROBOMAL_LOAD:
+            emit_data_op(jit, load_op, sizeof(load_op), operand);
+            break;
+
+            case ROBOMAL_STORE:
+            emit_data_op(jit, store_op, sizeof(store_op), operand);
+            break;
+
+            case ROBOMAL_LOAD_INDIRECT:
+            case ROBOMAL_STORE_INDIRECT:
+            emit_bytes(jit, load_address, sizeof(load_address));
+            emit8(jit, 0x84);   // ModRM: eax, [SIB + disp32]
+            emit8(jit, 0x24);   // SIB: base r12, no index
+            emit32(jit, operand);
+            emit8(jit, 0x3D);   // cmp eax, imm32
+            emit32(jit, ROBOMAL_DATA_SIZE - 2);
+            emit_fault_check(jit, &faults[fault_count++], ja, i, index + length, ROBOMAL_DATA_OUT_OF_RANGE);
+
+            if(opcode == ROBOMAL_LOAD_INDIRECT)
+            {
+                emit_bytes(jit, load_indirect, sizeof(load_indirect));
+            }
+            else
+            {
+                emit_bytes(jit, store_indirect, sizeof(store_indirect));
+            }
+            break;
+
+            case ROBOMAL_LOAD_IMMEDIATE:
+            emit8(jit, 0xBB);   // mov ebx, imm32
+            emit32(jit, operand);
+            break;
+
+            case ROBOMAL_ADD:
+            emit_data_op(jit, add_op, sizeof(add_op), operand);
+            break;
+
+            case ROBOMAL_SUBTRACT:
+            emit_data_op(jit, subtract_op, sizeof(subtract_op), operand);
+            break;
+
+            case ROBOMAL_MULTIPLY:
+            emit_data_op(jit, multiply_op, sizeof(multiply_op), operand);
+            emit_bytes(jit, multiply_high, sizeof(multiply_high));
+            emit32(jit, offsetof(robomal_t, multiply_high));
+            emit_bytes(jit, zero_extend, sizeof(zero_extend));
+            break;
+
+            case ROBOMAL_ADD_IMMEDIATE:
+            emit_bytes(jit, add_immediate, sizeof(add_immediate));
+            emit32(jit, operand);
+            break;
+
+            case ROBOMAL_SUBTRACT_IMMEDIATE:
+            emit_bytes(jit, subtract_immediate, sizeof(subtract_immediate));
+            emit32(jit, operand);
+            break;
+
+            case ROBOMAL_MULTIPLY_IMMEDIATE:
+            emit_bytes(jit, multiply_immediate, sizeof(multiply_immediate));
+            emit32(jit, operand);
+            emit_bytes(jit, multiply_high, sizeof(multiply_high));
+            emit32(jit, offsetof(robomal_t, multiply_high));
+            emit_bytes(jit, zero_extend, sizeof(zero_extend));
+            break;
+
+            case ROBOMAL_LEFT:
+            case ROBOMAL_RIGHT:
+            case ROBOMAL_FORWARD:
+            case ROBOMAL_BACKWARD:
+            case ROBOMAL_BRAKE:
+            emit_call(jit, jit_motion, instruction);
+            break;
+
+            case ROBOMAL_BRANCH:
+            case ROBOMAL_BRANCHEQ:
+            case ROBOMAL_BRANCHNE:
+            case ROBOMAL_HALT:
+            case ROBOMAL_BRANCHLT:
+            case ROBOMAL_BRANCHGE:
+            case ROBOMAL_CALL:
+            case ROBOMAL_RETURN:
+            // Terminators are handled after the loop
+            break;
+
+            default:
+            emit_bytes(jit, count_invalid, sizeof(count_invalid));
+            emit32(jit, offsetof(robomal_t, invalid_opcodes));
+        }
+    }
+
+    // The last executed instruction is all that is kept of r7-r9
+    uint32_t last = index + length - 1;
+    uint16_t last_instruction = code[last * 2] | (code[last * 2 + 1] << 8);
+    uint32_t target = (last_instruction & 0xFF) / 2;
+    uint32_t fallthrough = last + 1;
+
+    emit_bytes(jit, store_instruction, sizeof(store_instruction));
+    emit32(jit, offsetof(robomal_t, instruction));
+    emit16(jit, last_instruction);
+
+    switch(last_opcode)
+    {
+        case ROBOMAL_HALT:
+        emit_set_context32(jit, offsetof(jit_context_t, exit_pc), fallthrough * 2);
+        emit_jump_to_exit(jit, JIT_EXIT_HALT);
+        break;
+
+        case ROBOMAL_BRANCH:
+        pending_patch[0] = emit_block_exit(jit, jmp, sizeof(jmp), target);
+        pending_target[0] = target;
+        break;
+
+        case ROBOMAL_BRANCHEQ:
+        case ROBOMAL_BRANCHNE:
+        case ROBOMAL_BRANCHLT:
+        case ROBOMAL_BRANCHGE:
+        {
+            static const uint8_t *const conditions[] = {jz, jnz, NULL, js, jns};
+
+            emit_bytes(jit, test_ebx, sizeof(test_ebx));
+            pending_patch[0] = emit_block_exit(jit, conditions[last_opcode - ROBOMAL_BRANCHEQ], 2, target);
+        pending_target[0] = target;
+            pending_patch[1] = emit_block_exit(jit, jmp, sizeof(jmp), fallthrough);
+            pending_target[1] = fallthrough;
+            break;
+        }
+
+        case ROBOMAL_CALL:
+        emit_bytes(jit, load_depth, sizeof(load_depth));
+        emit32(jit, offsetof(robomal_t, call_depth));
+        emit8(jit, 0x83);       // cmp eax, imm8
+        emit8(jit, 0xF8);
+        emit8(jit, ROBOMAL_CALL_DEPTH);
+        emit_fault_check(jit, &faults[fault_count++], jae, last, fallthrough, ROBOMAL_STACK_OVERFLOW);
+        emit_bytes(jit, push_return, sizeof(push_return));
+        emit32(jit, offsetof(robomal_t, return_stack));
+        emit16(jit, fallthrough * 2);
+        emit_bytes(jit, count_invalid, sizeof(count_invalid));     // inc call_depth
+        emit32(jit, offsetof(robomal_t, call_depth));
+        pending_patch[0] = emit_block_exit(jit, jmp, sizeof(jmp), target);
+        pending_target[0] = target;
+        break;
+
+        case ROBOMAL_RETURN:
+        // Jump straight to a translated target, otherwise link it
+        // through C without a site to patch
+        emit_bytes(jit, load_depth, sizeof(load_depth));
+        emit32(jit, offsetof(robomal_t, call_depth));
+        emit_bytes(jit, test_eax, sizeof(test_eax));
+        emit_fault_check(jit, &faults[fault_count++], jz, last, fallthrough, ROBOMAL_STACK_UNDERFLOW);
+        emit_bytes(jit, decrement_eax, sizeof(decrement_eax));
+        emit_bytes(jit, store_depth, sizeof(store_depth));
+        emit32(jit, offsetof(robomal_t, call_depth));
+        emit_bytes(jit, pop_return, sizeof(pop_return));
+        emit32(jit, offsetof(robomal_t, return_stack));
+        emit8(jit, 0x48);       // mov rcx, blocks
+        emit8(jit, 0xB9);
+        emit64(jit, (uint64_t)(uintptr_t)jit->blocks);
+        emit_bytes(jit, return_lookup, sizeof(return_lookup));
+        emit_bytes(jit, store_target, sizeof(store_target));
+        emit32(jit, offsetof(jit_context_t, target_index));
+        emit_bytes(jit, clear_patch, sizeof(clear_patch));
+        emit32(jit, offsetof(jit_context_t, patch));
+        emit32(jit, 0);
+        emit_jump_to_exit(jit, JIT_EXIT_LINK);
+        break;
+
+        default:
+        // Length limit or end of program, continue with the next block
+        pending_patch[0] = emit_block_exit(jit, jmp, sizeof(jmp), fallthrough);
+        pending_target[0] = fallthrough;
+    }
+
+    for(uint32_t i = 0; i < 2; i++)
+    {
+        if(pending_patch[i])
+        {
+            emit_link_stub(jit, pending_patch[i], pending_target[i]);
+        }
+    }
+
+    for(uint32_t i = 0; i < fault_count; i++)
+    {
+        uint32_t at = faults[i].index;
+        emit_fault_exit(jit, &faults[i], code[at * 2] | (code[at * 2 + 1] << 8));
+    }
+
+    // Not enough budget for this block: hand it back and let C finish
+    patch_rel32(budget_patch, jit->code + jit->used);
+    emit_bytes(jit, refund_budget, sizeof(refund_budget));
+    emit32(jit, length);
+    emit_set_context32(jit, offsetof(jit_context_t, exit_pc), index * 2);
+    emit_jump_to_exit(jit, JIT_EXIT_BUDGET);
+
+    return block;
+}
+
+/************************************************************
+ * Function: jit_create
+ * Description: Allocates the translator and its executable
+ *              code buffer for robo's program.
+ * Returns: robomal_jit_t* - Translator, NULL on failure
+ ************************************************************/
+static robomal_jit_t *jit_create(robomal_t *robo)
+{
+    robomal_jit_t *jit = calloc(1, sizeof(robomal_jit_t));
+
+    if(!jit)
+    {
+        return NULL;
+    }
+
+    jit->block_count = robo->decoded_count;
+    jit->blocks = calloc(jit->block_count, sizeof(uint8_t*));
+    jit->code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(!jit->blocks || jit->code == MAP_FAILED)
+    {
+        if(jit->code != MAP_FAILED) munmap(jit->code, JIT_CODE_SIZE);
+        free(jit->blocks);
+        free(jit);
+        return NULL;
+    }
+
+    emit_prologue(jit);
+
+    return jit;
+}
+
+/************************************************************
+ * Function: robomal_run_jit
+ * Description: Runs robo from its current PC with translated
+ *              blocks. Results match robomal_run for every
+ *              program robomal_predecode accepts.
+ * Input parameters:
+ *      - robo: Machine to run
+ *      - max_cycles: Cycle budget, 0 for no limit
+ * Returns: robomal_status_t - HALTED, PC_OUT_OF_RANGE,
+ *          CYCLE_LIMIT, a fault, or the error that prevented
+ *          running
+ ************************************************************/
+robomal_status_t robomal_run_jit(robomal_t *robo, uint64_t max_cycles)
+{
+    if(!robo->decoded)
+    {
+        robomal_status_t status = robomal_predecode(robo);
+
+        if(status != ROBOMAL_RUNNING && status != ROBOMAL_INVALID_OPCODE)
+        {
+            return status;
+        }
+    }
+
+    if(!robo->jit)
+    {
+        robo->jit = jit_create(robo);
+
+        if(!robo->jit)
+        {
+            return ROBOMAL_OUT_OF_MEMORY;
+        }
+    }
+
+    robomal_jit_t *jit = robo->jit;
+    jit_context_t *context = &jit->context;
+    jit_enter_t enter = (jit_enter_t)(void*)jit->code;
+    uint32_t index = robo->pc / 2;
+    uint32_t reason;
+
+    if(index >= jit->block_count)
+    {
+        return ROBOMAL_PC_OUT_OF_RANGE;
+    }
+
+    context->robo = robo;
+    context->data = robo->data;
+    context->budget = max_cycles ? max_cycles : UINT64_MAX;
+    context->accumulator = robo->accumulator;
+
+    uint64_t start_budget = context->budget;
+    uint64_t start_cycles = robo->cycles;
+    const uint8_t *block = jit->blocks[index] ? jit->blocks[index] : translate_block(jit, robo, index);
+
+    while((reason = enter(context, block)) == JIT_EXIT_LINK)
+    {
+        size_t used = jit->used;
+        index = context->target_index;
+        block = jit->blocks[index] ? jit->blocks[index] : translate_block(jit, robo, index);
+
+        // A flush while translating discards the code holding the patch site
+        if(context->patch && jit->used >= used)
+        {
+            patch_rel32(context->patch, block);
+        }
+    }
+
+    robo->accumulator = context->accumulator;
+    robo->pc = context->exit_pc;
+    robo->cycles = start_cycles + (start_budget - context->budget);
+    robo->opcode = robo->instruction >> 8;
+    robo->operand = robo->instruction & 0xFF;
+
+    switch(reason)
+    {
+        case JIT_EXIT_HALT:
+        return ROBOMAL_HALTED;
+
+        case JIT_EXIT_FAULT:
+        return context->fault;
+
+        case JIT_EXIT_END:
+        // robomal_run checks the budget before fetching
+        return context->budget ? ROBOMAL_PC_OUT_OF_RANGE : ROBOMAL_CYCLE_LIMIT;
+
+        default:
+        // Fewer cycles left than the next block holds
+        return context->budget ? robomal_run(robo, context->budget) : ROBOMAL_CYCLE_LIMIT;
+    }
+}
+
+/************************************************************
+ * Function: robomal_jit_release
+ * Description: Frees the translator and its code buffer.
+ * Input parameters:
+ *      - robo: Machine to release
+ * Returns: None
+ ************************************************************/
+void robomal_jit_release(robomal_t *robo)
+{
+    robomal_jit_t *jit = robo->jit;
+
+    if(jit)
+    {
+        munmap(jit->code, JIT_CODE_SIZE);
+        free(jit->blocks);
+        free(jit);
+        robo->jit = NULL;
+    }
+}
+
+#else
+
+robomal_status_t robomal_run_jit(robomal_t *robo, uint64_t max_cycles)
+{
+    return robomal_run_threaded(robo, max_cycles);
+}
+
+void robomal_jit_release(robomal_t *robo)
+{
+    (void)robo;
+}
+
+#endif
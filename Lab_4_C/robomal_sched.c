@@ -0,0 +1,116 @@
+#include "robomal_sched.h"
+
+/************************************************************
+ * Function: robomal_sched_init
+ * Description: Empties a scheduler.
+ * Input parameters:
+ *      - sched: Scheduler
+ *      - quantum: Instructions per slice, 0 is taken as 1
+ *      - run: Engine the slices run under, robomal_run,
+ *             robomal_run_threaded or robomal_run_jit
+ * Returns: None
+ ************************************************************/
+void robomal_sched_init(robomal_sched_t *sched, uint32_t quantum, robomal_engine_t run)
+{
+    sched->count = 0;
+    sched->running = 0;
+    sched->next = 0;
+    sched->quantum = quantum ? quantum : 1;
+    sched->run = run;
+}
+
+/************************************************************
+ * Function: robomal_sched_add
+ * Description: Adds an initialised machine as the last context.
+ * Input parameters:
+ *      - sched: Scheduler
+ *      - robo: Machine, must stay valid while scheduled
+ * Returns: bool - false if all contexts are in use
+ ************************************************************/
+bool robomal_sched_add(robomal_sched_t *sched, robomal_t *robo)
+{
+    if(sched->count == ROBOMAL_SCHED_MAX_CONTEXTS)
+    {
+        return false;
+    }
+
+    robomal_context_t *context = &sched->contexts[sched->count++];
+
+    context->robo = robo;
+    context->status = ROBOMAL_RUNNING;
+    context->instructions = 0;
+    context->slices = 0;
+    sched->running++;
+
+    return true;
+}
+
+/************************************************************
+ * Function: robomal_context_stopped
+ * Description: A context stops for good on halt, running off
+ *              its program or a fault. Running out of quantum
+ *              and skipping an invalid opcode do not stop it.
+ * Input parameters:
+ *      - context: Context
+ * Returns: bool - true if it gets no more slices
+ ************************************************************/
+bool robomal_context_stopped(const robomal_context_t *context)
+{
+    return context->status != ROBOMAL_RUNNING && context->status != ROBOMAL_CYCLE_LIMIT &&
+           context->status != ROBOMAL_INVALID_OPCODE;
+}
+
+/************************************************************
+ * Function: robomal_sched_slice
+ * Description: Runs one slice: the next context in round-robin
+ *              order that has not stopped runs for up to the
+ *              quantum. Its machine keeps its registers between
+ *              slices, so switching is only a change of machine.
+ * Input parameters:
+ *      - sched: Scheduler
+ * Returns: int32_t - Index of the context run, -1 if every
+ *          context has stopped
+ ************************************************************/
+int32_t robomal_sched_slice(robomal_sched_t *sched)
+{
+    if(!sched->running)
+    {
+        return -1;
+    }
+
+    while(robomal_context_stopped(&sched->contexts[sched->next]))
+    {
+        sched->next = (sched->next + 1) % sched->count;
+    }
+
+    uint32_t index = sched->next;
+    robomal_context_t *context = &sched->contexts[index];
+    uint64_t start = context->robo->cycles;
+
+    context->status = sched->run(context->robo, sched->quantum);
+    context->instructions += context->robo->cycles - start;
+    context->slices++;
+
+    if(robomal_context_stopped(context))
+    {
+        sched->running--;
+    }
+
+    sched->next = (index + 1) % sched->count;
+    return index;
+}
+
+/************************************************************
+ * Function: robomal_sched_run
+ * Description: Runs slices back to back until every context
+ *              has stopped, the unthrottled firmware schedule.
+ * Input parameters:
+ *      - sched: Scheduler
+ * Returns: None
+ ************************************************************/
+void robomal_sched_run(robomal_sched_t *sched)
+{
+    while(robomal_sched_slice(sched) >= 0)
+    {
+    }
+}
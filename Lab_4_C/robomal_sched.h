@@ -0,0 +1,43 @@
+#ifndef ROBOMAL_SCHED_H
+#define ROBOMAL_SCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "robomal.h"
+
+// Round-robin time slicing of several ROBOMAL machines, the host model of
+// ROBO_MODE_SCHEDULED in Lab_4/robomal.S. Each context is a whole machine
+// with its own program, data and register file; a slice runs the next
+// context that has not stopped for up to quantum instructions under any
+// of the execution engines. The firmware starts a slice on each global
+// timer tick; on the host the caller decides when robomal_sched_slice runs.
+
+#define ROBOMAL_SCHED_MAX_CONTEXTS 8
+
+typedef robomal_status_t (*robomal_engine_t)(robomal_t *robo, uint64_t max_cycles);
+
+typedef struct
+{
+    robomal_t *robo;            // Machine, owned by the caller
+    robomal_status_t status;    // Status of its last slice
+    uint64_t instructions;      // Executed over all its slices
+    uint32_t slices;
+} robomal_context_t;
+
+typedef struct
+{
+    robomal_context_t contexts[ROBOMAL_SCHED_MAX_CONTEXTS];
+    uint32_t count;
+    uint32_t running;           // Contexts that have not stopped
+    uint32_t next;              // Index the next slice looks from
+    uint32_t quantum;           // Instructions per slice, at least 1
+    robomal_engine_t run;
+} robomal_sched_t;
+
+void robomal_sched_init(robomal_sched_t *sched, uint32_t quantum, robomal_engine_t run);
+bool robomal_sched_add(robomal_sched_t *sched, robomal_t *robo);
+int32_t robomal_sched_slice(robomal_sched_t *sched);
+void robomal_sched_run(robomal_sched_t *sched);
+bool robomal_context_stopped(const robomal_context_t *context);
+
+#endif // ROBOMAL_SCHED_H
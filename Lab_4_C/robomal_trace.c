@@ -0,0 +1,263 @@
+/*******************************************************************************
+ * Description: Decoder for ROBOMAL trace dumps. Reads a UART capture
+ *              containing the output of dump_robo_trace (Lab_4/
+ *              robomal_trace.S), skips everything outside the
+ *              ROBO_TRACE ... ROBO_TRACE_END framing, and renders each
+ *              dump: the recorded instructions with their mnemonics and
+ *              the global timer ticks between them, the per-opcode counts
+ *              and the hottest PCs.
+ *
+ * Build:       gcc -O2 robomal_trace.c robomal.c robomal_jit.c -o robomal_trace
+ * Usage:       ./robomal_trace [capture.log]   (stdin if omitted)
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "robomal.h"
+
+#define TRACE_MAX_RECORDS 256       // ROBO_TRACE_ENTRIES
+#define TRACE_OPCODES 0x50
+#define TRACE_PCS 0x100
+#define HOT_PC_COUNT 10
+#define NS_PER_TICK 3               // Global timer runs at half the 666 MHz CPU clock
+
+typedef struct
+{
+    uint32_t pc;
+    uint32_t instruction;
+    uint32_t accumulator;
+    uint32_t multiply_high;
+    uint32_t timer;
+} trace_record_t;
+
+typedef struct
+{
+    uint32_t total;                 // Records written since reset
+    trace_record_t records[TRACE_MAX_RECORDS];
+    uint32_t record_count;
+    uint32_t opcode_counts[TRACE_OPCODES];
+    uint32_t pc_counts[TRACE_PCS];
+    uint32_t pc_instruction[TRACE_PCS];     // Instruction seen at each PC, for the hot list
+} trace_dump_t;
+
+/************************************************************
+ * Function: format_instruction
+ * Description: Renders an instruction with the robomal_debug.S
+ *              mnemonic, or the raw halfword if unknown.
+ ************************************************************/
+static void format_instruction(char *text, size_t size, uint32_t instruction)
+{
+    const char *mnemonic = robomal_mnemonic(instruction >> 8);
+
+    if(mnemonic)
+    {
+        snprintf(text, size, "%-9s 0x%02X", mnemonic, instruction & 0xFF);
+    }
+    else
+    {
+        snprintf(text, size, "0x%04X", instruction);
+    }
+}
+
+/************************************************************
+ * Function: print_dump
+ * Description: Renders one decoded dump.
+ ************************************************************/
+static void print_dump(const trace_dump_t *dump, uint32_t number)
+{
+    char text[32];
+    uint64_t counted = 0;
+
+    printf("Trace %u: %u instructions executed, last %u recorded\n\n", number, dump->total, dump->record_count);
+    printf("%8s  %4s  %-14s  %10s  %8s  %10s  %8s\n", "#", "pc", "instruction", "accumulator", "r10", "timer", "+ticks");
+
+    for(uint32_t i = 0; i < dump->record_count; i++)
+    {
+        const trace_record_t *record = &dump->records[i];
+        uint32_t index = dump->total - dump->record_count + i;
+
+        format_instruction(text, sizeof(text), record->instruction);
+        printf("%8u  0x%02X  %-14s  0x%08X  0x%04X  0x%08X", index, record->pc, text, record->accumulator,
+               record->multiply_high, record->timer);
+
+        if(i > 0)
+        {
+            printf("  %8u", record->timer - dump->records[i - 1].timer);
+        }
+
+        printf("\n");
+    }
+
+    if(dump->record_count > 1)
+    {
+        uint32_t ticks = dump->records[dump->record_count - 1].timer - dump->records[0].timer;
+        double seconds = ticks * (NS_PER_TICK * 1e-9);
+
+        printf("\n%u instructions in %u ticks: %.1f ticks per instruction", dump->record_count - 1, ticks,
+               (double)ticks / (dump->record_count - 1));
+
+        if(ticks)
+        {
+            printf(", %.0f instructions per second", (dump->record_count - 1) / seconds);
+        }
+
+        printf("\n");
+    }
+
+    for(uint32_t i = 0; i < TRACE_OPCODES; i++)
+    {
+        counted += dump->opcode_counts[i];
+    }
+
+    printf("\n%-10s %10s %7s\n", "opcode", "count", "share");
+
+    // Printed in descending count order
+    uint32_t printed[TRACE_OPCODES] = {0};
+
+    for(uint32_t n = 0; n < TRACE_OPCODES; n++)
+    {
+        int best = -1;
+
+        for(uint32_t i = 0; i < TRACE_OPCODES; i++)
+        {
+            if(dump->opcode_counts[i] && !printed[i] && (best < 0 || dump->opcode_counts[i] > dump->opcode_counts[best]))
+            {
+                best = i;
+            }
+        }
+
+        if(best < 0)
+        {
+            break;
+        }
+
+        printed[best] = 1;
+        const char *mnemonic = robomal_mnemonic(best);
+        printf("%-10s %10u %6.1f%%\n", mnemonic ? mnemonic : "?", dump->opcode_counts[best],
+               100.0 * dump->opcode_counts[best] / counted);
+    }
+
+    printf("\n%-4s  %-14s %10s %7s\n", "pc", "instruction", "count", "share");
+
+    uint32_t shown[TRACE_PCS] = {0};
+
+    for(uint32_t n = 0; n < HOT_PC_COUNT; n++)
+    {
+        int best = -1;
+
+        for(uint32_t pc = 0; pc < TRACE_PCS; pc++)
+        {
+            if(dump->pc_counts[pc] && !shown[pc] && (best < 0 || dump->pc_counts[pc] > dump->pc_counts[best]))
+            {
+                best = pc;
+            }
+        }
+
+        if(best < 0)
+        {
+            break;
+        }
+
+        shown[best] = 1;
+
+        if(dump->pc_instruction[best] != UINT32_MAX)
+        {
+            format_instruction(text, sizeof(text), dump->pc_instruction[best]);
+        }
+        else
+        {
+            strcpy(text, "-");
+        }
+
+        printf("0x%02X  %-14s %10u %6.1f%%\n", best, text, dump->pc_counts[best], 100.0 * dump->pc_counts[best] / counted);
+    }
+
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    static trace_dump_t dump;
+    FILE *file = stdin;
+    char line[256];
+    uint32_t dumps = 0;
+    int in_dump = 0;
+
+    if(argc > 2)
+    {
+        fprintf(stderr, "usage: %s [capture.log]\n", argv[0]);
+        return 2;
+    }
+
+    if(argc == 2 && !(file = fopen(argv[1], "r")))
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    while(fgets(line, sizeof(line), file))
+    {
+        // The board may send \r\n or interleave other output before the framing
+        char *start = strstr(line, "ROBO_TRACE");
+        trace_record_t record;
+        uint32_t key, value;
+
+        if(start && strncmp(start, "ROBO_TRACE_END", 14) == 0)
+        {
+            if(in_dump)
+            {
+                print_dump(&dump, ++dumps);
+            }
+
+            in_dump = 0;
+        }
+        else if(start && sscanf(start, "ROBO_TRACE %x", &value) == 1)
+        {
+            memset(&dump, 0, sizeof(dump));
+            memset(dump.pc_instruction, 0xFF, sizeof(dump.pc_instruction));
+            dump.total = value;
+            in_dump = 1;
+        }
+        else if(!in_dump)
+        {
+            continue;
+        }
+        else if(sscanf(line, "R %x %x %x %x %x", &record.pc, &record.instruction, &record.accumulator,
+                       &record.multiply_high, &record.timer) == 5)
+        {
+            if(dump.record_count < TRACE_MAX_RECORDS)
+            {
+                dump.records[dump.record_count++] = record;
+                dump.pc_instruction[record.pc & (TRACE_PCS - 1)] = record.instruction;
+            }
+        }
+        else if(sscanf(line, "C %x %x", &key, &value) == 2 && key < TRACE_OPCODES)
+        {
+            dump.opcode_counts[key] = value;
+        }
+        else if(sscanf(line, "H %x %x", &key, &value) == 2 && key < TRACE_PCS)
+        {
+            dump.pc_counts[key] = value;
+        }
+    }
+
+    if(file != stdin)
+    {
+        fclose(file);
+    }
+
+    if(in_dump)
+    {
+        fprintf(stderr, "warning: capture ends inside a trace dump\n");
+    }
+
+    if(dumps == 0)
+    {
+        fprintf(stderr, "no ROBO_TRACE dump found\n");
+        return 1;
+    }
+
+    return 0;
+}
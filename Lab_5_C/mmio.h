@@ -0,0 +1,29 @@
+#ifndef MMIO_H
+#define MMIO_H
+
+#include <stdint.h>
+
+// Every peripheral register access goes through mmio_read/mmio_write. On
+// the board they are single volatile loads and stores. A host build
+// defines MMIO_HOST and links Host/sim/mmio_sim.c, which routes them to
+// simulated peripherals so the drivers run, and can be measured, on Linux.
+#ifdef MMIO_HOST
+
+uint32_t mmio_read(uint32_t address);
+void mmio_write(uint32_t address, uint32_t value);
+
+#else
+
+static inline uint32_t mmio_read(uint32_t address)
+{
+    return *((volatile uint32_t*)(uintptr_t)address);
+}
+
+static inline void mmio_write(uint32_t address, uint32_t value)
+{
+    *((volatile uint32_t*)(uintptr_t)address) = value;
+}
+
+#endif
+
+#endif // MMIO_H
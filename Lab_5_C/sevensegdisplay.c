@@ -0,0 +1,370 @@
+/*******************************************************************************
+ * Description: C equivalent of Lab_5/sevensegdisplay.S. bin_to_bcd splits
+ *              digits off with a multiply by the reciprocal of 10, so every
+ *              value costs the same, and unsigned_division is a bounded
+ *              shift and subtract instead of repeated subtraction.
+ *
+ *              The display runs in segment mode: decimal, signed and hex
+ *              values are turned into segment patterns from a table, which
+ *              also allows blanked leading zeros, a minus sign and decimal
+ *              points. The driver keeps what the display shows, so writing
+ *              the same value again (every timer tick in Lab 5) neither
+ *              converts nor touches the register.
+ ******************************************************************************/
+
+#include "sevensegdisplay.h"
+
+// Segment patterns of the digits 0 - F
+static const uint8_t digit_patterns[16] =
+{
+    0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07,
+    0x7F, 0x6F, 0x77, 0x7C, 0x39, 0x5E, 0x79, 0x71
+};
+
+// What the display shows
+static sevseg_format_t shown_format = SEVSEG_FORMAT_NONE;
+static uint32_t shown_value = 0;
+static uint32_t data_register = 0;
+
+static uint32_t points = 0;             // Bit n lights the point of digit n
+static bool blank_zeros = false;
+
+/************************************************************
+ * Function: init_seven_seg
+ * Description: Enables the seven-segment display in segment
+ *              mode and blanks it.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+void init_seven_seg()
+{
+    mmio_write(SEVSEG_BASEADDR + SEVSEG_CTRL_OFFSET, SEVSEG_ENABLE | (SEVSEG_MODE_SEGMENTS << 1));
+    mmio_write(SEVSEG_BASEADDR + SEVSEG_DATA_OFFSET, 0);
+
+    shown_format = SEVSEG_FORMAT_NONE;
+    shown_value = 0;
+    data_register = 0;
+}
+
+/************************************************************
+ * Function: digits_to_segments
+ * Description: Looks up the segment pattern of each digit,
+ *              leaving leading zeros dark when blanking is on.
+ *              At least one digit is always shown.
+ * Input parameters:
+ *      - digits: One digit (0 - F) per byte, digit 0 lowest
+ *      - shown: Output, number of digits lit
+ * Returns: uint32_t - Segment patterns, one digit per byte
+ ************************************************************/
+static uint32_t digits_to_segments(uint32_t digits, uint32_t *shown)
+{
+    uint32_t segments = 0;
+    uint32_t count = SEVSEG_DIGITS;
+
+    while(blank_zeros && count > 1 && !((digits >> ((count - 1) * 8)) & 0xFF))
+    {
+        count--;
+    }
+
+    for(uint32_t digit = 0; digit < count; digit++)
+    {
+        segments |= (uint32_t)digit_patterns[(digits >> (digit * 8)) & 0x0F] << (digit * 8);
+    }
+
+    *shown = count;
+    return segments;
+}
+
+/************************************************************
+ * Function: render
+ * Description: Turns the shown value into segment patterns and
+ *              writes them, with the decimal points, if they
+ *              differ from what the register holds.
+ * Input parameters: None
+ * Returns: None
+ ************************************************************/
+static void render()
+{
+    uint32_t segments = 0;
+    uint32_t shown;
+
+    switch(shown_format)
+    {
+        case SEVSEG_FORMAT_DEC:
+        segments = digits_to_segments(bin_to_bcd(shown_value), &shown);
+        break;
+
+        case SEVSEG_FORMAT_SIGNED:
+        if((int32_t)shown_value >= 0)
+        {
+            segments = digits_to_segments(bin_to_bcd(shown_value), &shown);
+        }
+        else
+        {
+            // Minus sign left of the digits, in place of the top digit
+            // when zeros are not blanked
+            segments = digits_to_segments(bin_to_bcd(-shown_value) & 0x00FFFFFF, &shown);
+
+            if(shown == SEVSEG_DIGITS)
+            {
+                shown--;
+            }
+
+            segments &= ~(0xFFu << (shown * 8));
+            segments |= (uint32_t)SEVSEG_PATTERN_MINUS << (shown * 8);
+        }
+        break;
+
+        case SEVSEG_FORMAT_HEX:
+        {
+            uint32_t digits = 0;
+
+            for(uint32_t digit = 0; digit < SEVSEG_DIGITS; digit++)
+            {
+                digits |= ((shown_value >> (digit * 4)) & 0x0F) << (digit * 8);
+            }
+
+            segments = digits_to_segments(digits, &shown);
+        }
+        break;
+
+        case SEVSEG_FORMAT_RAW:
+        segments = shown_value;
+        break;
+
+        default:
+        break;
+    }
+
+    for(uint32_t digit = 0; digit < SEVSEG_DIGITS; digit++)
+    {
+        if(points & (1 << digit))
+        {
+            segments |= (uint32_t)SEVSEG_POINT << (digit * 8);
+        }
+    }
+
+    if(segments != data_register)
+    {
+        mmio_write(SEVSEG_BASEADDR + SEVSEG_DATA_OFFSET, segments);
+        data_register = segments;
+    }
+}
+
+/************************************************************
+ * Function: show
+ * Description: Puts a value on the display unless it is
+ *              already there.
+ * Input parameters:
+ *      - format: How to show the value
+ *      - value: Value, or segment patterns for SEVSEG_FORMAT_RAW
+ * Returns: None
+ ************************************************************/
+static void show(sevseg_format_t format, uint32_t value)
+{
+    if(format == shown_format && value == shown_value)
+    {
+        return;
+    }
+
+    shown_format = format;
+    shown_value = value;
+    render();
+}
+
+/************************************************************
+ * Function: write_seven_seg_dec
+ * Description: Shows the low four decimal digits of a value.
+ * Input parameters:
+ *      - value: Value to display
+ * Returns: None
+ ************************************************************/
+void write_seven_seg_dec(uint32_t value)
+{
+    show(SEVSEG_FORMAT_DEC, value);
+}
+
+/************************************************************
+ * Function: write_seven_seg_signed
+ * Description: Shows a signed decimal value. Values from
+ *              SEVSEG_SIGNED_MIN to SEVSEG_SIGNED_MAX fit; others
+ *              show their low digits (three for negatives).
+ * Input parameters:
+ *      - value: Value to display
+ * Returns: None
+ ************************************************************/
+void write_seven_seg_signed(int32_t value)
+{
+    show(SEVSEG_FORMAT_SIGNED, (uint32_t)value);
+}
+
+/************************************************************
+ * Function: write_seven_seg_hex
+ * Description: Shows the low four hex digits of a value.
+ * Input parameters:
+ *      - value: Value to display
+ * Returns: None
+ ************************************************************/
+void write_seven_seg_hex(uint32_t value)
+{
+    show(SEVSEG_FORMAT_HEX, value);
+}
+
+/************************************************************
+ * Function: write_seven_seg_raw
+ * Description: Shows segment patterns as given, see the
+ *              SEVSEG_SEGMENT_* bits. Decimal points set with
+ *              seven_seg_set_points are added.
+ * Input parameters:
+ *      - segments: One pattern per byte, digit 0 lowest
+ * Returns: None
+ ************************************************************/
+void write_seven_seg_raw(uint32_t segments)
+{
+    show(SEVSEG_FORMAT_RAW, segments);
+}
+
+/************************************************************
+ * Function: seven_seg_set_points
+ * Description: Chooses which decimal points are lit.
+ * Input parameters:
+ *      - new_points: Bit n lights the point of digit n
+ * Returns: None
+ ************************************************************/
+void seven_seg_set_points(uint32_t new_points)
+{
+    new_points &= (1 << SEVSEG_DIGITS) - 1;
+
+    if(new_points != points)
+    {
+        points = new_points;
+        render();
+    }
+}
+
+/************************************************************
+ * Function: seven_seg_set_blank_zeros
+ * Description: Turns leading-zero blanking on or off for the
+ *              decimal, signed and hex formats.
+ * Input parameters:
+ *      - blank: true leaves leading zeros dark
+ * Returns: None
+ ************************************************************/
+void seven_seg_set_blank_zeros(bool blank)
+{
+    if(blank != blank_zeros)
+    {
+        blank_zeros = blank;
+        render();
+    }
+}
+
+/************************************************************
+ * Function: seven_seg_digit_pattern
+ * Description: Returns the segment pattern of a digit, for
+ *              building write_seven_seg_raw patterns.
+ * Input parameters:
+ *      - digit: 0 - 15
+ * Returns: uint32_t - Segment pattern
+ ************************************************************/
+uint32_t seven_seg_digit_pattern(uint32_t digit)
+{
+    return digit_patterns[digit & 0x0F];
+}
+
+/************************************************************
+ * Function: bin_to_bcd
+ * Description: Converts the low four decimal digits of a value
+ *              to BCD, one digit per byte, least significant
+ *              digit in the low byte. value / 10 is computed as
+ *              (value * 0xCCCCCCCD) >> 35, exact for every
+ *              32-bit value (a single UMULL on the Zynq).
+ * Input parameters:
+ *      - value: Binary value to convert
+ * Returns: uint32_t - BCD representation
+ ************************************************************/
+uint32_t bin_to_bcd(uint32_t value)
+{
+    uint32_t bcd = 0;
+
+    for(uint32_t digit = 0; digit < SEVSEG_DIGITS; digit++)
+    {
+        uint32_t quotient = (uint32_t)(((uint64_t)value * 0xCCCCCCCDu) >> 35);
+
+        bcd |= (value - quotient * 10) << (digit * 8);
+        value = quotient;
+    }
+
+    return bcd;
+}
+
+/************************************************************
+ * Function: unsigned_division
+ * Description: Unsigned division by shift and subtract from the
+ *              numerator's highest set bit, at most 32 steps.
+ *              Division by zero gives a quotient and remainder
+ *              of 0xFFFFFFFF like the assembly version.
+ * Input parameters:
+ *      - numerator: Dividend
+ *      - denominator: Divisor
+ *      - remainder: Output, numerator % denominator (may be NULL)
+ * Returns: uint32_t - Quotient
+ ************************************************************/
+uint32_t unsigned_division(uint32_t numerator, uint32_t denominator, uint32_t *remainder)
+{
+    uint32_t quotient = 0;
+
+    if(denominator == 0)
+    {
+        quotient = 0xFFFFFFFF;
+        numerator = 0xFFFFFFFF;
+    }
+    else if(numerator >= denominator)
+    {
+        // Lining the divisor's top bit up with the numerator's
+        uint32_t shift = __builtin_clz(denominator) - __builtin_clz(numerator);
+        uint32_t bit = 1u << shift;
+
+        denominator <<= shift;
+
+        while(bit)
+        {
+            if(numerator >= denominator)
+            {
+                numerator -= denominator;
+                quotient |= bit;
+            }
+
+            denominator >>= 1;
+            bit >>= 1;
+        }
+    }
+
+    if(remainder)
+    {
+        *remainder = numerator;
+    }
+
+    return quotient;
+}
+
+/************************************************************
+ * Function: udiv
+ * Description: Unsigned division, quotient only.
+ ************************************************************/
+uint32_t udiv(uint32_t numerator, uint32_t denominator)
+{
+    return unsigned_division(numerator, denominator, 0);
+}
+
+/************************************************************
+ * Function: umod
+ * Description: Unsigned division, remainder only.
+ ************************************************************/
+uint32_t umod(uint32_t numerator, uint32_t denominator)
+{
+    uint32_t remainder;
+
+    unsigned_division(numerator, denominator, &remainder);
+    return remainder;
+}
@@ -0,0 +1,59 @@
+#ifndef SEVENSEGDISPLAY_H
+#define SEVENSEGDISPLAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mmio.h"
+
+#define SEVSEG_BASEADDR 0x43C10000
+#define SEVSEG_CTRL_OFFSET 0x0
+#define SEVSEG_DATA_OFFSET 0x4
+
+#define SEVSEG_ENABLE 0b01
+#define SEVSEG_MODE_BCD 0b00
+#define SEVSEG_MODE_SEGMENTS 0b01
+
+#define SEVSEG_DIGITS 4
+
+// Digit byte in segment mode, digit 0 (rightmost) in the low byte:
+// bits 0 - 6 light segments a - g, bit 7 the decimal point
+#define SEVSEG_SEGMENT_A 0x01
+#define SEVSEG_SEGMENT_B 0x02
+#define SEVSEG_SEGMENT_C 0x04
+#define SEVSEG_SEGMENT_D 0x08
+#define SEVSEG_SEGMENT_E 0x10
+#define SEVSEG_SEGMENT_F 0x20
+#define SEVSEG_SEGMENT_G 0x40
+#define SEVSEG_POINT 0x80
+
+#define SEVSEG_PATTERN_MINUS SEVSEG_SEGMENT_G
+#define SEVSEG_PATTERN_BLANK 0x00
+
+// Signed values that fit: a minus sign and three digits
+#define SEVSEG_SIGNED_MIN -999
+#define SEVSEG_SIGNED_MAX 9999
+
+typedef enum
+{
+    SEVSEG_FORMAT_DEC,
+    SEVSEG_FORMAT_SIGNED,
+    SEVSEG_FORMAT_HEX,
+    SEVSEG_FORMAT_RAW,
+    SEVSEG_FORMAT_NONE          // Nothing shown since init_seven_seg
+} sevseg_format_t;
+
+void init_seven_seg();
+void write_seven_seg_dec(uint32_t value);
+void write_seven_seg_signed(int32_t value);
+void write_seven_seg_hex(uint32_t value);
+void write_seven_seg_raw(uint32_t segments);
+void seven_seg_set_points(uint32_t points);
+void seven_seg_set_blank_zeros(bool blank);
+uint32_t seven_seg_digit_pattern(uint32_t digit);
+uint32_t bin_to_bcd(uint32_t value);
+
+uint32_t unsigned_division(uint32_t numerator, uint32_t denominator, uint32_t *remainder);
+uint32_t udiv(uint32_t numerator, uint32_t denominator);
+uint32_t umod(uint32_t numerator, uint32_t denominator);
+
+#endif // SEVENSEGDISPLAY_H